@@ -0,0 +1,45 @@
+/*
+ * Microbenchmark for klee_intercept_reads/klee_intercept_writes: a loop
+ * accessing a device model either through interceptors or, with -DPLAIN,
+ * as plain memory. A second, never intercepted, buffer is accessed in both
+ * variants. See scripts/bench-intercept.sh.
+ */
+#include "klee/klee.h"
+
+#include <stdint.h>
+
+#ifndef ITERATIONS
+#define ITERATIONS 100000
+#endif
+
+#define DEVICE ((volatile uint32_t *)0x10000)
+
+static uint32_t registers[4];
+
+uint64_t device_read(uint64_t addr, unsigned offset, unsigned size) {
+  return registers[offset / 4];
+}
+
+void device_write(uint64_t addr, unsigned offset, unsigned size,
+                  uint64_t value) {
+  registers[offset / 4] = value;
+}
+
+int main() {
+  volatile uint32_t buffer[4] = {0};
+  uint32_t sum = 0;
+
+  klee_define_fixed_object((void *)DEVICE, sizeof(registers));
+#ifndef PLAIN
+  klee_intercept_reads((void *)DEVICE, "device_read");
+  klee_intercept_writes((void *)DEVICE, "device_write");
+#endif
+
+  for (unsigned i = 0; i < ITERATIONS; ++i) {
+    DEVICE[i % 4] = i;
+    sum += DEVICE[(i + 1) % 4];
+    buffer[i % 4] = sum;
+    sum += buffer[(i + 3) % 4];
+  }
+  return sum == 0;
+}
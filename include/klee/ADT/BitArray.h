@@ -59,6 +59,19 @@ public:
   void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
   void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
   void set(unsigned idx, bool value) { if (value) set(idx); else unset(idx); }
+  /// Sets the bits in [begin, end) to value, a word at a time.
+  void set(unsigned begin, unsigned end, bool value) {
+    while (begin < end) {
+      unsigned bit = begin & 0x1F;
+      unsigned n = end - begin < 32 - bit ? end - begin : 32 - bit;
+      uint32_t mask = n == 32 ? ~0u : ((1u << n) - 1) << bit;
+      if (value)
+        bits[begin/32] |= mask;
+      else
+        bits[begin/32] &= ~mask;
+      begin += n;
+    }
+  }
   unsigned size() const { return len*32; }
   const uint32_t *get_bits() const { return bits; }
 };
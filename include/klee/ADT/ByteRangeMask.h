@@ -0,0 +1,112 @@
+//===-- ByteRangeMask.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BYTERANGEMASK_H
+#define KLEE_BYTERANGEMASK_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace klee {
+
+/// A set of byte offsets, stored as sorted, disjoint and non-adjacent
+/// half-open ranges. Masks of large objects in which few, mostly
+/// contiguous, bytes are set take space proportional to the number of
+/// ranges rather than to the size of the object.
+class ByteRangeMask {
+public:
+  struct Range {
+    unsigned begin, end;
+
+    bool operator==(const Range &b) const {
+      return begin == b.begin && end == b.end;
+    }
+  };
+
+  typedef std::vector<Range>::const_iterator iterator;
+
+private:
+  std::vector<Range> ranges;
+
+  /// The first range ending at or after `offset`.
+  std::vector<Range>::iterator lowerBound(unsigned offset) {
+    return std::lower_bound(
+        ranges.begin(), ranges.end(), offset,
+        [](const Range &r, unsigned offset) { return r.end < offset; });
+  }
+
+public:
+  bool empty() const { return ranges.empty(); }
+  iterator begin() const { return ranges.begin(); }
+  iterator end() const { return ranges.end(); }
+  size_t numRanges() const { return ranges.size(); }
+
+  bool get(unsigned offset) const {
+    auto it = std::upper_bound(
+        ranges.begin(), ranges.end(), offset,
+        [](unsigned offset, const Range &r) { return offset < r.end; });
+    return it != ranges.end() && it->begin <= offset;
+  }
+
+  /// Sets the bytes in [begin, end), merging the ranges it overlaps or
+  /// touches.
+  void set(unsigned begin, unsigned end) {
+    if (begin >= end)
+      return;
+    auto first = lowerBound(begin);
+    auto last = first;
+    while (last != ranges.end() && last->begin <= end)
+      ++last;
+    if (first == last) {
+      ranges.insert(first, Range{begin, end});
+      return;
+    }
+    first->begin = std::min(first->begin, begin);
+    first->end = std::max((last - 1)->end, end);
+    ranges.erase(first + 1, last);
+  }
+
+  void set(unsigned offset) { set(offset, offset + 1); }
+
+  /// The number of bytes set.
+  uint64_t count() const {
+    uint64_t n = 0;
+    for (const Range &r : ranges)
+      n += r.end - r.begin;
+    return n;
+  }
+
+  /// The heap memory used by the mask.
+  size_t memoryUsage() const { return ranges.capacity() * sizeof(Range); }
+
+  /// Writes the mask as a bit array of `numWords` 32-bit words, filling
+  /// whole words at once.
+  void toBits(uint32_t *words, unsigned numWords) const {
+    std::fill(words, words + numWords, 0);
+    for (const Range &r : ranges) {
+      unsigned begin = r.begin, end = std::min(r.end, numWords * 32);
+      while (begin < end) {
+        unsigned bit = begin % 32, n = std::min(32 - bit, end - begin);
+        uint32_t bits = n == 32 ? ~0u : ((1u << n) - 1) << bit;
+        words[begin / 32] |= bits;
+        begin += n;
+      }
+    }
+  }
+
+  bool operator==(const ByteRangeMask &b) const { return ranges == b.ranges; }
+  bool operator!=(const ByteRangeMask &b) const { return !(*this == b); }
+};
+
+} // End klee namespace
+
+#endif /* KLEE_BYTERANGEMASK_H */
@@ -31,6 +31,7 @@
 
 #include "klee/Support/Casting.h"
 
+#include <atomic>
 #include <cassert>
 #include <iosfwd> // FIXME: Remove this when LLVM 4.0 support is removed!!!
 
@@ -49,7 +50,12 @@ class ReferenceCounter {
   friend class ref;
 
   /// Count how often the object has been referenced.
-  unsigned refCount = 0;
+  std::atomic<unsigned> refCount{0};
+
+  static bool &threadSafe() {
+    static bool value = false;
+    return value;
+  }
 
 public:
   ReferenceCounter() = default;
@@ -62,14 +68,14 @@ public:
 
   /// Returns the number of parallel references of this objects
   /// \return number of references on this object
-  unsigned getCount() {return refCount;}
+  unsigned getCount() const { return refCount.load(std::memory_order_relaxed); }
 
   // Copy assignment operator
   ReferenceCounter &operator=(const ReferenceCounter &a) {
     if (this == &a)
       return *this;
     // The new copy won't be referenced
-    refCount = 0;
+    refCount.store(0, std::memory_order_relaxed);
     return *this;
   }
 
@@ -77,6 +83,31 @@ public:
   // as otherwise, references become incorrect.
   ReferenceCounter(ReferenceCounter &&r) noexcept = delete;
   ReferenceCounter &operator=(ReferenceCounter &&other) noexcept = delete;
+
+  /// Whether counts are updated with atomic read-modify-write operations,
+  /// so that objects may be referenced from several threads. Otherwise
+  /// they are plain increments and decrements. Must be set before a second
+  /// thread references any object.
+  static void setThreadSafe(bool value) { threadSafe() = value; }
+  static bool isThreadSafe() { return threadSafe(); }
+
+  /// Increments `count`.
+  static void increment(std::atomic<unsigned> &count) {
+    if (isThreadSafe())
+      count.fetch_add(1, std::memory_order_relaxed);
+    else
+      count.store(count.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+  }
+
+  /// Decrements `count` and returns its new value.
+  static unsigned decrement(std::atomic<unsigned> &count) {
+    if (isThreadSafe())
+      return count.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    unsigned value = count.load(std::memory_order_relaxed) - 1;
+    count.store(value, std::memory_order_relaxed);
+    return value;
+  }
 };
 
 template<class T>
@@ -90,16 +121,14 @@ public:
 
 private:
   void inc() const {
-    if (ptr) {
-      assert(0 <= ptr->_refCount.refCount);
-      ++ptr->_refCount.refCount;
-    }
+    if (ptr)
+      ReferenceCounter::increment(ptr->_refCount.refCount);
   }
 
   void dec() const {
     if (ptr) {
-      assert(0 < ptr->_refCount.refCount);
-      if (--ptr->_refCount.refCount == 0)
+      assert(0 < ptr->_refCount.getCount());
+      if (ReferenceCounter::decrement(ptr->_refCount.refCount) == 0)
         delete ptr;
     }
   }
@@ -15,7 +15,7 @@
 #include <string>
 #include <vector>
 
-#include "klee/ADT/BitArray.h"
+#include "klee/ADT/ByteRangeMask.h"
 
 struct KTest;
 
@@ -30,6 +30,7 @@ class raw_fd_ostream;
 namespace klee {
 class ExecutionState;
 class Interpreter;
+class SolverService;
 class TreeStreamWriter;
 
 class InterpreterHandler {
@@ -48,12 +49,16 @@ public:
                                const char *err,
                                const char *suffix) = 0;
   virtual void processCallPath(const ExecutionState &state) = 0;
+
+  /// Called for a state stopped at a path prefix (see
+  /// InterpreterOptions::PathPrefixDepth) instead of a test case.
+  virtual void processPathPrefix(const ExecutionState &state) {}
 };
 
 struct HavocedLocation {
   std::string name;
   std::vector<unsigned char> value;
-  BitArray mask;
+  ByteRangeMask mask;
 };
 
 class Interpreter {
@@ -95,9 +100,30 @@ public:
     /// that alter their value during the loop invariant analysis.
     bool CondoneUndeclaredHavocs;
 
+    /// The number of threads exploring states in parallel (0 or 1 for a
+    /// single one).
+    unsigned ParallelWorkers;
+
+    /// When non-zero, states are stopped at the first symbolic branch that
+    /// takes them to this depth, and their branch decisions are handed to
+    /// the handler as a path prefix to be explored separately.
+    unsigned PathPrefixDepth;
+
+    /// Whether the replay path is a prefix: once it is exhausted, all paths
+    /// are explored, and paths leaving it are silently dropped.
+    bool ReplayPathIsPrefix;
+
+    /// Whether to record every instruction executed while tracing, for the
+    /// handler to dump.
+    bool RecordInstructionTrace;
+
     InterpreterOptions()
       : MakeConcreteSymbolic(false),
-        CondoneUndeclaredHavocs(false)
+        CondoneUndeclaredHavocs(false),
+        ParallelWorkers(0),
+        PathPrefixDepth(0),
+        ReplayPathIsPrefix(false),
+        RecordInstructionTrace(false)
     {}
   };
 
@@ -177,6 +203,10 @@ public:
 
   virtual void getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) = 0;
+
+  /// The services over the solver chains of the interpreter, one per
+  /// worker thread, through which other analyses can share their caches.
+  virtual std::vector<SolverService *> getSolverServices() = 0;
 };
 
 } // End klee namespace
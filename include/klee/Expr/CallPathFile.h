@@ -0,0 +1,114 @@
+//===-- CallPathFile.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CALLPATHFILE_H
+#define KLEE_CALLPATHFILE_H
+
+#include "klee/Expr/Expr.h"
+
+#include "llvm/ADT/StringRef.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace klee {
+class ArrayCache;
+namespace expr {
+class Decl;
+class Parser;
+}
+
+/// The contents of a call path (.call_path) file: the path constraints of a
+/// test, the expressions it evaluated, and the "Calls", "Tags", "BPF
+/// Calls" and "Path Cost" sections. The calls refer to the evaluated expressions by
+/// position, in the order of `values`.
+///
+/// A call path is stored either as text, where the expressions are a kQuery
+/// that has to be parsed, or in a binary format where every unique
+/// expression is serialized once and referenced by index:
+///
+///   header:      "KCALLPTH", u32 version, u32 reserved
+///   arrays:      u32 count, then per array: str name, u32 size, u32 domain,
+///                u32 range, u32 number of constant values, u64 values
+///   nodes:       u32 count, then per node a u8 tag followed by
+///                - an update (tag 0xff): u32 next + 1 (0 if none),
+///                  u32 index, u32 value
+///                - an expression (tag = Expr::Kind): u32 width, then
+///                  Constant: u32 number of words, u64 words
+///                  Read:     u32 array, u32 update list head + 1, u32 index
+///                  Extract:  u32 offset, u32 expr
+///                  others:   u32 kids
+///   constraints: u32 count, u32 nodes
+///   values:      u32 count, u32 nodes
+///   calls:       str
+///   tags:        u32 count, str name, str value
+///   bpf calls:   str
+///   path cost:   str (since version 2)
+///
+/// All integers are little-endian and a str is a u32 length followed by its
+/// bytes. Nodes only refer to earlier nodes, so a reader builds every
+/// expression in a single pass over the buffer.
+class CallPathFile {
+  // Own the arrays of the call path; declared first so that they outlive the
+  // expressions referring to them.
+  std::unique_ptr<ArrayCache> arrayCache;
+  /// Where the arrays are created instead, if set.
+  ArrayCache *sharedArrayCache = nullptr;
+  std::unique_ptr<expr::Parser> parser;
+  /// The declarations of a text call path, which its parser refers to.
+  std::vector<std::unique_ptr<expr::Decl>> decls;
+
+public:
+  /// Version of the binary format written by writeBinary().
+  static const uint32_t BinaryVersion = 2;
+
+  std::vector<const Array *> arrays;
+  std::vector<ref<Expr>> constraints;
+  std::vector<ref<Expr>> values;
+  /// The "Calls" section, verbatim.
+  std::string calls;
+  std::vector<std::pair<std::string, std::string>> tags;
+  /// The "BPF Calls" section, verbatim.
+  std::string bpfCalls;
+  /// The "Path Cost" section, verbatim ("<counter> = <value>" lines). The
+  /// text format leaves an empty section out.
+  std::string pathCost;
+
+  CallPathFile();
+  /// Creates the arrays of the call path in `arrays`, which then outlive
+  /// it and are shared with the other call paths read into the same cache.
+  explicit CallPathFile(ArrayCache *arrays);
+  ~CallPathFile();
+  CallPathFile(const CallPathFile &) = delete;
+  CallPathFile &operator=(const CallPathFile &) = delete;
+
+  /// Whether `contents` is a call path in the binary format.
+  static bool isBinary(llvm::StringRef contents);
+
+  /// Reads a call path in either format. Returns false and sets `error` if
+  /// `contents` is malformed.
+  bool read(llvm::StringRef contents, std::string &error);
+  bool readText(llvm::StringRef contents, std::string &error);
+  bool readBinary(llvm::StringRef contents, std::string &error);
+
+  /// Writes the call path in the text format. Without `withExprs`, the
+  /// kQuery and "Constraints" sections are left empty.
+  void writeText(llvm::raw_ostream &os, bool withExprs = true) const;
+  void writeBinary(llvm::raw_ostream &os) const;
+};
+
+} // namespace klee
+
+#endif /* KLEE_CALLPATHFILE_H */
@@ -19,6 +19,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <atomic>
 #include <sstream>
 #include <set>
 #include <vector>
@@ -90,7 +91,8 @@ Todo: Shouldn't bool \c Xor just be written as not equal?
 
 class Expr {
 public:
-  static unsigned count;
+  /// The number of expressions alive.
+  static std::atomic<unsigned> count;
   static const unsigned MAGIC_HASH_CONSTANT = 39;
 
   /// The type of an expression is simply its width, in bits. 
@@ -204,8 +206,8 @@ protected:
   virtual int compareContents(const Expr &b) const = 0;
 
 public:
-  Expr() { Expr::count++; }
-  virtual ~Expr() { Expr::count--; } 
+  Expr() { ReferenceCounter::increment(Expr::count); }
+  virtual ~Expr() { ReferenceCounter::decrement(Expr::count); }
 
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
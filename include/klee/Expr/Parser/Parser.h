@@ -20,6 +20,7 @@ namespace llvm {
 }
 
 namespace klee {
+  class ArrayCache;
   class ExprBuilder;
 
 namespace expr {
@@ -221,6 +222,10 @@ namespace expr {
     /// \return NULL indicates the end of the file has been reached.
     virtual Decl *ParseTopLevelDecl() = 0;
 
+    /// DeclareArray - Make an array created elsewhere visible to the
+    /// following declarations, as if it had been declared under its name.
+    virtual void DeclareArray(const Array *Root) = 0;
+
     /// CreateParser - Create a parser implementation for the given
     /// MemoryBuffer.
     ///
@@ -228,8 +233,11 @@ namespace expr {
     /// \arg MB - The input data.
     /// \arg Builder - The expression builder to use for constructing
     /// expressions.
+    /// \arg Arrays - Where to create the declared arrays, so that they
+    /// outlive the parser. By default, the parser owns them.
     static Parser *Create(const std::string Name, const llvm::MemoryBuffer *MB,
-                          ExprBuilder *Builder, bool ClearArrayAfterQuery);
+                          ExprBuilder *Builder, bool ClearArrayAfterQuery,
+                          ArrayCache *Arrays = nullptr);
   };
 }
 }
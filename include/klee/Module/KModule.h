@@ -10,6 +10,7 @@
 #ifndef KLEE_KMODULE_H
 #define KLEE_KMODULE_H
 
+#include "klee/ADT/ByteRangeMask.h"
 #include "klee/Config/Version.h"
 #include "klee/Core/Interpreter.h"
 
@@ -20,6 +21,7 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
 #include <vector>
 
 namespace llvm {
@@ -44,10 +46,16 @@ namespace klee {
   class TimingSolver;
   class LoopEntryState;
   class MemoryObject;
-  class BitArray;
-  
+
   /// A global bytemask for all the memory of a program.
-using StateByteMask = std::map<const MemoryObject *, BitArray *>;
+using StateByteMask = std::map<const MemoryObject *, ByteRangeMask>;
+
+  /// The objects the entry state of a loop may havoc: their havoc names
+  /// and sizes.
+using LoopEntryAbstraction = std::map<std::string, unsigned>;
+
+  /// The bytes a loop may change, by havoc name.
+using LoopSummary = std::map<std::string, ByteRangeMask>;
 
   struct KFunction {
     llvm::Function *function;
@@ -71,10 +79,16 @@ using StateByteMask = std::map<const MemoryObject *, BitArray *>;
     /// Keep track of the loops that were analysed on the subject of
     /// the invariants. Map these loops to the most general (i.e. the smallest)
     /// set of invariants.
-    /// Owns the StateByteMask values.
+    /// Owns the LoopEntryState values.
     std::map<const llvm::Loop*,
              LoopEntryState*> analysedLoops;
 
+    /// The results of finished invariant analyses, by loop and by the
+    /// abstraction of their entry state, to seed later analyses of the loop
+    /// in any state with the same abstraction.
+    std::map<std::pair<const llvm::Loop *, LoopEntryAbstraction>, LoopSummary>
+        loopSummaries;
+
   public:
     explicit KFunction(llvm::Function*, KModule *);
     KFunction(const KFunction &) = delete;
@@ -89,6 +103,17 @@ using StateByteMask = std::map<const MemoryObject *, BitArray *>;
                 const ExecutionState& state);
     LoopEntryState* analysedStateFor(const llvm::Loop *loop);
     void clearAnalysedLoops();
+
+    /// The memory used by the forget masks of the analysed loops and by the
+    /// loop summaries.
+    size_t getAnalysedLoopsMemoryUsage() const;
+
+    const LoopSummary *summaryFor(const llvm::Loop *loop,
+                                  const LoopEntryAbstraction &entry) const;
+    /// Returns false if the same summary was already known.
+    bool insertSummary(const llvm::Loop *loop,
+                       const LoopEntryAbstraction &entry,
+                       const LoopSummary &summary);
   };
 
 
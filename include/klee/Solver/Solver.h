@@ -243,6 +243,18 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createCexCachingSolver(Solver *s);
 
+  /// createPersistentCachingSolver - Create a solver which caches the
+  /// validity results, values and assignments of queries in a file, so that
+  /// they are reused by later runs and by concurrent processes sharing the
+  /// file. Queries are identified by a hash of their structure, with their
+  /// arrays numbered in the order they first appear rather than named,
+  /// independently of the order of their constraints. Returns \p s itself
+  /// if the file cannot be used.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param path - The cache file, created if it does not exist.
+  Solver *createPersistentCachingSolver(Solver *s, const std::string &path);
+
   /// createFastCexSolver - Create a "fast counterexample solver", which tries
   /// to quickly compute a satisfying assignment for a constraint set using
   /// value propogation and range analysis.
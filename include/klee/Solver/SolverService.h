@@ -0,0 +1,75 @@
+//===-- SolverService.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SOLVERSERVICE_H
+#define KLEE_SOLVERSERVICE_H
+
+#include "klee/System/Time.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace klee {
+class Solver;
+
+/// A solver chain shared by the components of a process, so that the
+/// queries answered for one client (e.g. the executor) are cached for all
+/// the others. Every client is a Solver of its own, with its own timeout and
+/// statistics.
+///
+/// A service and its clients are not synchronized: they must be used by one
+/// thread at a time, as must the expressions its caches keep. Threads that
+/// query concurrently get a service each, as the workers of the executor do
+/// (where the expressions they share are counted atomically, see
+/// ReferenceCounter::setThreadSafe).
+class SolverService {
+public:
+  struct ClientStats {
+    std::string name;
+    std::uint64_t queries = 0;
+    /// Queries answered without querying the core solver.
+    std::uint64_t cacheHits = 0;
+    time::Span time;
+  };
+
+private:
+  class Client;
+
+  std::unique_ptr<Solver> solver;
+  /// Statistics of the clients, in order of creation.
+  std::deque<ClientStats> clients;
+
+public:
+  /// Serve the queries of the clients with `solver`.
+  explicit SolverService(Solver *solver);
+  ~SolverService();
+
+  /// A service over the usual chain of the tools: independence, query
+  /// caching and counterexample caching in front of `coreSolver`.
+  static std::unique_ptr<SolverService> create(Solver *coreSolver);
+
+  /// A new client named `name`. The client must not outlive the service.
+  Solver *createClient(const std::string &name);
+
+  std::vector<ClientStats> getClientStats() const;
+
+  /// Prints one line of statistics per client, starting with `prefix`.
+  void printClientStats(llvm::raw_ostream &os, const char *prefix = "") const;
+};
+
+} // namespace klee
+
+#endif /* KLEE_SOLVERSERVICE_H */
@@ -23,9 +23,30 @@ namespace stats {
   extern Statistic queryCacheMisses;
   extern Statistic queryCexCacheHits;
   extern Statistic queryCexCacheMisses;
+  extern Statistic queryPersistentCacheHits;
+  extern Statistic queryPersistentCacheMisses;
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
   extern Statistic queryTime;
+
+  /// Constraints already asserted in the incremental Z3 solver and reused
+  /// by a later query.
+  extern Statistic z3IncrementalReused;
+
+  /// Queries the incremental Z3 solver gave up on and that were retried
+  /// with a fresh solver.
+  extern Statistic z3IncrementalFallbacks;
+
+  /// Queries whose constraint set the independent solver had already
+  /// partitioned, and queries for which it had to partition new
+  /// constraints.
+  extern Statistic independentPartitionHits;
+  extern Statistic independentPartitionMisses;
+
+  /// Constraints taken from a cached partition, and constraints the
+  /// independent solver had to add to one.
+  extern Statistic independentConstraintsReused;
+  extern Statistic independentConstraintsIndexed;
   
 #ifdef KLEE_ARRAY_DEBUG
   extern Statistic arrayHashTime;
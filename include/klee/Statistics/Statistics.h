@@ -45,6 +45,8 @@ namespace klee {
     uint64_t *indexedStats;
     StatisticRecord *contextStats;
     unsigned index;
+    /// The totals at the last snapshot().
+    std::vector<uint64_t> snapshotStats;
 
   public:
     StatisticManager();
@@ -62,6 +64,12 @@ namespace klee {
     
     void registerStatistic(Statistic &s);
     void incrementStatistic(Statistic &s, uint64_t addend);
+    /// Starts counting the statistics of `sm` from their current totals,
+    /// without indexed or context statistics.
+    void snapshot(const StatisticManager &sm);
+    /// Adds what was counted since the last snapshot to `sm`, attributing
+    /// it to the current instruction and context of `sm`.
+    void flushTo(StatisticManager &sm) const;
     uint64_t getValue(const Statistic &s) const;
     void incrementIndexedValue(const Statistic &s, unsigned index, 
                                uint64_t addend) const;
@@ -73,6 +81,12 @@ namespace klee {
 
   extern StatisticManager *theStatisticManager;
 
+  /// Makes the statistics of the calling thread count into `sm` instead of
+  /// theStatisticManager, e.g. while the thread runs without the lock that
+  /// protects theStatisticManager. Null to count into theStatisticManager
+  /// again.
+  void setThreadStatisticManager(StatisticManager *sm);
+
   inline void StatisticManager::incrementStatistic(Statistic &s, 
                                                    uint64_t addend) {
     if (enabled) {
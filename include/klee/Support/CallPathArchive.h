@@ -0,0 +1,81 @@
+//===-- CallPathArchive.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CALLPATHARCHIVE_H
+#define KLEE_CALLPATHARCHIVE_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+
+/// An append-only archive of named records, used to store the call paths of
+/// a run in a single file. Every record is compressed as its own gzip
+/// member, so the archive as a whole is a valid gzip file, and its location
+/// is appended to a text index next to it ("<archive>.idx"), one
+/// "<name> <offset> <size>" line per record.
+class CallPathArchiveWriter {
+  int FD;
+  std::ofstream index;
+  std::uint64_t offset;
+
+public:
+  CallPathArchiveWriter(const std::string &path, std::string &error);
+  ~CallPathArchiveWriter();
+
+  bool append(const std::string &name, const std::string &contents,
+              std::string &error);
+};
+
+class CallPathArchiveReader {
+public:
+  struct Record {
+    std::string name;
+    std::uint64_t offset;
+    std::uint64_t size;
+  };
+
+private:
+  int FD;
+  std::vector<Record> records;
+  std::unordered_map<std::string, size_t> recordsByName;
+
+  CallPathArchiveReader(int FD, std::vector<Record> records);
+
+public:
+  ~CallPathArchiveReader();
+
+  /// Returns null and sets `error` if `path` is not a readable archive.
+  static std::unique_ptr<CallPathArchiveReader> open(const std::string &path,
+                                                     std::string &error);
+
+  /// Whether `path` has an index next to it.
+  static bool isArchive(const std::string &path);
+
+  const std::vector<Record> &getRecords() const { return records; }
+
+  bool read(const Record &record, std::string &contents,
+            std::string &error) const;
+  bool read(const std::string &name, std::string &contents,
+            std::string &error) const;
+};
+
+/// Reads a call path named either by a plain file path or by
+/// "<archive>:<record>". The last archive opened is kept open for the
+/// following calls.
+bool readCallPathFile(const std::string &path, std::string &contents,
+                      std::string &error);
+
+} // namespace klee
+
+#endif /* KLEE_CALLPATHARCHIVE_H */
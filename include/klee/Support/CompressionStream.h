@@ -18,6 +18,7 @@ const size_t BUFSIZE = 128 * 1024;
 
 class compressed_fd_ostream : public llvm::raw_ostream {
   int FD;
+  bool ShouldClose;
   uint8_t buffer[BUFSIZE];
   z_stream strm;
   uint64_t pos;
@@ -30,6 +31,7 @@ class compressed_fd_ostream : public llvm::raw_ostream {
 
   void flush_compressed_data();
   void writeFullCompressedData();
+  void init(std::string &ErrorInfo);
 
 public:
   /// compressed_fd_ostream - Open the specified file for writing. If an error
@@ -39,6 +41,11 @@ public:
   /// opened.
   compressed_fd_ostream(const std::string &Filename, std::string &ErrorInfo);
 
+  /// compressed_fd_ostream - Write a complete gzip member to the open file
+  /// descriptor FD, at its current position. The member is finished when
+  /// the stream is destroyed; FD is closed only if ShouldClose is set.
+  compressed_fd_ostream(int FD, bool ShouldClose, std::string &ErrorInfo);
+
   ~compressed_fd_ostream();
 };
 }
@@ -40,6 +40,21 @@ void StatisticManager::registerStatistic(Statistic &s) {
   memset(globalStats, 0, sizeof(*globalStats)*stats.size());
 }
 
+void StatisticManager::snapshot(const StatisticManager &sm) {
+  if (stats.empty()) {
+    stats = sm.stats;
+    globalStats = new uint64_t[stats.size()];
+  }
+  memcpy(globalStats, sm.globalStats, sizeof(*globalStats) * stats.size());
+  snapshotStats.assign(globalStats, globalStats + stats.size());
+}
+
+void StatisticManager::flushTo(StatisticManager &sm) const {
+  for (unsigned i = 0; i < snapshotStats.size(); i++)
+    if (uint64_t addend = globalStats[i] - snapshotStats[i])
+      sm.incrementStatistic(*stats[i], addend);
+}
+
 int StatisticManager::getStatisticID(const std::string &name) const {
   for (unsigned i=0; i<stats.size(); i++)
     if (stats[i]->getName() == name)
@@ -56,6 +71,12 @@ Statistic *StatisticManager::getStatisticByName(const std::string &name) const {
 
 StatisticManager *klee::theStatisticManager = 0;
 
+static thread_local StatisticManager *threadStatisticManager = nullptr;
+
+void klee::setThreadStatisticManager(StatisticManager *sm) {
+  threadStatisticManager = sm;
+}
+
 static StatisticManager &getStatisticManager() {
   static StatisticManager sm;
   theStatisticManager = &sm;
@@ -70,10 +91,12 @@ Statistic::Statistic(const std::string &name, const std::string &shortName)
 }
 
 Statistic &Statistic::operator+=(std::uint64_t addend) {
-  theStatisticManager->incrementStatistic(*this, addend);
+  StatisticManager *sm = threadStatisticManager;
+  (sm ? sm : theStatisticManager)->incrementStatistic(*this, addend);
   return *this;
 }
 
 std::uint64_t Statistic::getValue() const {
-  return theStatisticManager->getValue(*this);
+  StatisticManager *sm = threadStatisticManager;
+  return (sm ? sm : theStatisticManager)->getValue(*this);
 }
@@ -0,0 +1,82 @@
+//===-- ChunkedLog.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CHUNKEDLOG_H
+#define KLEE_CHUNKEDLOG_H
+
+#include "klee/ADT/Ref.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// An append-only list made of chunks that may be shared by several
+/// logs: copying a log is O(1), and logs copied from one another share
+/// the entries they have in common. Entries are immutable once appended.
+template <typename T, unsigned ChunkSize = 4096> class ChunkedLog {
+  struct Chunk {
+    class ReferenceCounter _refCount;
+    /// The chunk this one continues and how many of its entries
+    /// precede this chunk.
+    ref<Chunk> parent;
+    unsigned parentLength;
+    std::vector<T> entries;
+
+    Chunk(const ref<Chunk> &parent, unsigned parentLength)
+        : parent(parent), parentLength(parentLength) {}
+
+    ~Chunk() {
+      // Release the chain iteratively: a long log would otherwise
+      // overflow the stack through the recursive ref<> destructors.
+      while (!parent.isNull() && parent->_refCount.getCount() == 1) {
+        ref<Chunk> next = std::move(parent->parent);
+        parent = std::move(next);
+      }
+    }
+  };
+
+  ref<Chunk> tail;
+  /// Number of entries of `tail` that belong to this log. Other logs
+  /// sharing `tail` may have appended past it.
+  unsigned tailLength = 0;
+  std::uint64_t length = 0;
+
+public:
+  void push_back(T entry) {
+    if (tail.isNull() || tailLength != tail->entries.size() ||
+        tailLength == ChunkSize) {
+      tail = new Chunk(tail, tailLength);
+      tailLength = 0;
+    }
+    tail->entries.push_back(std::move(entry));
+    ++tailLength;
+    ++length;
+  }
+
+  std::uint64_t size() const { return length; }
+  bool empty() const { return length == 0; }
+
+  /// Call `f` on every entry, oldest first.
+  template <typename F> void forEach(F f) const {
+    std::vector<std::pair<const Chunk *, unsigned>> chunks;
+    unsigned len = tailLength;
+    for (const Chunk *c = tail.get(); c; c = c->parent.get()) {
+      chunks.emplace_back(c, len);
+      len = c->parentLength;
+    }
+    for (auto it = chunks.rbegin(), ie = chunks.rend(); it != ie; ++it)
+      for (unsigned i = 0; i < it->second; ++i)
+        f(it->first->entries[i]);
+  }
+};
+} // namespace klee
+
+#endif /* KLEE_CHUNKEDLOG_H */
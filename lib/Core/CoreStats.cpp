@@ -19,6 +19,12 @@ Statistic stats::forks("Forks", "Forks");
 Statistic stats::instructionRealTime("InstructionRealTimes", "Ireal");
 Statistic stats::instructionTime("InstructionTimes", "Itime");
 Statistic stats::instructions("Instructions", "I");
+Statistic stats::loopDiffCandidateBytes("LoopDiffCandidateBytes", "LDbytes");
+Statistic stats::loopDiffQueries("LoopDiffQueries", "LDq");
+Statistic stats::loopDiffTime("LoopDiffTime", "LDtime");
+Statistic stats::loopDiffTimeSaved("LoopDiffTimeSaved", "LDsaved");
+Statistic stats::loopSummaryHits("LoopSummaryHits", "LShits");
+Statistic stats::loopSummaryMisses("LoopSummaryMisses", "LSmisses");
 Statistic stats::minDistToReturn("MinDistToReturn", "Rdist");
 Statistic stats::minDistToUncovered("MinDistToUncovered", "UCdist");
 Statistic stats::reachableUncovered("ReachableUncovered", "IuncovReach");
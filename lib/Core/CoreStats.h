@@ -47,6 +47,26 @@ namespace stats {
   /// distance to a function return.
   extern Statistic minDistToReturn;
 
+  /// Solver queries issued by loop invariant analysis to check whether
+  /// structurally changed bytes may really differ between iterations.
+  extern Statistic loopDiffQueries;
+
+  /// Changed bytes that needed such a check (one query each in the
+  /// byte-granular mode).
+  extern Statistic loopDiffCandidateBytes;
+
+  /// Time spent in those queries (microseconds).
+  extern Statistic loopDiffTime;
+
+  /// Estimated query time avoided by checking bytes in groups
+  /// (microseconds).
+  extern Statistic loopDiffTimeSaved;
+
+  /// Loop invariant analyses seeded with a summary of an earlier analysis
+  /// of the same loop and entry abstraction, and those without one.
+  extern Statistic loopSummaryHits;
+  extern Statistic loopSummaryMisses;
+
 }
 }
 
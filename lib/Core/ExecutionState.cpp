@@ -9,6 +9,7 @@
 
 #include "ExecutionState.h"
 
+#include "CoreStats.h"
 #include "Memory.h"
 #include "../Module/LoopAnalysis.h"
 #include "klee/Expr/Expr.h"
@@ -24,10 +25,12 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprBuilder.h"
 
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/DebugLoc.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/FileSystem.h"
@@ -106,7 +109,9 @@ ExecutionState::ExecutionState(const std::vector<ref<Expr> > &assumptions)
       relevantSymbols(), 
       doTrace(true),
       condoneUndeclaredHavocs(false), 
-      bpf_calls(0) {}
+      bpf_calls(0) {
+  updateConnectivity();
+}
 
 ExecutionState::~ExecutionState() {
   for (const auto &cur_mergehandler: openMergeStack){
@@ -132,16 +137,19 @@ ExecutionState::ExecutionState(const ExecutionState &state)
       analysedLoops(state.analysedLoops), 
       executionStateForLoopInProcess(nullptr),
       constraints(state.constraints),
+      connectivity(state.connectivity),
       isTracing(state.isTracing),
-      callPathInstr(state.callPathInstr), 
-      traceCallStack(state.traceCallStack), 
-      stackInstrMap(state.stackInstrMap), 
+      traceCallStack(state.traceCallStack),
+      instrTrace(state.instrTrace),
+      pathCost(state.pathCost),
 
       pathOS(state.pathOS), 
+      pathLength(state.pathLength),
       symPathOS(state.symPathOS),
 
       coveredLines(state.coveredLines),
       ptreeNode(state.ptreeNode),
+      lastFork(state.lastFork),
       symbolics(state.symbolics),
       havocs(state.havocs), 
       havocNames(state.havocNames),
@@ -170,9 +178,13 @@ ExecutionState::ExecutionState(const ExecutionState &state)
 
 void ExecutionState::addHavocInfo(const MemoryObject *mo,
                                   const std::string &name) {
-  havocs[mo].name = name;
-  havocs[mo].havoced = false;
-  havocs[mo].mask = BitArray();
+  HavocInfo info{};
+  if (const auto *previous = havocs.lookup(mo))
+    info = previous->second;
+  info.name = name;
+  info.havoced = false;
+  info.mask = ByteRangeMask();
+  havocs = havocs.replace(std::make_pair(ref<const MemoryObject>(mo), info));
 }
 
 ExecutionState *ExecutionState::branch() {
@@ -202,72 +214,113 @@ void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) {
 }
 ///
 
-std::string ExecutionState::getFnAlias(std::string fn) {
-  for (auto &candidate : fnAliases) {
-    if (candidate.isRegex) {
-      if (std::regex_match(fn, candidate.nameRegex)) {
-        return candidate.alias;
+GlobalValue *FunctionAliasTable::resolve(GlobalValue *gv,
+                                         Module *module) const {
+  auto it = resolved.find(gv);
+  if (it != resolved.end())
+    return it->second;
+
+  GlobalValue *target = nullptr;
+  std::string fn = gv->getName().str();
+  for (auto &candidate : aliases) {
+    if (candidate.isRegex ? std::regex_match(fn, *candidate.nameRegex)
+                          : fn == candidate.name) {
+      target = module->getNamedValue(candidate.alias);
+      if (!target) {
+        klee_error("Function %s(), alias for %s not found!\n",
+                   candidate.alias.c_str(), fn.c_str());
       }
-    } else if (fn == candidate.name) {
-      return candidate.alias;
+      break;
     }
   }
+  resolved.emplace(gv, target);
+  return target;
+}
 
-  return "";
+void FunctionAliasTable::add(FunctionAlias alias) {
+  aliases.push_back(std::move(alias));
+  resolved.clear();
+}
+
+void FunctionAliasTable::remove(const std::string &name) {
+  aliases.erase(std::remove_if(aliases.begin(), aliases.end(),
+                               [&name](const FunctionAlias &candidate) {
+                                 return candidate.name == name;
+                               }),
+                aliases.end());
+  resolved.clear();
+}
+
+GlobalValue *ExecutionState::getFnAlias(GlobalValue *gv, Module *module) const {
+  if (fnAliases.isNull())
+    return nullptr;
+  return fnAliases->resolve(gv, module);
 }
 
 void ExecutionState::addFnAlias(std::string old_fn, std::string new_fn) {
+  // Also gives this state its own copy of the table.
   removeFnAlias(old_fn);
 
   FunctionAlias alias{.isRegex = false,
-                      .nameRegex = std::regex(""),
+                      .nameRegex = nullptr,
                       .name = old_fn,
                       .alias = new_fn};
-  fnAliases.push_back(alias);
+  fnAliases->add(std::move(alias));
 }
 
 void ExecutionState::addFnRegexAlias(std::string fn_regex, std::string new_fn) {
   removeFnAlias(fn_regex);
 
   FunctionAlias alias = {.isRegex = true,
-                         .nameRegex = std::regex(fn_regex),
+                         .nameRegex = std::make_shared<std::regex>(fn_regex),
                          .name = fn_regex,
                          .alias = new_fn};
-  fnAliases.push_back(alias);
+  fnAliases->add(std::move(alias));
 }
 
 void ExecutionState::removeFnAlias(std::string fn) {
-  fnAliases.erase(std::remove_if(fnAliases.begin(), fnAliases.end(),
-                                 [fn](FunctionAlias candidate) {
-                                   return candidate.name == fn;
-                                 }),
-                  fnAliases.end());
+  // Copy on write: the table may be shared with other states.
+  if (fnAliases.isNull())
+    fnAliases = new FunctionAliasTable();
+  else if (fnAliases->_refCount.getCount() > 1)
+    fnAliases = new FunctionAliasTable(*fnAliases);
+  fnAliases->remove(fn);
 }
 
-std::string ExecutionState::getInterceptReader(uint64_t addr) {
-  auto it = readsIntercepts.find(addr);
-  if (it == readsIntercepts.end()) {
-    return "";
-  }
+Function *ExecutionState::getInterceptReader(const MemoryObject *mo) const {
+  if (!mo->isIntercepted)
+    return nullptr;
+  auto it = readsIntercepts.find(mo->address);
+  return it == readsIntercepts.end() ? nullptr : it->second;
+}
 
-  return it->second;
+Function *ExecutionState::getInterceptWriter(const MemoryObject *mo) const {
+  if (!mo->isIntercepted)
+    return nullptr;
+  auto it = writesIntercepts.find(mo->address);
+  return it == writesIntercepts.end() ? nullptr : it->second;
 }
 
-std::string ExecutionState::getInterceptWriter(uint64_t addr) {
-  auto it = writesIntercepts.find(addr);
-  if (it == writesIntercepts.end()) {
-    return "";
-  }
+void ExecutionState::markIntercepted(uint64_t addr) {
+  ObjectPair op;
+  ref<ConstantExpr> address =
+      ConstantExpr::alloc(addr, Context::get().getPointerWidth());
+  if (addressSpace.resolveOne(address, op) && op.first->address == addr)
+    op.first->isIntercepted = true;
+}
 
-  return it->second;
+bool ExecutionState::isInterceptedAddress(uint64_t addr) const {
+  return readsIntercepts.count(addr) || writesIntercepts.count(addr);
 }
 
-void ExecutionState::addReadsIntercept(uint64_t addr, std::string reader) {
+void ExecutionState::addReadsIntercept(uint64_t addr, Function *reader) {
   readsIntercepts[addr] = reader;
+  markIntercepted(addr);
 }
 
-void ExecutionState::addWritesIntercept(uint64_t addr, std::string writer) {
+void ExecutionState::addWritesIntercept(uint64_t addr, Function *writer) {
   writesIntercepts[addr] = writer;
+  markIntercepted(addr);
 }
 
 /**/
@@ -451,6 +504,7 @@ bool ExecutionState::merge(const ExecutionState &b) {
   for (const auto &constraint : commonConstraints)
     m.addConstraint(constraint);
   m.addConstraint(OrExpr::create(inA, inB));
+  updateConnectivity();
 
   return true;
 }
@@ -490,45 +544,15 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
   }
 }
 
-bool symbolSetsIntersect(const SymbolSet &a, const SymbolSet &b) {
-  if (a.size() > b.size())
-    return symbolSetsIntersect(b, a);
-  for (SymbolSet::const_iterator i = a.begin(), e = a.end(); i != e; ++i) {
-    if (b.count(*i))
-      return true;
-  }
-  return false;
-}
-
 std::vector<ref<Expr>>
 ExecutionState::relevantConstraints(SymbolSet symbols) const {
-  std::vector<ref<Expr>> ret;
-  llvm::SmallPtrSet<Expr *, 32> insertedConstraints;
-  bool newSymbols = false;
-  do {
-    newSymbols = false;
-    for (ConstraintSet::const_iterator ci = constraints.begin(),
-                                       cEnd = constraints.end();
-         ci != cEnd; ++ci) {
-      if (insertedConstraints.count((*ci).get()))
-        continue;
-      SymbolSet constrainedSymbols = GetExprSymbols::visit(*ci);
-      if (symbolSetsIntersect(constrainedSymbols, symbols)) {
-        for (SymbolSet::const_iterator csi = constrainedSymbols.begin(),
-                                       cse = constrainedSymbols.end();
-             csi != cse; ++csi) {
-          bool inserted = std::get<1>(symbols.insert(*csi));
-          newSymbols = newSymbols || inserted;
-        }
-        symbols.insert(constrainedSymbols.begin(), constrainedSymbols.end());
-        ret.push_back(*ci);
-        insertedConstraints.insert((*ci).get());
-      }
-    }
-  } while (newSymbols);
-  return ret;
+  assert(connectivity.isUpToDate(constraints) &&
+         "constraints changed without updateConnectivity()");
+  return connectivity.relevantConstraints(symbols);
 }
 
+void ExecutionState::updateConnectivity() { connectivity.update(constraints); }
+
 bool ExecutionState::isAccessibleAddr(ref<Expr> addr) const {
   ObjectPair op;
   ref<klee::ConstantExpr> address = cast<klee::ConstantExpr>(addr);
@@ -936,6 +960,22 @@ ExecutionState *ExecutionState::finishLoopRound(KFunction *kf) {
   if (analysisFinished) {
     kf->insert(loopInProcess->getLoop(), loopInProcess->getChangedBytes(),
                loopInProcess->getEntryState());
+    LoopSummary summary;
+    if (summarizeLoop(loopInProcess->getChangedBytes(),
+                      loopInProcess->getEntryState(), summary)) {
+      LoopEntryAbstraction entry =
+          abstractLoopEntry(loopInProcess->getEntryState());
+      if (kf->insertSummary(loopInProcess->getLoop(), entry, summary))
+        saveLoopSummary(*kf, loopInProcess->getLoop(), entry, summary);
+    }
+    const DiffMaskStats &diffStats = loopInProcess->getDiffStats();
+    klee_message("Loop at %s:%s analysed: %lu changed-byte queries for %lu "
+                 "candidate bytes (%.3fs, ~%.3fs saved)",
+                 kf->function->getName().str().c_str(),
+                 loopInProcess->getLoop()->getHeader()->getName().str().c_str(),
+                 diffStats.queries, diffStats.candidateBytes,
+                 diffStats.queryTime.toSeconds(),
+                 diffStats.timeSaved.toSeconds());
     LOG_LA("[" << loopInProcess->getLoop()
                << "]analysis finished, loop inserted");
   }
@@ -1068,7 +1108,7 @@ void ExecutionState::terminateState(ExecutionState **replace) {
   }
 }
 
-void ExecutionState::startInvariantSearch() {
+bool ExecutionState::startInvariantSearch() {
   KInstruction *inst = prevPC;
   llvm::Instruction *linst = inst->inst;
   assert(linst);
@@ -1103,20 +1143,36 @@ void ExecutionState::startInvariantSearch() {
 
     std::unique_ptr<ExecutionState> loop_state(nullptr);
     loop_state.swap(executionStateForLoopInProcess);
+    const LoopSummary *summary =
+        kf->summaryFor(loop, abstractLoopEntry(*loop_state));
+    StateByteMask seed;
+    if (summary) {
+      ++stats::loopSummaryHits;
+      seed = instantiateLoopSummary(*summary, *loop_state);
+    } else {
+      ++stats::loopSummaryMisses;
+    }
     loopInProcess =
         new LoopInProcess(loop, std::move(loop_state), loopInProcess);
     executionStateForLoopInProcess = nullptr;
+    if (!seed.empty()) {
+      LOG_LA("Seeding the analysis with a summary of the loop.");
+      loopInProcess->seed(seed);
+      return true;
+    }
   } else {
     LOG_LA("Already analysed, or being analysed at this very moment");
   }
+  return false;
 }
 
-void ExecutionState::induceInvariantsForThisLoop(KInstruction *target) {
-  startInvariantSearch();
+bool ExecutionState::induceInvariantsForThisLoop(KInstruction *target) {
+  bool seeded = startInvariantSearch();
 
   // The return value of the intrinsic function call.
   stack.back().locals[target->dest].value =
       ConstantExpr::create(0xffffffff, Expr::Int32);
+  return seeded;
 }
 
 bool FieldDescr::eq(const FieldDescr &other) const {
@@ -1345,6 +1401,51 @@ bool CallInfo::sameInvocation(const CallInfo *other) const {
   return equalContexts(callContext, other->callContext);
 }
 
+static std::size_t exprHash(const ref<Expr> &e) {
+  return e.isNull() ? 0 : e->hash();
+}
+
+std::size_t FieldDescr::hash() const {
+  return llvm::hash_combine(width, type, name, doTraceValueIn, doTraceValueOut,
+                            doTraceValueIn ? exprHash(inVal) : 0,
+                            doTraceValueOut ? exprHash(outVal) : 0);
+}
+
+std::size_t FieldDescr::invocationHash() const {
+  return llvm::hash_combine(width, type, name, doTraceValueIn,
+                            doTraceValueIn ? exprHash(inVal) : 0);
+}
+
+std::size_t CallArg::hash() const {
+  return llvm::hash_combine(exprHash(expr), isPtr,
+                            isPtr ? pointee.hash() : 0);
+}
+
+std::size_t CallArg::invocationHash() const {
+  return llvm::hash_combine(exprHash(expr), isPtr,
+                            isPtr ? pointee.invocationHash() : 0);
+}
+
+std::size_t RetVal::hash() const {
+  return llvm::hash_combine(exprHash(expr), isPtr,
+                            isPtr ? pointee.hash() : 0);
+}
+
+std::size_t CallInfo::hash() const {
+  std::size_t h = llvm::hash_combine(f, returned, ret.hash(),
+                                     callContext.size(), returnContext.size());
+  for (const CallArg &arg : args)
+    h = llvm::hash_combine(h, arg.hash());
+  return h;
+}
+
+std::size_t CallInfo::invocationHash() const {
+  std::size_t h = llvm::hash_combine(f, args.size(), callContext.size());
+  for (const CallArg &arg : args)
+    h = llvm::hash_combine(h, arg.invocationHash());
+  return h;
+}
+
 SymbolSet CallInfo::computeRetSymbolSet() const {
   assert(returned && "incomplete");
   SymbolSet symbols;
@@ -1384,37 +1485,21 @@ LoopInProcess::LoopInProcess(const llvm::Loop *_loop,
 }
 
 LoopInProcess::~LoopInProcess() {
-  for (std::map<const MemoryObject *, BitArray *>::iterator
-           i = changedBytes.begin(),
-           e = changedBytes.end();
-       i != e; ++i) {
-    delete i->second;
-  }
   assert(restartState);
 }
 
-unsigned countBitsSet(const BitArray *arr, unsigned size) {
-  unsigned rez = 0;
-  for (unsigned i = 0; i < size; ++i) {
-    if (arr->get(i))
-      ++rez;
-  }
-  return rez;
-}
-
 ExecutionState *LoopInProcess::makeRestartState() {
   auto newState = new ExecutionState(*restartState);
   newState->setID();
   LOG_LA("Making restart state " << (void *)newState << " from "
                                  << (void *)restartState.get());
-  for (std::map<const MemoryObject *, BitArray *>::iterator
-           i = changedBytes.begin(),
-           e = changedBytes.end();
+  for (StateByteMask::const_iterator i = changedBytes.begin(),
+                                     e = changedBytes.end();
        i != e; ++i) {
     const MemoryObject *mo = i->first;
-    const BitArray *bytes = i->second;
+    const ByteRangeMask &bytes = i->second;
     if (mo->allocSite) {
-      LOG_LA(" Forgetting: [" << countBitsSet(bytes, mo->size) << "/"
+      LOG_LA(" Forgetting: [" << bytes.count() << "/"
                               << mo->size << "]" << *mo->allocSite);
     } else {
       LOG_LA(" Forgetting something.\n");
@@ -1434,20 +1519,22 @@ ExecutionState *LoopInProcess::makeRestartState() {
       wos->forbidAccessWithLastMessage();
     }
 
-    auto havoc_info = newState->havocs.find(mo);
-    if (havoc_info == newState->havocs.end() &&
-        !restartState->condoneUndeclaredHavocs) {
+    const auto *havoc_info = newState->havocs.lookup(mo);
+    if (!havoc_info && !restartState->condoneUndeclaredHavocs) {
       printf("Unexpected memory location being havoced.\n");
       assert(0 && "Possible havoc location must have been predelcared");
     }
 
-    if (havoc_info != newState->havocs.end()) {
+    if (havoc_info) {
       // Remember the generated value for later reporting in the ktest file.
-      havoc_info->second.value = array;
-      havoc_info->second.havoced = true;
-      havoc_info->second.mask = BitArray(*bytes, bytes->size());
-      LOG_LA("Adding havoc here: " << havoc_info->second.name
+      HavocInfo info = havoc_info->second;
+      info.value = array;
+      info.havoced = true;
+      info.mask = bytes;
+      LOG_LA("Adding havoc here: " << info.name
                                    << " in: " << (void *)newState);
+      newState->havocs = newState->havocs.replace(
+          std::make_pair(havoc_info->first, info));
     }
 
     // Do not record this symbol, as it was not generated with
@@ -1459,6 +1546,10 @@ ExecutionState *LoopInProcess::makeRestartState() {
                << "]Some more objects were changed."
                   " repeat the loop.");
     lastRoundUpdated = false;
+    if (checkingSeed) {
+      seedRoundStart.reset(new AddressSpace(newState->addressSpace));
+      seedRoundChanged.clear();
+    }
     // This works, because refCount is the internal field.
     newState->loopInProcess = this;
   } else {
@@ -1474,15 +1565,79 @@ ExecutionState *LoopInProcess::makeRestartState() {
 
 void LoopInProcess::updateChangedObjects(const ExecutionState &current,
                                          TimingSolver *solver) {
+  if (seedRoundStart) {
+    updateDiffMask(&seedRoundChanged, *seedRoundStart, current, solver,
+                   &diffStats);
+    return;
+  }
   bool updated = updateDiffMask(&changedBytes, restartState->addressSpace,
-                                current, solver);
+                                current, solver, &diffStats);
   if (updated)
     lastRoundUpdated = true;
 }
 
+void LoopInProcess::seed(const StateByteMask &mask) {
+  changedBytes = mask;
+  lastRoundUpdated = true;
+  checkingSeed = true;
+}
+
+namespace {
+bool isSubset(const ByteRangeMask &a, const ByteRangeMask &b) {
+  for (const ByteRangeMask::Range &r : a) {
+    // The ranges of a mask are disjoint and not adjacent.
+    auto covering = std::find_if(b.begin(), b.end(),
+                                 [&r](const ByteRangeMask::Range &c) {
+                                   return c.begin <= r.begin && r.end <= c.end;
+                                 });
+    if (covering == b.end())
+      return false;
+  }
+  return true;
+}
+} // namespace
+
+void LoopInProcess::finishSeedRound() {
+  seedRoundStart.reset();
+  bool grew = false, shrank = false;
+  for (const auto &changed : seedRoundChanged) {
+    auto seeded = changedBytes.find(changed.first);
+    if (!changed.second.empty() &&
+        (seeded == changedBytes.end() ||
+         !isSubset(changed.second, seeded->second)))
+      grew = true;
+  }
+  for (const auto &seeded : changedBytes) {
+    auto changed = seedRoundChanged.find(seeded.first);
+    if (!seeded.second.empty() && (changed == seedRoundChanged.end() ||
+                                   changed->second != seeded.second))
+      shrank = true;
+  }
+
+  if (grew) {
+    // The summary does not hold for this entry state: the bytes outside
+    // of it that changed are not known to change without it.
+    LOG_LA("[" << loop << "]The summary does not apply. Start over.");
+    changedBytes.clear();
+    checkingSeed = false;
+    lastRoundUpdated = true;
+  } else if (shrank) {
+    // Forgetting only the bytes that changed keeps the others unchanged
+    // as well, so the smaller mask is checked in another round.
+    LOG_LA("[" << loop << "]Drop the seeded bytes that did not change.");
+    changedBytes = seedRoundChanged;
+    lastRoundUpdated = true;
+  } else {
+    checkingSeed = false;
+    lastRoundUpdated = false;
+  }
+}
+
 ExecutionState *LoopInProcess::nextRoundState(bool *analysisFinished) {
   if (_refCount.getCount() == 1) {
     // The last state in the round.
+    if (seedRoundStart)
+      finishSeedRound();
     if (!lastRoundUpdated) {
       LOG_LA("[" << loop
                  << "]Fixpoint reached. Time to"
@@ -1539,4 +1694,5 @@ void ExecutionState::dumpConstraints() const {
 void ExecutionState::addConstraint(ref<Expr> e) {
   ConstraintManager c(constraints);
   c.addConstraint(e);
+  updateConnectivity();
 }
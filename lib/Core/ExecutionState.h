@@ -12,6 +12,7 @@
 
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
+#include "klee/ADT/ImmutableMap.h"
 #include "klee/ADT/ImmutableSet.h"
 #include "klee/ADT/TreeStream.h"
 #include "klee/Solver/Solver.h"
@@ -19,7 +20,12 @@
 #include "klee/ADT/GetExprSymbols.h"
 
 #include "AddressSpace.h"
+#include "ChunkedLog.h"
+#include "InstructionTrace.h"
+#include "PathCost.h"
 #include "MergeHandler.h"
+#include "PTree.h"
+#include "SymbolConnectivity.h"
 #include "../Module/LoopAnalysis.h"
 #include "klee/Module/KInstIterator.h"
 
@@ -30,11 +36,14 @@
 #include <memory>
 #include <regex>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 namespace llvm {
 class Function;
 class BasicBlock;
+class GlobalValue;
+class Module;
 } // namespace llvm
 
 namespace klee {
@@ -79,11 +88,41 @@ struct StackFrame {
 
 struct FunctionAlias {
   bool isRegex;
-  std::regex nameRegex;
+  std::shared_ptr<const std::regex> nameRegex;
   std::string name;
   std::string alias;
 };
 
+/// @brief The function aliases installed by klee_alias_function* calls.
+/// A table is shared copy-on-write between forked states, together with
+/// the cache of the call targets it has already resolved, so resolving a
+/// call costs a single hash lookup regardless of the number of rules.
+class FunctionAliasTable {
+public:
+  class ReferenceCounter _refCount;
+
+private:
+  std::vector<FunctionAlias> aliases;
+  /// Targets resolved so far for this set of aliases; a null target
+  /// means the value is not aliased.
+  mutable std::unordered_map<const llvm::GlobalValue *, llvm::GlobalValue *>
+      resolved;
+
+public:
+  FunctionAliasTable() = default;
+  FunctionAliasTable(const FunctionAliasTable &other)
+      : aliases(other.aliases) {}
+
+  bool empty() const { return aliases.empty(); }
+
+  /// Returns the replacement of `gv` or null if it is not aliased.
+  llvm::GlobalValue *resolve(llvm::GlobalValue *gv,
+                             llvm::Module *module) const;
+
+  void add(FunctionAlias alias);
+  void remove(const std::string &name);
+};
+
 struct FieldDescr {
   Expr::Width width;
   std::string type;
@@ -97,6 +136,12 @@ struct FieldDescr {
 
   bool sameInvocationValue(const FieldDescr &other) const;
   bool eq(const FieldDescr &other) const;
+
+  /// Structural hashes consistent with eq() and sameInvocationValue().
+  /// Since eq() only checks that the fields of this descriptor are present
+  /// in the other one, the nested fields are not hashed.
+  std::size_t hash() const;
+  std::size_t invocationHash() const;
 };
 
 struct CallArg {
@@ -109,6 +154,10 @@ struct CallArg {
 
   bool eq(const CallArg &other) const;
   bool sameInvocationValue(const CallArg &other) const;
+
+  /// Structural hashes consistent with eq() and sameInvocationValue().
+  std::size_t hash() const;
+  std::size_t invocationHash() const;
 };
 
 struct RetVal {
@@ -119,6 +168,7 @@ struct RetVal {
   FieldDescr pointee;
 
   bool eq(const RetVal &other) const;
+  std::size_t hash() const;
 };
 
 struct CallExtraVal {
@@ -169,13 +219,61 @@ struct CallInfo {
   CallArg *getCallArgPtrp(ref<Expr> ptr);
   bool eq(const CallInfo &other) const;
   bool sameInvocation(const CallInfo *other) const;
+  /// Structural hashes consistent with eq() and sameInvocation(). The
+  /// contexts are compared as sets, so only their sizes are hashed.
+  std::size_t hash() const;
+  std::size_t invocationHash() const;
   SymbolSet computeRetSymbolSet() const;
 };
 
+/// The calls traced on a path. All the calls but the last one are complete
+/// and shared with the states forked from this one. The last call may still
+/// be recorded, so each state has its own copy of it.
+class CallPathLog {
+  ChunkedLog<CallInfo, 64> completed;
+  CallInfo last;
+  bool hasLast = false;
+
+public:
+  bool empty() const { return !hasLast; }
+  std::uint64_t size() const { return completed.size() + hasLast; }
+
+  CallInfo &back() {
+    assert(hasLast && "empty call path");
+    return last;
+  }
+  const CallInfo &back() const {
+    assert(hasLast && "empty call path");
+    return last;
+  }
+
+  void push_back(CallInfo call) {
+    if (hasLast)
+      completed.push_back(std::move(last));
+    last = std::move(call);
+    hasLast = true;
+  }
+
+  /// Call `f` on every call, oldest first.
+  template <typename F> void forEach(F f) const {
+    completed.forEach(f);
+    if (hasLast)
+      f(last);
+  }
+
+  /// The calls, oldest first.
+  std::vector<const CallInfo *> entries() const {
+    std::vector<const CallInfo *> calls;
+    calls.reserve(size());
+    forEach([&calls](const CallInfo &call) { calls.push_back(&call); });
+    return calls;
+  }
+};
+
 struct HavocInfo {
   std::string name;
   bool havoced;
-  BitArray mask;
+  ByteRangeMask mask;
   const Array *value;
 };
 
@@ -196,11 +294,21 @@ private:
   // loop in process.
   std::unique_ptr<ExecutionState> restartState; // Owner.
   bool lastRoundUpdated;
-  // Owner for the bitarrays.
   StateByteMask changedBytes;
+  // Solver effort spent on this loop across all rounds.
+  DiffMaskStats diffStats;
   // std::set<const MemoryObject *> changedObjects;
 
+  // Whether changedBytes comes from a summary that is not checked yet
+  // against this entry state.
+  bool checkingSeed = false;
+  // While checking a seed: the memory at the start of the round, with the
+  // seeded bytes forgotten, and the bytes the round may change from it.
+  std::unique_ptr<AddressSpace> seedRoundStart;
+  StateByteMask seedRoundChanged;
+
   ExecutionState *makeRestartState();
+  void finishSeedRound();
 
 public:
   // Captures ownership of the _headerState.
@@ -211,10 +319,18 @@ public:
 
   void updateChangedObjects(const ExecutionState &current,
                             TimingSolver *solver);
+  /// Starts from the bytes a previous analysis of the loop found to
+  /// change: the next round restarts with them forgotten. The seeded bytes
+  /// that round does not change are dropped and the round repeated, so
+  /// that a summary made for another entry state does not forget more
+  /// than needed here. If the round changes other bytes, the summary does
+  /// not apply and the analysis starts over without it.
+  void seed(const StateByteMask &mask);
   ExecutionState *nextRoundState(bool *analysisFinished);
 
   const llvm::Loop *getLoop() const { return loop; }
   const StateByteMask &getChangedBytes() const { return changedBytes; }
+  const DiffMaskStats &getDiffStats() const { return diffStats; }
   const ExecutionState &getEntryState() const { return *restartState; }
   const ref<LoopInProcess> &getOuter() const { return outer; }
 };
@@ -308,9 +424,12 @@ public:
 private:
 
   // function alias and hardware intercepts related states
-  std::vector<FunctionAlias> fnAliases;
-  std::map<uint64_t, std::string> readsIntercepts;
-  std::map<uint64_t, std::string> writesIntercepts;
+  ref<FunctionAliasTable> fnAliases;
+  std::map<uint64_t, llvm::Function *> readsIntercepts;
+  std::map<uint64_t, llvm::Function *> writesIntercepts;
+
+  /// Marks the object starting at `addr`, if any, as intercepted.
+  void markIntercepted(uint64_t addr);
 
 public:
   // Execution - Control Flow specific
@@ -354,21 +473,26 @@ public:
   /// @brief Constraints collected so far
   ConstraintSet constraints;
 
+  /// @brief Connectivity of the symbols through `constraints`, sharing its
+  /// storage with the states forked from this one.
+  SymbolConnectivity connectivity;
+
   /// @brief Flag to see if llvm instruction tracing is on
   int isTracing = 0;
 
-  /// @brief List of Instructions executed so far
-  std::vector<llvm::Instruction *> callPathInstr;
+  /// @brief Call stack of the functions entered so far, as a node of the
+  /// shared CallStackTrie. This is recorded only for the portions of the
+  /// call path when we are inside call-trace-instr-startfn (see main.cpp in
+  /// tools/klee)
+  CallStackTrie::NodeId traceCallStack = CallStackTrie::Root;
 
-  /// @brief Call Stack with unmangled Function call names. This
-  /// is recorded only for the portions of the call path when we are inside
-  /// call-trace-instr-startfn (see main.cpp in tools/klee)
-  std::vector<std::string> traceCallStack;
+  /// @brief Instructions executed so far while tracing, with their call
+  /// stacks. Forked states share the common prefix.
+  InstructionTrace instrTrace;
 
-  /// @brief Hash Map between CallStack and and llvm Instruction
-  // TODO: Change to std::map
-  std::vector<std::pair<std::vector<std::string>, llvm::Instruction *>>
-      stackInstrMap;
+  /// @brief Cost of the instructions executed so far while tracing, with
+  /// -count-path-cost.
+  PathCost pathCost;
 
   /// Statistics and information
 
@@ -379,6 +503,10 @@ public:
   /// reach/create this state (both concrete and symbolic)
   TreeOStream pathOS;
 
+  /// @brief Number of branch decisions on the path of this state (as
+  /// recorded in pathOS), i.e., its position in a replayed path
+  std::uint32_t pathLength = 0;
+
   /// @brief History of symbolic path: represents symbolic branches
   /// taken to reach/create this state
   TreeOStream symPathOS;
@@ -390,6 +518,9 @@ public:
   /// Copies of ExecutionState should not copy ptreeNode
   PTreeNode *ptreeNode = nullptr;
 
+  /// @brief Last fork on the path of this state (see PTreeFork)
+  ref<PTreeFork> lastFork;
+
   /// @brief Ordered list of symbolics: used to generate test cases.
   //
   // FIXME: Move to a shared list structure (not critical).
@@ -397,16 +528,17 @@ public:
 
   /// @brief The list of possibly havoced memory locations with their names
   ///  and values placed at the last havoc event.
-  std::map<ref<const MemoryObject>, HavocInfo> havocs;
+  ImmutableMap<ref<const MemoryObject>, HavocInfo> havocs;
 
   /// @brief The list of registered havoc mem location names, used to guarantee
   ///  uniqueness of each name.
-  std::set<std::string> havocNames;
+  ImmutableSet<std::string> havocNames;
 
   /// @brief Set of used array names for this state.  Used to avoid collisions.
-  std::set<std::string> arrayNames;
+  ImmutableSet<std::string> arrayNames;
 
-  std::vector<CallInfo> callPath;
+  /// @brief The traced calls, shared with the states forked from this one.
+  CallPathLog callPath;
   SymbolSet relevantSymbols;
 
   /// @brief: a flag indicating that the state is genuine and not
@@ -423,7 +555,7 @@ public:
   /// @brief The numbers of times this state has run through Executor::stepInstruction
   std::uint64_t steppedInstructions;
 
-  std::map<std::string, std::map<int, ref<Expr>>> reused_symbols;
+  ImmutableMap<std::string, std::map<int, ref<Expr>>> reused_symbols;
 
   unsigned int bpf_calls;
 
@@ -490,15 +622,19 @@ public:
   std::uint32_t getID() const { return id; };
   void setID() { id = nextID++; };
 
-  std::string getFnAlias(std::string fn);
+  llvm::GlobalValue *getFnAlias(llvm::GlobalValue *gv,
+                                llvm::Module *module) const;
   void addFnAlias(std::string old_fn, std::string new_fn);
   void addFnRegexAlias(std::string fn_regex, std::string new_fn);
   void removeFnAlias(std::string fn);
 
-  std::string getInterceptReader(uint64_t addr);
-  std::string getInterceptWriter(uint64_t addr);
-  void addReadsIntercept(uint64_t addr, std::string reader);
-  void addWritesIntercept(uint64_t addr, std::string writer);
+  /// The interceptor of the reads or writes of `mo`, or null.
+  llvm::Function *getInterceptReader(const MemoryObject *mo) const;
+  llvm::Function *getInterceptWriter(const MemoryObject *mo) const;
+  void addReadsIntercept(uint64_t addr, llvm::Function *reader);
+  void addWritesIntercept(uint64_t addr, llvm::Function *writer);
+  /// Whether objects allocated at `addr` are intercepted.
+  bool isInterceptedAddress(uint64_t addr) const;
   
   bool isAccessibleAddr(ref<Expr> addr) const;
   ref<Expr> readMemoryChunk(ref<Expr> addr, Expr::Width width,
@@ -545,9 +681,12 @@ public:
                                           TimingSolver *solver,
                                           bool *terminate);
   std::vector<ref<Expr>> relevantConstraints(SymbolSet symbols) const;
+  void updateConnectivity();
   void terminateState(ExecutionState **replace);
-  void induceInvariantsForThisLoop(KInstruction *target);
-  void startInvariantSearch();
+  /// Returns true if the analysis was seeded with a loop summary, in
+  /// which case the state must be terminated to start its next round.
+  bool induceInvariantsForThisLoop(KInstruction *target);
+  bool startInvariantSearch();
 };
 
 struct ExecutionStateIDCompare {
@@ -17,6 +17,8 @@
 #include "ImpliedValue.h"
 #include "Memory.h"
 #include "MemoryManager.h"
+#include "MergeHandler.h"
+#include "PathCost.h"
 #include "PTree.h"
 #include "Searcher.h"
 #include "SeedInfo.h"
@@ -96,6 +98,7 @@ typedef unsigned TypeSize;
 #include <sstream>
 #include <string>
 #include <sys/mman.h>
+#include <unistd.h>
 #include <vector>
 
 using namespace llvm;
@@ -491,20 +494,56 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
         setHaltExecution(true);
       }));
 
+  if (PathCostModel::enabled())
+    pathCostModel = &PathCostModel::get();
+
+  const unsigned numWorkers = std::max(1U, opts.ParallelWorkers);
+  if (numWorkers > 1) {
+    // The workers query their solver chains concurrently; only Z3 is known
+    // to be safe with one context per thread.
+    if (CoreSolverToUse != Z3_SOLVER ||
+        (DebugCrossCheckCoreSolverWith != NO_SOLVER &&
+         DebugCrossCheckCoreSolverWith != Z3_SOLVER))
+      klee_error("--parallel-workers requires the Z3 solver");
+    if (UseMerge)
+      klee_error("--parallel-workers cannot be used with --use-merge");
+    ReferenceCounter::setThreadSafe(true);
+  }
+
   coreSolverTimeout = time::Span{MaxCoreSolverTime};
   if (coreSolverTimeout) UseForkedCoreSolver = true;
-  Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
-  if (!coreSolver) {
-    klee_error("Failed to create core solver\n");
-  }
 
-  Solver *solver = constructSolverChain(
-      coreSolver,
-      interpreterHandler->getOutputFilename(ALL_QUERIES_SMT2_FILE_NAME),
-      interpreterHandler->getOutputFilename(SOLVER_QUERIES_SMT2_FILE_NAME),
-      interpreterHandler->getOutputFilename(ALL_QUERIES_KQUERY_FILE_NAME),
-      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME));
+  // Every worker thread gets a solver chain of its own, logging its queries
+  // to files tagged with the worker id.
+  std::vector<Solver *> workerSolvers;
+  for (unsigned i = 0; i < numWorkers; ++i) {
+    auto getQueryLogFilename = [&](const std::string &name) {
+      std::string filename = interpreterHandler->getOutputFilename(name);
+      if (i == 0)
+        return filename;
+      std::string tag = ".worker" + llvm::utostr(i);
+      std::string::size_type dot = filename.rfind('.');
+      return dot == std::string::npos ? filename + tag
+                                      : filename.insert(dot, tag);
+    };
+
+    Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
+    if (!coreSolver) {
+      klee_error("Failed to create core solver\n");
+    }
 
+    Solver *solver = constructSolverChain(
+        coreSolver, getQueryLogFilename(ALL_QUERIES_SMT2_FILE_NAME),
+        getQueryLogFilename(SOLVER_QUERIES_SMT2_FILE_NAME),
+        getQueryLogFilename(ALL_QUERIES_KQUERY_FILE_NAME),
+        getQueryLogFilename(SOLVER_QUERIES_KQUERY_FILE_NAME));
+
+    solverServices.push_back(std::make_unique<SolverService>(solver));
+    workerSolvers.push_back(solverServices.back()->createClient(
+        i == 0 ? "executor" : "executor.worker" + llvm::utostr(i)));
+  }
+  Solver *solver = numWorkers > 1 ? WorkerPool::createSolver(workerSolvers)
+                                  : workerSolvers.front();
   this->solver = new TimingSolver(solver, EqualitySubstitution);
   memory = new MemoryManager(&arrayCache);
 
@@ -582,6 +621,7 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
 
   // 4.) Manifest the module
   kmodule->manifest(interpreterHandler, StatsTracker::useStatistics());
+  loadLoopSummaries(*kmodule);
 
   specialFunctionHandler->bind();
 
@@ -910,8 +950,10 @@ void Executor::branch(ExecutionState &state,
   unsigned N = conditions.size();
   assert(N);
 
-  if (!branchingPermitted(state)) {
-    unsigned next = theRNG.getInt32() % N;
+  bool replaying = isRecordingArms() && isReplayingPath(state);
+  if (replaying || !branchingPermitted(state)) {
+    unsigned next = replaying ? getReplayedArm(state, N)
+                              : theRNG.getInt32() % N;
     for (unsigned i=0; i<N; ++i) {
       if (i == next) {
         result.push_back(&state);
@@ -922,17 +964,37 @@ void Executor::branch(ExecutionState &state,
   } else {
     stats::forks += N-1;
 
+    // The arms are forks of the same level, whichever state each of them is
+    // split from in the process tree below.
+    ref<PTreeFork> parentFork = state.lastFork;
+    std::uint32_t forkDepth = state.constraints.size();
+
     // XXX do proper balance or keep random?
     result.push_back(&state);
     for (unsigned i=1; i<N; ++i) {
-      ExecutionState *es = result[theRNG.getInt32() % i];
+      unsigned k = theRNG.getInt32() % i;
+      ExecutionState *es = result[k];
       ExecutionState *ns = es->branch();
       addedStates.push_back(ns);
       result.push_back(ns);
       processTree->attach(es->ptreeNode, ns, es);
+      if (pathWriter)
+        ns->pathOS = pathWriter->open(es->pathOS);
+      if (symPathWriter)
+        ns->symPathOS = symPathWriter->open(es->symPathOS);
     }
+
+    for (unsigned i=0; i<N; ++i)
+      result[i]->lastFork = new PTreeFork(parentFork, forkDepth, conditions[i]);
   }
 
+  // The arms are recorded in the path, so that replaying a prefix of it
+  // follows a single arm.
+  if (isRecordingArms())
+    for (unsigned i=0; i<N; ++i)
+      if (result[i])
+        recordArm(*result[i], i, N);
+
   // If necessary redistribute seeds to match conditions, killing
   // states if necessary due to OnlyReplaySeeds (inefficient but
   // simple).
@@ -985,6 +1047,44 @@ void Executor::branch(ExecutionState &state,
       addConstraint(*result[i], conditions[i]);
 }
 
+bool Executor::isReplayingPath(const ExecutionState &state) const {
+  return replayPath && (state.pathLength < replayPath->size() ||
+                        !interpreterOpts.ReplayPathIsPrefix);
+}
+
+bool Executor::isRecordingArms() const {
+  return interpreterOpts.PathPrefixDepth || interpreterOpts.ReplayPathIsPrefix;
+}
+
+unsigned Executor::getReplayedArm(const ExecutionState &state,
+                                  unsigned N) const {
+  unsigned arm = 0;
+  for (unsigned position = state.pathLength; arm + 1 < N; ++arm, ++position) {
+    assert(position < replayPath->size() &&
+           "ran out of branches in replay path mode");
+    if ((*replayPath)[position])
+      break;
+  }
+  return arm;
+}
+
+void Executor::recordArm(ExecutionState &state, unsigned arm, unsigned N) {
+  bool last = arm + 1 == N;
+  state.pathLength += last ? arm : arm + 1;
+  for (unsigned i = 0; i < arm; ++i) {
+    if (pathWriter)
+      state.pathOS << "0";
+    if (symPathWriter)
+      state.symPathOS << "0";
+  }
+  if (!last) {
+    if (pathWriter)
+      state.pathOS << "1";
+    if (symPathWriter)
+      state.symPathOS << "1";
+  }
+}
+
 Executor::StatePair 
 Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   Solver::Validity res;
@@ -1034,16 +1134,21 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   }
 
   if (!isSeeding) {
-    if (replayPath && !isInternal) {
-      assert(replayPosition<replayPath->size() &&
+    if (!isInternal && isReplayingPath(current)) {
+      assert(current.pathLength < replayPath->size() &&
              "ran out of branches in replay path mode");
-      bool branch = (*replayPath)[replayPosition++];
-      
-      if (res==Solver::True) {
-        assert(branch && "hit invalid branch in replay path mode");
-      } else if (res==Solver::False) {
-        assert(!branch && "hit invalid branch in replay path mode");
-      } else {
+      bool branch = (*replayPath)[current.pathLength];
+
+      if ((res == Solver::True && !branch) ||
+          (res == Solver::False && branch)) {
+        if (interpreterOpts.ReplayPathIsPrefix) {
+          // The path left the prefix after a fork the path does not record
+          // (e.g. an internal one); it is explored under another prefix.
+          discardState(current);
+          return StatePair(0, 0);
+        }
+        assert(0 && "hit invalid branch in replay path mode");
+      } else if (res == Solver::Unknown) {
         // add constraints
         if(branch) {
           res = Solver::True;
@@ -1110,6 +1215,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   // search ones. If that makes sense.
   if (res==Solver::True) {
     if (!isInternal) {
+      ++current.pathLength;
       if (pathWriter) {
         current.pathOS << "1";
       }
@@ -1118,6 +1224,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     return StatePair(&current, 0);
   } else if (res==Solver::False) {
     if (!isInternal) {
+      ++current.pathLength;
       if (pathWriter) {
         current.pathOS << "0";
       }
@@ -1168,8 +1275,13 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       }
     }
 
-    processTree->attach(current.ptreeNode, falseState, trueState);
+    processTree->attach(current.ptreeNode, falseState, trueState,
+                        Expr::createIsZero(condition), condition);
 
+    if (!isInternal) {
+      ++trueState->pathLength;
+      ++falseState->pathLength;
+    }
     if (pathWriter) {
       // Need to update the pathOS.id field of falseState, otherwise the same id
       // is used for both falseState and trueState.
@@ -1190,6 +1302,14 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     addConstraint(*trueState, condition);
     addConstraint(*falseState, Expr::createIsZero(condition));
 
+    if (interpreterOpts.PathPrefixDepth && !isInternal &&
+        interpreterOpts.PathPrefixDepth <= trueState->depth &&
+        trueState->loopInProcess.isNull()) {
+      terminateStateAtPathPrefix(*trueState);
+      terminateStateAtPathPrefix(*falseState);
+      return StatePair(0, 0);
+    }
+
     // Kinda gross, do we even really still want this option?
     if (MaxDepth && MaxDepth<=trueState->depth) {
       terminateStateEarly(*trueState, "max-depth exceeded.");
@@ -2023,15 +2143,8 @@ Function* Executor::getTargetFunction(Value *calledVal, ExecutionState &state) {
       if (!Visited.insert(gv).second)
         return 0;
         
-      std::string alias = state.getFnAlias(gv->getName().str());
-      if (!alias.empty()) {
-        GlobalValue *old_gv = gv;
-        gv = kmodule->module->getNamedValue(alias);
-        if (!gv) {
-          klee_error("Function %s(), alias for %s not found!\n", alias.c_str(),
-                      old_gv->getName().str().c_str());
-        }
-      }
+      if (GlobalValue *alias = state.getFnAlias(gv, kmodule->module.get()))
+        gv = alias;
 
       if (Function *f = dyn_cast<Function>(gv))
         return f;
@@ -2163,12 +2276,18 @@ void klee::FillCallInfoOutput(Function* f,
   state.recordRetConstraints(info);
 }
 
+void Executor::traceInstruction(ExecutionState &state, KInstruction *ki) {
+  if (interpreterOpts.RecordInstructionTrace)
+    state.instrTrace.push_back(state.traceCallStack, ki);
+  if (pathCostModel)
+    pathCostModel->step(state.pathCost, state.traceCallStack, ki);
+}
+
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   
   //Whenever we are about to execute an instruction within the traceCallStack, we add it to the state.
   if(state.isTracing){
-    state.callPathInstr.push_back(ki->inst);
-    state.stackInstrMap.push_back(std::make_pair(state.traceCallStack, ki->inst));
+    traceInstruction(state, ki);
   }
 
   Instruction *i = ki->inst;
@@ -2186,13 +2305,12 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     }
 
     Function* f = ri->getParent()->getParent();
-    std::string f_name = f->getName().str();
     //Instruction tracing state management
-    if(!state.traceCallStack.empty()){
-      state.traceCallStack.pop_back();
+    if(state.traceCallStack != CallStackTrie::Root){
+      state.traceCallStack = CallStackTrie::get().pop(state.traceCallStack);
 
       //Now we check if this was the --end-fn on the call stack
-      if(f_name == CallTraceEndPoint){
+      if(f->getName() == CallTraceEndPoint){
         state.isTracing = 0;
       }
     }
@@ -2553,19 +2671,19 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     //Instruction Tracing Management
     //Direct call
     if(f && !f->isDeclaration()){
-      std::string f_name = f->getName().str();
-      state.traceCallStack.push_back(f_name);
+      state.traceCallStack =
+          CallStackTrie::get().push(state.traceCallStack, f);
 
       //manage state.is_tracing
-      if(f_name == CallTraceStartPoint){
+      if(f->getName() == CallTraceStartPoint){
         state.isTracing = 1;
         //We must also record the call to --start-fn
-        state.callPathInstr.push_back(ki->inst);
-        state.stackInstrMap.push_back(std::make_pair(state.traceCallStack, ki->inst));      
+        traceInstruction(state, ki);
       }
     }
     else if(cs.getCalledFunction() == NULL){
-      state.traceCallStack.push_back("IndirectCall");
+      state.traceCallStack =
+          CallStackTrie::get().push(state.traceCallStack, nullptr);
     }
 
     // Skip debug intrinsics, we can't evaluate their metadata arguments.
@@ -3495,7 +3613,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 }
 
 void Executor::updateStates(ExecutionState *current) {
-  if (searcher) {
+  if (workerPool) {
+    workerPool->update(current, addedStates, removedStates);
+  } else if (searcher) {
     searcher->update(current, addedStates, removedStates);
   }
   
@@ -3619,13 +3739,18 @@ bool Executor::checkMemoryUsage() {
   if (totalUsage <= MaxMemory + 100)
     return true;
 
-  // just guess at how many to kill
-  const auto numStates = states.size();
+  // just guess at how many to kill; a worker thread only kills its own
+  // states, as the others may be stolen or stepped meanwhile
+  std::vector<ExecutionState *> arr; // FIXME: expensive
+  if (workerPool)
+    arr = workerPool->getOwnStates();
+  else
+    arr.assign(states.begin(), states.end());
+  const auto numStates = arr.size();
   auto toKill = std::max(1UL, numStates - numStates * MaxMemory / totalUsage);
   klee_warning("killing %lu states (over memory cap: %luMB)", toKill, totalUsage);
 
   // randomly select states for early termination
-  std::vector<ExecutionState *> arr(states.begin(), states.end()); // FIXME: expensive
   for (unsigned i = 0, N = arr.size(); N && i < toKill; ++i, --N) {
     unsigned idx = theRNG.getInt32() % N;
     // Make two pulls to try and not hit a state that
@@ -3634,6 +3759,8 @@ bool Executor::checkMemoryUsage() {
       idx = theRNG.getInt32() % N;
 
     std::swap(arr[idx], arr[N - 1]);
+    if (workerPool)
+      workerPool->disown({arr[N - 1]});
     terminateStateEarly(*arr[N - 1], "Memory limit exceeded.");
   }
 
@@ -3721,29 +3848,25 @@ void Executor::run(ExecutionState &initialState) {
     }
   }
 
+  if (interpreterOpts.ParallelWorkers > 1) {
+    if (seedMap.empty()) {
+      workerPool.reset(new WorkerPool(*this, interpreterOpts.ParallelWorkers));
+      workerPool->run();
+      workerPool = nullptr;
+      doDumpStates();
+      return;
+    }
+    klee_warning("states with seeds left, exploring with a single thread");
+  }
+
   searcher = constructUserSearcher(*this);
 
   std::vector<ExecutionState *> newStates(states.begin(), states.end());
   searcher->update(0, newStates, std::vector<ExecutionState *>());
 
   // main interpreter loop
-  while (!states.empty() && !haltExecution) {
-    ExecutionState &state = searcher->selectState();
-    KInstruction *ki = state.pc;
-    stepInstruction(state);
-
-    executeInstruction(state, ki);
-    timers.invoke();
-    if (::dumpStates) dumpStates();
-    if (::dumpPTree) dumpPTree();
-
-    updateStates(&state);
-
-    if (!checkMemoryUsage()) {
-      // update searchers when states were terminated early due to memory pressure
-      updateStates(nullptr);
-    }
-  }
+  while (!states.empty() && !haltExecution)
+    executeStep(searcher->selectState());
 
   delete searcher;
   searcher = nullptr;
@@ -3751,6 +3874,30 @@ void Executor::run(ExecutionState &initialState) {
   doDumpStates();
 }
 
+void Executor::executeStep(ExecutionState &state) {
+  KInstruction *ki = state.pc;
+  stepInstruction(state);
+
+  executeInstruction(state, ki);
+  timers.invoke();
+  if (::dumpStates) dumpStates();
+  if (::dumpPTree) dumpPTree();
+
+  updateStates(&state);
+
+  if (!checkMemoryUsage()) {
+    // update searchers when states were terminated early due to memory pressure
+    updateStates(nullptr);
+  }
+}
+
+std::vector<SolverService *> Executor::getSolverServices() {
+  std::vector<SolverService *> services;
+  for (auto &service : solverServices)
+    services.push_back(service.get());
+  return services;
+}
+
 std::string Executor::getAddressInfo(ExecutionState &state, 
                                      ref<Expr> address) const{
   std::string Str;
@@ -3817,10 +3964,27 @@ void Executor::terminateState(ExecutionState &state) {
     interpreterHandler->incPathsExplored();
   }
 
+  discardState(state);
+}
+
+void Executor::terminateStateAtPathPrefix(ExecutionState &state) {
+  interpreterHandler->processPathPrefix(state);
+  discardState(state);
+}
+
+bool Executor::endsBeforePathPrefix(const ExecutionState &state) const {
+  // The run that emitted the prefixes has written the tests of the paths
+  // shorter than them.
+  return replayPath && interpreterOpts.ReplayPathIsPrefix &&
+         state.pathLength < replayPath->size();
+}
+
+void Executor::discardState(ExecutionState &state) {
   ExecutionState *replacement = 0;
   state.terminateState(&replacement);
   assert(replacement != &state);
   if (replacement) {
+    // Not a fork: the replacement keeps the branches of the state
     processTree->attach(state.ptreeNode, replacement, &state);
     addedStates.push_back(replacement);
   }
@@ -3845,6 +4009,10 @@ void Executor::terminateState(ExecutionState &state) {
 
 void Executor::terminateStateEarly(ExecutionState &state, 
                                    const Twine &message) {
+  if (endsBeforePathPrefix(state)) {
+    discardState(state);
+    return;
+  }
   if (!OnlyOutputStatesCoveringNew || state.coveredNew ||
       (AlwaysOutputSeeds && seedMap.count(&state)))
     interpreterHandler->processTestCase(state, (message + "\n").str().c_str(),
@@ -3853,6 +4021,10 @@ void Executor::terminateStateEarly(ExecutionState &state,
 }
 
 void Executor::terminateStateOnExit(ExecutionState &state) {
+  if (endsBeforePathPrefix(state)) {
+    discardState(state);
+    return;
+  }
   if (!OnlyOutputStatesCoveringNew || state.coveredNew || 
       (AlwaysOutputSeeds && seedMap.count(&state)))
     interpreterHandler->processTestCase(state, 0, 0);
@@ -3918,6 +4090,10 @@ void Executor::terminateStateOnError(ExecutionState &state,
                                      enum TerminateReason termReason,
                                      const char *suffix,
                                      const llvm::Twine &info) {
+  if (endsBeforePathPrefix(state)) {
+    discardState(state);
+    return;
+  }
   std::string message = messaget.str();
   static std::set< std::pair<Instruction*, std::string> > emittedErrors;
   Instruction * lastInst;
@@ -4131,6 +4307,9 @@ ObjectState *Executor::bindObjectInState(ExecutionState &state,
                                          const Array *array) {
   ObjectState *os = array ? new ObjectState(mo, array) : new ObjectState(mo);
   state.addressSpace.bindObject(mo, os);
+  // Objects reusing the address of an intercepted object are intercepted too.
+  if (state.isInterceptedAddress(mo->address))
+    mo->isIntercepted = true;
 
   // Its possible that multiple bindings of the same mo in the state
   // will put multiple copies on this list, but it doesn't really
@@ -4383,16 +4562,7 @@ void Executor::executeMemoryOperation(ExecutionState &state,
 
     // check if the operation is intercepted
     if (isWrite) {
-      std::string interceptWriter = state.getInterceptWriter(mo->address);
-      if (interceptWriter != "") {
-        GlobalValue *gv = kmodule->module->getNamedValue(interceptWriter);
-        if (!gv) {
-          klee_error("Function %s(), interceptor, not found!\n", interceptWriter.c_str());
-        }
-        Function* interceptFunc;
-        if (!(interceptFunc = dyn_cast<Function>(gv))) {
-          klee_error("Interceptor is not a function\n");
-        }
+      if (Function *interceptFunc = state.getInterceptWriter(mo)) {
         std::vector<ref<Expr>> interceptArgs;
         interceptArgs.push_back(/* address */ ConstantExpr::alloc(mo->address, 64));
         interceptArgs.push_back(/* offset */ ZExtExpr::create(offset, 32));
@@ -4402,16 +4572,7 @@ void Executor::executeMemoryOperation(ExecutionState &state,
         return;
       }
     } else {
-      std::string interceptReader = state.getInterceptReader(mo->address);
-      if (interceptReader != "") {
-        GlobalValue *gv = kmodule->module->getNamedValue(interceptReader);
-        if (!gv) {
-          klee_error("Function %s(), interceptor, not found!\n", interceptReader.c_str());
-        }
-        Function* interceptFunc;
-        if (!(interceptFunc = dyn_cast<Function>(gv))) {
-          klee_error("Interceptor is not a function\n");
-        }
+      if (Function *interceptFunc = state.getInterceptReader(mo)) {
         std::vector<ref<Expr>> interceptArgs;
         interceptArgs.push_back(/* address */ ConstantExpr::alloc(mo->address, 64));
         interceptArgs.push_back(/* offset */ ZExtExpr::create(offset, 32));
@@ -4531,9 +4692,10 @@ void Executor::executeMakeSymbolic(ExecutionState &state,
     // or if that fails try adding a unique identifier.
     unsigned id = 0;
     std::string uniqueName = name;
-    while (!state.arrayNames.insert(uniqueName).second) {
+    while (state.arrayNames.count(uniqueName)) {
       uniqueName = name + "_" + llvm::utostr(++id);
     }
+    state.arrayNames = state.arrayNames.insert(uniqueName);
     const Array *array = arrayCache.CreateArray(uniqueName, mo->size);
     bindObjectInState(state, mo, false, array);
     state.addSymbolic(mo, array);
@@ -4609,9 +4771,10 @@ void Executor::executePossiblyHavoc(ExecutionState &state,
 
   unsigned id = 0;
   std::string uniqueName = name;
-  while (!state.havocNames.insert(uniqueName).second) {
+  while (state.havocNames.count(uniqueName)) {
     uniqueName = name + "_" + llvm::utostr(++id);
   }
+  state.havocNames = state.havocNames.insert(uniqueName);
 
   state.addHavocInfo(mo, uniqueName);
 }
@@ -4816,7 +4979,7 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
   std::vector< std::vector<unsigned char> > values;
   std::vector<const Array*> objects;
   std::vector<std::string> havoc_names;
-  std::vector<BitArray> havoc_masks;
+  std::vector<ByteRangeMask> havoc_masks;
   for (unsigned i = 0; i != state.symbolics.size(); ++i)
     objects.push_back(state.symbolics[i].second);
 
@@ -4895,6 +5058,19 @@ Expr::Width Executor::getWidthForLLVMType(llvm::Type *type) const {
   return kmodule->targetData->getTypeSizeInBits(type);
 }
 
+size_t Executor::getLoopAnalysisMemoryUsage() const {
+  size_t usage = 0;
+  std::set<const LoopInProcess *> visited;
+  for (const ExecutionState *state : states) {
+    for (const LoopInProcess *loop = state->loopInProcess.get();
+         loop && visited.insert(loop).second; loop = loop->getOuter().get())
+      usage += getMemoryUsage(loop->getChangedBytes());
+  }
+  for (const auto &kf : kmodule->functions)
+    usage += kf->getAnalysedLoopsMemoryUsage();
+  return usage;
+}
+
 size_t Executor::getAllocationAlignment(const llvm::Value *allocSite) const {
   // FIXME: 8 was the previous default. We shouldn't hard code this
   // and should fetch the default from elsewhere.
@@ -17,6 +17,7 @@
 
 #include "ExecutionState.h"
 #include "UserSearcher.h"
+#include "WorkerPool.h"
 
 #include "klee/ADT/RNG.h"
 #include "klee/Core/Interpreter.h"
@@ -25,6 +26,7 @@
 #include "klee/Module/Cell.h"
 #include "klee/Module/KInstruction.h"
 #include "klee/Module/KModule.h"
+#include "klee/Solver/SolverService.h"
 #include "klee/System/Time.h"
 
 #include "llvm/ADT/Twine.h"
@@ -68,6 +70,7 @@ namespace klee {
   class MemoryManager;
   class MemoryObject;
   class ObjectState;
+  class PathCostModel;
   class PTree;
   class Searcher;
   class SeedInfo;
@@ -92,6 +95,7 @@ class Executor : public Interpreter {
   friend class SpecialFunctionHandler;
   friend class StatsTracker;
   friend class MergeHandler;
+  friend class WorkerPool;
   friend klee::Searcher *klee::constructUserSearcher(Executor &executor);
 
 public:
@@ -127,6 +131,9 @@ private:
   Searcher *searcher;
 
   ExternalDispatcher *externalDispatcher;
+  /// Share the solver chains between `solver` and other clients, one chain
+  /// per worker thread, as a service must not be used by several threads.
+  std::vector<std::unique_ptr<SolverService>> solverServices;
   TimingSolver *solver;
   MemoryManager *memory;
   std::set<ExecutionState*, ExecutionStateIDCompare> states;
@@ -136,6 +143,12 @@ private:
   TimerGroup timers;
   std::unique_ptr<PTree> processTree;
 
+  /// The worker threads of parallel exploration, while they run.
+  std::unique_ptr<WorkerPool> workerPool;
+
+  /// The model path costs are counted with, if enabled.
+  const PathCostModel *pathCostModel = nullptr;
+
   /// Used to track states that have been added during the current
   /// instructions step. 
   /// \invariant \ref addedStates is a subset of \ref states. 
@@ -174,8 +187,8 @@ private:
   /// When non-null a list of branch decisions to be used for replay.
   const std::vector<bool> *replayPath;
 
-  /// The index into the current \ref replayKTest or \ref replayPath
-  /// object.
+  /// The index into the current \ref replayKTest object. States keep their
+  /// own position in the \ref replayPath (ExecutionState::pathLength).
   unsigned replayPosition;
 
   /// When non-null a list of "seed" inputs which will be used to
@@ -234,8 +247,14 @@ private:
   
   void executeInstruction(ExecutionState &state, KInstruction *ki);
 
+  /// Records an instruction executed while tracing.
+  void traceInstruction(ExecutionState &state, KInstruction *ki);
+
   void run(ExecutionState &initialState);
 
+  /// Executes one instruction of `state` and updates the states.
+  void executeStep(ExecutionState &state);
+
   // Given a concrete object in our [klee's] address space, add it to 
   // objects checked code can reference.
   MemoryObject *addExternalObject(ExecutionState &state, void *addr, 
@@ -355,6 +374,22 @@ private:
               const std::vector< ref<Expr> > &conditions,
               std::vector<ExecutionState*> &result);
 
+  /// Whether the branch decisions of state are taken from the replayed
+  /// path.
+  bool isReplayingPath(const ExecutionState &state) const;
+
+  /// Whether the paths record the arms taken at branch() (only with path
+  /// prefixes, so that -write-paths files keep their format otherwise).
+  bool isRecordingArms() const;
+
+  /// The arm of a branch() over N conditions that the replayed path
+  /// records for state.
+  unsigned getReplayedArm(const ExecutionState &state, unsigned N) const;
+
+  /// Records in the path of state that it took the arm of a branch() over
+  /// N conditions: arm zeros, then a one unless it is the last arm.
+  void recordArm(ExecutionState &state, unsigned arm, unsigned N);
+
   // Fork current and return states in which condition holds / does
   // not hold, respectively. One of the states is necessarily the
   // current state, and one of the states may be null.
@@ -434,6 +469,13 @@ private:
 
   // remove state from queue and delete
   void terminateState(ExecutionState &state);
+  // remove state from queue and delete, without counting it as a path
+  void discardState(ExecutionState &state);
+  // hand the path of the state over to the handler as a prefix and discard it
+  void terminateStateAtPathPrefix(ExecutionState &state);
+  // whether the state ends before the replayed path prefix, so that its
+  // path belongs to another prefix and it is discarded without a test
+  bool endsBeforePathPrefix(const ExecutionState &state) const;
   // call exit handler and terminate state
   void terminateStateEarly(ExecutionState &state, const llvm::Twine &message);
   // call exit handler and terminate state
@@ -550,12 +592,18 @@ public:
                        std::map<const std::string *, std::set<unsigned>> &res)
       override;
 
+  std::vector<SolverService *> getSolverServices() override;
+
   Expr::Width getWidthForLLVMType(llvm::Type *type) const;
   size_t getAllocationAlignment(const llvm::Value *allocSite) const;
 
   /// Returns the errno location in memory of the state
   int *getErrnoLocation(const ExecutionState &state) const;
 
+  /// The memory used by the forget masks of the loops being analysed and
+  /// of the analysed loops.
+  size_t getLoopAnalysisMemoryUsage() const;
+
   MergingSearcher *getMergingSearcher() const { return mergingSearcher; };
   void setMergingSearcher(MergingSearcher *ms) { mergingSearcher = ms; };
 };
@@ -0,0 +1,50 @@
+//===-- InstructionTrace.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "InstructionTrace.h"
+
+#include "llvm/IR/Function.h"
+
+using namespace llvm;
+using namespace klee;
+
+CallStackTrie::CallStackTrie() {
+  nodes.push_back({Root, 0, 0});
+  fnNames.push_back("IndirectCall");
+  fnIds[nullptr] = 0;
+}
+
+CallStackTrie &CallStackTrie::get() {
+  static CallStackTrie trie;
+  return trie;
+}
+
+CallStackTrie::NodeId CallStackTrie::push(NodeId stack, const Function *f) {
+  auto fnIt = fnIds.find(f);
+  if (fnIt == fnIds.end()) {
+    fnIt = fnIds.emplace(f, fnNames.size()).first;
+    fnNames.push_back(f->getName().str());
+  }
+  std::uint64_t key = (std::uint64_t(stack) << 32) | fnIt->second;
+  auto childIt = children.find(key);
+  if (childIt != children.end())
+    return childIt->second;
+
+  NodeId id = nodes.size();
+  nodes.push_back({stack, fnIt->second, nodes[stack].depth + 1});
+  children.emplace(key, id);
+  return id;
+}
+
+void CallStackTrie::getFrames(NodeId stack,
+                              std::vector<const std::string *> &frames) const {
+  frames.resize(nodes[stack].depth);
+  for (NodeId n = stack; n != Root; n = nodes[n].parent)
+    frames[nodes[n].depth - 1] = &fnNames[nodes[n].fn];
+}
@@ -0,0 +1,96 @@
+//===-- InstructionTrace.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_INSTRUCTIONTRACE_H
+#define KLEE_INSTRUCTIONTRACE_H
+
+#include "ChunkedLog.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace llvm {
+class Function;
+}
+
+namespace klee {
+struct KInstruction;
+
+/// Interns the call stacks recorded while tracing instructions
+/// (-dump-call-trace-instructions). Every stack is a node of a trie whose
+/// edges are interned function names, so a state refers to its stack
+/// with a single id and all states share the common stack prefixes.
+class CallStackTrie {
+public:
+  typedef std::uint32_t NodeId;
+
+  /// The empty call stack.
+  static const NodeId Root = 0;
+
+private:
+  struct Node {
+    NodeId parent;
+    std::uint32_t fn;
+    std::uint32_t depth;
+  };
+
+  std::vector<Node> nodes;
+  std::vector<std::string> fnNames;
+  std::unordered_map<const llvm::Function *, std::uint32_t> fnIds;
+  std::unordered_map<std::uint64_t, NodeId> children;
+
+  CallStackTrie();
+
+public:
+  /// The trie shared by all states of the process.
+  static CallStackTrie &get();
+
+  /// The stack obtained by calling `f` on top of `stack`. A null `f`
+  /// stands for an indirect call.
+  NodeId push(NodeId stack, const llvm::Function *f);
+
+  /// The stack of the caller of the topmost function.
+  NodeId pop(NodeId stack) const { return nodes[stack].parent; }
+
+  /// Name of the topmost function of a non-empty stack.
+  const std::string &top(NodeId stack) const {
+    return fnNames[nodes[stack].fn];
+  }
+
+  /// Id of the topmost function of a non-empty stack, unique per function.
+  std::uint32_t topFn(NodeId stack) const { return nodes[stack].fn; }
+
+  const std::string &fnName(std::uint32_t fn) const { return fnNames[fn]; }
+
+  unsigned depth(NodeId stack) const { return nodes[stack].depth; }
+
+  /// Function names of the stack, outermost first.
+  void getFrames(NodeId stack, std::vector<const std::string *> &frames) const;
+};
+
+struct InstructionTraceEntry {
+  CallStackTrie::NodeId stack;
+  KInstruction *ki;
+};
+
+/// The instructions executed by a state while tracing, each paired with
+/// its call stack. Forked states share the prefix they executed together.
+class InstructionTrace : public ChunkedLog<InstructionTraceEntry> {
+public:
+  typedef InstructionTraceEntry Entry;
+
+  void push_back(CallStackTrie::NodeId stack, KInstruction *ki) {
+    ChunkedLog<InstructionTraceEntry>::push_back({stack, ki});
+  }
+};
+} // namespace klee
+
+#endif /* KLEE_INSTRUCTIONTRACE_H */
@@ -14,6 +14,7 @@
 #include "MemoryManager.h"
 
 #include "klee/ADT/BitArray.h"
+#include "klee/ADT/ByteRangeMask.h"
 #include "klee/Expr/ArrayCache.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Support/OptionCategories.h"
@@ -268,7 +269,7 @@ const Array *ObjectState::forgetAll() {
   return array;
 }
 
-const Array *ObjectState::forgetThese(const BitArray *bytesToForget) {
+const Array *ObjectState::forgetThese(const ByteRangeMask &bytesToForget) {
   assert(accessible);
   static unsigned id = 0;
   //assert(size != 0); //TODO: why size can ever be 0?
@@ -277,15 +278,25 @@ const Array *ObjectState::forgetThese(const BitArray *bytesToForget) {
     getArrayCache()->CreateArray("reset_" + object->name + "_" + llvm::utostr(++id),
                                  size);
   UpdateList ul(array, 0);
-  for (unsigned i=0; i<size; i++) {
-    if (bytesToForget->get(i)) {
-      markByteSymbolic(i);
-      ref<Expr> read = ReadExpr::create(ul, ConstantExpr::alloc(i, Expr::Int32));
-      setKnownSymbolic(i, read.get());
-      markByteUnflushed(i);
-    }
+  if (!bytesToForget.empty()) {
+    if (!concreteMask)
+      concreteMask = new BitArray(size, true);
+    if (!knownSymbolics)
+      knownSymbolics = new ref<Expr>[size];
+  }
+  // Mark whole ranges symbolic and unflushed at once; only the reads of
+  // the new array are per byte.
+  for (const ByteRangeMask::Range &range : bytesToForget) {
+    unsigned end = std::min(range.end, size);
+    if (range.begin >= end)
+      continue;
+    concreteMask->set(range.begin, end, false);
+    if (flushMask)
+      flushMask->set(range.begin, end, true);
+    for (unsigned i = range.begin; i < end; i++)
+      knownSymbolics[i] =
+          ReadExpr::create(ul, ConstantExpr::alloc(i, Expr::Int32));
   }
-  // llvm::errs() << "\n";
   return array;
 }
 
@@ -28,6 +28,7 @@ namespace klee {
 
 class ArrayCache;
 class BitArray;
+class ByteRangeMask;
 class ExecutionState;
 class MemoryManager;
 class Solver;
@@ -58,6 +59,12 @@ public:
 
   bool isUserSpecified;
 
+  /// Whether some state intercepts the reads or writes of this object (see
+  /// klee_intercept_reads). Objects without it skip the interceptor lookup
+  /// on every access. Mutable since interceptors are registered after
+  /// allocation; it is never cleared.
+  mutable bool isIntercepted;
+
   MemoryManager *parent;
 
   /// "Location" for which this memory object was allocated. This
@@ -83,6 +90,7 @@ public:
       address(_address),
       size(0),
       isFixed(true),
+      isIntercepted(false),
       parent(NULL),
       allocSite(0) {
   }
@@ -99,6 +107,7 @@ public:
       isGlobal(_isGlobal),
       isFixed(_isFixed),
       isUserSpecified(false),
+      isIntercepted(false),
       parent(_parent), 
       allocSite(_allocSite) {
   }
@@ -250,7 +259,7 @@ public:
   void flushToConcreteStore(TimingSolver *solver,
                             const ExecutionState &state) const;
 
-  const Array *forgetThese(const BitArray *bytesToForget);
+  const Array *forgetThese(const ByteRangeMask &bytesToForget);
   const Array *forgetAll();
 
 private:
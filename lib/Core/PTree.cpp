@@ -36,14 +36,22 @@ PTree::PTree(ExecutionState *initialState)
   initialState->ptreeNode = root.getPointer();
 }
 
-void PTree::attach(PTreeNode *node, ExecutionState *leftState, ExecutionState *rightState) {
+void PTree::attach(PTreeNode *node, ExecutionState *leftState,
+                   ExecutionState *rightState, ref<Expr> leftCondition,
+                   ref<Expr> rightCondition) {
   assert(node && !node->left.getPointer() && !node->right.getPointer());
   assert(node == rightState->ptreeNode &&
          "Attach assumes the right state is the current state");
   node->state = nullptr;
+  if (!leftCondition.isNull() && !rightCondition.isNull()) {
+    ref<PTreeFork> parent = rightState->lastFork;
+    std::uint32_t depth = rightState->constraints.size();
+    leftState->lastFork = new PTreeFork(parent, depth, leftCondition);
+    rightState->lastFork = new PTreeFork(parent, depth, rightCondition);
+  }
   node->left = PTreeNodePtr(new PTreeNode(node, leftState));
   // The current node inherits the tag
-  uint8_t currentNodeTag = root.getInt();
+  std::uint32_t currentNodeTag = root.getInt();
   if (node->parent)
     currentNodeTag = node->parent->left.getPointer() == node
                          ? node->parent->left.getInt()
@@ -132,3 +140,38 @@ PTreeNode::PTreeNode(PTreeNode *parent, ExecutionState *state) : parent{parent},
   left = PTreeNodePtr(nullptr);
   right = PTreeNodePtr(nullptr);
 }
+
+PTreeFork::PTreeFork(const ref<PTreeFork> &parent,
+                     std::uint32_t constraintDepth, ref<Expr> condition)
+    : parent{parent}, level{parent.isNull() ? 1 : parent->level + 1},
+      constraintDepth{constraintDepth}, condition{condition} {}
+
+PTreeFork::~PTreeFork() {
+  // Release the path iteratively: deep paths would otherwise overflow the
+  // stack through the recursive ref<> destructors.
+  while (!parent.isNull() && parent->_refCount.getCount() == 1) {
+    ref<PTreeFork> next = std::move(parent->parent);
+    parent = std::move(next);
+  }
+}
+
+bool PTreeFork::divergence(const PTreeFork *a, const PTreeFork *b,
+                           const PTreeFork *&aBranch,
+                           const PTreeFork *&bBranch) {
+  if (!a || !b)
+    return false;
+  while (a->level > b->level)
+    a = a->parent.get();
+  while (b->level > a->level)
+    b = b->parent.get();
+  if (a == b)
+    return false;
+  // The paths diverge where they have the same parent
+  while (a->parent.get() != b->parent.get()) {
+    a = a->parent.get();
+    b = b->parent.get();
+  }
+  aBranch = a;
+  bBranch = b;
+  return true;
+}
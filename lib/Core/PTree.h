@@ -12,7 +12,8 @@
 
 #include "klee/Expr/Expr.h"
 #include "klee/Support/ErrorHandling.h"
-#include "llvm/ADT/PointerIntPair.h"
+
+#include <cstdint>
 
 namespace klee {
   class ExecutionState;
@@ -21,9 +22,24 @@ namespace klee {
   record which PTreeNode belongs to it. PTree is a global structure that
   captures all  states, whereas a Random Path Searcher might only care about
   a subset. The integer part of PTreeNodePtr is a bitmask (a "tag") of which
-  Random Path Searchers PTreeNode belongs to. */
-  constexpr int PtrBitCount = 3;
-  using PTreeNodePtr = llvm::PointerIntPair<PTreeNode *, PtrBitCount, uint8_t>;
+  Random Path Searchers PTreeNode belongs to. It is kept next to the pointer
+  rather than in its alignment bits, which would only leave room for three
+  searchers, while every worker of -parallel-workers has its own. */
+  constexpr int PtrBitCount = 32;
+
+  class PTreeNodePtr {
+    PTreeNode *pointer = nullptr;
+    std::uint32_t tag = 0;
+
+  public:
+    PTreeNodePtr() = default;
+    explicit PTreeNodePtr(PTreeNode *pointer, std::uint32_t tag = 0)
+        : pointer{pointer}, tag{tag} {}
+
+    PTreeNode *getPointer() const { return pointer; }
+    std::uint32_t getInt() const { return tag; }
+    void setInt(std::uint32_t value) { tag = value; }
+  };
 
   class PTreeNode {
   public:
@@ -38,6 +54,41 @@ namespace klee {
     ~PTreeNode() = default;
   };
 
+  /// The branch a state took at a fork, recorded by PTree::attach (or by
+  /// Executor::branch for N-way forks). The branches of a path form a list
+  /// shared with the states forked from it, and all the arms of a fork have
+  /// the same parent. Unlike PTreeNodes, they
+  /// stay alive as long as a state or a test refers to them, and
+  /// -compress-process-tree does not remove them.
+  class PTreeFork {
+  public:
+    class ReferenceCounter _refCount;
+
+    /// The branch taken at the previous fork on the path.
+    ref<PTreeFork> parent;
+
+    /// Number of forks on the path, including this one.
+    const std::uint32_t level;
+
+    /// Number of path constraints at the fork.
+    const std::uint32_t constraintDepth;
+
+    /// The condition of the branch. It is kept as is, since the
+    /// constraint manager may split or rewrite the constraint it adds.
+    const ref<Expr> condition;
+
+    PTreeFork(const ref<PTreeFork> &parent, std::uint32_t constraintDepth,
+              ref<Expr> condition);
+    PTreeFork(const PTreeFork &) = delete;
+    ~PTreeFork();
+
+    /// Finds the branches two paths took at the last fork they share.
+    /// Returns false if they share no fork or do not diverge.
+    static bool divergence(const PTreeFork *a, const PTreeFork *b,
+                           const PTreeFork *&aBranch,
+                           const PTreeFork *&bBranch);
+  };
+
   class PTree {
     // Number of registered ID
     int registeredIds = 0;
@@ -47,17 +98,22 @@ namespace klee {
     explicit PTree(ExecutionState *initialState);
     ~PTree() = default;
 
+    /// Records that the state of `node` forked into `leftState` and
+    /// `rightState`, on the conditions of each side. Without conditions,
+    /// e.g. for the replacement of a terminated state, only the process
+    /// tree is extended.
     void attach(PTreeNode *node, ExecutionState *leftState,
-                ExecutionState *rightState);
+                ExecutionState *rightState,
+                ref<Expr> leftCondition = ref<Expr>(),
+                ref<Expr> rightCondition = ref<Expr>());
     void remove(PTreeNode *node);
     void dump(llvm::raw_ostream &os);
-    std::uint8_t getNextId() {
-      std::uint8_t id = 1 << registeredIds++;
-      if (registeredIds > PtrBitCount) {
+    std::uint32_t getNextId() {
+      if (registeredIds == PtrBitCount) {
         klee_error("PTree cannot support more than %d RandomPathSearchers",
                    PtrBitCount);
       }
-      return id;
+      return 1U << registeredIds++;
     }
   };
 }
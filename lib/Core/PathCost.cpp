@@ -0,0 +1,339 @@
+//===-- PathCost.cpp ------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PathCost.h"
+
+#include "klee/Module/KInstruction.h"
+#include "klee/Support/ErrorHandling.h"
+#include "klee/Support/OptionCategories.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <sstream>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+cl::opt<bool> CountPathCost(
+    "count-path-cost",
+    cl::desc("Count the instructions, memory accesses and cost of every "
+             "path while tracing, outside of demarcated functions, and "
+             "write them into its .call_path (default=false)"),
+    cl::init(false), cl::cat(TestGenCat));
+
+cl::opt<std::string> PathCostConfig(
+    "path-cost-config",
+    cl::desc("Read the demarcated functions and the opcode costs of "
+             "-count-path-cost and -dump-call-trace-instructions from this "
+             "file. Implies -count-path-cost."),
+    cl::value_desc("path"), cl::cat(TestGenCat));
+
+/// The configuration used without -path-cost-config.
+const char DefaultConfig[] = R"(
+# libVig data structures
+demarcate dchain_allocate
+demarcate dchain_allocate_new_index
+demarcate dchain_rejuvenate_index
+demarcate dchain_expire_one_index
+demarcate dmap_allocate
+demarcate dmap_get_a
+demarcate dmap_get_b
+demarcate dmap_put
+demarcate dmap_erase
+demarcate dmap_get_value
+demarcate dmap_size
+demarcate expire_items
+demarcate expire_items_single_map
+demarcate map_impl_init
+demarcate map_impl_get
+demarcate map_impl_put
+demarcate map_impl_erase
+demarcate map_allocate
+demarcate map_get
+demarcate map_put
+demarcate map_erase
+demarcate map_size
+demarcate dchain_make_space
+demarcate dchain_reset
+demarcate map_set_layout
+demarcate map_entry_condition
+demarcate map_set_entry_condition
+demarcate map_reset
+demarcate map_increase_occupancy
+demarcate map_decrease_occupancy
+demarcate dmap_set_layout
+demarcate entry_condition
+demarcate dmap_set_entry_condition
+demarcate dmap_reset
+demarcate dmap_increase_occupancy
+demarcate dmap_decrease_occupancy
+demarcate dmap_lowerbound_on_occupancy
+demarcate dmap_occupancy_p
+demarcate vector_allocate
+demarcate vector_borrow
+demarcate vector_return
+demarcate vector_set_layout
+demarcate vector_reset
+demarcate handle_packet_timestamp
+demarcate lpm_lookup
+demarcate lpm_init
+demarcate memcpy
+demarcate trace_reset_buffers
+demarcate map_get_1
+demarcate map_get_2
+demarcate map2_get_1
+demarcate map2_put
+demarcate map2_erase
+demarcate dchain2_allocate
+demarcate dchain2_allocate_new_index
+demarcate dchain2_rejuvenate_index
+demarcate dchain2_expire_one_index
+demarcate lb_find_preferred_available_backend
+demarcate dchain_is_index_allocated
+demarcate dchain2_is_index_allocated
+demarcate dchain2_make_space
+demarcate dchain2_reset
+demarcate map2_set_layout
+demarcate map2_entry_condition
+demarcate map2_set_entry_condition
+demarcate map2_reset
+demarcate map2_increase_occupancy
+demarcate map2_decrease_occupancy
+demarcate process_ip_packet
+# DPDK
+demarcate rte_reset
+demarcate rte_arch_bswap16
+demarcate rte_arch_bswap32
+demarcate rte_arch_bswap64
+demarcate __rte_raw_cksum
+demarcate __rte_raw_cksum_reduce
+demarcate rte_raw_cksum
+demarcate rte_ipv4_phdr_cksum
+demarcate rte_ipv4_cksum
+demarcate rte_ipv4_udptcp_cksum
+demarcate rte_exit
+demarcate rte_lcore_is_enabled
+demarcate rte_get_master_lcore
+demarcate rte_get_closest_next_lcore
+demarcate rte_eth_tx_burst
+demarcate flood
+demarcate rte_pktmbuf_free
+demarcate rte_get_tsc_hz
+demarcate rte_lcore_id
+demarcate rte_rdtsc
+demarcate rte_eth_rx_burst
+demarcate rte_prefetch0
+demarcate rte_lcore_is_enabled
+demarcate rte_lcore_to_socket_id
+demarcate rte_socket_id
+demarcate rte_eth_dev_socket_id
+demarcate rte_eth_link_get_nowait
+demarcate rte_delay_ms
+demarcate rte_eal_init
+demarcate rte_eth_dev_count
+demarcate rte_lcore_count
+demarcate rte_eth_dev_configure
+demarcate rte_eth_macaddr_get
+demarcate rte_eth_dev_info_get
+demarcate rte_eth_tx_queue_setup
+demarcate rte_eth_rx_queue_setup
+demarcate rte_eth_dev_start
+demarcate rte_eth_promiscuous_enable
+demarcate rte_eal_mp_remote_launch
+demarcate rte_eal_wait_lcore
+demarcate rte_pktmbuf_pool_create
+demarcate rte_get_master_lcore
+demarcate rte_strerror
+demarcate rte_pktmbuf_clone
+demarcate cmdline_isendoftoken
+demarcate nf_set_ipv4_checksum
+# Time
+demarcate start_time
+demarcate restart_time
+demarcate current_time
+demarcate get_start_time_internal
+demarcate get_start_time
+demarcate clock_gettime
+demarcate gettimeofday
+# Verification helpers
+demarcate loop_iteration_assumptions
+demarcate loop_iteration_assertions
+demarcate loop_invariant_consume
+demarcate loop_invariant_produce
+demarcate loop_iteration_begin
+demarcate loop_iteration_end
+demarcate loop_enumeration_begin
+demarcate loop_enumeration_end
+demarcate allocate_unique_name
+demarcate count_reuse
+demarcate init_test_data
+demarcate report_internal_error
+demarcate rand_byte
+demarcate bridge_loop_invariant_consume
+demarcate bridge_loop_invariant_produce
+demarcate bridge_loop_iteration_begin
+demarcate bridge_loop_iteration_end
+demarcate bridge_loop_iteration_assumptions
+demarcate nf_loop_iteration_begin
+demarcate nf_add_loop_iteration_assumptions
+demarcate nf_loop_iteration_end
+demarcate concretize_devices
+demarcate flow_consistency
+demarcate rte_eth_dev_count
+demarcate flood
+demarcate exit
+demarcate __uClibc_fini
+demarcate _stdio_term
+# eBPF helpers
+demarcate bpf_map_lookup_elem
+demarcate bpf_map_update_elem
+demarcate bpf_csum_diff
+demarcate bpf_xdp_adjust_head
+# KLEE intrinsics and exit stubs
+demarcate-regex klee*
+demarcate-regex _exit@plt*
+)";
+} // namespace
+
+PathCostModel::PathCostModel() : opcodeCosts(Instruction::OtherOpsEnd, 1) {}
+
+bool PathCostModel::parse(const std::string &config, std::string &error) {
+  std::istringstream in(config);
+  std::string line;
+  for (unsigned lineNo = 1; std::getline(in, line); ++lineNo) {
+    StringRef text = StringRef(line).split('#').first.trim();
+    if (text.empty())
+      continue;
+    std::pair<StringRef, StringRef> keyword = text.split(' ');
+    StringRef arg = keyword.second.trim();
+    if (keyword.first == "demarcate" && !arg.empty()) {
+      functions.insert(arg.str());
+    } else if (keyword.first == "demarcate-regex" && !arg.empty()) {
+      llvm::Regex pattern("^(" + arg.str() + ")$");
+      std::string regexError;
+      if (!pattern.isValid(regexError)) {
+        error = "line " + std::to_string(lineNo) + ": " + regexError;
+        return false;
+      }
+      patterns.push_back(std::move(pattern));
+    } else if (keyword.first == "cost") {
+      std::pair<StringRef, StringRef> opcodeCost = arg.split(' ');
+      std::uint64_t cost;
+      if (opcodeCost.second.trim().getAsInteger(10, cost)) {
+        error = "line " + std::to_string(lineNo) + ": invalid cost";
+        return false;
+      }
+      if (opcodeCost.first == "default") {
+        std::fill(opcodeCosts.begin(), opcodeCosts.end(), cost);
+        continue;
+      }
+      unsigned op = 1;
+      while (op < Instruction::OtherOpsEnd &&
+             opcodeCost.first != Instruction::getOpcodeName(op))
+        ++op;
+      if (op == Instruction::OtherOpsEnd) {
+        error = "line " + std::to_string(lineNo) + ": unknown opcode " +
+                opcodeCost.first.str();
+        return false;
+      }
+      opcodeCosts[op] = cost;
+    } else {
+      error = "line " + std::to_string(lineNo) + ": invalid entry";
+      return false;
+    }
+  }
+  demarcatedFns.clear();
+  return true;
+}
+
+const PathCostModel &PathCostModel::get() {
+  static std::unique_ptr<PathCostModel> model;
+  if (!model) {
+    model.reset(new PathCostModel());
+    std::string config = DefaultConfig, error;
+    if (!PathCostConfig.empty()) {
+      auto buffer = MemoryBuffer::getFile(PathCostConfig);
+      if (!buffer)
+        klee_error("Unable to read path cost config %s: %s",
+                   PathCostConfig.c_str(),
+                   buffer.getError().message().c_str());
+      config = (*buffer)->getBuffer().str();
+    }
+    if (!model->parse(config, error))
+      klee_error("Invalid path cost config %s: %s",
+                 PathCostConfig.empty() ? "(default)" : PathCostConfig.c_str(),
+                 error.c_str());
+  }
+  return *model;
+}
+
+bool PathCostModel::enabled() {
+  return CountPathCost || !PathCostConfig.empty();
+}
+
+bool PathCostModel::isDemarcated(const std::string &fn) const {
+  if (functions.count(fn))
+    return true;
+  for (const llvm::Regex &pattern : patterns)
+    if (pattern.match(fn))
+      return true;
+  return false;
+}
+
+bool PathCostModel::isDemarcated(std::uint32_t fn) const {
+  if (fn >= demarcatedFns.size())
+    demarcatedFns.resize(fn + 1, 0);
+  if (!demarcatedFns[fn])
+    demarcatedFns[fn] =
+        isDemarcated(CallStackTrie::get().fnName(fn)) ? 2 : 1;
+  return demarcatedFns[fn] == 2;
+}
+
+bool PathCostModel::step(PathCost &cost, CallStackTrie::NodeId stack,
+                         const KInstruction *ki) const {
+  if (stack == CallStackTrie::Root)
+    return false; // Cant do anything with an empty call stack
+  unsigned opcode = ki->inst->getOpcode();
+  std::uint32_t fn = CallStackTrie::get().topFn(stack);
+
+  // Skip the demarcated function up to (and including) its return.
+  if (cost.demarcatedFn != PathCost::NoFunction) {
+    if (opcode == Instruction::Ret && fn == cost.demarcatedFn)
+      cost.demarcatedFn = PathCost::NoFunction;
+    return false;
+  }
+  if (cost.checkCallee) {
+    cost.checkCallee = false;
+    if (isDemarcated(fn)) {
+      cost.demarcatedFn = fn;
+      return false;
+    }
+  }
+
+  if (opcode == Instruction::Call)
+    cost.checkCallee = true;
+  ++cost.instructions;
+  if (opcode == Instruction::Load)
+    ++cost.loads;
+  else if (opcode == Instruction::Store)
+    ++cost.stores;
+  cost.cost += opcodeCosts[opcode];
+  return true;
+}
+
+std::string PathCostModel::format(const PathCost &cost) {
+  return "instructions = " + std::to_string(cost.instructions) +
+         "\nloads = " + std::to_string(cost.loads) +
+         "\nstores = " + std::to_string(cost.stores) +
+         "\ncost = " + std::to_string(cost.cost) + "\n";
+}
@@ -0,0 +1,94 @@
+//===-- PathCost.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PATHCOST_H
+#define KLEE_PATHCOST_H
+
+#include "InstructionTrace.h"
+
+#include "llvm/Support/Regex.h"
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace klee {
+struct KInstruction;
+
+/// The cost of the instructions a state executed while tracing (from
+/// -call-trace-instr-startfn on), not counting the demarcated functions,
+/// whose performance is modelled separately, nor their callees.
+struct PathCost {
+  static const std::uint32_t NoFunction = ~std::uint32_t(0);
+
+  std::uint64_t instructions = 0;
+  std::uint64_t loads = 0;
+  std::uint64_t stores = 0;
+  /// Sum of the per-opcode costs of the counted instructions.
+  std::uint64_t cost = 0;
+
+  /// The demarcated function being executed (as a CallStackTrie function
+  /// id), whose instructions are skipped up to its return.
+  std::uint32_t demarcatedFn = NoFunction;
+  /// Whether the last counted instruction was a call, so that the next one
+  /// is the first of the callee.
+  bool checkCallee = false;
+};
+
+/// Which functions are demarcated and what every opcode costs, as read from
+/// a configuration file (-path-cost-config) of lines
+///
+///   demarcate <function>
+///   demarcate-regex <regex>
+///   cost <opcode name>|default <cost>
+///
+/// with '#' starting a comment. Without a file, the functions of libVig,
+/// DPDK, time, verification and eBPF helpers are demarcated, and every
+/// instruction costs 1.
+class PathCostModel {
+  std::set<std::string> functions;
+  /// Matched against whole function names.
+  std::vector<llvm::Regex> patterns;
+  /// Cost of an instruction, by opcode.
+  std::vector<std::uint64_t> opcodeCosts;
+  /// Whether each function of the CallStackTrie is demarcated: 0 unknown,
+  /// 1 no, 2 yes.
+  mutable std::vector<std::uint8_t> demarcatedFns;
+
+  bool isDemarcated(std::uint32_t fn) const;
+
+public:
+  PathCostModel();
+
+  /// Reads a configuration. Returns false and sets `error` if it is
+  /// malformed.
+  bool parse(const std::string &config, std::string &error);
+
+  /// The model of the process, read from -path-cost-config if given.
+  static const PathCostModel &get();
+
+  /// Whether the executor counts path costs (-count-path-cost or
+  /// -path-cost-config).
+  static bool enabled();
+
+  bool isDemarcated(const std::string &fn) const;
+
+  /// Accounts for `ki`, executed with the call stack `stack`. Returns
+  /// whether it was counted, i.e. is outside of demarcated functions.
+  bool step(PathCost &cost, CallStackTrie::NodeId stack,
+            const KInstruction *ki) const;
+
+  /// The "Path Cost" section of a call path.
+  static std::string format(const PathCost &cost);
+};
+} // namespace klee
+
+#endif /* KLEE_PATHCOST_H */
@@ -162,13 +162,10 @@ namespace klee {
   ///
   /// To support this, RandomPathSearcher has a subgraph view of PTree, in that it
   /// only walks the PTreeNodes that it "owns". Ownership is stored in the
-  /// getInt method of the PTreeNodePtr class (which hides it in the pointer itself).
+  /// getInt method of the PTreeNodePtr class.
   ///
-  /// The current implementation of PTreeNodePtr supports only 3 instances of the
-  /// RandomPathSearcher. This is because the current PTreeNodePtr implementation
-  /// conforms to C++ and only steals the last 3 alignment bits. This restriction
-  /// could be relaxed slightly by an architecture-specific implementation of
-  /// PTreeNodePtr that also steals the top bits of the pointer.
+  /// The current implementation of PTreeNodePtr supports up to 32 instances
+  /// of the RandomPathSearcher (see PtrBitCount).
   ///
   /// The ownership bits are maintained in the update method.
   class RandomPathSearcher final : public Searcher {
@@ -176,7 +173,7 @@ namespace klee {
     RNG &theRNG;
 
     // Unique bitmask of this searcher
-    const uint8_t idBitMask;
+    const std::uint32_t idBitMask;
 
   public:
     /// \param processTree The process tree.
@@ -319,6 +319,15 @@ SpecialFunctionHandler::readStringAtAddress(ExecutionState &state,
   // the relativeOffset must be concrete as the address is concrete
   size_t offset = cast<ConstantExpr>(relativeOffset)->getZExtValue();
 
+  // Names passed to the klee_ functions are mostly string literals, which
+  // live in read-only objects and can be decoded once per run.
+  uint64_t key = (uint64_t(mo->id) << 32) | offset;
+  if (os->readOnly) {
+    auto it = constantStrings.find(key);
+    if (it != constantStrings.end())
+      return it->second;
+  }
+
   std::ostringstream buf;
   char c = 0;
   for (size_t i = offset; i < mo->size; ++i) {
@@ -340,6 +349,8 @@ SpecialFunctionHandler::readStringAtAddress(ExecutionState &state,
                            "one of the klee_ functions");
   }
 
+  if (os->readOnly)
+    constantStrings.emplace(key, buf.str());
   return buf.str();
 }
 
@@ -902,6 +913,18 @@ void SpecialFunctionHandler::handleGetValue(ExecutionState &state,
   executor.executeGetValue(state, arguments[0], target);
 }
 
+// Interceptors are resolved once, when they are registered, rather than on
+// every intercepted access.
+Function *SpecialFunctionHandler::getInterceptor(const std::string &name) {
+  GlobalValue *gv = executor.kmodule->module->getNamedValue(name);
+  if (!gv)
+    klee_error("Function %s(), interceptor, not found!\n", name.c_str());
+  Function *f = dyn_cast<Function>(gv);
+  if (!f)
+    klee_error("Interceptor is not a function\n");
+  return f;
+}
+
 void SpecialFunctionHandler::handleInterceptReads(ExecutionState &state,
                                                   KInstruction *target,
                                                   std::vector<ref<Expr> > &arguments) {
@@ -910,7 +933,7 @@ void SpecialFunctionHandler::handleInterceptReads(ExecutionState &state,
 
   uint64_t addr = cast<ConstantExpr>(arguments[0])->getZExtValue();
   std::string reader = readStringAtAddress(state, arguments[1]);
-  state.addReadsIntercept(addr, reader);
+  state.addReadsIntercept(addr, getInterceptor(reader));
 }
 
 void SpecialFunctionHandler::handleInterceptWrites(ExecutionState &state,
@@ -921,8 +944,7 @@ void SpecialFunctionHandler::handleInterceptWrites(ExecutionState &state,
 
   uint64_t addr = cast<ConstantExpr>(arguments[0])->getZExtValue();
   std::string writer = readStringAtAddress(state, arguments[1]);
-
-  state.addWritesIntercept(addr, writer);
+  state.addWritesIntercept(addr, getInterceptor(writer));
 }
 
 void SpecialFunctionHandler::handleDefineFixedObject(ExecutionState &state,
@@ -1475,7 +1497,10 @@ void SpecialFunctionHandler::handleTraceParamFPtr(ExecutionState &state,
 
 void SpecialFunctionHandler::handleInduceInvariants
 (ExecutionState &state, KInstruction *target, std::vector<ref<Expr> > &arguments) {
-  state.induceInvariantsForThisLoop(target);
+  // A seeded analysis skips the first round: its next round starts from
+  // the loop entry with the summarized bytes forgotten.
+  if (state.induceInvariantsForThisLoop(target))
+    executor.terminateState(state);
 }
 
 void SpecialFunctionHandler::handleForbidAccess
@@ -1666,7 +1691,8 @@ void SpecialFunctionHandler::handleMapSymbolNames(ExecutionState &state,
   Expr::Width width = (cast<klee::ConstantExpr>(arguments[3]))->getZExtValue();
   width = width * 8;//Convert to bits.
   ref<Expr> key_expr = state.readMemoryChunk(arguments[2], width, true);
-  state.reused_symbols[symbol_name]={{occurence,key_expr}};
+  state.reused_symbols = state.reused_symbols.replace(
+      {symbol_name, {{occurence, key_expr}}});
 }
 
 void SpecialFunctionHandler::handleAddBPFCall(ExecutionState &state,
@@ -10,9 +10,11 @@
 #ifndef KLEE_SPECIALFUNCTIONHANDLER_H
 #define KLEE_SPECIALFUNCTIONHANDLER_H
 
+#include <cstdint>
 #include <iterator>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace llvm {
@@ -37,6 +39,11 @@ public:
   handlers_ty handlers;
   class Executor &executor;
 
+  /// Strings read by readStringAtAddress from read-only objects, keyed by
+  /// the id of the object and the offset of the string. Read-only objects
+  /// never change, so the entries stay valid for the whole run.
+  std::unordered_map<uint64_t, std::string> constantStrings;
+
   struct HandlerInfo {
     const char *name;
     SpecialFunctionHandler::Handler handler;
@@ -92,6 +99,9 @@ public:
 
   std::string readStringAtAddress(ExecutionState &state, ref<Expr> address);
 
+  /// The function named `name`, for klee_intercept_reads/writes.
+  llvm::Function *getInterceptor(const std::string &name);
+
   /* Handlers */
 
 #define HANDLER(name) void name(ExecutionState &state, \
@@ -460,7 +460,20 @@ void StatsTracker::writeStatsHeader() {
              << "ResolveTime INTEGER,"
              << "QueryCexCacheMisses INTEGER,"
              << "QueryCexCacheHits INTEGER,"
-             << "ArrayHashTime INTEGER"
+             << "ArrayHashTime INTEGER,"
+             << "LoopDiffQueries INTEGER,"
+             << "LoopDiffCandidateBytes INTEGER,"
+             << "LoopDiffTime INTEGER,"
+             << "LoopDiffTimeSaved INTEGER,"
+             << "IndependentPartitionHits INTEGER,"
+             << "IndependentPartitionMisses INTEGER,"
+             << "IndependentConstraintsReused INTEGER,"
+             << "IndependentConstraintsIndexed INTEGER,"
+             << "QueryPersistentCacheHits INTEGER,"
+             << "QueryPersistentCacheMisses INTEGER,"
+             << "LoopAnalysisMemory INTEGER,"
+             << "LoopSummaryHits INTEGER,"
+             << "LoopSummaryMisses INTEGER"
          << ')';
   char *zErrMsg = nullptr;
   if(sqlite3_exec(statsFile, create.str().c_str(), nullptr, nullptr, &zErrMsg)) {
@@ -493,7 +506,20 @@ void StatsTracker::writeStatsHeader() {
              << "ResolveTime,"
              << "QueryCexCacheMisses,"
              << "QueryCexCacheHits,"
-             << "ArrayHashTime"
+             << "ArrayHashTime,"
+             << "LoopDiffQueries,"
+             << "LoopDiffCandidateBytes,"
+             << "LoopDiffTime,"
+             << "LoopDiffTimeSaved,"
+             << "IndependentPartitionHits,"
+             << "IndependentPartitionMisses,"
+             << "IndependentConstraintsReused,"
+             << "IndependentConstraintsIndexed,"
+             << "QueryPersistentCacheHits,"
+             << "QueryPersistentCacheMisses,"
+             << "LoopAnalysisMemory,"
+             << "LoopSummaryHits,"
+             << "LoopSummaryMisses"
          << ") VALUES ("
              << "?,"
              << "?,"
@@ -514,6 +540,19 @@ void StatsTracker::writeStatsHeader() {
              << "?,"
              << "?,"
              << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
              << "? "
          << ')';
 
@@ -551,6 +590,19 @@ void StatsTracker::writeStatsLine() {
 #else
   sqlite3_bind_int64(insertStmt, 20, -1LL);
 #endif
+  sqlite3_bind_int64(insertStmt, 21, stats::loopDiffQueries);
+  sqlite3_bind_int64(insertStmt, 22, stats::loopDiffCandidateBytes);
+  sqlite3_bind_int64(insertStmt, 23, stats::loopDiffTime);
+  sqlite3_bind_int64(insertStmt, 24, stats::loopDiffTimeSaved);
+  sqlite3_bind_int64(insertStmt, 25, stats::independentPartitionHits);
+  sqlite3_bind_int64(insertStmt, 26, stats::independentPartitionMisses);
+  sqlite3_bind_int64(insertStmt, 27, stats::independentConstraintsReused);
+  sqlite3_bind_int64(insertStmt, 28, stats::independentConstraintsIndexed);
+  sqlite3_bind_int64(insertStmt, 29, stats::queryPersistentCacheHits);
+  sqlite3_bind_int64(insertStmt, 30, stats::queryPersistentCacheMisses);
+  sqlite3_bind_int64(insertStmt, 31, executor.getLoopAnalysisMemoryUsage());
+  sqlite3_bind_int64(insertStmt, 32, stats::loopSummaryHits);
+  sqlite3_bind_int64(insertStmt, 33, stats::loopSummaryMisses);
   int errCode = sqlite3_step(insertStmt);
   if(errCode != SQLITE_DONE) klee_error("Error writing stats data: %s", sqlite3_errmsg(statsFile));
   sqlite3_reset(insertStmt);
@@ -0,0 +1,156 @@
+//===-- SymbolConnectivity.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SymbolConnectivity.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+using namespace klee;
+
+static std::vector<const Array *> getSymbols(const ref<Expr> &e) {
+  SymbolSet symbols = GetExprSymbols::visit(e);
+  return std::vector<const Array *>(symbols.begin(), symbols.end());
+}
+
+const Array *SymbolConnectivity::find(const Array *array) const {
+  // Union by rank keeps the trees shallow enough to go without path
+  // compression, which lets lookups stay const.
+  for (;;) {
+    const Array *p = parent.lookup(array)->second;
+    if (p == array)
+      return array;
+    array = p;
+  }
+}
+
+const Array *SymbolConnectivity::unite(const Array *a, const Array *b) {
+  a = find(a);
+  b = find(b);
+  if (a == b)
+    return a;
+  unsigned rankA = rank.lookup(a)->second, rankB = rank.lookup(b)->second;
+  if (rankA < rankB)
+    std::swap(a, b);
+  else if (rankA == rankB)
+    rank = rank.replace(std::make_pair(a, rankA + 1));
+  parent = parent.replace(std::make_pair(b, a));
+
+  auto merged = members.lookup(b);
+  if (merged) {
+    auto keptMembers = members.lookup(a);
+    ImmutableSet<unsigned> kept =
+        keptMembers ? keptMembers->second : ImmutableSet<unsigned>();
+    ImmutableSet<unsigned> moved = merged->second;
+    if (moved.size() > kept.size())
+      std::swap(kept, moved);
+    for (unsigned index : moved)
+      kept = kept.insert(index);
+    members = members.remove(b).replace(std::make_pair(a, kept));
+  }
+  return a;
+}
+
+void SymbolConnectivity::append(ref<IndexedConstraint> c) {
+  unsigned index = constraints.size();
+  const Array *root = nullptr;
+  for (const Array *array : c->symbols) {
+    if (!parent.count(array)) {
+      parent = parent.insert(std::make_pair(array, array));
+      rank = rank.insert(std::make_pair(array, 0U));
+    }
+    root = root ? unite(root, array) : find(array);
+  }
+  if (root) {
+    auto rootMembers = members.lookup(root);
+    ImmutableSet<unsigned> indices =
+        rootMembers ? rootMembers->second : ImmutableSet<unsigned>();
+    members = members.replace(std::make_pair(root, indices.insert(index)));
+  }
+  constraints = constraints.insert(std::make_pair(index, c));
+}
+
+void SymbolConnectivity::update(const ConstraintSet &cs) {
+  ConstraintSet::const_iterator it = cs.begin(), ie = cs.end();
+  bool isPrefix = cs.size() >= constraints.size();
+  for (auto ci = constraints.begin(), ce = constraints.end();
+       isPrefix && ci != ce; ++ci, ++it)
+    isPrefix = it->get() == ci->second->expr.get();
+  if (isPrefix) {
+    for (; it != ie; ++it)
+      append(new IndexedConstraint(*it, getSymbols(*it)));
+    return;
+  }
+
+  // Some constraints were rewritten (e.g. by an equality), which may split
+  // components, so rebuild the forest. The old constraints stay referenced
+  // until the end so that their addresses cannot be reused meanwhile.
+  ImmutableMap<unsigned, ref<IndexedConstraint>> old = constraints;
+  constraints = ImmutableMap<unsigned, ref<IndexedConstraint>>();
+  parent = ImmutableMap<const Array *, const Array *>();
+  rank = ImmutableMap<const Array *, unsigned>();
+  members = ImmutableMap<const Array *, ImmutableSet<unsigned>>();
+  std::unordered_map<const Expr *, ref<IndexedConstraint>> known;
+  for (const auto &c : old)
+    known.emplace(c.second->expr.get(), c.second);
+  for (const ref<Expr> &e : cs) {
+    auto k = known.find(e.get());
+    append(k != known.end() ? k->second
+                            : new IndexedConstraint(e, getSymbols(e)));
+  }
+}
+
+bool SymbolConnectivity::isUpToDate(const ConstraintSet &cs) const {
+  return cs.size() == constraints.size() &&
+         (cs.empty() ||
+          cs.begin()->get() == constraints.lookup(0)->second->expr.get());
+}
+
+std::vector<ref<Expr>>
+SymbolConnectivity::relevantConstraints(SymbolSet symbols) const {
+  // Only the constraints of the components of `symbols` can be relevant.
+  std::vector<unsigned> candidates;
+  llvm::SmallPtrSet<const Array *, 8> roots;
+  for (const Array *array : symbols) {
+    if (!parent.count(array))
+      continue;
+    const Array *root = find(array);
+    if (!roots.insert(root).second)
+      continue;
+    for (unsigned index : members.lookup(root)->second)
+      candidates.push_back(index);
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  // Replay the fixpoint over the candidates only, so that the constraints
+  // come out in the order callers have always seen them.
+  std::vector<ref<Expr>> ret;
+  llvm::SmallPtrSet<Expr *, 32> insertedConstraints;
+  bool newSymbols = false;
+  do {
+    newSymbols = false;
+    for (unsigned index : candidates) {
+      const IndexedConstraint &c = *constraints.lookup(index)->second;
+      if (insertedConstraints.count(c.expr.get()))
+        continue;
+      bool intersects =
+          std::any_of(c.symbols.begin(), c.symbols.end(),
+                      [&symbols](const Array *a) { return symbols.count(a); });
+      if (!intersects)
+        continue;
+      for (const Array *array : c.symbols)
+        newSymbols = symbols.insert(array).second || newSymbols;
+      ret.push_back(c.expr);
+      insertedConstraints.insert(c.expr.get());
+    }
+  } while (newSymbols);
+  return ret;
+}
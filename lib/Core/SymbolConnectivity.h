@@ -0,0 +1,75 @@
+//===-- SymbolConnectivity.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SYMBOLCONNECTIVITY_H
+#define KLEE_SYMBOLCONNECTIVITY_H
+
+#include "klee/ADT/GetExprSymbols.h"
+#include "klee/ADT/ImmutableMap.h"
+#include "klee/ADT/ImmutableSet.h"
+#include "klee/ADT/Ref.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+
+#include <vector>
+
+namespace klee {
+
+/// Index of the arrays connected through the constraints of a state: two
+/// arrays are connected if some chain of constraints links them. The index
+/// is a union-find over arrays, maintained incrementally as constraints are
+/// appended, so that the constraints relevant to a set of symbols are those
+/// of the components of the symbols. The symbols of every constraint are
+/// computed once.
+///
+/// The index is kept in persistent maps, like the address space, so that
+/// copying it along with a forked state takes constant time and the copies
+/// share everything indexed before the fork.
+class SymbolConnectivity {
+  struct IndexedConstraint {
+    /// @brief Required by klee::ref-managed objects
+    class ReferenceCounter _refCount;
+    ref<Expr> expr;
+    std::vector<const Array *> symbols;
+
+    IndexedConstraint(const ref<Expr> &expr,
+                      std::vector<const Array *> symbols)
+        : expr(expr), symbols(std::move(symbols)) {}
+  };
+
+  /// The constraints of the state, keyed by their position.
+  ImmutableMap<unsigned, ref<IndexedConstraint>> constraints;
+
+  /// Union-find forest over the arrays; roots map to themselves.
+  ImmutableMap<const Array *, const Array *> parent;
+  ImmutableMap<const Array *, unsigned> rank;
+
+  /// Positions of the constraints of each component, keyed by its root.
+  ImmutableMap<const Array *, ImmutableSet<unsigned>> members;
+
+  const Array *find(const Array *array) const;
+  const Array *unite(const Array *a, const Array *b);
+  void append(ref<IndexedConstraint> c);
+
+public:
+  /// Brings the index up to date with `cs`. Appended constraints are
+  /// indexed incrementally; if earlier constraints were rewritten, the
+  /// forest is rebuilt, reusing the symbols of the unchanged constraints.
+  void update(const ConstraintSet &cs);
+
+  bool isUpToDate(const ConstraintSet &cs) const;
+
+  /// The constraints transitively sharing symbols with `symbols`, in the
+  /// order a fixpoint over the constraint set discovers them.
+  std::vector<ref<Expr>> relevantConstraints(SymbolSet symbols) const;
+};
+
+} // namespace klee
+
+#endif /* KLEE_SYMBOLCONNECTIVITY_H */
@@ -0,0 +1,307 @@
+//===-- WorkerPool.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "WorkerPool.h"
+
+#include "Executor.h"
+#include "Searcher.h"
+#include "UserSearcher.h"
+
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+using namespace klee;
+
+void TicketLock::lock() {
+  std::unique_lock<std::mutex> guard(mutex);
+  unsigned long ticket = nextTicket++;
+  turn.wait(guard, [&] { return nowServing == ticket; });
+}
+
+void TicketLock::unlock() {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    ++nowServing;
+  }
+  turn.notify_all();
+}
+
+bool TicketLock::isContended() {
+  std::lock_guard<std::mutex> guard(mutex);
+  return nextTicket - nowServing > 1;
+}
+
+WorkerPool::Worker *&WorkerPool::currentWorker() {
+  static thread_local Worker *worker = nullptr;
+  return worker;
+}
+
+unsigned WorkerPool::getWorkerId() {
+  Worker *worker = currentWorker();
+  return worker ? worker->id : 0;
+}
+
+WorkerPool::WorkerPool(Executor &executor, unsigned numWorkers)
+    : executor(executor) {
+  assert(numWorkers > 0 && "a pool needs workers");
+  for (unsigned i = 0; i < numWorkers; ++i) {
+    std::unique_ptr<Worker> worker(new Worker());
+    worker->pool = this;
+    worker->id = i;
+    worker->searcher.reset(constructUserSearcher(executor));
+    workers.push_back(std::move(worker));
+  }
+
+  // Deal the states out in the order of their ids.
+  unsigned next = 0;
+  for (ExecutionState *state : executor.states)
+    assign(state, *workers[next++ % numWorkers]);
+  for (auto &worker : workers) {
+    std::vector<ExecutionState *> states(worker->states.begin(),
+                                         worker->states.end());
+    worker->searcher->update(nullptr, states, {});
+  }
+}
+
+WorkerPool::~WorkerPool() = default;
+
+void WorkerPool::assign(ExecutionState *state, Worker &worker) {
+  owners[state] = &worker;
+  worker.states.insert(state);
+}
+
+void WorkerPool::run() {
+  for (auto &worker : workers) {
+    Worker *w = worker.get();
+    w->thread = std::thread([this, w] { run(*w); });
+  }
+  for (auto &worker : workers)
+    worker->thread.join();
+}
+
+void WorkerPool::run(Worker &worker) {
+  currentWorker() = &worker;
+  lock.lock();
+  enter(worker);
+
+  unsigned steps = 0;
+  while (!executor.haltExecution) {
+    if (worker.searcher->empty() && !steal(worker)) {
+      if (executor.states.empty())
+        break;
+      // Wait for the other workers to fork states that can be stolen.
+      leave(worker);
+      ++idleWorkers;
+      changed.wait_for(lock, std::chrono::milliseconds(100));
+      --idleWorkers;
+      enter(worker);
+      continue;
+    }
+
+    ExecutionState &state = worker.searcher->selectState();
+    worker.current = &state;
+    executor.executeStep(state);
+    worker.current = nullptr;
+
+    // Apart from solver queries, the lock is only released here, so that
+    // workers which rarely query the solver do not starve the others.
+    if (++steps % 1000 == 0 && lock.isContended()) {
+      leave(worker);
+      lock.unlock();
+      lock.lock();
+      enter(worker);
+    }
+  }
+
+  leave(worker);
+  lock.unlock();
+  changed.notify_all();
+  currentWorker() = nullptr;
+}
+
+void WorkerPool::enter(Worker &worker) {
+  std::swap(executor.addedStates, worker.addedStates);
+  std::swap(executor.removedStates, worker.removedStates);
+
+  setThreadStatisticManager(nullptr);
+  theStatisticManager->setIndex(worker.statisticIndex);
+  theStatisticManager->setContext(worker.statisticContext);
+  worker.statistics.flushTo(*theStatisticManager);
+}
+
+void WorkerPool::leave(Worker &worker) {
+  worker.statisticIndex = theStatisticManager->getIndex();
+  worker.statisticContext = theStatisticManager->getContext();
+  worker.statistics.snapshot(*theStatisticManager);
+  setThreadStatisticManager(&worker.statistics);
+
+  std::swap(executor.addedStates, worker.addedStates);
+  std::swap(executor.removedStates, worker.removedStates);
+}
+
+bool WorkerPool::steal(Worker &thief) {
+  Worker *victim = nullptr;
+  std::vector<ExecutionState *> stealable;
+  std::size_t count = 0;
+
+  for (auto &worker : workers) {
+    if (worker.get() == &thief)
+      continue;
+    std::vector<ExecutionState *> candidates;
+    for (ExecutionState *state : worker->states) {
+      if (state == worker->current || !state->loopInProcess.isNull() ||
+          std::find(worker->removedStates.begin(), worker->removedStates.end(),
+                    state) != worker->removedStates.end())
+        continue;
+      candidates.push_back(state);
+    }
+    // Half of the states, counting the one being stepped.
+    std::size_t total = candidates.size() + (worker->current ? 1 : 0);
+    std::size_t half = std::min(candidates.size(), total / 2);
+    if (half > count) {
+      victim = worker.get();
+      stealable = std::move(candidates);
+      count = half;
+    }
+  }
+  if (!victim)
+    return false;
+
+  // Take every other state, so that both workers keep states of all depths.
+  std::vector<ExecutionState *> stolen;
+  for (std::size_t i = 0; i < count; ++i)
+    stolen.push_back(stealable[stealable.size() - 1 - 2 * i]);
+
+  victim->searcher->update(nullptr, {}, stolen);
+  for (ExecutionState *state : stolen) {
+    victim->states.erase(state);
+    assign(state, thief);
+  }
+  thief.searcher->update(nullptr, stolen, {});
+  return true;
+}
+
+void WorkerPool::update(ExecutionState *current,
+                        const std::vector<ExecutionState *> &addedStates,
+                        const std::vector<ExecutionState *> &removedStates) {
+  Worker *worker = currentWorker();
+  assert(worker && "states updated outside of a worker");
+
+  for (ExecutionState *state : addedStates)
+    assign(state, *worker);
+
+  std::vector<ExecutionState *> ownRemoved;
+  for (ExecutionState *state : removedStates) {
+    auto it = owners.find(state);
+    if (it == owners.end())
+      continue; // disowned, no longer in any searcher
+    Worker *owner = it->second;
+    owners.erase(it);
+    owner->states.erase(state);
+    if (owner == worker)
+      ownRemoved.push_back(state);
+    else
+      owner->searcher->update(nullptr, {}, {state});
+  }
+  worker->searcher->update(current, addedStates, ownRemoved);
+
+  if ((!addedStates.empty() && idleWorkers > 0) || owners.empty())
+    changed.notify_all();
+}
+
+std::vector<ExecutionState *> WorkerPool::getOwnStates() const {
+  Worker *worker = currentWorker();
+  assert(worker && "no current worker");
+  return std::vector<ExecutionState *>(worker->states.begin(),
+                                       worker->states.end());
+}
+
+void WorkerPool::disown(const std::vector<ExecutionState *> &states) {
+  Worker *worker = currentWorker();
+  assert(worker && "no current worker");
+  for (ExecutionState *state : states) {
+    owners.erase(state);
+    worker->states.erase(state);
+  }
+  worker->searcher->update(nullptr, {}, states);
+}
+
+WorkerPool::Unlocked::Unlocked() : worker(currentWorker()) {
+  if (!worker)
+    return;
+  worker->pool->leave(*worker);
+  worker->pool->lock.unlock();
+}
+
+WorkerPool::Unlocked::~Unlocked() {
+  if (!worker)
+    return;
+  worker->pool->lock.lock();
+  worker->pool->enter(*worker);
+}
+
+namespace {
+/// Forwards every query to the solver chain of the worker issuing it, and
+/// releases the executor lock while the chain runs.
+class WorkerSolverImpl : public SolverImpl {
+  std::vector<std::unique_ptr<Solver>> solvers;
+  std::vector<SolverRunStatus> status;
+  time::Span timeout;
+
+  template <typename Query> bool run(Query query) {
+    unsigned id = WorkerPool::getWorkerId();
+    Solver &solver = *solvers[id];
+    solver.setCoreSolverTimeout(timeout);
+    WorkerPool::Unlocked unlocked;
+    bool success = query(*solver.impl);
+    status[id] = solver.impl->getOperationStatusCode();
+    return success;
+  }
+
+public:
+  explicit WorkerSolverImpl(std::vector<Solver *> workerSolvers)
+      : status(workerSolvers.size(), SOLVER_RUN_STATUS_FAILURE) {
+    for (Solver *solver : workerSolvers)
+      solvers.emplace_back(solver);
+  }
+
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    return run([&](SolverImpl &s) { return s.computeValidity(query, result); });
+  }
+  bool computeTruth(const Query &query, bool &isValid) {
+    return run([&](SolverImpl &s) { return s.computeTruth(query, isValid); });
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    return run([&](SolverImpl &s) { return s.computeValue(query, result); });
+  }
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution) {
+    return run([&](SolverImpl &s) {
+      return s.computeInitialValues(query, objects, values, hasSolution);
+    });
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return status[WorkerPool::getWorkerId()];
+  }
+  char *getConstraintLog(const Query &query) {
+    return solvers[WorkerPool::getWorkerId()]->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) { this->timeout = timeout; }
+};
+} // namespace
+
+Solver *WorkerPool::createSolver(std::vector<Solver *> workerSolvers) {
+  return new Solver(new WorkerSolverImpl(std::move(workerSolvers)));
+}
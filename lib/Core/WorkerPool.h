@@ -0,0 +1,150 @@
+//===-- WorkerPool.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_WORKERPOOL_H
+#define KLEE_WORKERPOOL_H
+
+#include "ExecutionState.h"
+
+#include "klee/Statistics/Statistics.h"
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace klee {
+class Executor;
+class Searcher;
+class Solver;
+
+/// A lock granted in the order it was requested, so that a thread that
+/// releases it to let the others run cannot take it right back.
+class TicketLock {
+  std::mutex mutex;
+  std::condition_variable turn;
+  unsigned long nextTicket = 0;
+  unsigned long nowServing = 0;
+
+public:
+  void lock();
+  void unlock();
+
+  /// Whether other threads wait for the lock, which the caller holds.
+  bool isContended();
+};
+
+/// Worker threads exploring the states of an executor in parallel.
+///
+/// Every worker has a searcher over the states it owns, and steps them while
+/// it holds the executor lock: the executor, the states and everything they
+/// share are only ever used by one worker at a time. The lock is released
+/// while a worker waits for its solver chain (see Unlocked), which is where
+/// exploration spends most of its time; every worker has a chain of its own
+/// (see createSolver), so that queries run in parallel. A worker that runs
+/// out of states steals half of the states of the worker that owns the
+/// most, except for the state that worker is stepping and the states
+/// analysing a loop, which keep to the worker that started the analysis.
+///
+/// The executor keeps the context of the step being executed in its
+/// members (the added and removed states, the instruction statistics are
+/// attributed to); the pool swaps the context of each worker in and out
+/// with the lock. Statistics counted without the lock go to a manager of
+/// the worker and are added to theStatisticManager when it takes the lock
+/// again.
+class WorkerPool {
+  struct Worker {
+    WorkerPool *pool;
+    unsigned id;
+    std::thread thread;
+    std::unique_ptr<Searcher> searcher;
+    std::vector<ExecutionState *> addedStates;
+    std::vector<ExecutionState *> removedStates;
+    /// The states the searcher of the worker selects from.
+    std::set<ExecutionState *, ExecutionStateIDCompare> states;
+    /// The state being stepped, if any.
+    ExecutionState *current = nullptr;
+    /// The statistics counted without the lock, and the instruction and
+    /// context they belong to.
+    StatisticManager statistics;
+    unsigned statisticIndex = 0;
+    StatisticRecord *statisticContext = nullptr;
+  };
+
+  Executor &executor;
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::map<ExecutionState *, Worker *> owners;
+
+  TicketLock lock;
+  /// Notified when states are added or the exploration ends.
+  std::condition_variable_any changed;
+  unsigned idleWorkers = 0;
+
+  void run(Worker &worker);
+  /// Makes the executor step for `worker`, which just took the lock.
+  void enter(Worker &worker);
+  /// Saves the context of `worker`, which is about to release the lock.
+  void leave(Worker &worker);
+  /// Moves states from the busiest worker to `thief`. Returns false if
+  /// there was nothing to steal.
+  bool steal(Worker &thief);
+  void assign(ExecutionState *state, Worker &worker);
+
+  static Worker *&currentWorker();
+
+public:
+  /// Distributes the states of `executor` over `numWorkers` workers.
+  WorkerPool(Executor &executor, unsigned numWorkers);
+  ~WorkerPool();
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  /// Explores until no states are left or the executor halts.
+  void run();
+
+  /// Updates the searchers and the ownership of the states after a step of
+  /// the current worker, like Searcher::update.
+  void update(ExecutionState *current,
+              const std::vector<ExecutionState *> &addedStates,
+              const std::vector<ExecutionState *> &removedStates);
+
+  /// The states owned by the current worker.
+  std::vector<ExecutionState *> getOwnStates() const;
+
+  /// Removes `states` from the searcher of the current worker, so that they
+  /// cannot be stolen while the worker terminates them.
+  void disown(const std::vector<ExecutionState *> &states);
+
+  /// The index of the worker running on the calling thread, or 0 outside
+  /// of the workers.
+  static unsigned getWorkerId();
+
+  /// Releases the executor lock for the lifetime of the object, if the
+  /// calling thread is a worker.
+  class Unlocked {
+    Worker *worker;
+
+  public:
+    Unlocked();
+    ~Unlocked();
+    Unlocked(const Unlocked &) = delete;
+    Unlocked &operator=(const Unlocked &) = delete;
+  };
+
+  /// A solver forwarding the queries of each worker to
+  /// `workerSolvers[getWorkerId()]`, without the executor lock.
+  static Solver *createSolver(std::vector<Solver *> workerSolvers);
+};
+
+} // namespace klee
+
+#endif /* KLEE_WORKERPOOL_H */
@@ -0,0 +1,554 @@
+//===-- CallPathFile.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/CallPathFile.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Expr/ExprPPrinter.h"
+#include "klee/Expr/Parser/Parser.h"
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+#include <tuple>
+#include <unordered_map>
+
+using namespace klee;
+
+namespace {
+const char Magic[] = "KCALLPTH";
+const size_t MagicSize = sizeof(Magic) - 1;
+const uint8_t UpdateTag = 0xff;
+
+const char KQuerySection[] = ";;-- kQuery --\n";
+const char CallsSection[] = ";;-- Calls --\n";
+const char ConstraintsSection[] = ";;-- Constraints --\n";
+const char TagsSection[] = ";;-- Tags --\n";
+const char BPFCallsSection[] = ";;-- BPF Calls --\n";
+const char PathCostSection[] = ";;-- Path Cost --\n";
+
+void writeU8(std::string &out, uint8_t v) { out.push_back(char(v)); }
+
+void writeU32(std::string &out, uint32_t v) {
+  for (unsigned i = 0; i < 4; ++i)
+    out.push_back(char(v >> (8 * i)));
+}
+
+void writeU64(std::string &out, uint64_t v) {
+  for (unsigned i = 0; i < 8; ++i)
+    out.push_back(char(v >> (8 * i)));
+}
+
+void writeStr(std::string &out, llvm::StringRef s) {
+  writeU32(out, s.size());
+  out.append(s.data(), s.size());
+}
+
+/// Serializes expressions into the node table, each unique expression once.
+class BinaryWriter {
+  std::unordered_map<const Array *, uint32_t> arrayIds;
+  std::unordered_map<const UpdateNode *, uint32_t> updateIds;
+  ExprHashMap<uint32_t> exprIds;
+  uint32_t numNodes = 0;
+
+public:
+  std::vector<const Array *> arrays;
+  std::string nodes;
+
+  uint32_t addArray(const Array *array) {
+    auto it = arrayIds.find(array);
+    if (it != arrayIds.end())
+      return it->second;
+    uint32_t id = arrays.size();
+    arrays.push_back(array);
+    arrayIds.emplace(array, id);
+    return id;
+  }
+
+  /// Returns the node id of `head` plus one, or zero for an empty list.
+  uint32_t addUpdates(const UpdateNode *head) {
+    // Update lists can be long, so walk them iteratively and emit the
+    // oldest new update first.
+    std::vector<const UpdateNode *> pending;
+    for (const UpdateNode *un = head; un && !updateIds.count(un);
+         un = un->next.get())
+      pending.push_back(un);
+    for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+      const UpdateNode *un = *it;
+      uint32_t next = un->next.isNull() ? 0 : updateIds[un->next.get()] + 1;
+      uint32_t index = addExpr(un->index);
+      uint32_t value = addExpr(un->value);
+      writeU8(nodes, UpdateTag);
+      writeU32(nodes, next);
+      writeU32(nodes, index);
+      writeU32(nodes, value);
+      updateIds[un] = numNodes++;
+    }
+    return head ? updateIds[head] + 1 : 0;
+  }
+
+  uint32_t addExpr(const ref<Expr> &e) {
+    auto it = exprIds.find(e);
+    if (it != exprIds.end())
+      return it->second;
+
+    std::string record;
+    writeU8(record, e->getKind());
+    writeU32(record, e->getWidth());
+    switch (e->getKind()) {
+    case Expr::Constant: {
+      const llvm::APInt &value = cast<ConstantExpr>(e)->getAPValue();
+      writeU32(record, value.getNumWords());
+      for (unsigned i = 0; i < value.getNumWords(); ++i)
+        writeU64(record, value.getRawData()[i]);
+      break;
+    }
+    case Expr::Read: {
+      const ReadExpr *re = cast<ReadExpr>(e);
+      uint32_t array = addArray(re->updates.root);
+      uint32_t head = addUpdates(re->updates.head.get());
+      uint32_t index = addExpr(re->index);
+      writeU32(record, array);
+      writeU32(record, head);
+      writeU32(record, index);
+      break;
+    }
+    case Expr::Extract: {
+      const ExtractExpr *ee = cast<ExtractExpr>(e);
+      uint32_t kid = addExpr(ee->expr);
+      writeU32(record, ee->offset);
+      writeU32(record, kid);
+      break;
+    }
+    default: {
+      std::vector<uint32_t> kids;
+      for (unsigned i = 0; i < e->getNumKids(); ++i)
+        kids.push_back(addExpr(e->getKid(i)));
+      for (uint32_t kid : kids)
+        writeU32(record, kid);
+      break;
+    }
+    }
+    nodes += record;
+    uint32_t id = numNodes++;
+    exprIds.emplace(e, id);
+    return id;
+  }
+
+  uint32_t getNumNodes() const { return numNodes; }
+};
+
+/// Reads little-endian integers and strings from a buffer, recording
+/// whether it ran past its end.
+class BinaryReader {
+  const char *pos, *end;
+
+public:
+  bool truncated = false;
+
+  explicit BinaryReader(llvm::StringRef buffer)
+      : pos(buffer.begin()), end(buffer.end()) {}
+
+  uint64_t readN(unsigned n) {
+    if (unsigned(end - pos) < n) {
+      truncated = true;
+      pos = end;
+      return 0;
+    }
+    uint64_t v = 0;
+    for (unsigned i = 0; i < n; ++i)
+      v |= uint64_t(uint8_t(pos[i])) << (8 * i);
+    pos += n;
+    return v;
+  }
+
+  uint8_t readU8() { return readN(1); }
+  uint32_t readU32() { return readN(4); }
+  uint64_t readU64() { return readN(8); }
+
+  llvm::StringRef readStr() {
+    uint32_t size = readU32();
+    if (uint64_t(end - pos) < size) {
+      truncated = true;
+      pos = end;
+      return llvm::StringRef();
+    }
+    llvm::StringRef s(pos, size);
+    pos += size;
+    return s;
+  }
+};
+
+bool isBinaryKind(uint8_t kind) {
+  return kind >= Expr::BinaryKindFirst && kind <= Expr::BinaryKindLast;
+}
+
+ref<Expr> allocBinary(Expr::Kind kind, const ref<Expr> &l,
+                      const ref<Expr> &r) {
+  switch (kind) {
+#define BINARY_CASE(KIND)                                                      \
+  case Expr::KIND:                                                             \
+    return KIND##Expr::alloc(l, r);
+    BINARY_CASE(Add)
+    BINARY_CASE(Sub)
+    BINARY_CASE(Mul)
+    BINARY_CASE(UDiv)
+    BINARY_CASE(SDiv)
+    BINARY_CASE(URem)
+    BINARY_CASE(SRem)
+    BINARY_CASE(And)
+    BINARY_CASE(Or)
+    BINARY_CASE(Xor)
+    BINARY_CASE(Shl)
+    BINARY_CASE(LShr)
+    BINARY_CASE(AShr)
+    BINARY_CASE(Eq)
+    BINARY_CASE(Ne)
+    BINARY_CASE(Ult)
+    BINARY_CASE(Ule)
+    BINARY_CASE(Ugt)
+    BINARY_CASE(Uge)
+    BINARY_CASE(Slt)
+    BINARY_CASE(Sle)
+    BINARY_CASE(Sgt)
+    BINARY_CASE(Sge)
+#undef BINARY_CASE
+  default:
+    assert(0 && "not a binary expression kind");
+    return ref<Expr>();
+  }
+}
+
+/// Returns the text between `begin` and the next occurrence of `marker`, and
+/// moves `begin` past that marker (to npos if there is none).
+llvm::StringRef nextSection(llvm::StringRef contents, size_t &begin,
+                            const char *marker) {
+  size_t end = contents.find(marker, begin);
+  llvm::StringRef section = contents.slice(begin, end);
+  begin = end == llvm::StringRef::npos ? end : end + strlen(marker);
+  return section;
+}
+} // namespace
+
+CallPathFile::CallPathFile() {}
+
+CallPathFile::CallPathFile(ArrayCache *arrays) : sharedArrayCache(arrays) {}
+
+CallPathFile::~CallPathFile() {}
+
+bool CallPathFile::isBinary(llvm::StringRef contents) {
+  return contents.startswith(llvm::StringRef(Magic, MagicSize));
+}
+
+bool CallPathFile::read(llvm::StringRef contents, std::string &error) {
+  return isBinary(contents) ? readBinary(contents, error)
+                            : readText(contents, error);
+}
+
+bool CallPathFile::readText(llvm::StringRef contents, std::string &error) {
+  size_t kQueryBegin = contents.find(KQuerySection);
+  if (kQueryBegin == llvm::StringRef::npos) {
+    error = "missing kQuery section";
+    return false;
+  }
+  size_t pos = kQueryBegin + strlen(KQuerySection);
+  llvm::StringRef kQuery = nextSection(contents, pos, CallsSection);
+  if (pos == llvm::StringRef::npos) {
+    error = "missing Calls section";
+    return false;
+  }
+  calls = nextSection(contents, pos, ConstraintsSection).str();
+  // The "Constraints" section repeats the constraints of the kQuery.
+  nextSection(contents, pos, TagsSection);
+  llvm::StringRef tagLines = nextSection(contents, pos, BPFCallsSection);
+  bpfCalls = nextSection(contents, pos, PathCostSection).str();
+  if (pos != llvm::StringRef::npos)
+    pathCost = contents.slice(pos, llvm::StringRef::npos).str();
+
+  std::unique_ptr<llvm::MemoryBuffer> MB =
+      llvm::MemoryBuffer::getMemBufferCopy(kQuery);
+  std::unique_ptr<ExprBuilder> builder(createDefaultExprBuilder());
+  parser.reset(expr::Parser::Create("", MB.get(), builder.get(), false,
+                                    sharedArrayCache));
+  while (expr::Decl *D = parser->ParseTopLevelDecl()) {
+    decls.emplace_back(D);
+    if (expr::ArrayDecl *AD = llvm::dyn_cast<expr::ArrayDecl>(D)) {
+      arrays.push_back(AD->Root);
+    } else if (expr::QueryCommand *QC = llvm::dyn_cast<expr::QueryCommand>(D)) {
+      constraints = QC->Constraints;
+      values = QC->Values;
+      break;
+    }
+  }
+  if (parser->GetNumErrors()) {
+    error = "malformed kQuery";
+    return false;
+  }
+
+  while (!tagLines.empty()) {
+    llvm::StringRef line;
+    std::tie(line, tagLines) = tagLines.split('\n');
+    if (line.empty())
+      continue;
+    size_t delim = line.find(" = ");
+    if (delim == llvm::StringRef::npos) {
+      error = "invalid tag: " + line.str();
+      return false;
+    }
+    tags.emplace_back(line.substr(0, delim).str(),
+                      line.substr(delim + 3).str());
+  }
+  return true;
+}
+
+bool CallPathFile::readBinary(llvm::StringRef contents, std::string &error) {
+  if (!isBinary(contents)) {
+    error = "not a binary call path";
+    return false;
+  }
+  BinaryReader reader(contents.substr(MagicSize));
+  uint32_t version = reader.readU32();
+  reader.readU32();
+  if (version < 1 || version > BinaryVersion) {
+    error = "unsupported call path format version " + std::to_string(version);
+    return false;
+  }
+
+  ArrayCache *cache = sharedArrayCache;
+  if (!cache) {
+    if (!arrayCache)
+      arrayCache.reset(new ArrayCache());
+    cache = arrayCache.get();
+  }
+  uint32_t numArrays = reader.readU32();
+  std::vector<const Array *> binaryArrays;
+  for (uint32_t i = 0; i < numArrays && !reader.truncated; ++i) {
+    std::string name = reader.readStr().str();
+    uint32_t size = reader.readU32();
+    Expr::Width domain = reader.readU32();
+    Expr::Width range = reader.readU32();
+    uint32_t numValues = reader.readU32();
+    if (numValues && numValues != size) {
+      error = "invalid constant array " + name;
+      return false;
+    }
+    std::vector<ref<ConstantExpr>> constantValues;
+    for (uint32_t j = 0; j < numValues && !reader.truncated; ++j)
+      constantValues.push_back(ConstantExpr::alloc(reader.readU64(), range));
+    if (reader.truncated)
+      break;
+    binaryArrays.push_back(cache->CreateArray(
+        name, size, constantValues.data(),
+        constantValues.data() + constantValues.size(), domain, range));
+  }
+
+  uint32_t numNodes = reader.readU32();
+  std::vector<ref<Expr>> exprs;
+  std::vector<ref<UpdateNode>> updates;
+  auto getExpr = [&](uint32_t id) -> ref<Expr> {
+    return id < exprs.size() ? exprs[id] : ref<Expr>();
+  };
+  auto getUpdates = [&](uint32_t id, bool &valid) -> ref<UpdateNode> {
+    // Ids of update lists are offset by one, zero being the empty list.
+    valid = id == 0 || (id <= updates.size() && !updates[id - 1].isNull());
+    return id && valid ? updates[id - 1] : ref<UpdateNode>();
+  };
+  for (uint32_t i = 0; i < numNodes && !reader.truncated; ++i) {
+    uint8_t tag = reader.readU8();
+    ref<Expr> e;
+    if (tag == UpdateTag) {
+      bool valid;
+      ref<UpdateNode> next = getUpdates(reader.readU32(), valid);
+      ref<Expr> index = getExpr(reader.readU32());
+      ref<Expr> value = getExpr(reader.readU32());
+      if (!valid || index.isNull() || value.isNull())
+        break;
+      exprs.emplace_back();
+      updates.emplace_back(new UpdateNode(next, index, value));
+      continue;
+    }
+
+    Expr::Width width = reader.readU32();
+    Expr::Kind kind = Expr::Kind(tag);
+    switch (kind) {
+    case Expr::Constant: {
+      uint32_t numWords = reader.readU32();
+      std::vector<uint64_t> words;
+      for (uint32_t j = 0; j < numWords && !reader.truncated; ++j)
+        words.push_back(reader.readU64());
+      if (width && numWords == (width + 63) / 64)
+        e = ConstantExpr::alloc(llvm::APInt(width, words));
+      break;
+    }
+    case Expr::Read: {
+      uint32_t array = reader.readU32();
+      bool valid;
+      ref<UpdateNode> head = getUpdates(reader.readU32(), valid);
+      ref<Expr> index = getExpr(reader.readU32());
+      if (array < binaryArrays.size() && valid && !index.isNull())
+        e = ReadExpr::alloc(UpdateList(binaryArrays[array], head), index);
+      break;
+    }
+    case Expr::Extract: {
+      uint32_t offset = reader.readU32();
+      ref<Expr> kid = getExpr(reader.readU32());
+      if (!kid.isNull())
+        e = ExtractExpr::alloc(kid, offset, width);
+      break;
+    }
+    case Expr::NotOptimized:
+    case Expr::ZExt:
+    case Expr::SExt:
+    case Expr::Not: {
+      ref<Expr> kid = getExpr(reader.readU32());
+      if (kid.isNull())
+        break;
+      if (kind == Expr::NotOptimized)
+        e = NotOptimizedExpr::alloc(kid);
+      else if (kind == Expr::ZExt)
+        e = ZExtExpr::alloc(kid, width);
+      else if (kind == Expr::SExt)
+        e = SExtExpr::alloc(kid, width);
+      else
+        e = NotExpr::alloc(kid);
+      break;
+    }
+    case Expr::Select: {
+      ref<Expr> c = getExpr(reader.readU32());
+      ref<Expr> t = getExpr(reader.readU32());
+      ref<Expr> f = getExpr(reader.readU32());
+      if (!c.isNull() && !t.isNull() && !f.isNull())
+        e = SelectExpr::alloc(c, t, f);
+      break;
+    }
+    case Expr::Concat: {
+      ref<Expr> l = getExpr(reader.readU32());
+      ref<Expr> r = getExpr(reader.readU32());
+      if (!l.isNull() && !r.isNull())
+        e = ConcatExpr::alloc(l, r);
+      break;
+    }
+    default: {
+      if (!isBinaryKind(tag))
+        break;
+      ref<Expr> l = getExpr(reader.readU32());
+      ref<Expr> r = getExpr(reader.readU32());
+      if (!l.isNull() && !r.isNull())
+        e = allocBinary(kind, l, r);
+      break;
+    }
+    }
+    if (e.isNull() || e->getWidth() != width)
+      break;
+    exprs.push_back(e);
+    updates.emplace_back();
+  }
+  if (exprs.size() != numNodes) {
+    error = reader.truncated ? "truncated call path"
+                             : "invalid expression node " +
+                                   std::to_string(exprs.size());
+    return false;
+  }
+
+  auto readExprs = [&](std::vector<ref<Expr>> &out) {
+    uint32_t count = reader.readU32();
+    for (uint32_t i = 0; i < count && !reader.truncated; ++i) {
+      ref<Expr> e = getExpr(reader.readU32());
+      if (e.isNull())
+        return false;
+      out.push_back(e);
+    }
+    return true;
+  };
+  if (!readExprs(constraints) || !readExprs(values)) {
+    error = "invalid expression reference";
+    return false;
+  }
+  calls = reader.readStr().str();
+  uint32_t numTags = reader.readU32();
+  for (uint32_t i = 0; i < numTags && !reader.truncated; ++i) {
+    std::string name = reader.readStr().str();
+    tags.emplace_back(name, reader.readStr().str());
+  }
+  bpfCalls = reader.readStr().str();
+  if (version >= 2)
+    pathCost = reader.readStr().str();
+  if (reader.truncated) {
+    error = "truncated call path";
+    return false;
+  }
+  arrays.insert(arrays.end(), binaryArrays.begin(), binaryArrays.end());
+  return true;
+}
+
+void CallPathFile::writeText(llvm::raw_ostream &os, bool withExprs) const {
+  os << KQuerySection;
+  if (withExprs)
+    ExprPPrinter::printQuery(os, ConstraintSet(constraints),
+                             ConstantExpr::alloc(0, Expr::Bool),
+                             values.data(), values.data() + values.size(),
+                             nullptr, nullptr, true);
+  os << CallsSection << calls;
+  os << ConstraintsSection;
+  if (withExprs)
+    for (const ref<Expr> &c : constraints)
+      os << *c << "\n";
+  os << TagsSection;
+  for (const auto &tag : tags)
+    os << tag.first << " = " << tag.second << "\n";
+  os << BPFCallsSection << bpfCalls;
+  if (!pathCost.empty())
+    os << PathCostSection << pathCost;
+}
+
+void CallPathFile::writeBinary(llvm::raw_ostream &os) const {
+  BinaryWriter writer;
+  for (const Array *array : arrays)
+    writer.addArray(array);
+  std::vector<uint32_t> constraintIds, valueIds;
+  for (const ref<Expr> &c : constraints)
+    constraintIds.push_back(writer.addExpr(c));
+  for (const ref<Expr> &v : values)
+    valueIds.push_back(writer.addExpr(v));
+
+  std::string out(Magic, MagicSize);
+  writeU32(out, BinaryVersion);
+  writeU32(out, 0);
+  writeU32(out, writer.arrays.size());
+  for (const Array *array : writer.arrays) {
+    writeStr(out, array->name);
+    writeU32(out, array->size);
+    writeU32(out, array->domain);
+    writeU32(out, array->range);
+    writeU32(out, array->constantValues.size());
+    for (const ref<ConstantExpr> &value : array->constantValues)
+      writeU64(out, value->getZExtValue());
+  }
+  writeU32(out, writer.getNumNodes());
+  out += writer.nodes;
+  writeU32(out, constraintIds.size());
+  for (uint32_t id : constraintIds)
+    writeU32(out, id);
+  writeU32(out, valueIds.size());
+  for (uint32_t id : valueIds)
+    writeU32(out, id);
+  writeStr(out, calls);
+  writeU32(out, tags.size());
+  for (const auto &tag : tags) {
+    writeStr(out, tag.first);
+    writeStr(out, tag.second);
+  }
+  writeStr(out, bpfCalls);
+  writeStr(out, pathCost);
+  os << out;
+}
@@ -41,7 +41,7 @@ cl::opt<bool> ConstArrayOpt(
 
 /***/
 
-unsigned Expr::count = 0;
+std::atomic<unsigned> Expr::count{0};
 
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
@@ -90,7 +90,7 @@ ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
 }
 
 int Expr::compare(const Expr &b) const {
-  static ExprEquivSet equivs;
+  static thread_local ExprEquivSet equivs;
   int r = compare(b, equivs);
   equivs.clear();
   return r;
@@ -22,6 +22,7 @@
 
 #include <cassert>
 #include <map>
+#include <memory>
 #include <cstring>
 
 using namespace llvm;
@@ -108,7 +109,8 @@ namespace {
     const std::string Filename;
     const MemoryBuffer *TheMemoryBuffer;
     ExprBuilder *Builder;
-    ArrayCache TheArrayCache;
+    ArrayCache OwnArrayCache;
+    ArrayCache &TheArrayCache;
     bool ClearArrayAfterQuery;
 
     Lexer TheLexer;
@@ -119,6 +121,8 @@ namespace {
     IdentifierTabTy IdentifierTab;
 
     std::map<const Identifier*, const ArrayDecl*> ArraySymTab;
+    /// The declarations made through DeclareArray, owned by the parser.
+    std::vector<std::unique_ptr<ArrayDecl>> ExternalArrayDecls;
     ExprSymTabTy ExprSymTab;
     VersionSymTabTy VersionSymTab;
 
@@ -322,8 +326,10 @@ namespace {
 
   public:
     ParserImpl(const std::string _Filename, const MemoryBuffer *MB,
-               ExprBuilder *_Builder, bool _ClearArrayAfterQuery)
+               ExprBuilder *_Builder, bool _ClearArrayAfterQuery,
+               ArrayCache *_Arrays)
         : Filename(_Filename), TheMemoryBuffer(MB), Builder(_Builder),
+          TheArrayCache(_Arrays ? *_Arrays : OwnArrayCache),
           ClearArrayAfterQuery(_ClearArrayAfterQuery), TheLexer(MB),
           MaxErrors(~0u), NumErrors(0) {}
 
@@ -341,6 +347,8 @@ namespace {
 
     virtual Decl *ParseTopLevelDecl();
 
+    virtual void DeclareArray(const Array *Root);
+
     virtual void SetMaxErrors(unsigned N) {
       MaxErrors = N;
     }
@@ -392,6 +400,23 @@ Decl *ParserImpl::ParseTopLevelDecl() {
   return 0;
 }
 
+void ParserImpl::DeclareArray(const Array *Root) {
+  const Identifier *Label;
+  IdentifierTabTy::iterator it = IdentifierTab.find(Root->name);
+  if (it != IdentifierTab.end()) {
+    Label = it->second;
+  } else {
+    Label = new Identifier(Root->name);
+    IdentifierTab.insert(std::make_pair(Root->name, Label));
+  }
+
+  ArrayDecl *AD =
+      new ArrayDecl(Label, Root->size, Root->domain, Root->range, Root);
+  ExternalArrayDecls.emplace_back(AD);
+  ArraySymTab[Label] = AD;
+  VersionSymTab.insert(std::make_pair(Label, UpdateList(Root, NULL)));
+}
+
 /// ParseArrayDecl - Parse an array declaration. The lexer should be positioned
 /// at the opening 'array'.
 ///
@@ -1646,8 +1671,10 @@ Parser::~Parser() {
 }
 
 Parser *Parser::Create(const std::string Filename, const MemoryBuffer *MB,
-                       ExprBuilder *Builder, bool ClearArrayAfterQuery) {
-  ParserImpl *P = new ParserImpl(Filename, MB, Builder, ClearArrayAfterQuery);
+                       ExprBuilder *Builder, bool ClearArrayAfterQuery,
+                       ArrayCache *Arrays) {
+  ParserImpl *P =
+      new ParserImpl(Filename, MB, Builder, ClearArrayAfterQuery, Arrays);
   P->Initialize();
   return P;
 }
@@ -549,6 +549,38 @@ void KFunction::clearAnalysedLoops() {
   analysedLoops.clear();
 }
 
+size_t KFunction::getAnalysedLoopsMemoryUsage() const {
+  size_t usage = 0;
+  for (const auto &loop : analysedLoops)
+    usage += getMemoryUsage(loop.second->forgetMask);
+  for (const auto &summary : loopSummaries) {
+    for (const auto &entry : summary.second)
+      usage += entry.first.capacity() + entry.second.memoryUsage();
+  }
+  return usage;
+}
+
+const LoopSummary *
+KFunction::summaryFor(const llvm::Loop *loop,
+                      const LoopEntryAbstraction &entry) const {
+  auto i = loopSummaries.find(std::make_pair(loop, entry));
+  if (i == loopSummaries.end()) return 0;
+  return &i->second;
+}
+
+bool KFunction::insertSummary(const llvm::Loop *loop,
+                              const LoopEntryAbstraction &entry,
+                              const LoopSummary &summary) {
+  auto insRez = loopSummaries.insert(
+      std::make_pair(std::make_pair(loop, entry), summary));
+  if (insRez.second)
+    return true;
+  if (insRez.first->second == summary)
+    return false;
+  insRez.first->second = summary;
+  return true;
+}
+
 void KModule::clearAnalysedLoops() {
   for (auto it = functions.begin(); it != functions.end(); ++it) {
     (**it).clearAnalysedLoops();
@@ -1,14 +1,122 @@
 #include "LoopAnalysis.h"
 
+#include "../Core/CoreStats.h"
 #include "../Core/ExecutionState.h"
+#include "../Core/TimingSolver.h"
 #include "klee/Support/ErrorHandling.h"
+#include "klee/Support/OptionCategories.h"
+#include "klee/Support/Timer.h"
 
 #include "llvm/IR/DebugLoc.h"
 #include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace llvm;
 using namespace klee;
 
+namespace {
+enum class DiffGranularity { Byte, Word, Object };
+
+cl::opt<DiffGranularity> LoopDiffGranularity(
+    "loop-diff-granularity",
+    cl::desc("How to group the structurally changed bytes when checking "
+             "whether they may differ between loop iterations "
+             "(default=byte)"),
+    cl::values(clEnumValN(DiffGranularity::Byte, "byte",
+                          "one solver query per changed byte"),
+               clEnumValN(DiffGranularity::Word, "word",
+                          "one query per aligned 8-byte word, bisected "
+                          "only if it may differ"),
+               clEnumValN(DiffGranularity::Object, "object",
+                          "one query per memory object, bisected "
+                          "only if it may differ")
+                   KLEE_LLVM_CL_VAL_END),
+    cl::init(DiffGranularity::Byte), cl::cat(klee::ModuleCat));
+
+cl::opt<std::string> LoopSummaryFile(
+    "loop-summary-file",
+    cl::desc("Seed the invariant analysis of loops with the summaries in the "
+             "given file, and append the summaries of newly analysed loops "
+             "to it (default=off)"),
+    cl::value_desc("path"), cl::cat(klee::ModuleCat));
+
+const unsigned DiffWordSize = 8;
+
+/// A byte that differs structurally between two iterations, together
+/// with the (non-constant) condition under which its value stays the same.
+struct DiffCandidate {
+  unsigned offset;
+  ref<Expr> same;
+};
+
+/// Check whether any byte in [begin, end) may differ with a single
+/// query over the conjunction of their equalities, and bisect the range
+/// only when it may. A single-byte range behaves exactly like the
+/// byte-granular mode, so the resulting mask is the same unless the
+/// solver times out.
+bool markMayDiffer(const std::vector<DiffCandidate> &cands, size_t begin,
+                   size_t end, ByteRangeMask &bytes, const ExecutionState &state,
+                   TimingSolver *solver, DiffMaskStats &stats) {
+  ref<Expr> allSame = cands[begin].same;
+  for (size_t i = begin + 1; i < end; ++i)
+    allSame = AndExpr::create(allSame, cands[i].same);
+
+  solver->setTimeout(
+      time::Span("1")); // TODO: determine a correct argument here.
+  bool mayDiffer = true;
+  WallTimer timer;
+  bool solverRes =
+      solver->mayBeFalse(state.constraints, allSame, mayDiffer,
+                         state.queryMetaData);
+  time::Span elapsed = timer.delta();
+  solver->setTimeout(time::Span());
+  ++stats.queries;
+  stats.queryTime += elapsed;
+
+  if (end - begin == 1) {
+    // assert(solverRes &&
+    //       "Solver failed in computing whether a byte changed or not.");
+    if (solverRes && mayDiffer) {
+      bytes.set(cands[begin].offset);
+      return true;
+    }
+    return false;
+  }
+  if (solverRes && !mayDiffer) {
+    // One query answered for the whole group; assume each of the
+    // skipped per-byte queries would have cost about as much.
+    stats.timeSaved += elapsed * static_cast<unsigned>(end - begin - 1);
+    return false;
+  }
+  size_t mid = begin + (end - begin) / 2;
+  bool updated = markMayDiffer(cands, begin, mid, bytes, state, solver, stats);
+  updated |= markMayDiffer(cands, mid, end, bytes, state, solver, stats);
+  return updated;
+}
+} // namespace
+
+DiffMaskStats &DiffMaskStats::operator+=(const DiffMaskStats &other) {
+  candidateBytes += other.candidateBytes;
+  queries += other.queries;
+  queryTime += other.queryTime;
+  timeSaved += other.timeSaved;
+  return *this;
+}
+
+size_t klee::getMemoryUsage(const StateByteMask &mask) {
+  // Roughly the size of a red-black tree node holding an entry.
+  const size_t nodeSize = 4 * sizeof(void *) + sizeof(StateByteMask::value_type);
+  size_t usage = 0;
+  for (const auto &entry : mask)
+    usage += nodeSize + entry.second.memoryUsage();
+  return usage;
+}
+
 std::string __attribute__((weak)) numToStr(long long n) {
     std::stringstream ss;
     ss << n;
@@ -16,8 +124,10 @@ std::string __attribute__((weak)) numToStr(long long n) {
   }
 
 bool klee::updateDiffMask(StateByteMask *mask, const AddressSpace &refValues,
-                          const ExecutionState &state, TimingSolver *solver) {
+                          const ExecutionState &state, TimingSolver *solver,
+                          DiffMaskStats *loopStats) {
   bool updated = false;
+  DiffMaskStats diffStats;
   for (MemoryMap::iterator i = refValues.objects.begin(),
                            e = refValues.objects.end();
        i != e; ++i) {
@@ -41,11 +151,7 @@ bool klee::updateDiffMask(StateByteMask *mask, const AddressSpace &refValues,
     assert(refOs->isAccessible() == os->isAccessible() &&
            "No support for accessibility alteration "
            "between loop iterations.");
-    std::pair<std::map<const MemoryObject *, BitArray *>::iterator, bool>
-        insRez =
-            mask->insert(std::pair<const MemoryObject *, BitArray *>(obj, 0));
-
-    if (state.havocs.find(obj) == state.havocs.end() &&
+    if (!state.havocs.count(obj) &&
         !state.condoneUndeclaredHavocs) {
       ref<Expr> firstByteRef = refOs->read8(0, true);
       ref<Expr> firstByte = os->read8(0, true);
@@ -88,35 +194,247 @@ bool klee::updateDiffMask(StateByteMask *mask, const AddressSpace &refValues,
                  metadata.c_str());
     }
 
-    if (insRez.second)
-      insRez.first->second = new BitArray(obj->size);
-    BitArray *bytes = insRez.first->second;
-    assert(bytes != 0);
+    ByteRangeMask &bytes = (*mask)[obj];
     unsigned size = obj->size;
-    for (unsigned j = 0; j < size; ++j) {
-      if (bytes->get(j))
-        continue;
-      ref<Expr> refVal = refOs->read8(j, true);
-      ref<Expr> val = os->read8(j, true);
-      if (0 != refVal->compare(*val)) {
-        // So: this byte was not diferent on the previous round,
-        // it also differs structuraly now. It is time to make
-        // sure it can be really different.
-
-        solver->setTimeout(
-            time::Span("1")); // TODO: determine a correct argument here.
-        bool mayDiffer = true;
-        bool solverRes = solver->mayBeFalse(state.constraints, EqExpr::create(refVal, val),
-                                            /*&*/ mayDiffer, state.queryMetaData);
-        solver->setTimeout(time::Span());
-        // assert(solverRes &&
-        //       "Solver failed in computing whether a byte changed or not.");
-        if (solverRes && mayDiffer) {
-          bytes->set(j);
-          updated = true;
+    std::vector<DiffCandidate> cands;
+    std::vector<unsigned> differing;
+    // Only the bytes between the ranges already marked need a look.
+    unsigned j = 0;
+    for (ByteRangeMask::iterator r = bytes.begin();; ++r) {
+      unsigned gapEnd = r == bytes.end() ? size : std::min(r->begin, size);
+      for (; j < gapEnd; ++j) {
+        ref<Expr> refVal = refOs->read8(j, true);
+        ref<Expr> val = os->read8(j, true);
+        if (0 != refVal->compare(*val)) {
+          // So: this byte was not diferent on the previous round,
+          // it also differs structuraly now. It is time to make
+          // sure it can be really different.
+          ref<Expr> same = EqExpr::create(refVal, val);
+          if (ConstantExpr *CE = dyn_cast<ConstantExpr>(same)) {
+            // Decided without the solver, just as the solver
+            // fast path would.
+            if (CE->isFalse())
+              differing.push_back(j);
+            continue;
+          }
+          cands.push_back({j, same});
+        }
+      }
+      if (r == bytes.end())
+        break;
+      j = std::max(j, r->end);
+    }
+    for (unsigned offset : differing)
+      bytes.set(offset);
+    updated |= !differing.empty();
+    diffStats.candidateBytes += cands.size();
+
+    size_t groupBegin = 0;
+    for (size_t k = 0; k < cands.size(); ++k) {
+      bool groupEnds = true;
+      if (k + 1 < cands.size()) {
+        switch (LoopDiffGranularity) {
+        case DiffGranularity::Byte:
+          break;
+        case DiffGranularity::Word:
+          groupEnds = cands[k].offset / DiffWordSize !=
+                      cands[k + 1].offset / DiffWordSize;
+          break;
+        case DiffGranularity::Object:
+          groupEnds = false;
+          break;
         }
       }
+      if (!groupEnds)
+        continue;
+      if (markMayDiffer(cands, groupBegin, k + 1, bytes, state, solver,
+                        diffStats))
+        updated = true;
+      groupBegin = k + 1;
     }
   }
+
+  stats::loopDiffQueries += diffStats.queries;
+  stats::loopDiffCandidateBytes += diffStats.candidateBytes;
+  stats::loopDiffTime += diffStats.queryTime.toMicroseconds();
+  stats::loopDiffTimeSaved += diffStats.timeSaved.toMicroseconds();
+  if (loopStats)
+    *loopStats += diffStats;
   return updated;
 }
+
+LoopEntryAbstraction klee::abstractLoopEntry(const ExecutionState &entry) {
+  LoopEntryAbstraction abstraction;
+  for (auto it = entry.havocs.begin(), ie = entry.havocs.end(); it != ie; ++it)
+    abstraction[it->second.name] = it->first->size;
+  return abstraction;
+}
+
+bool klee::summarizeLoop(const StateByteMask &changedBytes,
+                         const ExecutionState &entry, LoopSummary &summary) {
+  for (const auto &changed : changedBytes) {
+    if (changed.second.empty())
+      continue;
+    auto havoc = entry.havocs.lookup(changed.first);
+    if (!havoc)
+      return false;
+    summary[havoc->second.name] = changed.second;
+  }
+  return true;
+}
+
+StateByteMask klee::instantiateLoopSummary(const LoopSummary &summary,
+                                           const ExecutionState &entry) {
+  std::map<std::string, const MemoryObject *> objects;
+  for (auto it = entry.havocs.begin(), ie = entry.havocs.end(); it != ie; ++it)
+    objects[it->second.name] = it->first.get();
+  StateByteMask mask;
+  for (const auto &changed : summary) {
+    auto object = objects.find(changed.first);
+    // Objects freed since their havoc declaration cannot be forgotten; the
+    // verification round reports them if they still matter.
+    if (object != objects.end() &&
+        entry.addressSpace.findObject(object->second))
+      mask[object->second] = changed.second;
+  }
+  return mask;
+}
+
+namespace {
+/// Loop headers are identified by their position in the function, which
+/// is stable across runs on the same bitcode.
+unsigned getHeaderIndex(const llvm::Loop *loop) {
+  const BasicBlock *header = loop->getHeader();
+  unsigned index = 0;
+  for (const BasicBlock &bb : *header->getParent()) {
+    if (&bb == header)
+      break;
+    ++index;
+  }
+  return index;
+}
+
+/// A summary line reads
+///   function <tab> header index <tab> name:size,... <tab> name=b-e+b-e,...
+bool parseLoopSummary(KModule &kmodule, StringRef line) {
+  SmallVector<StringRef, 4> fields;
+  line.split(fields, '\t');
+  unsigned headerIndex;
+  if (fields.size() != 4 || fields[1].getAsInteger(10, headerIndex))
+    return false;
+  Function *f = kmodule.module->getFunction(fields[0]);
+  auto kfi = kmodule.functionMap.find(f);
+  if (!f || kfi == kmodule.functionMap.end())
+    return false;
+  KFunction *kf = kfi->second;
+  const BasicBlock *header = nullptr;
+  for (const BasicBlock &bb : *f)
+    if (headerIndex-- == 0) {
+      header = &bb;
+      break;
+    }
+  const llvm::Loop *loop = header ? kf->loopInfo.getLoopFor(header) : nullptr;
+  if (!loop || loop->getHeader() != header)
+    return false;
+
+  LoopEntryAbstraction entry;
+  SmallVector<StringRef, 8> items;
+  fields[2].split(items, ',', -1, false);
+  for (StringRef item : items) {
+    std::pair<StringRef, StringRef> nameSize = item.split(':');
+    unsigned size;
+    if (nameSize.first.empty() || nameSize.second.getAsInteger(10, size))
+      return false;
+    entry[nameSize.first.str()] = size;
+  }
+
+  LoopSummary summary;
+  items.clear();
+  fields[3].split(items, ',', -1, false);
+  for (StringRef item : items) {
+    std::pair<StringRef, StringRef> nameRanges = item.split('=');
+    auto declared = entry.find(nameRanges.first.str());
+    if (declared == entry.end())
+      return false;
+    ByteRangeMask &mask = summary[declared->first];
+    SmallVector<StringRef, 8> ranges;
+    nameRanges.second.split(ranges, '+', -1, false);
+    for (StringRef range : ranges) {
+      std::pair<StringRef, StringRef> bounds = range.split('-');
+      unsigned begin, end;
+      if (bounds.first.getAsInteger(10, begin) ||
+          bounds.second.getAsInteger(10, end) || begin >= end ||
+          end > declared->second)
+        return false;
+      mask.set(begin, end);
+    }
+  }
+  kf->insertSummary(loop, entry, summary);
+  return true;
+}
+
+bool isSummaryName(const std::string &name) {
+  return !name.empty() && name.find_first_of("\t\n,:=") == std::string::npos;
+}
+} // namespace
+
+void klee::loadLoopSummaries(KModule &kmodule) {
+  if (LoopSummaryFile.empty())
+    return;
+  auto buffer = MemoryBuffer::getFile(LoopSummaryFile);
+  if (!buffer) // The file is created by the first summary saved.
+    return;
+  SmallVector<StringRef, 64> lines;
+  (*buffer)->getBuffer().split(lines, '\n', -1, false);
+  unsigned loaded = 0;
+  for (unsigned i = 0; i < lines.size(); ++i) {
+    if (parseLoopSummary(kmodule, lines[i]))
+      ++loaded;
+    else
+      klee_warning("%s:%u: ignoring malformed or stale loop summary",
+                   LoopSummaryFile.c_str(), i + 1);
+  }
+  klee_message("Loaded %u loop summaries from %s", loaded,
+               LoopSummaryFile.c_str());
+}
+
+void klee::saveLoopSummary(const KFunction &kf, const llvm::Loop *loop,
+                           const LoopEntryAbstraction &entry,
+                           const LoopSummary &summary) {
+  if (LoopSummaryFile.empty())
+    return;
+  std::string line;
+  llvm::raw_string_ostream os(line);
+  os << kf.function->getName() << '\t' << getHeaderIndex(loop) << '\t';
+  const char *sep = "";
+  for (const auto &declared : entry) {
+    if (!isSummaryName(declared.first))
+      return;
+    os << sep << declared.first << ':' << declared.second;
+    sep = ",";
+  }
+  os << '\t';
+  sep = "";
+  for (const auto &changed : summary) {
+    os << sep << changed.first << '=';
+    const char *rangeSep = "";
+    for (const ByteRangeMask::Range &r : changed.second) {
+      os << rangeSep << r.begin << '-' << r.end;
+      rangeSep = "+";
+    }
+    sep = ",";
+  }
+  os << '\n';
+  os.flush();
+
+  // A single append per summary, so that the lines of runs sharing the
+  // file do not interleave.
+  int fd = ::open(LoopSummaryFile.c_str(),
+                  O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0 || ::write(fd, line.data(), line.size()) !=
+                    static_cast<ssize_t>(line.size()))
+    klee_warning("could not save loop summary to %s",
+                 LoopSummaryFile.c_str());
+  if (fd >= 0)
+    ::close(fd);
+}
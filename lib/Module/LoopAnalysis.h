@@ -10,7 +10,9 @@
 #ifndef LOOP_ANALYSIS_H
 #define LOOP_ANALYSIS_H
 
-#include "klee/ADT/BitArray.h"
+#include "klee/ADT/ByteRangeMask.h"
+#include "klee/Module/KModule.h"
+#include "klee/System/Time.h"
 #include "../Core/AddressSpace.h"
 
 namespace klee {
@@ -19,7 +21,10 @@ class ExecutionState;
 class TimingSolver;
 
 /// A global bytemask for all the memory of a program.
-using StateByteMask = std::map<const MemoryObject *, BitArray *>;
+using StateByteMask = std::map<const MemoryObject *, ByteRangeMask>;
+
+/// The memory used by a mask, including its map nodes.
+size_t getMemoryUsage(const StateByteMask &mask);
 
 struct LoopEntryState {
   StateByteMask forgetMask;
@@ -31,10 +36,52 @@ struct LoopEntryState {
   {}
  };
 
+/// Solver effort spent by updateDiffMask on behalf of a single loop.
+struct DiffMaskStats {
+  /// Bytes that differ structurally and required a solver query in
+  /// the byte-granular mode.
+  uint64_t candidateBytes = 0;
+  /// Solver queries actually issued.
+  uint64_t queries = 0;
+  /// Time spent in those queries.
+  time::Span queryTime;
+  /// Estimated time avoided by answering a whole group with one query.
+  time::Span timeSaved;
+
+  DiffMaskStats &operator+=(const DiffMaskStats &other);
+};
+
+/// Mark in the mask every byte that may differ between refValues and
+/// the current state. Returns true if a new byte was marked. The
+/// solver effort is accumulated into `loopStats`, when given.
 bool updateDiffMask(StateByteMask* mask,
                       const AddressSpace& refValues,
                       const ExecutionState& state,
-                      TimingSolver* solver);
+                      TimingSolver* solver,
+                      DiffMaskStats *loopStats = nullptr);
+
+/// The abstraction of a loop entry state that loop summaries are keyed by:
+/// the objects the state declared havocable.
+LoopEntryAbstraction abstractLoopEntry(const ExecutionState &entry);
+
+/// Maps the bytes changed by an analysed loop to their havoc names.
+/// Returns false if a changed object was not declared havocable.
+bool summarizeLoop(const StateByteMask &changedBytes,
+                   const ExecutionState &entry, LoopSummary &summary);
+
+/// Maps a summary back to the objects of an entry state with the same
+/// abstraction.
+StateByteMask instantiateLoopSummary(const LoopSummary &summary,
+                                     const ExecutionState &entry);
+
+/// Loads the summaries of -loop-summary-file into the functions of the
+/// module.
+void loadLoopSummaries(KModule &kmodule);
+
+/// Appends a summary to -loop-summary-file, if given.
+void saveLoopSummary(const KFunction &kf, const llvm::Loop *loop,
+                     const LoopEntryAbstraction &entry,
+                     const LoopSummary &summary);
 
 //#define DO_LOG_LOOP_ANALYSIS
 #ifdef DO_LOG_LOOP_ANALYSIS
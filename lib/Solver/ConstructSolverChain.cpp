@@ -40,6 +40,14 @@ Solver *constructSolverChain(Solver *coreSolver,
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (!QueryCacheFile.empty()) {
+    Solver *cached = createPersistentCachingSolver(solver, QueryCacheFile);
+    if (cached != solver)
+      klee_message("Caching queries that reach the solver in %s\n",
+                   QueryCacheFile.c_str());
+    solver = cached;
+  }
+
   if (UseAssignmentValidatingSolver)
     solver = createAssignmentValidatingSolver(solver);
 
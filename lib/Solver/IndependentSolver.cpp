@@ -15,18 +15,33 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Support/Debug.h"
+#include "klee/Support/OptionCategories.h"
 #include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <list>
 #include <map>
+#include <memory>
 #include <ostream>
+#include <unordered_map>
 #include <vector>
 
 using namespace klee;
 using namespace llvm;
 
+namespace {
+cl::opt<unsigned> IndependentPartitionCacheSize(
+    "independent-partition-cache-size", cl::init(1024),
+    cl::desc("Number of constraint set partitions the independent solver "
+             "keeps for later queries on the same or extended constraint "
+             "sets. 0 disables the reuse (default=1024)"),
+    cl::cat(SolvingCat));
+} // namespace
+
 template<class T>
 class DenseSet {
   typedef std::set<T> set_ty;
@@ -56,8 +71,8 @@ public:
     return modified;
   }
 
-  bool intersects(const DenseSet &b) {
-    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
+  bool intersects(const DenseSet &b) const {
+    for (typename set_ty::const_iterator it = s.begin(), ie = s.end(); 
          it != ie; ++it)
       if (b.s.count(*it))
         return true;
@@ -182,16 +197,16 @@ public:
   }
 
   // more efficient when this is the smaller set
-  bool intersects(const IndependentElementSet &b) {
+  bool intersects(const IndependentElementSet &b) const {
     // If there are any symbolic arrays in our query that b accesses
-    for (std::set<const Array*>::iterator it = wholeObjects.begin(), 
+    for (std::set<const Array*>::const_iterator it = wholeObjects.begin(), 
            ie = wholeObjects.end(); it != ie; ++it) {
       const Array *array = *it;
       if (b.wholeObjects.count(array) || 
           b.elements.find(array) != b.elements.end())
         return true;
     }
-    for (elements_ty::iterator it = elements.begin(), ie = elements.end();
+    for (elements_ty::const_iterator it = elements.begin(), ie = elements.end();
          it != ie; ++it) {
       const Array *array = it->first;
       // if the array we access is symbolic in b
@@ -255,114 +270,97 @@ inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
   return os;
 }
 
+/// A factor of a constraint set: the constraints that transitively share
+/// array elements, and the elements they access.
+struct ConstraintFactor {
+  IndependentElementSet elements; // `exprs` is left empty
+  std::vector<unsigned> indices;  // Positions in the constraint set, sorted
+};
+
+/// The independent factors of a constraint set. Factors never intersect, so
+/// that an appended constraint only merges the factors it intersects, and
+/// partitions of extended constraint sets share the factors they did not
+/// merge.
+struct ConstraintPartition {
+  std::vector<ref<Expr> > constraints;
+  std::vector<std::shared_ptr<const ConstraintFactor> > factors;
+
+  /// The constraints of `indices`, in the order of the constraint set.
+  void getConstraints(const std::vector<unsigned> &indices,
+                      std::vector<ref<Expr> > &result) const {
+    for (unsigned index : indices)
+      result.push_back(constraints[index]);
+  }
+};
+
 // Breaks down a constraint into all of it's individual pieces, returning a
-// list of IndependentElementSets or the independent factors.
+// list of IndependentElementSets or the independent factors. The negated
+// query expression is merged into the factors of `partition` it intersects.
 //
 // Caller takes ownership of returned std::list.
-static std::list<IndependentElementSet>*
-getAllIndependentConstraintsSets(const Query &query) {
+static std::list<IndependentElementSet> *
+getAllIndependentConstraintsSets(const Query &query,
+                                 const ConstraintPartition &partition) {
   std::list<IndependentElementSet> *factors = new std::list<IndependentElementSet>();
   ConstantExpr *CE = dyn_cast<ConstantExpr>(query.expr);
   if (CE) {
     assert(CE && CE->isFalse() && "the expr should always be false and "
                                   "therefore not included in factors");
-  } else {
-    ref<Expr> neg = Expr::createIsZero(query.expr);
-    factors->push_back(IndependentElementSet(neg));
-  }
-
-  for (const auto &constraint : query.constraints) {
-    // iterate through all the previously separated constraints.  Until we
-    // actually return, factors is treated as a queue of expressions to be
-    // evaluated.  If the queue property isn't maintained, then the exprs
-    // could be returned in an order different from how they came it, negatively
-    // affecting later stages.
-    factors->push_back(IndependentElementSet(constraint));
+    for (const auto &factor : partition.factors) {
+      factors->push_back(factor->elements);
+      partition.getConstraints(factor->indices, factors->back().exprs);
+    }
+    return factors;
   }
 
-  bool doneLoop = false;
-  do {
-    doneLoop = true;
-    std::list<IndependentElementSet> *done =
-        new std::list<IndependentElementSet>;
-    while (factors->size() > 0) {
-      IndependentElementSet current = factors->front();
-      factors->pop_front();
-      // This list represents the set of factors that are separate from current.
-      // Those that are not inserted into this list (queue) intersect with
-      // current.
-      std::list<IndependentElementSet> *keep =
-          new std::list<IndependentElementSet>;
-      while (factors->size() > 0) {
-        IndependentElementSet compare = factors->front();
-        factors->pop_front();
-        if (current.intersects(compare)) {
-          if (current.add(compare)) {
-            // Means that we have added (z=y)added to (x=y)
-            // Now need to see if there are any (z=?)'s
-            doneLoop = false;
-          }
-        } else {
-          keep->push_back(compare);
-        }
-      }
-      done->push_back(current);
-      delete factors;
-      factors = keep;
+  ref<Expr> neg = Expr::createIsZero(query.expr);
+  IndependentElementSet queryFactor(neg);
+  const IndependentElementSet negElements(neg);
+  std::vector<unsigned> merged;
+  for (const auto &factor : partition.factors) {
+    if (negElements.intersects(factor->elements)) {
+      queryFactor.add(factor->elements);
+      merged.insert(merged.end(), factor->indices.begin(),
+                    factor->indices.end());
+    } else {
+      factors->push_back(factor->elements);
+      partition.getConstraints(factor->indices, factors->back().exprs);
     }
-    delete factors;
-    factors = done;
-  } while (!doneLoop);
-
+  }
+  // Keep the query expression first and the constraints in the order they
+  // came in, as later stages are sensitive to it.
+  std::sort(merged.begin(), merged.end());
+  partition.getConstraints(merged, queryFactor.exprs);
+  factors->push_front(queryFactor);
   return factors;
 }
 
-static 
-IndependentElementSet getIndependentConstraints(const Query& query,
-                                                std::vector< ref<Expr> > &result) {
-  IndependentElementSet eltsClosure(query.expr);
-  std::vector< std::pair<ref<Expr>, IndependentElementSet> > worklist;
-
-  for (const auto &constraint : query.constraints)
-    worklist.push_back(
-        std::make_pair(constraint, IndependentElementSet(constraint)));
-
-  // XXX This should be more efficient (in terms of low level copy stuff).
-  bool done = false;
-  do {
-    done = true;
-    std::vector< std::pair<ref<Expr>, IndependentElementSet> > newWorklist;
-    for (std::vector< std::pair<ref<Expr>, IndependentElementSet> >::iterator
-           it = worklist.begin(), ie = worklist.end(); it != ie; ++it) {
-      if (it->second.intersects(eltsClosure)) {
-        if (eltsClosure.add(it->second))
-          done = false;
-        result.push_back(it->first);
-        // Means that we have added (z=y)added to (x=y)
-        // Now need to see if there are any (z=?)'s
-      } else {
-        newWorklist.push_back(*it);
-      }
-    }
-    worklist.swap(newWorklist);
-  } while (!done);
+static void getIndependentConstraints(const Query &query,
+                                      const ConstraintPartition &partition,
+                                      std::vector<ref<Expr> > &result) {
+  // Factors do not intersect, so the closure of the query expression is the
+  // union of the factors it intersects.
+  const IndependentElementSet queryElements(query.expr);
+  std::vector<unsigned> required;
+  for (const auto &factor : partition.factors)
+    if (queryElements.intersects(factor->elements))
+      required.insert(required.end(), factor->indices.begin(),
+                      factor->indices.end());
+  std::sort(required.begin(), required.end());
+  partition.getConstraints(required, result);
 
   KLEE_DEBUG(
     std::set< ref<Expr> > reqset(result.begin(), result.end());
     errs() << "--\n";
     errs() << "Q: " << query.expr << "\n";
-    errs() << "\telts: " << IndependentElementSet(query.expr) << "\n";
+    errs() << "\telts: " << queryElements << "\n";
     int i = 0;
     for (const auto &constraint: query.constraints) {
       errs() << "C" << i++ << ": " << constraint;
       errs() << " " << (reqset.count(constraint) ? "(required)" : "(independent)") << "\n";
       errs() << "\telts: " << IndependentElementSet(constraint) << "\n";
     }
-    errs() << "elts closure: " << eltsClosure << "\n";
  );
-
-
-  return eltsClosure;
 }
 
 
@@ -390,6 +388,22 @@ class IndependentSolver : public SolverImpl {
 private:
   Solver *solver;
 
+  /// The element sets of the constraints seen so far. The key is kept
+  /// alive by the entry so that its address is not reused.
+  std::unordered_map<const Expr *,
+                     std::pair<ref<Expr>, IndependentElementSet> >
+      elementSets;
+
+  /// Partitions of the constraint sets of earlier queries, keyed by their
+  /// last constraint and their size.
+  std::map<std::pair<const Expr *, size_t>,
+           std::shared_ptr<const ConstraintPartition> >
+      partitions;
+
+  const IndependentElementSet &getElementSet(const ref<Expr> &e);
+  std::shared_ptr<const ConstraintPartition>
+  getPartition(const ConstraintSet &constraints);
+
 public:
   IndependentSolver(Solver *_solver) 
     : solver(_solver) {}
@@ -407,11 +421,93 @@ public:
   void setCoreSolverTimeout(time::Span timeout);
 };
   
+const IndependentElementSet &
+IndependentSolver::getElementSet(const ref<Expr> &e) {
+  auto it = elementSets.find(e.get());
+  if (it == elementSets.end()) {
+    IndependentElementSet elements(e);
+    elements.exprs.clear();
+    it = elementSets.emplace(e.get(), std::make_pair(e, std::move(elements)))
+             .first;
+  }
+  return it->second.second;
+}
+
+std::shared_ptr<const ConstraintPartition>
+IndependentSolver::getPartition(const ConstraintSet &constraints) {
+  std::vector<const Expr *> exprs;
+  exprs.reserve(constraints.size());
+  for (const auto &constraint : constraints)
+    exprs.push_back(constraint.get());
+
+  // Constraints are only ever appended along a path, so the partition of the
+  // parent state's constraints, or of an earlier query on this state, is
+  // usually a prefix of this one.
+  std::shared_ptr<const ConstraintPartition> base;
+  for (size_t size = exprs.size(); size > 0 && !base; --size) {
+    auto it = partitions.find(std::make_pair(exprs[size - 1], size));
+    if (it == partitions.end())
+      continue;
+    const std::vector<ref<Expr> > &cached = it->second->constraints;
+    if (std::equal(cached.begin(), cached.end(), exprs.begin(),
+                   [](const ref<Expr> &a, const Expr *b) {
+                     return a.get() == b;
+                   }))
+      base = it->second;
+  }
+
+  size_t reused = base ? base->constraints.size() : 0;
+  stats::independentConstraintsReused += reused;
+  if (reused == exprs.size()) {
+    if (base)
+      ++stats::independentPartitionHits;
+    return base ? base : std::make_shared<ConstraintPartition>();
+  }
+  ++stats::independentPartitionMisses;
+  stats::independentConstraintsIndexed += exprs.size() - reused;
+
+  if (partitions.size() >= IndependentPartitionCacheSize) {
+    partitions.clear();
+    elementSets.clear();
+  }
+
+  auto partition = base ? std::make_shared<ConstraintPartition>(*base)
+                        : std::make_shared<ConstraintPartition>();
+  ConstraintSet::const_iterator it = constraints.begin();
+  std::advance(it, reused);
+  for (; it != constraints.end(); ++it) {
+    unsigned index = partition->constraints.size();
+    partition->constraints.push_back(*it);
+
+    // Merge the factors the constraint intersects; the others are shared
+    // with the base partition.
+    auto factor = std::make_shared<ConstraintFactor>();
+    factor->elements = getElementSet(*it);
+    std::vector<std::shared_ptr<const ConstraintFactor> > independent;
+    for (auto &other : partition->factors) {
+      if (factor->elements.intersects(other->elements)) {
+        factor->elements.add(other->elements);
+        factor->indices.insert(factor->indices.end(), other->indices.begin(),
+                               other->indices.end());
+      } else {
+        independent.push_back(std::move(other));
+      }
+    }
+    std::sort(factor->indices.begin(), factor->indices.end());
+    factor->indices.push_back(index);
+    independent.push_back(std::move(factor));
+    partition->factors.swap(independent);
+  }
+
+  if (IndependentPartitionCacheSize > 0)
+    partitions[std::make_pair(exprs.back(), exprs.size())] = partition;
+  return partition;
+}
+
 bool IndependentSolver::computeValidity(const Query& query,
                                         Solver::Validity &result) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure =
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, *getPartition(query.constraints), required);
   ConstraintSet tmp(required);
   return solver->impl->computeValidity(Query(tmp, query.expr), 
                                        result);
@@ -419,8 +515,7 @@ bool IndependentSolver::computeValidity(const Query& query,
 
 bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, *getPartition(query.constraints), required);
   ConstraintSet tmp(required);
   return solver->impl->computeTruth(Query(tmp, query.expr), 
                                     isValid);
@@ -428,8 +523,7 @@ bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
 
 bool IndependentSolver::computeValue(const Query& query, ref<Expr> &result) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, *getPartition(query.constraints), required);
   ConstraintSet tmp(required);
   return solver->impl->computeValue(Query(tmp, query.expr), result);
 }
@@ -480,7 +574,8 @@ bool IndependentSolver::computeInitialValues(const Query& query,
   hasSolution = true;
   // FIXME: When we switch to C++11 this should be a std::unique_ptr so we don't need
   // to remember to manually call delete
-  std::list<IndependentElementSet> *factors = getAllIndependentConstraintsSets(query);
+  std::list<IndependentElementSet> *factors =
+      getAllIndependentConstraintsSets(query, *getPartition(query.constraints));
 
   //Used to rearrange all of the answers into the correct order
   std::map<const Array*, std::vector<unsigned char> > retMap;
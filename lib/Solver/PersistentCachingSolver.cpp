@@ -0,0 +1,741 @@
+//===-- PersistentCachingSolver.cpp - On-disk query cache -----------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/IncompleteSolver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+/// A 128-bit key that only depends on the structure of what was hashed, so
+/// that it identifies a query across runs.
+struct QueryKey {
+  uint64_t lo = 0, hi = 0;
+
+  bool operator==(const QueryKey &b) const { return lo == b.lo && hi == b.hi; }
+  bool operator<(const QueryKey &b) const {
+    return lo < b.lo || (lo == b.lo && hi < b.hi);
+  }
+};
+
+struct QueryKeyHash {
+  size_t operator()(const QueryKey &key) const { return key.lo; }
+};
+
+/// Accumulates 64-bit words into a QueryKey. The two halves go through
+/// different mixers, so a collision needs both to collide.
+class KeyBuilder {
+  uint64_t lo = 0xcbf29ce484222325ULL;
+  uint64_t hi = 0x9e3779b97f4a7c15ULL;
+
+public:
+  KeyBuilder &add(uint64_t v) {
+    lo ^= v;
+    lo ^= lo >> 33;
+    lo *= 0xff51afd7ed558ccdULL;
+    lo ^= lo >> 33;
+    lo *= 0xc4ceb9fe1a85ec53ULL;
+    lo ^= lo >> 33;
+    hi += v + 0x9e3779b97f4a7c15ULL;
+    hi = (hi ^ (hi >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hi = (hi ^ (hi >> 27)) * 0x94d049bb133111ebULL;
+    hi ^= hi >> 31;
+    return *this;
+  }
+
+  KeyBuilder &add(const QueryKey &key) { return add(key.lo).add(key.hi); }
+
+  KeyBuilder &add(const void *data, size_t size) {
+    add(size);
+    const char *bytes = static_cast<const char *>(data);
+    for (size_t i = 0; i < size; i += 8) {
+      uint64_t word = 0;
+      memcpy(&word, bytes + i, std::min<size_t>(8, size - i));
+      add(word);
+    }
+    return *this;
+  }
+
+  QueryKey get() const {
+    QueryKey key;
+    key.lo = lo;
+    key.hi = hi;
+    return key;
+  }
+};
+
+/// Computes the keys of queries. Arrays are not identified by their names,
+/// which are only unique within a run (and not even there for arrays loaded
+/// from different files), but numbered in the order they first appear in the
+/// query: queries that only differ in the names of their arrays share a key.
+///
+/// The key of an expression numbers the arrays in the order they first appear
+/// in that expression, so that it does not depend on the query and can be
+/// memoized. The key of a composite expression is made of the keys of its
+/// kids, and of where the arrays of each kid come in its own numbering.
+class ExprKeys {
+public:
+  struct Entry {
+    QueryKey key;
+    /// The arrays of the expression, in the order they first appear.
+    std::vector<const Array *> arrays;
+  };
+
+private:
+  /// The expressions are kept referenced so that their addresses cannot be
+  /// reused while they are in the map.
+  std::unordered_map<const Expr *, std::pair<ref<Expr>, Entry>> exprs;
+  std::unordered_map<const UpdateNode *, std::pair<ref<UpdateNode>, Entry>>
+      updates;
+
+  /// The number of expressions after which the memo is dropped.
+  static const size_t maxExprs = 1 << 18;
+
+  static void addConstant(KeyBuilder &builder, const ConstantExpr *ce) {
+    const llvm::APInt &value = ce->getAPValue();
+    builder.add(value.getBitWidth());
+    for (unsigned i = 0; i < value.getNumWords(); ++i)
+      builder.add(value.getRawData()[i]);
+  }
+
+  /// The structure of an array, without its name.
+  static QueryKey getShape(const Array *array) {
+    KeyBuilder builder;
+    builder.add(array->size)
+        .add(array->domain)
+        .add(array->range)
+        .add(array->constantValues.size());
+    for (const ref<ConstantExpr> &value : array->constantValues)
+      addConstant(builder, value.get());
+    return builder.get();
+  }
+
+  const Entry &get(const UpdateNode *head) {
+    static const Entry empty;
+    // Update lists can be long, so walk them iteratively from the oldest
+    // update not yet memoized.
+    std::vector<const UpdateNode *> pending;
+    const Entry *next = &empty;
+    for (const UpdateNode *un = head; un; un = un->next.get()) {
+      auto it = updates.find(un);
+      if (it != updates.end()) {
+        next = &it->second.second;
+        break;
+      }
+      pending.push_back(un);
+    }
+    for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+      const UpdateNode *un = *it;
+      Entry entry;
+      KeyBuilder builder;
+      add(builder, entry.arrays, *next);
+      add(builder, entry.arrays, get(un->index));
+      add(builder, entry.arrays, get(un->value));
+      entry.key = builder.get();
+      ref<UpdateNode> kept(const_cast<UpdateNode *>(un));
+      next = &updates.emplace(un, std::make_pair(kept, std::move(entry)))
+                  .first->second.second;
+    }
+    return *next;
+  }
+
+public:
+  /// Adds `kid` to `builder`, numbering its arrays after the arrays seen so
+  /// far, in `arrays`.
+  static void add(KeyBuilder &builder, std::vector<const Array *> &arrays,
+                  const Entry &kid) {
+    builder.add(kid.key).add(kid.arrays.size());
+    for (const Array *array : kid.arrays) {
+      auto it = std::find(arrays.begin(), arrays.end(), array);
+      builder.add(it - arrays.begin());
+      if (it == arrays.end())
+        arrays.push_back(array);
+    }
+  }
+
+  /// Adds an array that is not part of an expression, e.g. an object whose
+  /// values are asked for.
+  static void add(KeyBuilder &builder, std::vector<const Array *> &arrays,
+                  const Array *array) {
+    Entry entry;
+    entry.key = getShape(array);
+    entry.arrays.push_back(array);
+    add(builder, arrays, entry);
+  }
+
+  const Entry &get(const ref<Expr> &e) {
+    auto it = exprs.find(e.get());
+    if (it != exprs.end())
+      return it->second.second;
+
+    Entry entry;
+    KeyBuilder builder;
+    builder.add(e->getKind()).add(e->getWidth());
+    if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+      addConstant(builder, ce);
+    } else if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      add(builder, entry.arrays, re->updates.root);
+      add(builder, entry.arrays, get(re->updates.head.get()));
+      add(builder, entry.arrays, get(re->index));
+    } else {
+      if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e))
+        builder.add(ee->offset);
+      for (unsigned i = 0, n = e->getNumKids(); i < n; ++i)
+        add(builder, entry.arrays, get(e->getKid(i)));
+    }
+    entry.key = builder.get();
+    return exprs.emplace(e.get(), std::make_pair(e, std::move(entry)))
+        .first->second.second;
+  }
+
+  /// Adds the constraints of a query, in an order that does not depend on
+  /// the order they were added in.
+  void add(KeyBuilder &builder, std::vector<const Array *> &arrays,
+           const ConstraintSet &constraints) {
+    if (exprs.size() > maxExprs) {
+      exprs.clear();
+      updates.clear();
+    }
+    std::vector<const Entry *> entries;
+    entries.reserve(constraints.size());
+    for (const ref<Expr> &constraint : constraints)
+      entries.push_back(&get(constraint));
+    // Constraints that only differ in their arrays keep their order, which
+    // at worst makes the same query miss under another order.
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry *a, const Entry *b) {
+                       return a->key < b->key;
+                     });
+    builder.add(entries.size());
+    for (const Entry *entry : entries)
+      add(builder, arrays, *entry);
+  }
+};
+
+/// An append-only file of query results, shared by concurrent processes.
+///
+/// Every record carries a checksum, so a record torn by a crash, or still
+/// being written by another process, is recognized and ends the valid part
+/// of the file. Readers map the file and index the valid records,
+/// re-scanning it when a lookup misses; later records of a key override
+/// earlier ones. Writers append under a POSIX record lock (which, unlike
+/// flock, also excludes forked children), overwriting any torn tail. The
+/// file never shrinks, so concurrent readers never access unmapped pages.
+class QueryResultFile {
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+  };
+
+  struct RecordHeader {
+    uint64_t checksum;
+    QueryKey key;
+    uint32_t kind;
+    uint32_t size;
+  };
+
+  static constexpr char magic[8] = {'K', 'L', 'E', 'E', 'Q', 'R', 'Y', 'C'};
+  static const uint32_t version = 2;
+
+  std::string path;
+  int fd = -1;
+  const char *base = nullptr;
+  size_t mapped = 0;
+
+  /// The end of the last valid record indexed so far.
+  size_t scanned = sizeof(FileHeader);
+
+  /// The offsets of the latest records of the keys.
+  std::unordered_map<QueryKey, size_t, QueryKeyHash> index;
+
+  bool failed = false;
+
+  static size_t padded(size_t size) { return (size + 7) & ~size_t(7); }
+
+  static uint64_t checksum(const RecordHeader &header, const char *payload) {
+    return KeyBuilder()
+        .add(header.key)
+        .add(header.kind)
+        .add(payload, header.size)
+        .get()
+        .lo;
+  }
+
+  /// POSIX record locks are held by the process, so writers in the same
+  /// process (e.g. the solver chains of -parallel-workers, each with their
+  /// own file) also take this lock.
+  static std::mutex &processLock() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  bool lock(short type) {
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &fl) == -1) {
+      if (errno != EINTR)
+        return false;
+    }
+    return true;
+  }
+
+  void fail(const char *what) {
+    klee_warning("query cache %s: %s: %s, disabling it", path.c_str(), what,
+                 strerror(errno));
+    failed = true;
+  }
+
+  /// Maps and indexes the records appended since the last refresh.
+  void refresh() {
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+      fail("cannot stat");
+      return;
+    }
+    size_t size = st.st_size;
+    if (size <= scanned)
+      return;
+    if (size > mapped) {
+      if (base)
+        munmap(const_cast<char *>(base), mapped);
+      void *memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+      if (memory == MAP_FAILED) {
+        base = nullptr;
+        mapped = 0;
+        fail("cannot map");
+        return;
+      }
+      base = static_cast<const char *>(memory);
+      mapped = size;
+    }
+    while (size - scanned >= sizeof(RecordHeader)) {
+      RecordHeader header;
+      memcpy(&header, base + scanned, sizeof(header));
+      const char *payload = base + scanned + sizeof(header);
+      if (header.size > size - scanned - sizeof(header) ||
+          padded(header.size) > size - scanned - sizeof(header) ||
+          checksum(header, payload) != header.checksum)
+        break;
+      index[header.key] = scanned;
+      scanned += sizeof(header) + padded(header.size);
+    }
+  }
+
+public:
+  ~QueryResultFile() {
+    if (base)
+      munmap(const_cast<char *>(base), mapped);
+    if (fd != -1)
+      close(fd);
+  }
+
+  bool open(const std::string &_path) {
+    path = _path;
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+      klee_warning("cannot open query cache %s: %s", path.c_str(),
+                   strerror(errno));
+      return false;
+    }
+
+    std::unique_lock<std::mutex> guard(processLock());
+    if (!lock(F_WRLCK)) {
+      fail("cannot lock");
+      return false;
+    }
+    FileHeader header;
+    ssize_t n = pread(fd, &header, sizeof(header), 0);
+    if (n == 0) {
+      memcpy(header.magic, magic, sizeof(magic));
+      header.version = version;
+      header.reserved = 0;
+      n = pwrite(fd, &header, sizeof(header), 0);
+    }
+    lock(F_UNLCK);
+    guard.unlock();
+    if (n != sizeof(header) || memcmp(header.magic, magic, sizeof(magic)) ||
+        header.version != version) {
+      klee_warning("%s is not a query cache of this version of KLEE, "
+                   "ignoring it",
+                   path.c_str());
+      return false;
+    }
+
+    refresh();
+    return !failed;
+  }
+
+  size_t size() const { return index.size(); }
+
+  /// Looks up the latest record of `key`. The payload stays valid until
+  /// the next lookup.
+  bool lookup(const QueryKey &key, uint32_t kind, const char *&payload,
+              size_t &size) {
+    if (failed)
+      return false;
+    auto it = index.find(key);
+    if (it == index.end()) {
+      refresh();
+      it = index.find(key);
+      if (it == index.end() || failed)
+        return false;
+    }
+    RecordHeader header;
+    memcpy(&header, base + it->second, sizeof(header));
+    if (header.kind != kind)
+      return false;
+    payload = base + it->second + sizeof(header);
+    size = header.size;
+    return true;
+  }
+
+  void insert(const QueryKey &key, uint32_t kind,
+              const std::vector<char> &payload) {
+    if (failed)
+      return;
+    std::vector<char> record(sizeof(RecordHeader) + padded(payload.size()));
+    RecordHeader header;
+    header.key = key;
+    header.kind = kind;
+    header.size = payload.size();
+    std::copy(payload.begin(), payload.end(),
+              record.begin() + sizeof(header));
+    header.checksum = checksum(header, record.data() + sizeof(header));
+    memcpy(record.data(), &header, sizeof(header));
+
+    std::lock_guard<std::mutex> guard(processLock());
+    if (!lock(F_WRLCK)) {
+      fail("cannot lock");
+      return;
+    }
+    // Append after the records of the other writers.
+    refresh();
+    size_t offset = scanned, written = 0;
+    while (!failed && written < record.size()) {
+      ssize_t n = pwrite(fd, record.data() + written, record.size() - written,
+                         offset + written);
+      if (n == -1 && errno != EINTR)
+        fail("cannot write");
+      else if (n > 0)
+        written += n;
+    }
+    lock(F_UNLCK);
+  }
+};
+
+constexpr char QueryResultFile::magic[8];
+
+class PersistentCachingSolver : public SolverImpl {
+private:
+  enum RecordKind : uint32_t { Validity = 1, Value = 2, InitialValues = 3 };
+
+  Solver *solver;
+  std::unique_ptr<QueryResultFile> file;
+  ExprKeys keys;
+
+  QueryKey validityKey(const Query &query, bool &negationUsed);
+  bool cacheLookup(const Query &query,
+                   IncompleteSolver::PartialValidity &result);
+  void cacheInsert(const Query &query,
+                   IncompleteSolver::PartialValidity result);
+
+public:
+  PersistentCachingSolver(Solver *s, std::unique_ptr<QueryResultFile> f)
+      : solver(s), file(std::move(f)) {}
+  ~PersistentCachingSolver() { delete solver; }
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &query, ref<Expr> &result);
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(time::Span timeout);
+};
+
+/// Like the branch cache, validity results are stored for the smaller of
+/// the query and its negation, here by key so that the choice is the same
+/// in every run.
+QueryKey PersistentCachingSolver::validityKey(const Query &query,
+                                              bool &negationUsed) {
+  KeyBuilder builder;
+  std::vector<const Array *> arrays;
+  builder.add(Validity);
+  keys.add(builder, arrays, query.constraints);
+  KeyBuilder negatedBuilder = builder;
+  std::vector<const Array *> negatedArrays = arrays;
+  ExprKeys::add(builder, arrays, keys.get(query.expr));
+  ExprKeys::add(negatedBuilder, negatedArrays,
+                keys.get(Expr::createIsZero(query.expr)));
+  QueryKey original = builder.get(), negated = negatedBuilder.get();
+  negationUsed = negated < original;
+  return negationUsed ? negated : original;
+}
+
+bool PersistentCachingSolver::cacheLookup(
+    const Query &query, IncompleteSolver::PartialValidity &result) {
+  bool negationUsed;
+  QueryKey key = validityKey(query, negationUsed);
+  const char *payload;
+  size_t size;
+  if (!file->lookup(key, Validity, payload, size) || size != sizeof(int32_t))
+    return false;
+  int32_t value;
+  memcpy(&value, payload, sizeof(value));
+  switch (value) {
+  case IncompleteSolver::MustBeTrue:
+  case IncompleteSolver::MustBeFalse:
+  case IncompleteSolver::MayBeTrue:
+  case IncompleteSolver::MayBeFalse:
+  case IncompleteSolver::TrueOrFalse:
+    break;
+  default:
+    return false;
+  }
+  auto cached = static_cast<IncompleteSolver::PartialValidity>(value);
+  result = negationUsed ? IncompleteSolver::negatePartialValidity(cached)
+                        : cached;
+  return true;
+}
+
+void PersistentCachingSolver::cacheInsert(
+    const Query &query, IncompleteSolver::PartialValidity result) {
+  bool negationUsed;
+  QueryKey key = validityKey(query, negationUsed);
+  int32_t value = negationUsed ? IncompleteSolver::negatePartialValidity(result)
+                               : result;
+  std::vector<char> payload(sizeof(value));
+  memcpy(payload.data(), &value, sizeof(value));
+  file->insert(key, Validity, payload);
+}
+
+bool PersistentCachingSolver::computeValidity(const Query &query,
+                                              Solver::Validity &result) {
+  IncompleteSolver::PartialValidity cachedResult;
+  bool tmp, cacheHit = cacheLookup(query, cachedResult);
+
+  if (cacheHit) {
+    switch (cachedResult) {
+    case IncompleteSolver::MustBeTrue:
+      result = Solver::True;
+      ++stats::queryPersistentCacheHits;
+      return true;
+    case IncompleteSolver::MustBeFalse:
+      result = Solver::False;
+      ++stats::queryPersistentCacheHits;
+      return true;
+    case IncompleteSolver::TrueOrFalse:
+      result = Solver::Unknown;
+      ++stats::queryPersistentCacheHits;
+      return true;
+    case IncompleteSolver::MayBeTrue: {
+      ++stats::queryPersistentCacheMisses;
+      if (!solver->impl->computeTruth(query, tmp))
+        return false;
+      cachedResult =
+          tmp ? IncompleteSolver::MustBeTrue : IncompleteSolver::TrueOrFalse;
+      result = tmp ? Solver::True : Solver::Unknown;
+      cacheInsert(query, cachedResult);
+      return true;
+    }
+    case IncompleteSolver::MayBeFalse: {
+      ++stats::queryPersistentCacheMisses;
+      if (!solver->impl->computeTruth(query.negateExpr(), tmp))
+        return false;
+      cachedResult =
+          tmp ? IncompleteSolver::MustBeFalse : IncompleteSolver::TrueOrFalse;
+      result = tmp ? Solver::False : Solver::Unknown;
+      cacheInsert(query, cachedResult);
+      return true;
+    }
+    default:
+      assert(0 && "unreachable");
+    }
+  }
+
+  ++stats::queryPersistentCacheMisses;
+
+  if (!solver->impl->computeValidity(query, result))
+    return false;
+
+  switch (result) {
+  case Solver::True:
+    cachedResult = IncompleteSolver::MustBeTrue;
+    break;
+  case Solver::False:
+    cachedResult = IncompleteSolver::MustBeFalse;
+    break;
+  default:
+    cachedResult = IncompleteSolver::TrueOrFalse;
+    break;
+  }
+
+  cacheInsert(query, cachedResult);
+  return true;
+}
+
+bool PersistentCachingSolver::computeTruth(const Query &query, bool &isValid) {
+  IncompleteSolver::PartialValidity cachedResult;
+  bool cacheHit = cacheLookup(query, cachedResult);
+
+  // a cached result of MayBeTrue forces us to check whether
+  // a False assignment exists.
+  if (cacheHit && cachedResult != IncompleteSolver::MayBeTrue) {
+    ++stats::queryPersistentCacheHits;
+    isValid = (cachedResult == IncompleteSolver::MustBeTrue);
+    return true;
+  }
+
+  ++stats::queryPersistentCacheMisses;
+
+  if (!solver->impl->computeTruth(query, isValid))
+    return false;
+
+  if (isValid)
+    cachedResult = IncompleteSolver::MustBeTrue;
+  else if (cacheHit)
+    cachedResult = IncompleteSolver::TrueOrFalse;
+  else
+    cachedResult = IncompleteSolver::MayBeFalse;
+
+  cacheInsert(query, cachedResult);
+  return true;
+}
+
+bool PersistentCachingSolver::computeValue(const Query &query,
+                                           ref<Expr> &result) {
+  Expr::Width width = query.expr->getWidth();
+  if (width > 64) {
+    ++stats::queryPersistentCacheMisses;
+    return solver->impl->computeValue(query, result);
+  }
+
+  KeyBuilder builder;
+  std::vector<const Array *> arrays;
+  builder.add(Value);
+  keys.add(builder, arrays, query.constraints);
+  ExprKeys::add(builder, arrays, keys.get(query.expr));
+  QueryKey key = builder.get();
+  const char *payload;
+  size_t size;
+  if (file->lookup(key, Value, payload, size) && size == sizeof(uint64_t)) {
+    uint64_t value;
+    memcpy(&value, payload, sizeof(value));
+    result = ConstantExpr::create(value, width);
+    ++stats::queryPersistentCacheHits;
+    return true;
+  }
+
+  ++stats::queryPersistentCacheMisses;
+  if (!solver->impl->computeValue(query, result))
+    return false;
+  if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(result)) {
+    uint64_t value = ce->getZExtValue();
+    std::vector<char> bytes(sizeof(value));
+    memcpy(bytes.data(), &value, sizeof(value));
+    file->insert(key, Value, bytes);
+  }
+  return true;
+}
+
+bool PersistentCachingSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
+  KeyBuilder builder;
+  std::vector<const Array *> arrays;
+  builder.add(InitialValues);
+  keys.add(builder, arrays, query.constraints);
+  ExprKeys::add(builder, arrays, keys.get(query.expr));
+  builder.add(objects.size());
+  size_t total = 0;
+  for (const Array *array : objects) {
+    ExprKeys::add(builder, arrays, array);
+    total += array->size;
+  }
+  QueryKey key = builder.get();
+
+  // The payload is a byte telling whether there is a solution, followed by
+  // the values of the objects if there is.
+  const char *payload;
+  size_t size;
+  if (file->lookup(key, InitialValues, payload, size) && size >= 1 &&
+      size == 1 + (payload[0] ? total : 0)) {
+    hasSolution = payload[0];
+    if (hasSolution) {
+      const char *bytes = payload + 1;
+      for (const Array *array : objects) {
+        values.push_back(std::vector<unsigned char>(bytes, bytes + array->size));
+        bytes += array->size;
+      }
+    }
+    ++stats::queryPersistentCacheHits;
+    return true;
+  }
+
+  ++stats::queryPersistentCacheMisses;
+  if (!solver->impl->computeInitialValues(query, objects, values, hasSolution))
+    return false;
+  std::vector<char> bytes(1, hasSolution);
+  if (hasSolution) {
+    for (const std::vector<unsigned char> &value : values)
+      bytes.insert(bytes.end(), value.begin(), value.end());
+  }
+  if (bytes.size() == 1 + (hasSolution ? total : 0))
+    file->insert(key, InitialValues, bytes);
+  return true;
+}
+
+SolverImpl::SolverRunStatus PersistentCachingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *PersistentCachingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void PersistentCachingSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+} // namespace
+
+///
+
+Solver *klee::createPersistentCachingSolver(Solver *s,
+                                            const std::string &path) {
+  std::unique_ptr<QueryResultFile> file(new QueryResultFile());
+  if (!file->open(path))
+    return s;
+  return new Solver(new PersistentCachingSolver(s, std::move(file)));
+}
@@ -56,6 +56,13 @@ cl::opt<bool>
                          cl::desc("Use constraint independence (default=true)"),
                          cl::cat(SolvingCat));
 
+cl::opt<std::string> QueryCacheFile(
+    "query-cache-file",
+    cl::desc("Cache the results of queries reaching the core solver in the "
+             "given file, and reuse the results cached there by earlier or "
+             "concurrent runs (default=off)"),
+    cl::value_desc("path"), cl::cat(SolvingCat));
+
 cl::opt<bool> DebugValidateSolver(
     "debug-validate-solver", cl::init(false),
     cl::desc("Crosscheck the results of the solver chain above the core solver "
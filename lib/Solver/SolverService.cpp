@@ -0,0 +1,103 @@
+//===-- SolverService.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/SolverService.h"
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Support/Timer.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+using namespace klee;
+
+/// Forwards the queries of one client to the shared chain.
+class SolverService::Client : public SolverImpl {
+  SolverService &service;
+  ClientStats &stats;
+  time::Span timeout;
+  SolverRunStatus status = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+
+  /// Runs `query` on the shared chain with the timeout of the client, and
+  /// counts it as a cache hit if the core solver was not involved.
+  template <typename Fn> bool run(Fn query) {
+    WallTimer timer;
+    std::uint64_t coreQueries = stats::queries;
+    Solver &solver = *service.solver;
+    solver.setCoreSolverTimeout(timeout);
+    bool success = query(*solver.impl);
+    status = solver.impl->getOperationStatusCode();
+    ++stats.queries;
+    if (stats::queries == coreQueries)
+      ++stats.cacheHits;
+    stats.time += timer.delta();
+    return success;
+  }
+
+public:
+  Client(SolverService &service, ClientStats &stats)
+      : service(service), stats(stats) {}
+
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    return run([&](SolverImpl &s) { return s.computeValidity(query, result); });
+  }
+  bool computeTruth(const Query &query, bool &isValid) {
+    return run([&](SolverImpl &s) { return s.computeTruth(query, isValid); });
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    return run([&](SolverImpl &s) { return s.computeValue(query, result); });
+  }
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution) {
+    return run([&](SolverImpl &s) {
+      return s.computeInitialValues(query, objects, values, hasSolution);
+    });
+  }
+  SolverRunStatus getOperationStatusCode() { return status; }
+  char *getConstraintLog(const Query &query) {
+    return service.solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span t) { timeout = t; }
+};
+
+SolverService::SolverService(Solver *solver) : solver(solver) {}
+
+SolverService::~SolverService() = default;
+
+std::unique_ptr<SolverService> SolverService::create(Solver *coreSolver) {
+  Solver *solver = createCexCachingSolver(coreSolver);
+  solver = createCachingSolver(solver);
+  solver = createIndependentSolver(solver);
+  return std::unique_ptr<SolverService>(new SolverService(solver));
+}
+
+Solver *SolverService::createClient(const std::string &name) {
+  clients.emplace_back();
+  clients.back().name = name;
+  return new Solver(new Client(*this, clients.back()));
+}
+
+std::vector<SolverService::ClientStats> SolverService::getClientStats() const {
+  return std::vector<ClientStats>(clients.begin(), clients.end());
+}
+
+void SolverService::printClientStats(llvm::raw_ostream &os,
+                                     const char *prefix) const {
+  for (const ClientStats &client : getClientStats()) {
+    os << prefix << "solver client " << client.name << ": queries = " << client.queries
+       << ", cache hits = " << client.cacheHits << " ("
+       << (client.queries ? 100 * client.cacheHits / client.queries : 0)
+       << "%), time = " << client.time << "\n";
+  }
+}
@@ -12,6 +12,14 @@
 using namespace klee;
 
 Statistic stats::cexCacheTime("CexCacheTime", "CCtime");
+Statistic stats::independentConstraintsIndexed("IndependentConstraintsIndexed",
+                                                "ICindexed");
+Statistic stats::independentConstraintsReused("IndependentConstraintsReused",
+                                               "ICreused");
+Statistic stats::independentPartitionHits("IndependentPartitionHits",
+                                           "IPhits");
+Statistic stats::independentPartitionMisses("IndependentPartitionMisses",
+                                             "IPmisses");
 Statistic stats::queries("Queries", "Q");
 Statistic stats::queriesInvalid("QueriesInvalid", "Qiv");
 Statistic stats::queriesValid("QueriesValid", "Qv");
@@ -19,9 +27,15 @@ Statistic stats::queryCacheHits("QueryCacheHits", "QChits") ;
 Statistic stats::queryCacheMisses("QueryCacheMisses", "QCmisses");
 Statistic stats::queryCexCacheHits("QueryCexCacheHits", "QCexHits") ;
 Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
+Statistic stats::queryPersistentCacheHits("QueryPersistentCacheHits",
+                                           "QPChits");
+Statistic stats::queryPersistentCacheMisses("QueryPersistentCacheMisses",
+                                             "QPCmisses");
 Statistic stats::queryConstructs("QueryConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
 Statistic stats::queryTime("QueryTime", "Qtime");
+Statistic stats::z3IncrementalFallbacks("Z3IncrementalFallbacks", "Z3Ifb");
+Statistic stats::z3IncrementalReused("Z3IncrementalReused", "Z3Ireused");
 
 #ifdef KLEE_ARRAY_DEBUG
 Statistic stats::arrayHashTime("ArrayHashTime", "AHtime");
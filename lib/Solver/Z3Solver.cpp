@@ -25,6 +25,8 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+
 namespace {
 // NOTE: Very useful for debugging Z3 behaviour. These files can be given to
 // the z3 binary to replay all Z3 API calls using its `-log` option.
@@ -43,6 +45,15 @@ llvm::cl::opt<bool> Z3ValidateModels(
     llvm::cl::desc("When generating Z3 models validate these against the query"),
     llvm::cl::cat(klee::SolvingCat));
 
+llvm::cl::opt<bool> Z3Incremental(
+    "z3-incremental", llvm::cl::init(false),
+    llvm::cl::desc("Keep one Z3 solver across queries and only assert the "
+                   "constraints that are not shared with the previous query, "
+                   "using push/pop. Queries the kept solver gives up on are "
+                   "retried with a fresh solver, within the remaining "
+                   "timeout (default=false)"),
+    llvm::cl::cat(klee::SolvingCat));
+
 llvm::cl::opt<unsigned>
     Z3VerbosityLevel("debug-z3-verbosity", llvm::cl::init(0),
                      llvm::cl::desc("Z3 verbosity level (default=0)"),
@@ -63,10 +74,26 @@ private:
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
 
+  // Incremental mode: the solver kept across queries and the constraints
+  // asserted in it, each one in its own push scope.
+  ::Z3_solver incrementalSolver;
+  std::vector<ref<Expr> > assertedConstraints;
+
   bool internalRunSolver(const Query &,
                          const std::vector<const Array *> *objects,
                          std::vector<std::vector<unsigned char> > *values,
                          bool &hasSolution);
+  // Run the query in a new solver, respectively in the incremental one, and
+  // set runStatusCode. Statistics are counted by internalRunSolver.
+  void internalRunFreshSolver(const Query &,
+                              const std::vector<const Array *> *objects,
+                              std::vector<std::vector<unsigned char> > *values,
+                              bool &hasSolution, ::Z3_params parameters);
+  void internalRunIncrementalSolver(
+      const Query &, const std::vector<const Array *> *objects,
+      std::vector<std::vector<unsigned char> > *values, bool &hasSolution);
+  void resetIncrementalSolver();
+  void assertExpr(::Z3_solver theSolver, const ref<Expr> &e, bool negate);
   bool validateZ3Model(::Z3_solver &theSolver, ::Z3_model &theModel);
 
 public:
@@ -76,11 +103,15 @@ public:
   char *getConstraintLog(const Query &);
   void setCoreSolverTimeout(time::Span _timeout) {
     timeout = _timeout;
+    setTimeoutParameter(solverParameters, timeout);
+  }
 
+  // A zero timeout means none.
+  void setTimeoutParameter(::Z3_params parameters, time::Span timeout) {
     auto timeoutInMilliSeconds = static_cast<unsigned>((timeout.toMicroseconds() / 1000));
     if (!timeoutInMilliSeconds)
       timeoutInMilliSeconds = UINT_MAX;
-    Z3_params_set_uint(builder->ctx, solverParameters, timeoutParamStrSymbol,
+    Z3_params_set_uint(builder->ctx, parameters, timeoutParamStrSymbol,
                        timeoutInMilliSeconds);
   }
 
@@ -104,7 +135,7 @@ Z3SolverImpl::Z3SolverImpl()
           /*z3LogInteractionFileArg=*/Z3LogInteractionFile.size() > 0
               ? Z3LogInteractionFile.c_str()
               : NULL)),
-      runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+      runStatusCode(SOLVER_RUN_STATUS_FAILURE), incrementalSolver(NULL) {
   assert(builder && "unable to create Z3Builder");
   solverParameters = Z3_mk_params(builder->ctx);
   Z3_params_inc_ref(builder->ctx, solverParameters);
@@ -132,6 +163,7 @@ Z3SolverImpl::Z3SolverImpl()
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  resetIncrementalSolver();
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
@@ -244,20 +276,158 @@ bool Z3SolverImpl::computeInitialValues(
   return internalRunSolver(query, &objects, &values, hasSolution);
 }
 
+void Z3SolverImpl::resetIncrementalSolver() {
+  if (incrementalSolver)
+    Z3_solver_dec_ref(builder->ctx, incrementalSolver);
+  incrementalSolver = NULL;
+  assertedConstraints.clear();
+}
+
+void Z3SolverImpl::assertExpr(::Z3_solver theSolver, const ref<Expr> &e,
+                              bool negate) {
+  Z3ASTHandle z3Expr = Z3ASTHandle(builder->construct(e), builder->ctx);
+  if (negate)
+    z3Expr = Z3ASTHandle(Z3_mk_not(builder->ctx, z3Expr), builder->ctx);
+  Z3_solver_assert(builder->ctx, theSolver, z3Expr);
+
+  ConstantArrayFinder constant_arrays_in_expr;
+  constant_arrays_in_expr.visit(e);
+  for (auto const &constant_array : constant_arrays_in_expr.results) {
+    assert(builder->constant_array_assertions.count(constant_array) == 1 &&
+           "Constant array found in query, but not handled by Z3Builder");
+    for (auto const &arrayIndexValueExpr :
+         builder->constant_array_assertions[constant_array]) {
+      Z3_solver_assert(builder->ctx, theSolver, arrayIndexValueExpr);
+    }
+  }
+}
+
+void Z3SolverImpl::internalRunIncrementalSolver(
+    const Query &query, const std::vector<const Array *> *objects,
+    std::vector<std::vector<unsigned char> > *values, bool &hasSolution) {
+  if (!incrementalSolver) {
+    incrementalSolver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, incrementalSolver);
+  }
+  // The timeout may have changed since the previous query.
+  Z3_solver_set_params(builder->ctx, incrementalSolver, solverParameters);
+
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  // Keep the longest prefix of the asserted constraints that the query
+  // shares, and only assert the rest.
+  size_t common = 0;
+  auto ci = query.constraints.begin(), ce = query.constraints.end();
+  while (common < assertedConstraints.size() && ci != ce &&
+         assertedConstraints[common] == *ci) {
+    ++common;
+    ++ci;
+  }
+  if (common < assertedConstraints.size()) {
+    Z3_solver_pop(builder->ctx, incrementalSolver,
+                  assertedConstraints.size() - common);
+    assertedConstraints.resize(common);
+  }
+  stats::z3IncrementalReused += common;
+  for (; ci != ce; ++ci) {
+    Z3_solver_push(builder->ctx, incrementalSolver);
+    assertExpr(incrementalSolver, *ci, /*negate=*/false);
+    assertedConstraints.push_back(*ci);
+  }
+
+  // KLEE Queries are validity queries, see internalRunSolver().
+  Z3_solver_push(builder->ctx, incrementalSolver);
+  assertExpr(incrementalSolver, query.expr, /*negate=*/true);
+
+  if (dumpedQueriesFile) {
+    *dumpedQueriesFile << "; start Z3 query\n";
+    *dumpedQueriesFile << Z3_solver_to_string(builder->ctx, incrementalSolver);
+    *dumpedQueriesFile << "(check-sat)\n";
+    *dumpedQueriesFile << "(reset)\n";
+    *dumpedQueriesFile << "; end Z3 query\n\n";
+    dumpedQueriesFile->flush();
+  }
+
+  ::Z3_lbool satisfiable = Z3_solver_check(builder->ctx, incrementalSolver);
+  runStatusCode = handleSolverResponse(incrementalSolver, satisfiable, objects,
+                                       values, hasSolution);
+
+  Z3_solver_pop(builder->ctx, incrementalSolver, 1);
+  builder->clearConstructCache();
+
+  // Z3 may have given up because of the state accumulated in the solver,
+  // so start over from an empty one.
+  if (runStatusCode != SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE &&
+      runStatusCode != SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE)
+    resetIncrementalSolver();
+}
+
 bool Z3SolverImpl::internalRunSolver(
     const Query &query, const std::vector<const Array *> *objects,
     std::vector<std::vector<unsigned char> > *values, bool &hasSolution) {
 
   TimerStatIncrementer t(stats::queryTime);
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  if (!Z3Incremental) {
+    internalRunFreshSolver(query, objects, values, hasSolution,
+                           solverParameters);
+  } else {
+    internalRunIncrementalSolver(query, objects, values, hasSolution);
+    if (runStatusCode != SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE &&
+        runStatusCode != SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
+      // Retry with a fresh solver, within what is left of the timeout. If
+      // the incremental solver used it up, its status stands.
+      time::Span elapsed = t.delta();
+      if (!timeout || elapsed < timeout) {
+        ++stats::z3IncrementalFallbacks;
+        if (values)
+          values->clear();
+        if (!timeout) {
+          internalRunFreshSolver(query, objects, values, hasSolution,
+                                 solverParameters);
+        } else {
+          ::Z3_params parameters = Z3_mk_params(builder->ctx);
+          Z3_params_inc_ref(builder->ctx, parameters);
+          setTimeoutParameter(parameters, std::max(timeout - elapsed,
+                                                   time::milliseconds(1)));
+          internalRunFreshSolver(query, objects, values, hasSolution,
+                                 parameters);
+          Z3_params_dec_ref(builder->ctx, parameters);
+        }
+      }
+    }
+  }
+
+  ++stats::queries;
+  if (objects)
+    ++stats::queryCounterexamples;
+  if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
+      runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
+    if (hasSolution) {
+      ++stats::queriesInvalid;
+    } else {
+      ++stats::queriesValid;
+    }
+    return true; // success
+  }
+  return false; // failed
+}
+
+void Z3SolverImpl::internalRunFreshSolver(
+    const Query &query, const std::vector<const Array *> *objects,
+    std::vector<std::vector<unsigned char> > *values, bool &hasSolution,
+    ::Z3_params parameters) {
   // NOTE: Z3 will switch to using a slower solver internally if push/pop are
   // used so for now it is likely that creating a new solver each time is the
-  // right way to go until Z3 changes its behaviour.
+  // right way to go until Z3 changes its behaviour. -z3-incremental trades
+  // this for not re-asserting the constraints shared between queries.
   //
   // TODO: Investigate using a custom tactic as described in
   // https://github.com/klee/klee/issues/653
   Z3_solver theSolver = Z3_mk_solver(builder->ctx);
   Z3_solver_inc_ref(builder->ctx, theSolver);
-  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+  Z3_solver_set_params(builder->ctx, theSolver, parameters);
 
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
 
@@ -266,9 +436,6 @@ bool Z3SolverImpl::internalRunSolver(
     Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
     constant_arrays_in_query.visit(constraint);
   }
-  ++stats::queries;
-  if (objects)
-    ++stats::queryCounterexamples;
 
   Z3ASTHandle z3QueryExpr =
       Z3ASTHandle(builder->construct(query.expr), builder->ctx);
@@ -312,17 +479,6 @@ bool Z3SolverImpl::internalRunSolver(
   // ``Query`` rather than only sharing within a single call to
   // ``builder->construct()``.
   builder->clearConstructCache();
-
-  if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
-      runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
-    if (hasSolution) {
-      ++stats::queriesInvalid;
-    } else {
-      ++stats::queriesValid;
-    }
-    return true; // success
-  }
-  return false; // failed
 }
 
 SolverImpl::SolverRunStatus Z3SolverImpl::handleSolverResponse(
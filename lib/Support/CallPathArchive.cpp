@@ -0,0 +1,213 @@
+//===-- CallPathArchive.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Support/CallPathArchive.h"
+
+#include "klee/Config/config.h"
+
+#include "llvm/Support/MemoryBuffer.h"
+
+#ifdef HAVE_ZLIB_H
+#include "klee/Support/CompressionStream.h"
+#include "zlib.h"
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace klee;
+
+static std::string indexPath(const std::string &path) { return path + ".idx"; }
+
+CallPathArchiveWriter::CallPathArchiveWriter(const std::string &path,
+                                             std::string &error)
+    : FD(-1), offset(0) {
+  error = "";
+#ifdef HAVE_ZLIB_H
+  FD = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (FD < 0) {
+    error = std::strerror(errno);
+    return;
+  }
+  off_t end = ::lseek(FD, 0, SEEK_END);
+  offset = end < 0 ? 0 : end;
+  index.open(indexPath(path), std::ios::app);
+  if (!index.is_open())
+    error = "unable to open " + indexPath(path);
+#else
+  error = "KLEE was built without zlib support";
+#endif
+}
+
+CallPathArchiveWriter::~CallPathArchiveWriter() {
+  if (FD >= 0)
+    ::close(FD);
+}
+
+bool CallPathArchiveWriter::append(const std::string &name,
+                                   const std::string &contents,
+                                   std::string &error) {
+#ifdef HAVE_ZLIB_H
+  {
+    compressed_fd_ostream os(FD, /*ShouldClose=*/false, error);
+    if (!error.empty())
+      return false;
+    os << contents;
+  }
+  off_t end = ::lseek(FD, 0, SEEK_END);
+  if (end < 0) {
+    error = std::strerror(errno);
+    return false;
+  }
+  // The index line is written only once the record is complete, so that an
+  // interrupted run leaves a consistent archive behind.
+  index << name << " " << offset << " " << (end - offset) << "\n";
+  index.flush();
+  offset = end;
+  return true;
+#else
+  error = "KLEE was built without zlib support";
+  return false;
+#endif
+}
+
+CallPathArchiveReader::CallPathArchiveReader(int FD,
+                                             std::vector<Record> records)
+    : FD(FD), records(std::move(records)) {
+  for (size_t i = 0; i < this->records.size(); ++i)
+    recordsByName[this->records[i].name] = i;
+}
+
+CallPathArchiveReader::~CallPathArchiveReader() {
+  if (FD >= 0)
+    ::close(FD);
+}
+
+bool CallPathArchiveReader::isArchive(const std::string &path) {
+  struct stat st;
+  return ::stat(indexPath(path).c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+std::unique_ptr<CallPathArchiveReader>
+CallPathArchiveReader::open(const std::string &path, std::string &error) {
+  std::ifstream index(indexPath(path));
+  if (!index.is_open()) {
+    error = "unable to open " + indexPath(path);
+    return nullptr;
+  }
+  std::vector<Record> records;
+  std::string line;
+  while (std::getline(index, line)) {
+    std::istringstream fields(line);
+    Record record;
+    if (!(fields >> record.name >> record.offset >> record.size)) {
+      error = "malformed index line: " + line;
+      return nullptr;
+    }
+    records.push_back(record);
+  }
+  int FD = ::open(path.c_str(), O_RDONLY);
+  if (FD < 0) {
+    error = std::strerror(errno);
+    return nullptr;
+  }
+  return std::unique_ptr<CallPathArchiveReader>(
+      new CallPathArchiveReader(FD, std::move(records)));
+}
+
+bool CallPathArchiveReader::read(const Record &record, std::string &contents,
+                                 std::string &error) const {
+#ifdef HAVE_ZLIB_H
+  std::vector<unsigned char> compressed(record.size);
+  size_t done = 0;
+  while (done < record.size) {
+    ssize_t ret = ::pread(FD, compressed.data() + done, record.size - done,
+                          record.offset + done);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0) {
+      error = ret < 0 ? std::strerror(errno) : "truncated archive";
+      return false;
+    }
+    done += ret;
+  }
+
+  z_stream strm;
+  std::memset(&strm, 0, sizeof(strm));
+  // 15 + 32: maximum window size, with automatic gzip header detection.
+  if (inflateInit2(&strm, 15 + 32) != Z_OK) {
+    error = "unable to initialise zlib";
+    return false;
+  }
+  strm.next_in = compressed.data();
+  strm.avail_in = compressed.size();
+  contents.clear();
+  std::vector<unsigned char> buffer(BUFSIZE);
+  int ret;
+  do {
+    strm.next_out = buffer.data();
+    strm.avail_out = buffer.size();
+    ret = inflate(&strm, Z_NO_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END) {
+      inflateEnd(&strm);
+      error = "corrupted record " + record.name;
+      return false;
+    }
+    contents.append(reinterpret_cast<char *>(buffer.data()),
+                    buffer.size() - strm.avail_out);
+  } while (ret != Z_STREAM_END);
+  inflateEnd(&strm);
+  return true;
+#else
+  error = "KLEE was built without zlib support";
+  return false;
+#endif
+}
+
+bool CallPathArchiveReader::read(const std::string &name,
+                                 std::string &contents,
+                                 std::string &error) const {
+  auto it = recordsByName.find(name);
+  if (it == recordsByName.end()) {
+    error = "no record named " + name;
+    return false;
+  }
+  return read(records[it->second], contents, error);
+}
+
+bool klee::readCallPathFile(const std::string &path, std::string &contents,
+                            std::string &error) {
+  static std::string lastArchivePath;
+  static std::unique_ptr<CallPathArchiveReader> lastArchive;
+
+  size_t delim = path.rfind(':');
+  if (delim != std::string::npos) {
+    std::string archivePath = path.substr(0, delim);
+    if (lastArchive && archivePath == lastArchivePath)
+      return lastArchive->read(path.substr(delim + 1), contents, error);
+    if (CallPathArchiveReader::isArchive(archivePath)) {
+      lastArchive = CallPathArchiveReader::open(archivePath, error);
+      lastArchivePath = lastArchive ? archivePath : "";
+      return lastArchive &&
+             lastArchive->read(path.substr(delim + 1), contents, error);
+    }
+  }
+
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    error = buffer.getError().message();
+    return false;
+  }
+  contents = (*buffer)->getBuffer().str();
+  return true;
+}
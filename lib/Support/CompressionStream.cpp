@@ -23,7 +23,7 @@ namespace klee {
 
 compressed_fd_ostream::compressed_fd_ostream(const std::string &Filename,
                                              std::string &ErrorInfo)
-    : llvm::raw_ostream(), pos(0) {
+    : llvm::raw_ostream(), ShouldClose(true), pos(0) {
   ErrorInfo = "";
   // Open file in binary mode
 #if LLVM_VERSION_CODE >= LLVM_VERSION(7, 0)
@@ -38,6 +38,17 @@ compressed_fd_ostream::compressed_fd_ostream(const std::string &Filename,
     FD = -1;
     return;
   }
+  init(ErrorInfo);
+}
+
+compressed_fd_ostream::compressed_fd_ostream(int FD, bool ShouldClose,
+                                             std::string &ErrorInfo)
+    : llvm::raw_ostream(), FD(FD), ShouldClose(ShouldClose), pos(0) {
+  ErrorInfo = "";
+  init(ErrorInfo);
+}
+
+void compressed_fd_ostream::init(std::string &ErrorInfo) {
   // Initialize the compression library
   strm.zalloc = Z_NULL;
   strm.zfree = Z_NULL;
@@ -82,7 +93,8 @@ compressed_fd_ostream::~compressed_fd_ostream() {
   if (FD >= 0) {
     // write the remaining data
     flush_compressed_data();
-    close(FD);
+    if (ShouldClose)
+      close(FD);
   }
   deflateEnd(&strm);
 }
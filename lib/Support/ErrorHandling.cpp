@@ -18,6 +18,7 @@
 #include <assert.h>
 #include <string.h>
 
+#include <mutex>
 #include <set>
 
 using namespace klee;
@@ -159,6 +160,7 @@ void klee::klee_warning(const char *msg, ...) {
 
 /* Prints a warning once per message. */
 void klee::klee_warning_once(const void *id, const char *msg, ...) {
+  static std::mutex lock;
   static std::set<std::pair<const void *, const char *> > keys;
   std::pair<const void *, const char *> key;
 
@@ -170,8 +172,9 @@ void klee::klee_warning_once(const void *id, const char *msg, ...) {
   else
     key = std::make_pair(id, "calling external");
 
-  if (!keys.count(key)) {
-    keys.insert(key);
+  std::unique_lock<std::mutex> guard(lock);
+  if (keys.insert(key).second) {
+    guard.unlock();
     va_list ap;
     va_start(ap, msg);
     klee_vmessage(warningOncePrefix, WarningsOnlyToFile, msg, ap);
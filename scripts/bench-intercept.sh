@@ -0,0 +1,36 @@
+#!/bin/bash
+# Time intercepted and plain memory accesses with
+# examples/intercept-bench/intercept-bench.c.
+# Usage: bench-intercept.sh [klee-build-dir] [iterations] [extra klee args...]
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+KLEE_SRC=$(dirname $SCRIPT_DIR)
+BUILD_DIR=${1:-$KLEE_SRC/build}
+ITERATIONS=${2:-100000}
+shift $(( $# < 2 ? $# : 2 ))
+KLEE=$BUILD_DIR/bin/klee
+SRC=$KLEE_SRC/examples/intercept-bench/intercept-bench.c
+OUT_DIR=$(mktemp -d)
+
+run_timed() {
+      local start=$(date +%s.%N)
+      "$@" > /dev/null 2>&1
+      local status=$?
+      local end=$(date +%s.%N)
+      printf "%.3f" $(echo "$end - $start" | bc)
+      [ $status -eq 0 ] || printf " (exit %d)" $status
+}
+
+printf "%-20s %12s\n" variant time
+
+for variant in intercepted plain; do
+      flags="-DITERATIONS=$ITERATIONS"
+      [ $variant == plain ] && flags="$flags -DPLAIN"
+      bc=$OUT_DIR/$variant.bc
+      clang -emit-llvm -c -g -O0 -Xclang -disable-O0-optnone $flags \
+            -I$KLEE_SRC/include $SRC -o $bc || continue
+      t=$(run_timed $KLEE -output-dir=$OUT_DIR/$variant-out "$@" $bc)
+      printf "%-20s %12s\n" $variant "$t"
+done
+
+rm -rf $OUT_DIR
@@ -0,0 +1,63 @@
+#!/bin/bash
+# Time -parallel-workers with 1, 2, 4 and 8 worker threads on the examples,
+# and check that every run generates the same tests and call paths. Tests
+# only match where the paths have a single solution.
+# Usage: bench-parallel.sh [klee-build-dir] [extra klee args...]
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+KLEE_SRC=$(dirname $SCRIPT_DIR)
+BUILD_DIR=${1:-$KLEE_SRC/build}
+shift
+KLEE=$BUILD_DIR/bin/klee
+KTEST_TOOL=$BUILD_DIR/bin/ktest-tool
+OUT_DIR=$(mktemp -d)
+WORKERS="1 2 4 8"
+
+run_timed() {
+      local start=$(date +%s.%N)
+      "$@" > /dev/null 2>&1
+      local status=$?
+      local end=$(date +%s.%N)
+      printf "%.3f" $(echo "$end - $start" | bc)
+      [ $status -eq 0 ] || printf " (exit %d)" $status
+}
+
+# The tests and call paths of a run, independently of their names and of
+# the order in which the workers generated them.
+test_digest() {
+      {
+            for t in $1/*.ktest; do
+                  $KTEST_TOOL $t | grep -v "^ktest file"
+            done
+            cat $1/*.call_path 2>/dev/null
+      } | sort | md5sum | cut -d' ' -f1
+}
+
+printf "%-20s" benchmark
+for n in $WORKERS; do printf " %12s" "$n worker(s)"; done
+printf " %8s\n" same
+
+for src in $KLEE_SRC/examples/get_sign/get_sign.c \
+           $KLEE_SRC/examples/regexp/Regexp.c \
+           $KLEE_SRC/examples/sort/sort.c \
+           $KLEE_SRC/examples/loop-invariant/1loop.c; do
+      [ -f $src ] || continue
+      bc=$OUT_DIR/$(basename $src .c).bc
+      clang -emit-llvm -c -g -O0 -Xclang -disable-O0-optnone \
+            -I$KLEE_SRC/include $src -o $bc || continue
+      printf "%-20s" $(basename $src .c)
+      same=yes
+      reference=
+      for n in $WORKERS; do
+            out=$OUT_DIR/$(basename $src .c)-$n
+            t=$(run_timed $KLEE -output-dir=$out -solver-backend=z3 \
+                  -dump-call-traces -parallel-workers=$n "$@" $bc)
+            printf " %12s" "$t"
+            digest=$(test_digest $out)
+            [ -z "$reference" ] && reference=$digest
+            [ "$digest" == "$reference" ] || same=no
+      done
+      printf " %8s\n" $same
+done
+
+rm -rf $OUT_DIR
@@ -0,0 +1,47 @@
+#!/bin/bash
+# Compare Z3 with and without -z3-incremental on the solver regression
+# queries and on the loop-invariant examples.
+# Usage: bench-z3-incremental.sh [klee-build-dir] [extra klee args...]
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+KLEE_SRC=$(dirname $SCRIPT_DIR)
+BUILD_DIR=${1:-$KLEE_SRC/build}
+shift
+KLEE=$BUILD_DIR/bin/klee
+KLEAVER=$BUILD_DIR/bin/kleaver
+OUT_DIR=$(mktemp -d)
+
+run_timed() {
+      local start=$(date +%s.%N)
+      "$@" > /dev/null 2>&1
+      local status=$?
+      local end=$(date +%s.%N)
+      awk -v s=$start -v e=$end 'BEGIN { printf "%.3f", e - s }'
+      [ $status -eq 0 ] || printf " (exit %d)" $status
+}
+
+printf "%-50s %12s %12s\n" benchmark fresh incremental
+
+for q in $KLEE_SRC/test/Solver/*.kquery; do
+      fresh=$(run_timed $KLEAVER -solver-backend=z3 $q)
+      incr=$(run_timed $KLEAVER -solver-backend=z3 -z3-incremental $q)
+      printf "%-50s %12s %12s\n" $(basename $q) "$fresh" "$incr"
+done
+
+for src in $KLEE_SRC/test/Feature/LoopInvariant/*.c \
+           $KLEE_SRC/examples/loop-invariant/1loop.c; do
+      [ -f $src ] || continue
+      bc=$OUT_DIR/$(basename $src .c).bc
+      clang -emit-llvm -c -g -O0 -Xclang -disable-O0-optnone \
+            -I$KLEE_SRC/include $src -o $bc || continue
+      for mode in fresh incremental; do
+            flags="-solver-backend=z3"
+            [ $mode == incremental ] && flags="$flags -z3-incremental"
+            rm -rf $OUT_DIR/$mode
+            t=$(run_timed $KLEE $flags -output-dir=$OUT_DIR/$mode "$@" $bc)
+            eval ${mode}_t=\"$t\"
+      done
+      printf "%-50s %12s %12s\n" $(basename $src) "$fresh_t" "$incremental_t"
+done
+
+rm -rf $OUT_DIR
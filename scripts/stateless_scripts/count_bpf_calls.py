@@ -20,8 +20,8 @@ def main():
                     if file.endswith(".call_path"):
                         file_name = file.replace(
                             '.call_path', '')
-                        lines = f.readlines()
-                        num_calls = lines[len(lines)-1].rstrip()
+                        lines = [l.rstrip() for l in f.readlines()]
+                        num_calls = lines[lines.index(";;-- BPF Calls --") + 1]
                         op.write(file_name+","+num_calls+"\n")
 
 
@@ -6,6 +6,13 @@ TRACE_DIR=${1:-klee-last}
 
 SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 
+# With PIN_TRACE_BINARY=1, trace to the binary format and convert it after
+# every run, which is much faster on long runs.
+PIN_TRACE_FLAGS=""
+if [ "${PIN_TRACE_BINARY:-0}" = "1" ]; then
+  PIN_TRACE_FLAGS="-binary"
+fi
+
 for KTEST in $TRACE_DIR/*.ktest; do
   TRACE="${KTEST%.*}.instructions"
 
@@ -15,10 +22,15 @@ for KTEST in $TRACE_DIR/*.ktest; do
     export LD_BIND_NOW=1
     export KTEST_FILE=$KTEST
 
-    pin -t $SCRIPT_DIR/../trace-instructions/pin-trace.so -- \
+    pin -t $SCRIPT_DIR/../trace-instructions/pin-trace.so $PIN_TRACE_FLAGS -- \
         ./executable -- --wan 1 --lan-dev 0 \
                     --expire 10 --starting-port 0 --max-flows 65536 || true
 #         ./executable -- --expire 10 --capacity 100 --config no-file.cfg || true
-    mv trace.out $TRACE
+    if [ -n "$PIN_TRACE_FLAGS" ]; then
+      $SCRIPT_DIR/../trace-instructions/pin-trace-decode trace.table trace.bin $TRACE
+      rm trace.table trace.bin
+    else
+      mv trace.out $TRACE
+    fi
   fi
 done
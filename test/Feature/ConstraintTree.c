@@ -0,0 +1,105 @@
+// RUN: %clang %s -emit-llvm %O0opt -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=dfs --dump-constraint-tree %t.bc
+// RUN: FileCheck -check-prefix=CHECK-TREE -input-file=%t.klee-out/constraint-tree.txt %s
+// RUN: FileCheck -check-prefix=CHECK-BRANCHES -input-file=%t.klee-out/constraint-branches.txt %s
+// RUN: %clang %s -DEQUALITY -emit-llvm %O0opt -g -c -o %t2.bc
+// RUN: rm -rf %t2.klee-out
+// RUN: %klee --output-dir=%t2.klee-out --search=dfs --rewrite-equalities --dump-constraint-tree %t2.bc
+// RUN: FileCheck -check-prefix=CHECK-EQ-TREE -input-file=%t2.klee-out/constraint-tree.txt %s
+// RUN: FileCheck -check-prefix=CHECK-EQ-BRANCHES -input-file=%t2.klee-out/constraint-branches.txt %s
+// RUN: %clang %s -DSWITCH -emit-llvm %O0opt -g -c -o %t3.bc
+// RUN: rm -rf %t3.klee-out
+// RUN: %klee --output-dir=%t3.klee-out --search=dfs --dump-constraint-tree %t3.bc
+// RUN: FileCheck -check-prefix=CHECK-SWITCH-TREE -input-file=%t3.klee-out/constraint-tree.txt %s
+// RUN: FileCheck -check-prefix=CHECK-SWITCH-BRANCHES -input-file=%t3.klee-out/constraint-branches.txt %s
+// RUN: FileCheck -check-prefix=CHECK-SWITCH-ONE -input-file=%t3.klee-out/constraint-branches.txt %s
+// RUN: FileCheck -check-prefix=CHECK-SWITCH-TWO -input-file=%t3.klee-out/constraint-branches.txt %s
+// RUN: FileCheck -check-prefix=CHECK-SWITCH-DEFAULT -input-file=%t3.klee-out/constraint-branches.txt %s
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+#ifdef SWITCH
+  // The three arms are forked at once, in an order picked at random. Each
+  // pair of consecutive tests diverges on the conditions of their own arms.
+  switch (x) {
+  case 1:
+    return 1;
+  case 2:
+    return 2;
+  default:
+    return 0;
+  }
+#endif
+#ifdef EQUALITY
+  // DFS terminates x >= 10 first, then x != 3, then x == 3. Adding x == 3
+  // rewrites x < 10 into true, which leaves the last path with a single
+  // constraint after two forks.
+  if (x < 10) {
+    if (x == 3)
+      return 3;
+    return 1;
+  }
+  return 0;
+#endif
+  // DFS terminates x >= 10 first, then 5 <= x < 10, then x < 5.
+  if (x < 10) {
+    if (x < 5)
+      return 2;
+    return 1;
+  }
+  return 0;
+}
+
+// CHECK-TREE: 1|1|2
+// CHECK-TREE-NEXT: 1|2|1
+// CHECK-TREE-NEXT: 2|2|3
+// CHECK-TREE-NEXT: 2|3|2
+// CHECK-TREE-NEXT: 3|3|3
+
+// CHECK-BRANCHES-COUNT-2: 1|2|
+// CHECK-BRANCHES-COUNT-2: 2|3|
+
+// CHECK-EQ-TREE: 1|1|2
+// CHECK-EQ-TREE-NEXT: 1|2|1
+// CHECK-EQ-TREE-NEXT: 2|2|3
+// CHECK-EQ-TREE-NEXT: 2|3|2
+// CHECK-EQ-TREE-NEXT: 3|3|{{[0-9]+}}
+
+// The conditions are printed over several lines.
+// CHECK-EQ-BRANCHES: 1|2|(Eq false
+// CHECK-EQ-BRANCHES-NEXT: (Slt (ReadLSB w32 0 x)
+// CHECK-EQ-BRANCHES-NEXT: 10))
+// CHECK-EQ-BRANCHES-NEXT: 1|2|(Slt (ReadLSB w32 0 x)
+// CHECK-EQ-BRANCHES-NEXT: 10)
+// CHECK-EQ-BRANCHES-NEXT: 2|3|(Eq false
+// CHECK-EQ-BRANCHES-NEXT: (Eq 3
+// CHECK-EQ-BRANCHES-NEXT: (ReadLSB w32 0 x)))
+// CHECK-EQ-BRANCHES-NEXT: 2|3|(Eq 3
+// CHECK-EQ-BRANCHES-NEXT: (ReadLSB w32 0 x))
+
+// CHECK-SWITCH-TREE: 1|1|{{[23]}}
+// CHECK-SWITCH-TREE-NEXT: 1|2|1
+// CHECK-SWITCH-TREE-NEXT: 2|2|{{[23]}}
+// CHECK-SWITCH-TREE-NEXT: 2|3|1
+// CHECK-SWITCH-TREE-NEXT: 3|3|{{[23]}}
+
+// The first line of a condition tells the arms apart. The middle test is
+// compared on its own arm with both of its neighbours.
+// CHECK-SWITCH-BRANCHES: 1|2|[[FIRST:.+]]
+// CHECK-SWITCH-BRANCHES: 1|2|[[SECOND:.+]]
+// CHECK-SWITCH-BRANCHES: 2|3|[[SECOND]]{{$}}
+// CHECK-SWITCH-BRANCHES: 2|3|[[THIRD:.+]]
+
+// Each arm shows up with its own condition.
+// CHECK-SWITCH-ONE: |(Eq 1
+// CHECK-SWITCH-ONE-NEXT: (ReadLSB w32 0 x))
+// CHECK-SWITCH-TWO: |(Eq 2
+// CHECK-SWITCH-TWO-NEXT: (ReadLSB w32 0 x))
+// CHECK-SWITCH-DEFAULT: |(And (Eq false
+// CHECK-SWITCH-DEFAULT-NEXT: (Eq 1
+// CHECK-SWITCH-DEFAULT-NEXT: N0:(ReadLSB w32 0 x)))
+// CHECK-SWITCH-DEFAULT-NEXT: (Eq false (Eq 2 N0)))
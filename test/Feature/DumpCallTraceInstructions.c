@@ -0,0 +1,25 @@
+// RUN: %clang %s -emit-llvm %O0opt -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=dfs --dump-call-trace-instructions --call-trace-instr-startfn=process --call-trace-instr-endfn=process %t.bc
+// RUN: FileCheck -input-file=%t.klee-out/test000001.ll.demarcated %s
+// RUN: FileCheck -input-file=%t.klee-out/test000002.ll.demarcated %s
+
+#include "klee/klee.h"
+
+int process(int x) {
+  if (x < 10)
+    return x + 1;
+  return 0;
+}
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  return process(x);
+}
+
+// CHECK: LLVM Instruction trace
+// CHECK-NEXT: Call Stack | Current Function | Instruction
+// CHECK-NEXT: process | process | {{.*}}call {{.*}}@process
+// CHECK: process | process | {{.*}}icmp slt
+// CHECK: process | process | {{.*}}ret i32
@@ -0,0 +1,42 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error %t.bc 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEVICE ((uint32_t *)0x10000)
+
+static uint64_t last_write;
+
+uint64_t device_read(uint64_t addr, unsigned offset, unsigned size) {
+  return 0x40 + offset;
+}
+
+void device_write(uint64_t addr, unsigned offset, unsigned size,
+                  uint64_t value) {
+  last_write = value + offset;
+}
+
+int main() {
+  klee_define_fixed_object(DEVICE, 16);
+  klee_intercept_reads(DEVICE, "device_read");
+  klee_intercept_writes(DEVICE, "device_write");
+
+  // CHECK: read: 68
+  printf("read: %u\n", DEVICE[1]);
+  DEVICE[2] = 7;
+  // CHECK: write: 15
+  printf("write: %u\n", (unsigned)last_write);
+
+  // Other objects are not intercepted.
+  uint32_t *plain = malloc(16);
+  plain[1] = 3;
+  // CHECK: plain: 3
+  printf("plain: %u\n", plain[1]);
+  free(plain);
+  return 0;
+}
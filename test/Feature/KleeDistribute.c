@@ -0,0 +1,34 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee-distribute --jobs=3 --split-depth=2 --output-dir=%t.klee-out --dump-constraint-tree %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | grep -c "\.ktest$" | FileCheck -check-prefix=CHECK-FILES %s
+// RUN: FileCheck -check-prefix=CHECK-TREE -input-file=%t.klee-out/constraint-tree.txt %s
+
+// The paths of the prefixes are explored by separate processes and their
+// tests are numbered as a single run would have.
+// CHECK: KLEE: done: completed paths = 10
+// CHECK: KLEE: done: generated tests = 10
+// CHECK-FILES: 10
+
+// Consecutive tests diverge at the branch that separates them.
+// CHECK-TREE: 1|2|
+// CHECK-TREE: 9|10|
+
+#include "klee/klee.h"
+
+int main() {
+  int x, res = 1;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x & 1) {
+    res *= 2;
+    if (x & 2)
+      res *= 3;
+    if (x & 4)
+      res *= 5;
+    if (x & 8)
+      res *= 7;
+  } else if (x & 16) {
+    res *= 11;
+  }
+  return res;
+}
@@ -0,0 +1,34 @@
+// RUN: %clang %s -emit-llvm -g -c -o %t1.bc
+// RUN: rm -rf %t.klee-out %t.klee-out2 %t.summaries
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error --loop-summary-file=%t.summaries %t1.bc 2>&1 | FileCheck %s
+// RUN: FileCheck --check-prefix=CHECK-FILE %s < %t.summaries
+// RUN: %klee --output-dir=%t.klee-out2 --exit-on-error --loop-summary-file=%t.summaries %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-SEEDED %s
+// RUN: FileCheck --check-prefix=CHECK-FILE %s < %t.summaries
+
+#include <klee/klee.h>
+#include <stdio.h>
+
+int main() {
+  int x[3] = {1, 20, 3};
+  klee_possibly_havoc(x, sizeof(x), "x");
+  while(klee_induce_invariants() & x[1]) {
+    x[1] -- ;
+    if (x[0] < 4) {
+      printf("x[0] may be less than 4\n");
+    } else {
+      printf("x[0] may be more\n");
+      // CHECK-NOT: x[0] may be more
+      // CHECK-SEEDED-NOT: x[0] may be more
+    }
+  }
+  klee_assert(x[2] == 3);
+  printf("afterloop\n");
+  // CHECK: afterloop
+  // CHECK-SEEDED: Loaded 1 loop summaries
+  // CHECK-SEEDED: afterloop
+  return 0;
+}
+
+// The second run finds the same summary and does not append it again.
+// CHECK-FILE: main{{.}}{{[0-9]+}}{{.}}x:12{{.}}x={{[0-9]+}}-{{[0-9]+}}
+// CHECK-FILE-NOT: main
@@ -0,0 +1,34 @@
+// REQUIRES: z3
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.serial %t.parallel
+// RUN: %klee --output-dir=%t.serial --solver-backend=z3 --dump-call-traces %t.bc
+// RUN: %klee --output-dir=%t.parallel --solver-backend=z3 --dump-call-traces --parallel-workers=4 %t.bc 2>&1 | FileCheck %s
+// RUN: %ktest-tool %t.serial/*.ktest | grep -v "^ktest file" | sort > %t.serial.tests
+// RUN: %ktest-tool %t.parallel/*.ktest | grep -v "^ktest file" | sort > %t.parallel.tests
+// RUN: diff %t.serial.tests %t.parallel.tests
+// RUN: cat %t.serial/*.call_path | sort > %t.serial.paths
+// RUN: cat %t.parallel/*.call_path | sort > %t.parallel.paths
+// RUN: diff %t.serial.paths %t.parallel.paths
+
+// Four threads explore the same paths as a single one, and generate the
+// same tests and call paths: every path has a single solution, so the tests
+// do not depend on which worker's solver chain answered the queries.
+// CHECK: KLEE: done: completed paths = 64
+// CHECK: KLEE: done: generated tests = 64
+
+#include "klee/klee.h"
+
+int main() {
+  unsigned char input[6];
+  unsigned sum = 0;
+  klee_make_symbolic(input, sizeof(input), "input");
+  for (unsigned i = 0; i < sizeof(input); ++i) {
+    klee_assume(input[i] < 2);
+    if (input[i])
+      sum += i;
+    // Give every path some work between forks.
+    for (unsigned j = 0; j < 200; ++j)
+      sum = sum * 31 + j;
+  }
+  return sum & 1;
+}
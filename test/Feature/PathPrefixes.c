@@ -0,0 +1,30 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out-1 %t.klee-out-4
+// RUN: %klee --output-dir=%t.klee-out --emit-path-prefixes=2 %t.bc 2>&1 | FileCheck -check-prefix=CHECK-SPLIT %s
+// RUN: test -f %t.klee-out/test000004.prefix
+// RUN: not test -f %t.klee-out/test000001.ktest
+// RUN: %klee --output-dir=%t.klee-out-1 --replay-path=%t.klee-out/test000001.prefix --replay-path-prefix %t.bc 2>&1 | FileCheck -check-prefix=CHECK-PREFIX %s
+// RUN: %klee --output-dir=%t.klee-out-4 --replay-path=%t.klee-out/test000004.prefix --replay-path-prefix %t.bc 2>&1 | FileCheck -check-prefix=CHECK-PREFIX %s
+
+// The states stop at their second symbolic branch, leaving four prefixes.
+// CHECK-SPLIT: KLEE: done: completed paths = 0
+// CHECK-SPLIT: KLEE: done: generated tests = 0
+// CHECK-SPLIT: KLEE: done: path prefixes = 4
+
+// Each prefix leads to the two paths of the last branch.
+// CHECK-PREFIX: KLEE: done: completed paths = 2
+// CHECK-PREFIX: KLEE: done: generated tests = 2
+
+#include "klee/klee.h"
+
+int main() {
+  int x, res = 1;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x & 1)
+    res *= 2;
+  if (x & 2)
+    res *= 3;
+  if (x & 4)
+    res *= 5;
+  return res;
+}
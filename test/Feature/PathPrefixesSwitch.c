@@ -0,0 +1,37 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out-1 %t.klee-out-6
+// RUN: %klee --output-dir=%t.klee-out --emit-path-prefixes=1 %t.bc 2>&1 | FileCheck -check-prefix=CHECK-SPLIT %s
+// RUN: %klee --output-dir=%t.klee-out-1 --replay-path=%t.klee-out/test000001.prefix --replay-path-prefix %t.bc 2>&1 | FileCheck -check-prefix=CHECK-PREFIX %s
+// RUN: %klee --output-dir=%t.klee-out-6 --replay-path=%t.klee-out/test000006.prefix --replay-path-prefix %t.bc 2>&1 | FileCheck -check-prefix=CHECK-PREFIX %s
+
+// The three arms of the switch fork at the next branch, leaving six
+// prefixes.
+// CHECK-SPLIT: KLEE: done: completed paths = 0
+// CHECK-SPLIT: KLEE: done: path prefixes = 6
+
+// Each prefix records its arm of the switch and leads to the two paths of
+// the last branch only.
+// CHECK-PREFIX: KLEE: done: completed paths = 2
+// CHECK-PREFIX: KLEE: done: generated tests = 2
+
+#include "klee/klee.h"
+
+int main() {
+  int x, res;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  switch (x & 3) {
+  case 0:
+    res = 2;
+    break;
+  case 1:
+    res = 3;
+    break;
+  default:
+    res = 5;
+  }
+  if (x & 4)
+    res *= 7;
+  if (x & 8)
+    res *= 11;
+  return res;
+}
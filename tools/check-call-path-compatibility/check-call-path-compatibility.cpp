@@ -10,28 +10,64 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/perf-contracts.h"
+#include "klee/Expr/CallPathFile.h"
 #include "klee/Expr/Parser/Parser.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/ExprBuilder.h"
 #include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverService.h"
+#include "klee/Support/CallPathArchive.h"
+#include "klee/Solver/SolverCmdLine.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <dlfcn.h>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <vector>
 
 #define DEBUG
 
 namespace {
-llvm::cl::opt<std::string> SenderCallPathFile(llvm::cl::desc("<sender call path>"),
+llvm::cl::opt<std::string> SenderCallPathFile(llvm::cl::desc("<sender call path or directory>"),
                                          llvm::cl::Positional,
                                          llvm::cl::Required);
 
-llvm::cl::opt<std::string> ReceiverCallPathFile(llvm::cl::desc("<receiver call path>"),
+llvm::cl::opt<std::string> ReceiverCallPathFile(llvm::cl::desc("<receiver call path or directory>"),
                                          llvm::cl::Positional,
                                          llvm::cl::Required);
-}
+
+llvm::cl::opt<bool> Matrix(
+    "matrix",
+    llvm::cl::desc("Take a directory (or call path archive) of senders and "
+                   "one of receivers, check every pair and print a "
+                   "compatibility matrix (default=false)."),
+    llvm::cl::init(false));
+
+llvm::cl::opt<std::string> OutputFile(
+    "output",
+    llvm::cl::desc("Write the matrix to this file (default=stdout)."),
+    llvm::cl::init("-"));
+
+llvm::cl::opt<unsigned> NumWorkers(
+    "workers",
+    llvm::cl::desc("Number of worker processes checking pairs in matrix "
+                   "mode (default=1)."),
+    llvm::cl::init(1));
+
+llvm::cl::opt<bool> SolverClientStats(
+    "solver-client-stats",
+    llvm::cl::desc("Print the queries and cache hits of every matrix "
+                   "worker to stderr (default=false)."),
+    llvm::cl::init(false));
+} // namespace
 
 typedef struct {
   std::string function_name;
@@ -40,6 +76,9 @@ typedef struct {
 } call_t;
 
 typedef struct {
+  // Owns the arrays of a binary call path; declared first so that it
+  // outlives the expressions below.
+  std::unique_ptr<klee::CallPathFile> binary;
   klee::ConstraintSet constraints;
   std::vector<call_t> calls;
   std::map<std::string, const klee::Array *> arrays;
@@ -50,10 +89,39 @@ std::map<std::pair<std::string, int>, klee::ref<klee::Expr>>
     subcontract_constraints;
 
 call_path_t *load_call_path(std::string file_name) {
-  std::ifstream call_path_file(file_name);
-  assert(call_path_file.is_open() && "Unable to open call path file.");
+  std::string call_path_str, error;
+  if (!klee::readCallPathFile(file_name, call_path_str, error)) {
+    std::cerr << "Error: Unable to read call path " << file_name << ": "
+              << error << std::endl;
+    exit(-1);
+  }
 
   call_path_t *call_path = new call_path_t;
+  std::vector<klee::ref<klee::Expr>> exprs;
+
+  /* A binary call path already holds the parsed kQuery; only the text
+     sections are left for the loop below. */
+  bool is_binary = klee::CallPathFile::isBinary(call_path_str);
+  if (is_binary) {
+    call_path->binary.reset(new klee::CallPathFile());
+    klee::CallPathFile *binary = call_path->binary.get();
+    if (!binary->readBinary(call_path_str, error)) {
+      std::cerr << "Error: Invalid call path " << file_name << ": " << error
+                << std::endl;
+      exit(-1);
+    }
+    for (const klee::Array *array : binary->arrays) {
+      call_path->arrays[array->name] = array;
+    }
+    call_path->constraints = klee::ConstraintSet(binary->constraints);
+    exprs = binary->values;
+
+    call_path_str.clear();
+    llvm::raw_string_ostream sections(call_path_str);
+    binary->writeText(sections, false);
+    sections.flush();
+  }
+  std::istringstream call_path_file(call_path_str);
 
   enum {
     STATE_INIT,
@@ -64,7 +132,6 @@ call_path_t *load_call_path(std::string file_name) {
   } state = STATE_INIT;
 
   std::string kQuery;
-  std::vector<klee::ref<klee::Expr>> exprs;
   std::set<std::string> declared_arrays;
 
   int parenthesis_level = 0;
@@ -82,20 +149,24 @@ call_path_t *load_call_path(std::string file_name) {
 
     case STATE_KQUERY: {
       if (line == ";;-- Calls --") {
-        std::unique_ptr<llvm::MemoryBuffer> MB = llvm::MemoryBuffer::getMemBuffer(kQuery);
-        klee::ExprBuilder *Builder = klee::createDefaultExprBuilder();
-        klee::expr::Parser *P =
-            klee::expr::Parser::Create("", MB.get(), Builder, false);
-        while (klee::expr::Decl *D = P->ParseTopLevelDecl()) {
-          assert(!P->GetNumErrors() &&
-                 "Error parsing kquery in call path file.");
-          if (klee::expr::ArrayDecl *AD = llvm::dyn_cast<klee::expr::ArrayDecl>(D)) {
-            call_path->arrays[AD->Root->name] = AD->Root;
-          } else if (klee::expr::QueryCommand *QC =
-                         llvm::dyn_cast<klee::expr::QueryCommand>(D)) {
-            call_path->constraints = klee::ConstraintSet(QC->Constraints);
-            exprs = QC->Values;
-            break;
+        if (!is_binary) {
+          std::unique_ptr<llvm::MemoryBuffer> MB =
+              llvm::MemoryBuffer::getMemBuffer(kQuery);
+          klee::ExprBuilder *Builder = klee::createDefaultExprBuilder();
+          klee::expr::Parser *P =
+              klee::expr::Parser::Create("", MB.get(), Builder, false);
+          while (klee::expr::Decl *D = P->ParseTopLevelDecl()) {
+            assert(!P->GetNumErrors() &&
+                   "Error parsing kquery in call path file.");
+            if (klee::expr::ArrayDecl *AD =
+                    llvm::dyn_cast<klee::expr::ArrayDecl>(D)) {
+              call_path->arrays[AD->Root->name] = AD->Root;
+            } else if (klee::expr::QueryCommand *QC =
+                           llvm::dyn_cast<klee::expr::QueryCommand>(D)) {
+              call_path->constraints = klee::ConstraintSet(QC->Constraints);
+              exprs = QC->Values;
+              break;
+            }
           }
         }
 
@@ -191,68 +262,326 @@ call_path_t *load_call_path(std::string file_name) {
   return call_path;
 }
 
-int main(int argc, char **argv, char **envp) {
-  llvm::cl::ParseCommandLineOptions(argc, argv);
-
-  call_path_t *sender_call_path = load_call_path(SenderCallPathFile);
-  call_path_t *receiver_call_path = load_call_path(ReceiverCallPathFile);
-
-  klee::Solver *solver = klee::createCoreSolver(klee::Z3_SOLVER);
-  assert(solver);
-  solver = createCexCachingSolver(solver);
-  solver = createCachingSolver(solver);
-  solver = createIndependentSolver(solver);
+/* The user buffer passed to `function` (stub_core_trace_tx or
+   stub_core_trace_rx) by the last such call of the path, or null if the path
+   makes no such call. */
+klee::ref<klee::Expr> find_buffer_expr(const call_path_t *call_path,
+                                       const std::string &function) {
+  klee::ref<klee::Expr> expr;
+  for (const auto &call : call_path->calls) {
+    if (call.function_name == function) {
+      assert(call.extra_vars.count("user_buf_addr"));
+      expr = call.extra_vars.at("user_buf_addr").first;
+    }
+  }
+  return expr;
+}
 
-  klee::ExprBuilder *exprBuilder = klee::createDefaultExprBuilder();
+enum compatibility_t { COMPATIBLE, INCOMPATIBLE, UNKNOWN };
 
+/* Whether the sent and received buffers may be equal under the constraints
+   of both paths, or UNKNOWN if the solver fails to tell. */
+compatibility_t check_pair(klee::Solver *solver, const call_path_t *sender,
+                           klee::ref<klee::Expr> tx_expr,
+                           const call_path_t *receiver,
+                           klee::ref<klee::Expr> rx_expr) {
   klee::ConstraintSet constraints;
   klee::ConstraintManager constraints_manager(constraints);
 
-  for (auto c : sender_call_path->constraints) {
+  for (auto c : sender->constraints) {
     constraints_manager.addConstraint(c);
   }
-  for (auto c : receiver_call_path->constraints) {
+  for (auto c : receiver->constraints) {
     constraints_manager.addConstraint(c);
   }
 
-  klee::ref<klee::Expr> tx_expr;
-  for (auto call : sender_call_path->calls) {
-    if (call.function_name == "stub_core_trace_tx") {
-      assert(call.extra_vars.count("user_buf_addr"));
-      tx_expr = call.extra_vars["user_buf_addr"].first;
+  klee::ref<klee::Expr> eq_expr = klee::EqExpr::create(rx_expr, tx_expr);
+
+  klee::Query sat_query(constraints, eq_expr);
+  bool result = false;
+  if (!solver->mayBeTrue(sat_query, result)) {
+    return UNKNOWN;
+  }
+  return result ? COMPATIBLE : INCOMPATIBLE;
+}
+
+/* Cheap checks that prove two buffers different without the solver: they
+   differ in width, or in a byte that is constant in both. */
+bool buffers_structurally_differ(klee::ref<klee::Expr> tx_expr,
+                                 klee::ref<klee::Expr> rx_expr) {
+  klee::Expr::Width width = tx_expr->getWidth();
+  if (width != rx_expr->getWidth()) {
+    return true;
+  }
+  if (width % 8) {
+    return llvm::isa<klee::ConstantExpr>(tx_expr) &&
+           llvm::isa<klee::ConstantExpr>(rx_expr) && tx_expr != rx_expr;
+  }
+  for (unsigned offset = 0; offset < width; offset += 8) {
+    klee::ref<klee::Expr> tx_byte =
+        klee::ExtractExpr::create(tx_expr, offset, klee::Expr::Int8);
+    klee::ref<klee::Expr> rx_byte =
+        klee::ExtractExpr::create(rx_expr, offset, klee::Expr::Int8);
+    if (llvm::isa<klee::ConstantExpr>(tx_byte) &&
+        llvm::isa<klee::ConstantExpr>(rx_byte) && tx_byte != rx_byte) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* The call paths in a directory or call path archive, in name order. */
+std::vector<std::string> get_call_path_files(const std::string &path) {
+  std::vector<std::string> files;
+  if (klee::CallPathArchiveReader::isArchive(path)) {
+    std::string error;
+    std::unique_ptr<klee::CallPathArchiveReader> archive =
+        klee::CallPathArchiveReader::open(path, error);
+    if (!archive) {
+      std::cerr << "Error: Unable to open call path archive " << path << ": "
+                << error << std::endl;
+      exit(-1);
+    }
+    for (const auto &record : archive->getRecords()) {
+      files.push_back(path + ":" + record.name);
+    }
+    return files;
+  }
+
+  std::error_code ec;
+  llvm::sys::fs::directory_iterator i(path, ec), e;
+  for (; i != e && !ec; i.increment(ec)) {
+    if (llvm::sys::path::extension(i->path()) == ".call_path") {
+      files.push_back(i->path());
+    }
+  }
+  if (ec) {
+    std::cerr << "Error: Unable to read call path directory " << path << ": "
+              << ec.message() << std::endl;
+    exit(-1);
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+/* The call paths of a directory that make `function` calls, with the buffer
+   of each. */
+struct endpoints_t {
+  std::vector<std::string> files;
+  std::vector<call_path_t *> call_paths;
+  std::vector<klee::ref<klee::Expr>> buffers;
+  size_t skipped = 0;
+};
+
+endpoints_t load_endpoints(const std::string &path,
+                           const std::string &function) {
+  endpoints_t endpoints;
+  for (const auto &file : get_call_path_files(path)) {
+    call_path_t *call_path = load_call_path(file);
+    klee::ref<klee::Expr> buffer = find_buffer_expr(call_path, function);
+    if (buffer.isNull()) {
+      delete call_path;
+      endpoints.skipped++;
+      continue;
+    }
+    endpoints.files.push_back(file);
+    endpoints.call_paths.push_back(call_path);
+    endpoints.buffers.push_back(buffer);
+  }
+  return endpoints;
+}
+
+/* Matrix cells: '1' compatible, '0' incompatible, '-' incompatible by the
+   structural checks alone, '?' undecided by the solver or not checked
+   because the worker failed. */
+void run_matrix_worker(const endpoints_t &senders,
+                       const endpoints_t &receivers, unsigned worker,
+                       unsigned num_workers, const std::string &results_file) {
+  klee::Solver *core = klee::createCoreSolver(klee::Z3_SOLVER);
+  if (!klee::QueryCacheFile.empty()) {
+    core = klee::createPersistentCachingSolver(core, klee::QueryCacheFile);
+  }
+  std::unique_ptr<klee::SolverService> service =
+      klee::SolverService::create(core);
+  std::unique_ptr<klee::Solver> solver(service->createClient("compatibility"));
+  std::ofstream results(results_file, std::ios::app);
+  assert(results.is_open() && "Unable to open worker results file.");
+
+  /* Whole rows per worker, so that the queries of a row share the sender's
+     constraints in the caches. */
+  for (size_t s = worker; s < senders.files.size(); s += num_workers) {
+    std::string row(receivers.files.size(), '-');
+    for (size_t r = 0; r < receivers.files.size(); r++) {
+      if (buffers_structurally_differ(senders.buffers[s],
+                                      receivers.buffers[r])) {
+        continue;
+      }
+      switch (check_pair(solver.get(), senders.call_paths[s],
+                         senders.buffers[s], receivers.call_paths[r],
+                         receivers.buffers[r])) {
+      case COMPATIBLE: row[r] = '1'; break;
+      case INCOMPATIBLE: row[r] = '0'; break;
+      case UNKNOWN: row[r] = '?'; break;
+      }
+    }
+    results << s << " " << row << "\n";
+    results.flush();
+  }
+
+  if (SolverClientStats) {
+    std::string prefix = "worker " + std::to_string(worker) + ": ";
+    service->printClientStats(llvm::errs(), prefix.c_str());
+  }
+}
+
+int run_matrix() {
+  endpoints_t senders = load_endpoints(SenderCallPathFile, "stub_core_trace_tx");
+  endpoints_t receivers =
+      load_endpoints(ReceiverCallPathFile, "stub_core_trace_rx");
+  unsigned num_workers = std::max<size_t>(
+      1, std::min<size_t>(NumWorkers, senders.files.size()));
+
+  llvm::SmallString<128> results_dir;
+  if (std::error_code ec = llvm::sys::fs::createUniqueDirectory(
+          "check-call-path-compatibility", results_dir)) {
+    std::cerr << "Error: Unable to create temporary directory: "
+              << ec.message() << std::endl;
+    return -1;
+  }
+
+  std::vector<std::string> results_files;
+  std::map<pid_t, unsigned> running;
+  for (unsigned w = 0; w < num_workers; w++) {
+    results_files.push_back(
+        (results_dir + "/worker" + std::to_string(w)).str());
+    std::cout.flush();
+    std::cerr.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      exit(-1);
+    }
+    if (pid == 0) {
+      run_matrix_worker(senders, receivers, w, num_workers, results_files[w]);
+      _exit(0);
+    }
+    running[pid] = w;
+  }
+
+  while (!running.empty()) {
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid < 0) {
+      perror("waitpid");
+      return -1;
+    }
+    auto rit = running.find(pid);
+    if (rit == running.end()) {
+      continue;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+      std::cerr << "Error: Worker " << rit->second << " failed." << std::endl;
+    }
+    running.erase(rit);
+  }
+
+  std::vector<std::string> rows(
+      senders.files.size(), std::string(receivers.files.size(), '?'));
+  for (const auto &results_file : results_files) {
+    std::ifstream in(results_file);
+    size_t s;
+    std::string row;
+    while (in >> s >> row) {
+      if (s < rows.size() && row.size() == receivers.files.size()) {
+        rows[s] = row;
+      }
+    }
+    llvm::sys::fs::remove(results_file);
+  }
+  llvm::sys::fs::remove(results_dir);
+
+  std::ofstream output_file;
+  if (OutputFile != "-") {
+    output_file.open(OutputFile);
+    if (!output_file.is_open()) {
+      std::cerr << "Error: Unable to open output file " << OutputFile
+                << std::endl;
+      return -1;
     }
   }
+  std::ostream &out = OutputFile == "-" ? std::cout : output_file;
+
+  size_t counts[256] = {};
+  out << ";;-- Receivers --" << std::endl;
+  for (size_t r = 0; r < receivers.files.size(); r++) {
+    out << r << " " << receivers.files[r] << std::endl;
+  }
+  out << ";;-- Matrix (1 = compatible, 0 = incompatible, - = pruned, ? = "
+         "failed) --"
+      << std::endl;
+  for (size_t s = 0; s < senders.files.size(); s++) {
+    out << rows[s] << " " << senders.files[s] << std::endl;
+    for (char c : rows[s]) {
+      counts[static_cast<unsigned char>(c)]++;
+    }
+  }
+
+  std::cerr << "Senders: " << senders.files.size() << " ("
+            << senders.skipped << " without stub_core_trace_tx skipped)"
+            << std::endl;
+  std::cerr << "Receivers: " << receivers.files.size() << " ("
+            << receivers.skipped << " without stub_core_trace_rx skipped)"
+            << std::endl;
+  std::cerr << "Pairs: " << senders.files.size() * receivers.files.size()
+            << ", compatible: " << counts['1'] << ", incompatible: "
+            << counts['0'] << ", pruned: " << counts['-']
+            << ", failed: " << counts['?'] << std::endl;
+
+  return counts['?'] ? -1 : 0;
+}
+
+int main(int argc, char **argv, char **envp) {
+  llvm::cl::ParseCommandLineOptions(argc, argv);
+
+  if (Matrix) {
+    return run_matrix();
+  }
+
+  call_path_t *sender_call_path = load_call_path(SenderCallPathFile);
+  call_path_t *receiver_call_path = load_call_path(ReceiverCallPathFile);
+
+  std::unique_ptr<klee::SolverService> service =
+      klee::SolverService::create(klee::createCoreSolver(klee::Z3_SOLVER));
+  std::unique_ptr<klee::Solver> solver(service->createClient("compatibility"));
+
+  klee::ref<klee::Expr> tx_expr =
+      find_buffer_expr(sender_call_path, "stub_core_trace_tx");
   if (tx_expr.isNull()) {
     std::cout << "Sender doesn't send." << std::endl;
     std::cout << "Call paths incompatible." << std::endl;
     return 1;
   }
 
-  klee::ref<klee::Expr> rx_expr;
-  for (auto call : receiver_call_path->calls) {
-    if (call.function_name == "stub_core_trace_rx") {
-      assert(call.extra_vars.count("user_buf_addr"));
-      rx_expr = call.extra_vars["user_buf_addr"].first;
-    }
-  }
+  klee::ref<klee::Expr> rx_expr =
+      find_buffer_expr(receiver_call_path, "stub_core_trace_rx");
   if (rx_expr.isNull()) {
     std::cout << "Receiver doesn't receive." << std::endl;
     std::cout << "Call paths incompatible." << std::endl;
     return 1;
   }
 
-  klee::ref<klee::Expr> eq_expr = exprBuilder->Eq(rx_expr, tx_expr);
-
-  klee::Query sat_query(constraints, eq_expr);
-  bool result = false;
-  bool success = solver->mayBeTrue(sat_query, result);
-  assert(success);
-
-  if (result) {
+  switch (check_pair(solver.get(), sender_call_path, tx_expr,
+                     receiver_call_path, rx_expr)) {
+  case COMPATIBLE:
     std::cout << "Call paths compatible." << std::endl;
     return 0;
-  } else {
+  case INCOMPATIBLE:
     std::cout << "Call paths incompatible." << std::endl;
     return 1;
+  case UNKNOWN:
+  default:
+    std::cout << "Unable to decide whether the call paths are compatible."
+              << std::endl;
+    return -1;
   }
 }
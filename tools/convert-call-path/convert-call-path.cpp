@@ -0,0 +1,78 @@
+/* -*- mode: c++; c-basic-offset: 2; -*- */
+
+//===-- convert-call-path.cpp -----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/CallPathFile.h"
+#include "klee/Support/CallPathArchive.h"
+#include "klee/Support/FileHandling.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace {
+enum class Format { Auto, Text, Binary };
+
+llvm::cl::opt<std::string>
+    InputFile(llvm::cl::desc("<input call path>"), llvm::cl::Positional,
+              llvm::cl::Required);
+
+llvm::cl::opt<std::string> OutputFile(llvm::cl::desc("<output call path>"),
+                                      llvm::cl::Positional,
+                                      llvm::cl::init("-"));
+
+llvm::cl::opt<Format> OutputFormat(
+    "format", llvm::cl::desc("Format of the output call path"),
+    llvm::cl::values(
+        clEnumValN(Format::Auto, "auto",
+                   "The other format than the input's (default)"),
+        clEnumValN(Format::Text, "text", "kQuery and text sections"),
+        clEnumValN(Format::Binary, "binary",
+                   "Binary format with a shared expression table")
+            KLEE_LLVM_CL_VAL_END),
+    llvm::cl::init(Format::Auto));
+} // namespace
+
+int main(int argc, char **argv, char **envp) {
+  llvm::cl::ParseCommandLineOptions(argc, argv);
+
+  std::string contents, error;
+  if (!klee::readCallPathFile(InputFile, contents, error)) {
+    std::cerr << "Error: Unable to read call path " << InputFile << ": "
+              << error << std::endl;
+    return 1;
+  }
+
+  klee::CallPathFile callPath;
+  if (!callPath.read(contents, error)) {
+    std::cerr << "Error: Invalid call path " << InputFile << ": " << error
+              << std::endl;
+    return 1;
+  }
+
+  bool toBinary = OutputFormat == Format::Binary ||
+                  (OutputFormat == Format::Auto &&
+                   !klee::CallPathFile::isBinary(contents));
+
+  std::unique_ptr<llvm::raw_fd_ostream> out =
+      klee::klee_open_output_file(OutputFile, error);
+  if (!out) {
+    std::cerr << "Error: Unable to open " << OutputFile << ": " << error
+              << std::endl;
+    return 1;
+  }
+  if (toBinary)
+    callPath.writeBinary(*out);
+  else
+    callPath.writeText(*out);
+
+  return 0;
+}
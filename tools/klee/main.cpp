@@ -11,16 +11,21 @@
 
 #include "../../lib/Core/Memory.h"
 #include "../../lib/Core/ExecutionState.h"
+#include "../../lib/Core/PathCost.h"
 #include "klee/ADT/TreeStream.h"
 #include "klee/Config/Version.h"
 #include "klee/Core/Interpreter.h"
+#include "klee/Expr/CallPathFile.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprBuilder.h"
 #include "klee/Expr/ExprPPrinter.h"
+#include "klee/Module/KInstruction.h"
 #include "klee/ADT/KTest.h"
 #include "klee/ADT/TreeStream.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverService.h"
+#include "klee/Support/CallPathArchive.h"
 #include "klee/Support/OptionCategories.h"
 #include "klee/Support/Debug.h"
 #include "klee/Support/ErrorHandling.h"
@@ -64,15 +69,20 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cerrno>
+#include <condition_variable>
 #include <ctime>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <list>
-#include <regex>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
 
 using namespace llvm;
@@ -156,6 +166,34 @@ namespace {
               "klee_trace_ret* intrinsic labels."),
       cl::init(false), cl::cat(TestCaseCat));
 
+  enum class CallPathFormat { Text, Binary };
+
+  cl::opt<CallPathFormat> CallPathFileFormat(
+      "call-path-format",
+      cl::desc("Format of the call traces written by -dump-call-traces"),
+      cl::values(clEnumValN(CallPathFormat::Text, "text",
+                            "kQuery and text sections (default)"),
+                 clEnumValN(CallPathFormat::Binary, "binary",
+                            "Versioned binary format with a shared "
+                            "expression table, read without parsing")
+                     KLEE_LLVM_CL_VAL_END),
+      cl::init(CallPathFormat::Text), cl::cat(TestCaseCat));
+
+  cl::opt<bool> CallPathArchive(
+      "call-path-archive",
+      cl::desc("With -dump-call-traces, append the call traces to a single "
+               "compressed archive (call-paths.gz, indexed by "
+               "call-paths.gz.idx) instead of one file per test "
+               "(default=false)"),
+      cl::init(false), cl::cat(TestCaseCat));
+
+  cl::opt<unsigned> CallPathQueueSize(
+      "call-path-queue-size",
+      cl::desc("Number of call traces that may wait for the background "
+               "writer before test generation blocks. Set to 0 to write "
+               "them synchronously (default=64)"),
+      cl::init(64), cl::cat(TestCaseCat));
+
   cl::opt<bool> DumpCallTraceInstructions(
       "dump-call-trace-instructions",
       cl::desc("Log and dump each instruction executed for a call trace."),
@@ -200,6 +238,13 @@ namespace {
                "(default=false)."),
       cl::cat(StartCat));
 
+  cl::opt<unsigned> ParallelWorkers(
+      "parallel-workers",
+      cl::desc("Number of threads exploring states in parallel. A thread "
+               "without states steals half of the states of the busiest "
+               "one. Requires the Z3 solver (default=1)"),
+      cl::init(1), cl::cat(StartCat));
+
   /*** Linking options ***/
 
   cl::OptionCategory LinkCat("Linking options",
@@ -301,6 +346,29 @@ namespace {
       cl::value_desc("path file"),
       cl::cat(ReplayCat));
 
+  cl::opt<bool> ReplayPathPrefix(
+      "replay-path-prefix",
+      cl::desc("Treat the -replay-path file as a prefix and explore all the "
+               "paths starting with it (default=false)"),
+      cl::init(false), cl::cat(ReplayCat));
+
+  cl::opt<bool> MergePathPrefixRuns(
+      "merge-path-prefix-runs",
+      cl::desc("Instead of running a program, merge the runs of the path "
+               "prefixes of klee-distribute, kept in <output-dir>/runs, into "
+               "the output directory as if a single run had written them "
+               "(default=false)"),
+      cl::init(false), cl::cat(ReplayCat));
+
+  cl::opt<unsigned> EmitPathPrefixes(
+      "emit-path-prefixes",
+      cl::desc("Stop the states that reach this many symbolic branches and "
+               "write their branch decisions to a .prefix file instead of a "
+               "test case, to be explored with -replay-path-prefix. The "
+               "decisions include the arms taken at switches, also in the "
+               "-write-paths files. Set to 0 to disable (default=0)"),
+      cl::init(0), cl::cat(ReplayCat));
+
   cl::opt<bool> CondoneUndeclaredHavocs(
       "condone-undeclared-havocs",
       cl::desc("Do not throw an error if a memory location changes "
@@ -354,29 +422,47 @@ class ExecutionState;
 
 class KleeHandler;
 
-struct CallPathTip {
-  CallInfo call;
+template <typename Call> struct BasicCallPathTip {
+  Call call;
   unsigned path_id;
   int is_duplicate;
+  /* Cached Call::hash() of call */
+  std::size_t hash;
 };
 
-class CallTree {
-  std::vector<CallTree *> children;
-  CallPathTip tip;
-  std::vector<std::vector<CallPathTip *>> groupChildren();
+typedef BasicCallPathTip<CallInfo> CallPathTip;
+
+/* The call paths of the tests, merged on their common prefixes. Nodes are of
+   type Derived, and their calls of type Call, which provides hash() and eq().
+   Besides the CallTree of a run, this builds the call tree of the runs of
+   -merge-path-prefix-runs, from the calls they dumped. */
+template <typename Derived, typename Call> class BasicCallTree {
+protected:
+  std::vector<Derived *> children;
+  /* Indices of the children by the hash of their call, in insertion order */
+  std::unordered_map<std::size_t, std::vector<unsigned>> children_by_hash;
+  BasicCallPathTip<Call> tip;
+  Derived *addChild(const Call &call, std::size_t hash, unsigned path_id,
+                    int is_duplicate);
 
 public:
-  CallTree() : children(), tip(){};
-  void addCallPath(std::vector<CallInfo>::const_iterator path_begin,
-                   std::vector<CallInfo>::const_iterator path_end,
+  BasicCallTree() : children(), children_by_hash(), tip(){};
+  void addCallPath(typename std::vector<const Call *>::const_iterator path_begin,
+                   typename std::vector<const Call *>::const_iterator path_end,
                    unsigned path_id);
+  void dumpCallTree(std::vector<BasicCallPathTip<Call>> accumulated_prefix,
+                    llvm::raw_ostream *tree_file,
+                    llvm::raw_ostream *calls_file);
+};
+
+class CallTree : public BasicCallTree<CallTree, CallInfo> {
+  std::vector<std::vector<CallPathTip *>> groupChildren();
+
+public:
   void dumpCallPrefixes(
       std::list<CallInfo> accumulated_prefix,
       std::list<const std::vector<ref<Expr>> *> accumulated_context,
       KleeHandler *fileOpener);
-  void dumpCallTree(std::vector<CallPathTip> accumulated_prefix,
-                    llvm::raw_ostream *tree_file,
-                    llvm::raw_ostream *calls_file);
   void dumpCallPrefixesSExpr(std::list<CallInfo> accumulated_prefix,
                              KleeHandler *fileOpener);
 
@@ -385,28 +471,149 @@ public:
 };
 
 class ConstraintTree {
-  /* Index of vector is  */
-  std::vector<std::pair<int, ConstraintSet>> seen_tests;
+  /* The previous test, against which the next one is compared */
+  int last_id = 0;
+  ref<PTreeFork> last_fork;
   /* Key is a pair of test-cases. Value is the depth at which they diverge and
    * the constraint on which they diverge */
   std::map<std::pair<int, int>, int> overlap_depth;
   std::map<std::pair<int, int>, std::vector<ref<Expr>>> branch;
-  klee::Solver *solver; /* This should be a global variable */
-  void buildTree();
 
 public:
-  ConstraintTree() : seen_tests(), overlap_depth(), branch() {
-    solver = klee::createCoreSolver(klee::Z3_SOLVER);
-    assert(solver);
-    solver = createCexCachingSolver(solver);
-    solver = createCachingSolver(solver);
-    solver = createIndependentSolver(solver);
-  };
-  void addTest(int id, ExecutionState &state);
+  void addTest(int id, const ExecutionState &state);
   void dumpConstraintTree(llvm::raw_ostream *tree_file,
                           llvm::raw_ostream *constraints_file);
 };
 
+/* Writes the call traces of -dump-call-traces from a background thread, so
+   that compressing and writing them does not hold up the interpreter. The
+   traces are rendered to text beforehand, on the interpreter thread, since
+   expressions must not be shared between threads. The queue is also drained
+   when KLEE exits through exit() (e.g. klee_error), which skips the
+   destructor of the handler. */
+class CallPathWriter {
+  std::mutex lock;
+  std::condition_variable changed;
+  std::deque<std::pair<std::string, std::string>> queue;
+  size_t capacity;
+  bool closing = false;
+  std::string outputDirectory;
+  std::unique_ptr<CallPathArchiveWriter> archive;
+  std::thread thread;
+
+  void write(const std::string &name, const std::string &contents);
+  void run();
+
+  static CallPathWriter *active;
+  static void closeActive();
+
+public:
+  CallPathWriter(const std::string &outputDirectory, unsigned capacity);
+  ~CallPathWriter();
+  void push(std::string name, std::string contents);
+  /// Writes the pending call traces and closes the archive.
+  void close();
+};
+
+CallPathWriter *CallPathWriter::active = nullptr;
+
+void CallPathWriter::closeActive() {
+  if (active)
+    active->close();
+}
+
+CallPathWriter::CallPathWriter(const std::string &outputDirectory,
+                               unsigned capacity)
+    : capacity(capacity), outputDirectory(outputDirectory) {
+  if (CallPathArchive) {
+    std::string error;
+    SmallString<128> path(outputDirectory);
+    sys::path::append(path, "call-paths.gz");
+    archive.reset(new CallPathArchiveWriter(path.c_str(), error));
+    if (!error.empty())
+      klee_error("cannot open call path archive \"%s\": %s", path.c_str(),
+                 error.c_str());
+  }
+  if (capacity)
+    thread = std::thread(&CallPathWriter::run, this);
+
+  static bool closeAtExit = false;
+  if (!closeAtExit) {
+    atexit(closeActive);
+    closeAtExit = true;
+  }
+  active = this;
+}
+
+CallPathWriter::~CallPathWriter() {
+  close();
+  if (active == this)
+    active = nullptr;
+}
+
+void CallPathWriter::close() {
+  // The writer thread cannot wait for itself, if it is the one exiting.
+  if (thread.joinable() && thread.get_id() != std::this_thread::get_id()) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      closing = true;
+    }
+    changed.notify_all();
+    thread.join();
+  }
+  archive.reset();
+}
+
+void CallPathWriter::push(std::string name, std::string contents) {
+  if (!capacity) {
+    write(name, contents);
+    return;
+  }
+  std::unique_lock<std::mutex> guard(lock);
+  changed.wait(guard,
+               [this] { return closing || queue.size() < capacity; });
+  if (closing)
+    return; // another thread is exiting
+  queue.emplace_back(std::move(name), std::move(contents));
+  guard.unlock();
+  changed.notify_all();
+}
+
+void CallPathWriter::run() {
+  std::unique_lock<std::mutex> guard(lock);
+  while (true) {
+    changed.wait(guard, [this] { return closing || !queue.empty(); });
+    if (queue.empty())
+      return;
+    std::pair<std::string, std::string> next = std::move(queue.front());
+    queue.pop_front();
+    guard.unlock();
+    changed.notify_all();
+    write(next.first, next.second);
+    guard.lock();
+  }
+}
+
+void CallPathWriter::write(const std::string &name,
+                           const std::string &contents) {
+  std::string error;
+  if (archive) {
+    if (!archive->append(name, contents, error))
+      klee_warning("error writing %s to the call path archive (%s)",
+                   name.c_str(), error.c_str());
+    return;
+  }
+  SmallString<128> path(outputDirectory);
+  sys::path::append(path, name);
+  auto file = klee_open_output_file(path.c_str(), error);
+  if (!file) {
+    klee_warning("error opening file \"%s\" (%s)", path.c_str(),
+                 error.c_str());
+    return;
+  }
+  *file << contents;
+}
+
 class KleeHandler : public InterpreterHandler {
 private:
   Interpreter *m_interpreter;
@@ -420,6 +627,7 @@ private:
   unsigned m_pathsExplored;     // number of paths explored so far
   unsigned m_callPathIndex;     // number of call path strings dumped so far
   unsigned m_callPathPrefixIndex; // number of call path strings dumped so far
+  unsigned m_numPathPrefixes;   // number of path prefixes written
 
   // used for writing .ktest files
   int m_argc;
@@ -427,6 +635,7 @@ private:
 
   CallTree m_callTree;
   ConstraintTree m_constraintTree;
+  std::unique_ptr<CallPathWriter> m_callPathWriter;
   std::map<std::string, std::map<int, ref<Expr>>> reused_symbols;
 
 public:
@@ -439,13 +648,17 @@ public:
   /// Returns the number of test cases successfully generated so far
   unsigned getNumTestCases() { return m_numGeneratedTests; }
   unsigned getNumPathsExplored() { return m_pathsExplored; }
+  unsigned getNumPathPrefixes() { return m_numPathPrefixes; }
   void incPathsExplored() { m_pathsExplored++; }
 
+  void dumpExplorationTrees();
+
   void setInterpreter(Interpreter *i);
 
   void processTestCase(ExecutionState &state, const char *errorMessage,
                        const char *errorSuffix);
   void processCallPath(const ExecutionState &state);
+  void processPathPrefix(const ExecutionState &state);
 
   std::string getOutputFilename(const std::string &filename);
   std::unique_ptr<llvm::raw_fd_ostream>
@@ -476,7 +689,7 @@ KleeHandler::KleeHandler(int argc, char **argv)
     : m_interpreter(0), m_pathWriter(0), m_symPathWriter(0),
       m_outputDirectory(), m_numTotalTests(0), m_numGeneratedTests(0),
       m_pathsExplored(0), m_callPathIndex(1), m_callPathPrefixIndex(0),
-      m_argc(argc), m_argv(argv) {
+      m_numPathPrefixes(0), m_argc(argc), m_argv(argv) {
 
   // create output directory (OutputDir or "klee-out-<i>")
   bool dir_given = OutputDir != "";
@@ -546,19 +759,38 @@ KleeHandler::KleeHandler(int argc, char **argv)
 
   // open info
   m_infoFile = openOutputFile("info");
+
+  if (DumpCallTraces)
+    m_callPathWriter.reset(
+        new CallPathWriter(m_outputDirectory.c_str(), CallPathQueueSize));
 }
 
 KleeHandler::~KleeHandler() {
+  // Wait for the pending call traces before closing the log files.
+  m_callPathWriter.reset();
   delete m_pathWriter;
   delete m_symPathWriter;
   fclose(klee_warning_file);
   fclose(klee_message_file);
 }
 
+void KleeHandler::dumpExplorationTrees() {
+  if (DumpCallTracePrefixes)
+    dumpCallPathPrefixes();
+
+  if (DumpCallTraceTree)
+    dumpCallPathTree();
+
+  if (DumpConstraintTree)
+    dumpConstraintTree();
+
+  dumpReusedSymbols();
+}
+
 void KleeHandler::setInterpreter(Interpreter *i) {
   m_interpreter = i;
 
-  if (WritePaths) {
+  if (WritePaths || EmitPathPrefixes) {
     m_pathWriter = new TreeStreamWriter(getOutputFilename("paths.ts"));
     assert(m_pathWriter->good());
     m_interpreter->setPathWriter(m_pathWriter);
@@ -667,10 +899,9 @@ void KleeHandler::processTestCase(ExecutionState &state,
         assert(o->bytes);
         std::copy(havocs[i].value.begin(), havocs[i].value.end(), o->bytes);
         unsigned mask_size = (o->numBytes + 31) / 32 * 4;
-        assert(mask_size <= havocs[i].mask.size());
         o->mask = new uint32_t[mask_size / sizeof(uint32_t)];
         assert(o->mask);
-        memcpy(o->mask, havocs[i].mask.get_bits(), mask_size);
+        havocs[i].mask.toBits(o->mask, mask_size / sizeof(uint32_t));
         // printf("dumping mask for %s: ", o->name);
         // for (unsigned i = 0; i < mask_size/4*32; ++i) {
         //   uint32_t word = i / 32;
@@ -690,8 +921,8 @@ void KleeHandler::processTestCase(ExecutionState &state,
       }
 
       if (DumpCallTracePrefixes || DumpCallTraceTree) {
-        m_callTree.addCallPath(state.callPath.begin(), state.callPath.end(),
-                               id);
+        std::vector<const CallInfo *> calls = state.callPath.entries();
+        m_callTree.addCallPath(calls.begin(), calls.end(), id);
       }
 
       if (DumpConstraintTree) {
@@ -699,9 +930,12 @@ void KleeHandler::processTestCase(ExecutionState &state,
       }
 
       if (DumpCallTraces) {
-        std::unique_ptr<llvm::raw_fd_ostream> trace_file =
-            openOutputFile(getTestFilename("call_path", id));
-        dumpCallPath(state, trace_file.get());
+        std::string trace;
+        llvm::raw_string_ostream trace_stream(trace);
+        dumpCallPath(state, &trace_stream);
+        trace_stream.flush();
+        m_callPathWriter->push(getTestFilename("call_path", id),
+                               std::move(trace));
       }
 
       for (auto it : state.reused_symbols) {
@@ -730,7 +964,7 @@ void KleeHandler::processTestCase(ExecutionState &state,
         *f << errorMessage;
     }
 
-    if (m_pathWriter) {
+    if (WritePaths) {
       std::vector<unsigned char> concreteBranches;
       m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
                                concreteBranches);
@@ -793,7 +1027,7 @@ void KleeHandler::processTestCase(ExecutionState &state,
       }
     }
 
-    if (m_numGeneratedTests == MaxTests)
+    if (m_numGeneratedTests >= MaxTests)
       m_interpreter->setHaltExecution(true);
 
     if (WriteTestInfo) {
@@ -1110,22 +1344,17 @@ bool dumpCallInfoSExpr(const CallInfo &ci, llvm::raw_ostream &file) {
 }
 
 void KleeHandler::processCallPath(const ExecutionState &state) {
-  unsigned id = m_callPathIndex;
-
   if (!DumpCallTraces)
     return;
 
-  ++m_callPathIndex;
+  unsigned id = m_callPathIndex++;
 
   std::stringstream filename;
   filename << "call-path" << std::setfill('0') << std::setw(6) << id << '.'
            << "txt";
   std::unique_ptr<llvm::raw_fd_ostream> file = openOutputFile(filename.str());
-  for (std::vector<CallInfo>::const_iterator iter = state.callPath.begin(),
-                                             end = state.callPath.end();
-       iter != end; ++iter) {
-    const CallInfo &ci = *iter;
-    bool dumped = dumpCallInfo(ci, *file.get());
+  for (const CallInfo *ci : state.callPath.entries()) {
+    bool dumped = dumpCallInfo(*ci, *file.get());
     if (!dumped)
       break;
   }
@@ -1137,6 +1366,27 @@ void KleeHandler::processCallPath(const ExecutionState &state) {
   }
 }
 
+void KleeHandler::processPathPrefix(const ExecutionState &state) {
+  // Prefixes are numbered along with the tests, so that the tests found
+  // under a prefix can take its place in the order of the tests.
+  unsigned id = ++m_numTotalTests;
+  ++m_numPathPrefixes;
+
+  std::vector<unsigned char> concreteBranches;
+  m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
+                           concreteBranches);
+  auto f = openTestFile("prefix", id);
+  if (f) {
+    for (const auto &branch : concreteBranches) {
+      *f << branch << '\n';
+    }
+  }
+
+  if (DumpConstraintTree) {
+    m_constraintTree.addTest(id, state);
+  }
+}
+
 std::unique_ptr<llvm::raw_fd_ostream>
 KleeHandler::openNextCallPathPrefixFile() {
   unsigned id = ++m_callPathPrefixIndex;
@@ -1191,9 +1441,8 @@ void KleeHandler::dumpReusedSymbols() {
 void KleeHandler::dumpCallPath(const ExecutionState &state,
                                llvm::raw_ostream *file) {
   std::vector<klee::ref<klee::Expr>> evalExprs;
-  std::vector<const klee::Array *> evalArrays;
 
-  for (auto ci : state.callPath) {
+  state.callPath.forEach([&evalExprs](const CallInfo &ci) {
     for (auto e : ci.extraPtrs) {
       if (e.second.pointee.doTraceValueIn) {
         evalExprs.push_back(e.second.pointee.inVal);
@@ -1206,37 +1455,21 @@ void KleeHandler::dumpCallPath(const ExecutionState &state,
       evalExprs.push_back(e.inVal);
       evalExprs.push_back(e.outVal);
     }
-  }
+  });
 
-  ExprBuilder *exprBuilder = createDefaultExprBuilder();
-  std::string kleaverStr;
-  llvm::raw_string_ostream kleaverROS(kleaverStr);
-  ExprPPrinter::printQuery(kleaverROS, state.constraints, exprBuilder->False(),
-                           &evalExprs[0], &evalExprs[0] + evalExprs.size(),
-                           &evalArrays[0], &evalArrays[0] + evalArrays.size(),
-                           true);
-  kleaverROS.flush();
+  CallPathFile callPath;
+  callPath.constraints.assign(state.constraints.begin(),
+                              state.constraints.end());
+  callPath.values = evalExprs;
 
-  *file << ";;-- kQuery --\n";
-  *file << kleaverROS.str();
-
-  *file << ";;-- Calls --\n";
-  for (std::vector<CallInfo>::const_iterator iter = state.callPath.begin(),
-                                             end = state.callPath.end();
-       iter != end; ++iter) {
-    const CallInfo &ci = *iter;
-    bool dumped = dumpCallInfo(ci, *file);
+  llvm::raw_string_ostream calls(callPath.calls);
+  for (const CallInfo *ci : state.callPath.entries()) {
+    bool dumped = dumpCallInfo(*ci, calls);
     if (!dumped)
       break;
   }
-  *file << ";;-- Constraints --\n";
-  for (ConstraintSet::const_iterator ci = state.constraints.begin(),
-                                     cEnd = state.constraints.end();
-       ci != cEnd; ++ci) {
-    *file << **ci << "\n";
-  }
+  calls.flush();
 
-  *file << ";;-- Tags --\n";
   for (auto it : state.symbolics) {
     if (it.second->name.compare(0, sizeof("vigor_tag_") - 1, "vigor_tag_") ==
         0) {
@@ -1274,238 +1507,52 @@ void KleeHandler::dumpCallPath(const ExecutionState &state,
       }
       buf[i] = 0;
 
-      *file << it.second->name.substr(sizeof("vigor_tag_") - 1) << " = " << buf
-            << "\n";
+      callPath.tags.emplace_back(
+          it.second->name.substr(sizeof("vigor_tag_") - 1), buf);
       delete buf;
     }
   }
-  *file << ";;-- BPF Calls --\n";
-  *file << state.bpf_calls <<"\n";
+  callPath.bpfCalls = std::to_string(state.bpf_calls) + "\n";
+  if (PathCostModel::enabled())
+    callPath.pathCost = PathCostModel::format(state.pathCost);
+
+  if (CallPathFileFormat == CallPathFormat::Binary)
+    callPath.writeBinary(*file);
+  else
+    callPath.writeText(*file);
 }
 
-// This Handler is very hard-coded and may need maintainence from time to time.
+// Dumps the instructions of the path that are counted by -count-path-cost,
+// i.e. those outside of the functions demarcated by the path cost model.
 void KleeHandler::dumpCallPathInstructions(const ExecutionState &state,
                                            llvm::raw_ostream *file,
                                            unsigned id) {
   *file << ";;-- LLVM Instruction trace -- " << id << "\n";
   *file << "Call Stack | Current Function | Instruction\n";
 
-  // Initialize the function lists
-  std::vector<std::string> libvig_fns = {"dchain_allocate",
-                                         "dchain_allocate_new_index",
-                                         "dchain_rejuvenate_index",
-                                         "dchain_expire_one_index",
-                                         "dmap_allocate",
-                                         "dmap_get_a",
-                                         "dmap_get_b",
-                                         "dmap_put",
-                                         "dmap_erase",
-                                         "dmap_get_value",
-                                         "dmap_size",
-                                         "expire_items",
-                                         "expire_items_single_map",
-                                         "map_impl_init",
-                                         "map_impl_get",
-                                         "map_impl_put",
-                                         "map_impl_erase",
-                                         "map_allocate",
-                                         "map_get",
-                                         "map_put",
-                                         "map_erase",
-                                         "map_size",
-                                         "dchain_make_space",
-                                         "dchain_reset",
-                                         "map_set_layout",
-                                         "map_entry_condition",
-                                         "map_set_entry_condition",
-                                         "map_reset",
-                                         "map_increase_occupancy",
-                                         "map_decrease_occupancy",
-                                         "dmap_set_layout",
-                                         "entry_condition",
-                                         "dmap_set_entry_condition",
-                                         "dmap_reset",
-                                         "dmap_increase_occupancy",
-                                         "dmap_decrease_occupancy",
-                                         "dmap_lowerbound_on_occupancy",
-                                         "dmap_occupancy_p",
-                                         "vector_allocate",
-                                         "vector_borrow",
-                                         "vector_return",
-                                         "vector_set_layout",
-                                         "vector_reset",
-                                         "handle_packet_timestamp",
-                                         "lpm_lookup",
-                                         "lpm_init",
-                                         "memcpy",
-                                         "trace_reset_buffers",
-                                         "map_get_1",
-                                         "map_get_2",
-                                         "map2_get_1",
-                                         "map2_put",
-                                         "map2_erase",
-                                         "dchain2_allocate",
-                                         "dchain2_allocate_new_index",
-                                         "dchain2_rejuvenate_index",
-                                         "dchain2_expire_one_index",
-                                         "lb_find_preferred_available_backend",
-                                         "dchain_is_index_allocated",
-                                         "dchain2_is_index_allocated",
-                                         "dchain2_make_space",
-                                         "dchain2_reset",
-                                         "map2_set_layout",
-                                         "map2_entry_condition",
-                                         "map2_set_entry_condition",
-                                         "map2_reset",
-                                         "map2_increase_occupancy",
-                                         "map2_decrease_occupancy",
-                                         "process_ip_packet"};
-  std::vector<std::string> dpdk_fns = {"rte_reset",
-                                       "rte_arch_bswap16",
-                                       "rte_arch_bswap32",
-                                       "rte_arch_bswap64",
-                                       "__rte_raw_cksum",
-                                       "__rte_raw_cksum_reduce",
-                                       "rte_raw_cksum",
-                                       "rte_ipv4_phdr_cksum",
-                                       "rte_ipv4_cksum",
-                                       "rte_ipv4_udptcp_cksum",
-                                       "rte_exit",
-                                       "rte_lcore_is_enabled",
-                                       "rte_get_master_lcore",
-                                       "rte_get_closest_next_lcore",
-                                       "rte_eth_tx_burst",
-                                       "flood",
-                                       "rte_pktmbuf_free",
-                                       "rte_get_tsc_hz",
-                                       "rte_lcore_id",
-                                       "rte_rdtsc",
-                                       "rte_eth_rx_burst",
-                                       "rte_prefetch0",
-                                       "rte_lcore_is_enabled",
-                                       "rte_lcore_to_socket_id",
-                                       "rte_socket_id",
-                                       "rte_eth_dev_socket_id",
-                                       "rte_eth_link_get_nowait",
-                                       "rte_delay_ms",
-                                       "rte_eal_init",
-                                       "rte_eth_dev_count",
-                                       "rte_lcore_count",
-                                       "rte_eth_dev_configure",
-                                       "rte_eth_macaddr_get",
-                                       "rte_eth_dev_info_get",
-                                       "rte_eth_tx_queue_setup",
-                                       "rte_eth_rx_queue_setup",
-                                       "rte_eth_dev_start",
-                                       "rte_eth_promiscuous_enable",
-                                       "rte_eal_mp_remote_launch",
-                                       "rte_eal_wait_lcore",
-                                       "rte_pktmbuf_pool_create",
-                                       "rte_get_master_lcore",
-                                       "rte_strerror",
-                                       "rte_pktmbuf_clone",
-                                       "cmdline_isendoftoken",
-                                       "nf_set_ipv4_checksum"};
-  std::vector<std::string> time_fns = {
-      "start_time",     "restart_time",
-      "current_time",   "get_start_time_internal",
-      "get_start_time", "clock_gettime",
-      "gettimeofday"};
-  std::vector<std::string> verif_fns = {"loop_iteration_assumptions",
-                                        "loop_iteration_assertions",
-                                        "loop_invariant_consume",
-                                        "loop_invariant_produce",
-                                        "loop_iteration_begin",
-                                        "loop_iteration_end",
-                                        "loop_enumeration_begin",
-                                        "loop_enumeration_end",
-                                        "allocate_unique_name",
-                                        "count_reuse",
-                                        "init_test_data",
-                                        "report_internal_error",
-                                        "rand_byte",
-                                        "bridge_loop_invariant_consume",
-                                        "bridge_loop_invariant_produce",
-                                        "bridge_loop_iteration_begin",
-                                        "bridge_loop_iteration_end",
-                                        "bridge_loop_iteration_assumptions",
-                                        "nf_loop_iteration_begin",
-                                        "nf_add_loop_iteration_assumptions",
-                                        "nf_loop_iteration_end",
-                                        "concretize_devices",
-                                        "flow_consistency",
-                                        "rte_eth_dev_count",
-                                        "flood",
-                                        "exit",
-                                        "__uClibc_fini",
-                                        "_stdio_term"};
-
-  std::vector<std::string> ebpf_fns = {"bpf_map_lookup_elem",
-                                       "bpf_map_update_elem", "bpf_csum_diff",
-                                       "bpf_xdp_adjust_head"};
-  std::regex symbol_re("klee*");
-  std::regex symbol2_re("_exit@plt*");
-
-  std::vector<std::vector<std::string>> function_list = {
-      libvig_fns, dpdk_fns, time_fns, verif_fns, ebpf_fns};
-  int currently_demarcated = 0;
-  std::string currently_demarcated_fn = "";
-
-  // Now we start iterating over the input trace and print only stuff we
-  // demarcate
-  int check = 0;
-  for (auto it : state.stackInstrMap) {
-    std::string opcode = it.second->getOpcodeName();
-    std::string current_fn_name;
-    if (it.first.size() != 0) {
-      current_fn_name = it.first[it.first.size() - 1];
-    } else {
-      continue; // Cant do anything with an empty call stack
-    }
-
-    if (currently_demarcated && opcode != "ret") {
-      continue;
-    }
-
-    if (currently_demarcated && opcode == "ret" &&
-        current_fn_name == currently_demarcated_fn) {
-      currently_demarcated = 0;
-      currently_demarcated_fn = "";
-      continue;
-    }
-
-    else if (currently_demarcated == 0 && check == 1) {
-      check = 0;
-      int found = 0;
-      for (uint list_counter = 0; list_counter < function_list.size();
-           list_counter++) {
-        if (std::find(function_list[list_counter].begin(),
-                      function_list[list_counter].end(),
-                      current_fn_name) != function_list[list_counter].end()) {
-          found = 1;
-          break;
-        }
-      }
-      if(std::regex_match(current_fn_name, symbol_re) || std::regex_match(current_fn_name, symbol2_re))
-        found = 1;
-      if (found) {
-        currently_demarcated = 1;
-        currently_demarcated_fn = current_fn_name;
-      }
-    }
-
-    if (currently_demarcated == 0) {
-      if (opcode == "call")
-        check = 1;
-      int s = it.first.size();
-      if (s != 0) {
-        for (auto it2 : it.first) {
-          *file << it2 << " ";
-        }
-        *file << "| " << it.first[s - 1] << "| " << *(it.second) << "\n";
+  const PathCostModel &model = PathCostModel::get();
+  PathCost demarcation;
+  const CallStackTrie &stacks = CallStackTrie::get();
+  // Consecutive instructions mostly share the call stack, so the printed
+  // stack is only rebuilt when it changes.
+  CallStackTrie::NodeId printedStack = CallStackTrie::Root;
+  std::string printedFrames;
+  std::vector<const std::string *> frames;
+  state.instrTrace.forEach([&](const InstructionTrace::Entry &it) {
+    if (!model.step(demarcation, it.stack, it.ki))
+      return;
+    if (it.stack != printedStack) {
+      stacks.getFrames(it.stack, frames);
+      printedFrames.clear();
+      for (auto frame : frames) {
+        printedFrames += *frame;
+        printedFrames += " ";
       }
+      printedStack = it.stack;
     }
-  }
+    *file << printedFrames << "| " << stacks.top(it.stack) << "| "
+          << *(it.ki->inst) << "\n";
+  });
 }
 
 // load a .path file
@@ -1515,12 +1562,9 @@ void KleeHandler::loadPathFile(std::string name, std::vector<bool> &buffer) {
   if (!f.good())
     assert(0 && "unable to open path file");
 
-  while (f.good()) {
-    unsigned value;
-    f >> value;
+  unsigned value;
+  while (f >> value)
     buffer.push_back(!!value);
-    f.get();
-  }
 }
 
 void KleeHandler::getKTestFilesInDir(std::string directoryPath,
@@ -1582,51 +1626,71 @@ std::string KleeHandler::getRunTimeLibraryPath(const char *argv0) {
   return libDir.c_str();
 }
 
-void CallTree::addCallPath(std::vector<CallInfo>::const_iterator path_begin,
-                           std::vector<CallInfo>::const_iterator path_end,
-                           unsigned path_id) {
+template <typename Derived, typename Call>
+Derived *BasicCallTree<Derived, Call>::addChild(const Call &call,
+                                                std::size_t hash,
+                                                unsigned path_id,
+                                                int is_duplicate) {
+  children_by_hash[hash].push_back(children.size());
+  children.push_back(new Derived());
+  Derived *n = children.back();
+  n->tip.call = call;
+  n->tip.path_id = path_id;
+  n->tip.is_duplicate = is_duplicate;
+  n->tip.hash = hash;
+  return n;
+}
+
+template <typename Derived, typename Call>
+void BasicCallTree<Derived, Call>::addCallPath(
+    typename std::vector<const Call *>::const_iterator path_begin,
+    typename std::vector<const Call *>::const_iterator path_end,
+    unsigned path_id) {
   // TODO: do we process constraints (what if they are different from the old
   // ones?)
   // TODO: record assumptions for each item in the call-path, because, when
   // comparing two paths in the tree they may differ only by the assumptions.
   if (path_begin == path_end)
     return;
-  std::vector<CallInfo>::const_iterator next = path_begin;
+  typename std::vector<const Call *>::const_iterator next = path_begin;
   ++next;
-  std::vector<CallTree *>::iterator i = children.begin(), ie = children.end();
-  for (; i != ie; ++i) {
-    if ((*i)->tip.call.eq(*path_begin)) {
-      if (next == path_end) {
-        /* This adds a duplicate child if two paths end
-                                 similarly */
-        assert(tip.is_duplicate == 0 &&
-               "Trying to add child to a duplicate node");
-        children.push_back(new CallTree());
-        CallTree *n = children.back();
-        n->tip.call = *path_begin;
-        n->tip.path_id = path_id;
-        n->tip.is_duplicate = 1;
-      } else {
-
-        (*i)->addCallPath(next, path_end, path_id);
+  const Call &call = **path_begin;
+  std::size_t hash = call.hash();
+  Derived *match = nullptr;
+  auto candidates = children_by_hash.find(hash);
+  if (candidates != children_by_hash.end()) {
+    for (unsigned ci : candidates->second) {
+      if (children[ci]->tip.call.eq(call)) {
+        match = children[ci];
+        break;
       }
-      return;
     }
   }
-  children.push_back(new CallTree());
-  CallTree *n = children.back();
-  n->tip.call = *path_begin;
-  n->tip.path_id = path_id;
-  n->tip.is_duplicate = 0;
-  n->addCallPath(next, path_end, path_id);
+  if (match) {
+    if (next == path_end) {
+      /* This adds a duplicate child if two paths end
+                               similarly */
+      assert(tip.is_duplicate == 0 &&
+             "Trying to add child to a duplicate node");
+      addChild(call, hash, path_id, 1);
+    } else {
+      match->addCallPath(next, path_end, path_id);
+    }
+    return;
+  }
+  addChild(call, hash, path_id, 0)->addCallPath(next, path_end, path_id);
 }
 
 std::vector<std::vector<CallPathTip *>> CallTree::groupChildren() {
   std::vector<std::vector<CallPathTip *>> ret;
+  /* Indices of the groups by the invocation hash of their first call */
+  std::unordered_map<std::size_t, std::vector<unsigned>> groups_by_hash;
   for (unsigned ci = 0; ci < children.size(); ++ci) {
     CallPathTip *current = &children[ci]->tip;
+    std::vector<unsigned> &candidates =
+        groups_by_hash[current->call.invocationHash()];
     bool groupNotFound = true;
-    for (unsigned gi = 0; gi < ret.size(); ++gi) {
+    for (unsigned gi : candidates) {
       if (current->call.sameInvocation(&ret[gi][0]->call)) {
         ret[gi].push_back(current);
         groupNotFound = false;
@@ -1634,6 +1698,7 @@ std::vector<std::vector<CallPathTip *>> CallTree::groupChildren() {
       }
     }
     if (groupNotFound) {
+      candidates.push_back(ret.size());
       ret.push_back(std::vector<CallPathTip *>());
       ret.back().push_back(current);
     }
@@ -1818,24 +1883,32 @@ void CallTree::dumpCallPrefixes(
   }
 }
 
-void CallTree::dumpCallTree(std::vector<CallPathTip> accumulated_prefix,
-                            llvm::raw_ostream *tree_file,
-                            llvm::raw_ostream *calls_file) {
+static void dumpTreeCall(const CallInfo &call, unsigned path_id, int depth,
+                         llvm::raw_ostream &calls_file) {
+  if (call.returned) {
+    calls_file << "libVig Call:" << path_id << "," << depth << ","
+               << call.f->getName() << "\n";
+    dumpCallInfo(call, calls_file);
+  }
+}
+
+template <typename Derived, typename Call>
+void BasicCallTree<Derived, Call>::dumpCallTree(
+    std::vector<BasicCallPathTip<Call>> accumulated_prefix,
+    llvm::raw_ostream *tree_file, llvm::raw_ostream *calls_file) {
 
   accumulated_prefix.push_back(tip);
-  std::vector<CallTree *>::iterator ci = children.begin(), cie = children.end();
+  typename std::vector<Derived *>::iterator ci = children.begin(),
+                                            cie = children.end();
 
   if (ci == cie) { // Reached leaf node, so print
-    std::vector<CallPathTip>::iterator pi = accumulated_prefix.begin(),
-                                       pie = accumulated_prefix.end();
+    typename std::vector<BasicCallPathTip<Call>>::iterator
+        pi = accumulated_prefix.begin(),
+        pie = accumulated_prefix.end();
     for (int depth = 0; pi != pie; ++pi, ++depth) {
 
       *tree_file << (*pi).path_id << ",";
-      if ((*pi).call.returned) {
-        *calls_file << "libVig Call:" << (*pi).path_id << "," << depth << ","
-                    << (*pi).call.f->getName() << "\n";
-        dumpCallInfo((*pi).call, *calls_file);
-      }
+      dumpTreeCall((*pi).call, (*pi).path_id, depth, *calls_file);
     }
 
     *tree_file << "\n";
@@ -1883,154 +1956,29 @@ void CallTree::dumpCallPrefixesSExpr(std::list<CallInfo> accumulated_prefix,
   }
 }
 
-void ConstraintTree::addTest(int id, ExecutionState &state) {
-
-  std::pair<int, ConstraintSet> last_test;
-  if (id > 1) {
-    // Only perform comparison logic for tests after the first one (id > 1)
-    // The first test (id = 1) should be added without comparison
-    // Check if seen_tests is empty before calling .back()
-    if (seen_tests.empty()) {
-      klee_error("Trying to add test with id %d but no previous tests exist", id);
-    }
-    last_test = seen_tests.back();
-    assert(id == last_test.first + 1 && "Wrong order of tests to be added");
-
-    /* Iterating through constraints of existing test */
-    ConstraintSet constraints(state.constraints);
-    ConstraintSet::const_iterator cit = last_test.second.begin();
-    bool result;
-    uint depths[2] = {0, 0};
-    uint i; /* Needed for assert*/
-    klee::ref<Expr> unsat_constraints[2];
-    for (i = 0; i < last_test.second.size(); i++, cit++) {
-      klee::Query sat_query(constraints, *cit);
-      result = false;
-      bool success = solver->mayBeTrue(sat_query, result);
-      assert(success);
-      if (!result) {
-        depths[0] = i;
-        unsat_constraints[0] = *cit;
-        break;
-      }
-    }
-    assert(i < last_test.second.size() && "Trying to add duplicate test");
-
-    /* Now iterate the other way */
-    constraints = last_test.second;
-    cit = state.constraints.begin();
-    for (i = 0; i < state.constraints.size(); i++, cit++) {
-      klee::Query sat_query(constraints, *cit);
-      result = false;
-      bool success = solver->mayBeTrue(sat_query, result);
-      assert(success);
-      if (!result) {
-        depths[1] = i;
-        unsat_constraints[1] = *cit;
-        break;
-      }
-    }
-    assert(i < state.constraints.size() && "Could not find an unsat constraint");
-
-    /* Some checks */
-    ConstraintSet branch_constraints;
-    ConstraintManager branch_constraints_manager(branch_constraints);
-    branch_constraints_manager.addConstraint(unsat_constraints[0]);
-    klee::Query sat_query(branch_constraints, unsat_constraints[1]);
-    result = false;
-    bool success = solver->mayBeTrue(sat_query, result);
-    assert(success);
-    assert(!result && "Branching constraints are not mutually unsat");
-
-    assert(depths[0] >= depths[1] &&
-           "Constraint patching will go wrong due to incorrect assumptions");
-
-    if (depths[0] > depths[1]) {
-
-      ConstraintSet final_constraints;
-      ConstraintManager final_constraints_manager(final_constraints);
-      /* Fixing constraints */
-      for (i = 0, cit = last_test.second.begin(); i < depths[0]; i++, cit++)
-        final_constraints_manager.addConstraint(*cit);
-
-      for (i = depths[1], cit = state.constraints.begin() + depths[1];
-           i < state.constraints.size(); i++, cit++)
-        final_constraints_manager.addConstraint(*cit);
-
-      state.constraints = final_constraints;
-    }
-
-    std::pair<int, int> test_pair (last_test.first, id);
-    overlap_depth.insert({test_pair,depths[0]+1});
-    branch.insert({test_pair, std::vector<ref<Expr>>()});
-    branch[test_pair].push_back(unsat_constraints[0]);
-    branch[test_pair].push_back(unsat_constraints[1]);
-  }
-  
-  // Always add the test to seen_tests, regardless of whether comparison logic was performed
-  std::cout << "Added test number: " << id <<"\n";
-  seen_tests.push_back(std::make_pair(id, state.constraints));
-  overlap_depth.insert({std::minmax(id,id), state.constraints.size()+1});
-}
-
-void ConstraintTree::buildTree() {
-
-  for (auto it : seen_tests) {
-    overlap_depth.insert(
-        {std::minmax(it.first, it.first), it.second.size() + 1});
-
-    for (uint j = it.first + 1; j < seen_tests.size(); j++) {
-      auto it1 = seen_tests[j]; // Horrible code, need to change
-
-      std::pair<int, int> test_pair = std::minmax(it1.first, it.first);
-
-      /* Iterating through constraints of existing test */
-      ConstraintSet constraints = it1.second;
-      ConstraintSet::const_iterator cit = it.second.begin();
-      bool result;
-      uint i; /* Needed for assert*/
-      for (i = 0; i < it.second.size(); i++, cit++) {
-        klee::Query sat_query(constraints, *cit);
-        result = false;
-        bool success = solver->mayBeTrue(sat_query, result);
-        assert(success);
-        if (!result) {
-          overlap_depth.insert({test_pair, i + 1});
-          branch.insert({test_pair, std::vector<ref<Expr>>()});
-          branch[test_pair].push_back(*cit);
-          break;
-        }
-      }
-      assert(i < it.second.size() && "Trying to add duplicate test");
-      klee::ref<Expr> branch1 = *cit;
-
-      uint first_iter_depth = i;
-
-      /* Now iterate the other way */
-      constraints = it.second;
-      cit = it1.second.begin();
-      for (i = 0; i < it1.second.size(); i++, cit++) {
-        klee::Query sat_query(constraints, *cit);
-        result = false;
-        bool success = solver->mayBeTrue(sat_query, result);
-        assert(success);
-        if (!result) {
-          break;
-        }
-      }
-      assert(first_iter_depth == i &&
-             "Tree generation algorithm will fail due to mismatched prefixes");
-      ConstraintSet branch_constraints;
-      ConstraintManager branch_constraints_manager(branch_constraints);
-      branch_constraints_manager.addConstraint(branch1);
-      klee::Query sat_query(branch_constraints, *cit);
-      result = false;
-      bool success = solver->mayBeTrue(sat_query, result);
-      assert(success);
-      assert(!result && "Branching constraints are not mutually unsat");
-      branch[test_pair].push_back(*cit);
+void ConstraintTree::addTest(int id, const ExecutionState &state) {
+  // The first test has nothing to be compared with.
+  if (last_id != 0) {
+    assert(id > last_id && "Wrong order of tests to be added");
+
+    // Both tests took a different branch at the last fork they share.
+    const PTreeFork *last_branch, *this_branch;
+    if (!PTreeFork::divergence(last_fork.get(), state.lastFork.get(),
+                               last_branch, this_branch)) {
+      klee_error("Tests %d and %d do not diverge at any fork", last_id, id);
     }
+
+    std::pair<int, int> test_pair(last_id, id);
+    overlap_depth.insert({test_pair, last_branch->constraintDepth + 1});
+    std::vector<ref<Expr>> &branch_constraints = branch[test_pair];
+    branch_constraints.push_back(last_branch->condition);
+    branch_constraints.push_back(this_branch->condition);
   }
+
+  std::cout << "Added test number: " << id << "\n";
+  last_id = id;
+  last_fork = state.lastFork;
+  overlap_depth.insert({std::minmax(id, id), state.constraints.size() + 1});
 }
 
 void ConstraintTree::dumpConstraintTree(llvm::raw_ostream *tree_file,
@@ -2048,6 +1996,502 @@ void ConstraintTree::dumpConstraintTree(llvm::raw_ostream *tree_file,
   }
 }
 
+//===----------------------------------------------------------------------===//
+// Merging the runs of path prefixes (-merge-path-prefix-runs)
+//
+
+namespace {
+/* A call as CallTree::dumpCallTree wrote it to calls.txt. Calls that did not
+   return are not written there; their text names the node of the run they
+   were in instead, so that they are only taken for calls of the same node. */
+struct DumpedCall {
+  std::string function;
+  std::string text;
+  bool returned = false;
+
+  std::size_t hash() const {
+    return std::hash<std::string>()(function) ^ std::hash<std::string>()(text);
+  }
+  bool eq(const DumpedCall &other) const {
+    return returned == other.returned && function == other.function &&
+           text == other.text;
+  }
+};
+
+void dumpTreeCall(const DumpedCall &call, unsigned path_id, int depth,
+                  llvm::raw_ostream &calls_file) {
+  if (call.returned)
+    calls_file << "libVig Call:" << path_id << "," << depth << ","
+               << call.function << "\n"
+               << call.text;
+}
+
+class DumpedCallTree : public BasicCallTree<DumpedCallTree, DumpedCall> {};
+
+/* A record of constraint-tree.txt or constraint-branches.txt: a pair of
+   tests and a value, which may span several lines. */
+struct TestPairRecord {
+  unsigned first, second;
+  std::string value;
+};
+
+/* The runs of -emit-path-prefixes and -replay-path-prefix, as klee-distribute
+   lays them out in <output dir>/runs: the split run in split/, and the run
+   of the prefix of test N of the split run in testN/ (empty if another
+   prefix was the same). */
+class PathPrefixRuns {
+  std::string outputDir;
+  std::string splitDir;
+  /* The run directories, by the id of their prefix in the split run */
+  std::map<unsigned, std::string> runs;
+  /* The new ids of the tests of each run directory, by their old id */
+  std::map<std::string, std::map<unsigned, unsigned>> mappings;
+  /* The new ids of the tests that take the place of each test of the split
+     run: the test itself, or the tests found under its prefix */
+  std::map<unsigned, std::vector<unsigned>> expansion;
+
+  std::string getPath(const std::string &dir, const std::string &name) const;
+  std::vector<std::string> getRunDirs() const;
+  void moveFile(const std::string &from, const std::string &to) const;
+  std::unique_ptr<llvm::raw_fd_ostream>
+  openOutputFile(const std::string &name) const;
+  void mergeTests();
+  void mergeCallPathFiles();
+  void mergeConstraintTrees();
+  void mergeCallTrees();
+  void mergeReusedSymbols();
+
+public:
+  explicit PathPrefixRuns(const std::string &outputDir);
+  void merge();
+  /* The sums of the "KLEE: done:" statistics of the runs */
+  std::map<std::string, uint64_t> getStats() const;
+};
+} // namespace
+
+/* Splits `name` into the id and suffix of <prefix>NNNNNN.<suffix>. */
+static bool parseTestFilename(const std::string &name,
+                              const std::string &prefix, unsigned &id,
+                              std::string &suffix) {
+  if (name.compare(0, prefix.size(), prefix))
+    return false;
+  size_t dot = name.find('.', prefix.size());
+  if (dot == std::string::npos || dot - prefix.size() < 6)
+    return false;
+  for (size_t i = prefix.size(); i < dot; ++i)
+    if (!isdigit(name[i]))
+      return false;
+  id = std::stoul(name.substr(prefix.size(), dot - prefix.size()));
+  suffix = name.substr(dot + 1);
+  return true;
+}
+
+/* The names of the files in `dir`, sorted. */
+static std::vector<std::string> getFilenames(const std::string &dir) {
+  std::vector<std::string> names;
+  std::error_code ec;
+  llvm::sys::fs::directory_iterator i(dir, ec), e;
+  for (; i != e && !ec; i.increment(ec))
+    names.push_back(sys::path::filename(i->path()).str());
+  if (ec)
+    klee_error("unable to read directory %s: %s", dir.c_str(),
+               ec.message().c_str());
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+/* The files of the tests of a run, by test id. */
+static std::map<unsigned, std::vector<std::string>>
+getTestFiles(const std::string &dir) {
+  std::map<unsigned, std::vector<std::string>> tests;
+  for (const std::string &name : getFilenames(dir)) {
+    unsigned id;
+    std::string suffix;
+    if (parseTestFilename(name, "test", id, suffix))
+      tests[id].push_back(name);
+  }
+  return tests;
+}
+
+/* The records of a constraint tree file, if it exists. */
+static std::vector<TestPairRecord> readTestPairs(const std::string &path) {
+  std::vector<TestPairRecord> records;
+  std::ifstream f(path);
+  std::string line;
+  while (std::getline(f, line)) {
+    size_t bar = line.find('|'), bar2 = line.find('|', bar + 1);
+    bool isRecord = bar2 != std::string::npos && bar > 0 && bar2 > bar + 1 &&
+                    std::all_of(line.begin(), line.begin() + bar2, [](char c) {
+                      return c == '|' || isdigit(c);
+                    });
+    if (isRecord) {
+      records.push_back({(unsigned)std::stoul(line.substr(0, bar)),
+                         (unsigned)std::stoul(line.substr(bar + 1)),
+                         line.substr(bar2 + 1) + "\n"});
+    } else if (!records.empty()) {
+      records.back().value += line + "\n";
+    }
+  }
+  return records;
+}
+
+PathPrefixRuns::PathPrefixRuns(const std::string &outputDir)
+    : outputDir(outputDir), splitDir(getPath(outputDir, "runs/split")) {
+  for (const auto &test : getTestFiles(splitDir)) {
+    std::ostringstream prefix;
+    prefix << "test" << std::setfill('0') << std::setw(6) << test.first;
+    if (std::find(test.second.begin(), test.second.end(),
+                  prefix.str() + ".prefix") == test.second.end())
+      continue;
+    std::string run = getPath(outputDir, "runs/" + prefix.str());
+    if (!sys::fs::is_directory(run))
+      klee_error("no run of the prefix of test %u in %s", test.first,
+                 run.c_str());
+    runs[test.first] = run;
+  }
+}
+
+std::string PathPrefixRuns::getPath(const std::string &dir,
+                                    const std::string &name) const {
+  SmallString<128> path(dir);
+  sys::path::append(path, name);
+  return path.str().str();
+}
+
+std::vector<std::string> PathPrefixRuns::getRunDirs() const {
+  std::vector<std::string> dirs{splitDir};
+  for (const auto &run : runs)
+    dirs.push_back(run.second);
+  return dirs;
+}
+
+void PathPrefixRuns::moveFile(const std::string &from,
+                              const std::string &to) const {
+  if (std::error_code ec = sys::fs::rename(from, to))
+    klee_error("unable to move %s to %s: %s", from.c_str(), to.c_str(),
+               ec.message().c_str());
+}
+
+std::unique_ptr<llvm::raw_fd_ostream>
+PathPrefixRuns::openOutputFile(const std::string &name) const {
+  std::string path = getPath(outputDir, name), error;
+  auto f = klee_open_output_file(path, error);
+  if (!f)
+    klee_error("cannot open %s: %s", path.c_str(), error.c_str());
+  return f;
+}
+
+void PathPrefixRuns::merge() {
+  mergeTests();
+  mergeCallPathFiles();
+  mergeConstraintTrees();
+  mergeCallTrees();
+  mergeReusedSymbols();
+}
+
+/* Numbers the tests in the order of the split run, where the tests found
+   under a prefix take its place, and moves them to the output directory. */
+void PathPrefixRuns::mergeTests() {
+  std::set<unsigned> splitIds;
+  for (const auto &test : getTestFiles(splitDir))
+    splitIds.insert(test.first);
+  for (const TestPairRecord &r :
+       readTestPairs(getPath(splitDir, "constraint-tree.txt")))
+    splitIds.insert(r.first);
+
+  unsigned nextId = 1;
+  for (unsigned splitId : splitIds) {
+    auto run = runs.find(splitId);
+    if (run == runs.end()) {
+      mappings[splitDir][splitId] = nextId;
+      expansion[splitId].push_back(nextId++);
+      continue;
+    }
+    std::set<unsigned> ids;
+    for (const auto &test : getTestFiles(run->second))
+      ids.insert(test.first);
+    for (const TestPairRecord &r :
+         readTestPairs(getPath(run->second, "constraint-tree.txt")))
+      ids.insert(r.first);
+    std::map<unsigned, unsigned> &mapping = mappings[run->second];
+    std::vector<unsigned> &tests = expansion[splitId];
+    for (unsigned id : ids) {
+      mapping[id] = nextId;
+      tests.push_back(nextId++);
+    }
+  }
+
+  for (const auto &it : mappings) {
+    const std::string &dir = it.first;
+    for (const auto &test : getTestFiles(dir)) {
+      if (dir == splitDir && runs.count(test.first))
+        continue; // the prefix itself
+      for (const std::string &name : test.second) {
+        unsigned id;
+        std::string suffix;
+        parseTestFilename(name, "test", id, suffix);
+        std::ostringstream newName;
+        newName << "test" << std::setfill('0') << std::setw(6)
+                << it.second.at(id) << '.' << suffix;
+        moveFile(getPath(dir, name), getPath(outputDir, newName.str()));
+      }
+    }
+  }
+}
+
+/* The call path files of -dump-call-traces, numbered in run order. */
+void PathPrefixRuns::mergeCallPathFiles() {
+  unsigned nextId = 1;
+  for (const std::string &dir : getRunDirs()) {
+    for (const std::string &name : getFilenames(dir)) {
+      unsigned id;
+      std::string suffix;
+      if (!parseTestFilename(name, "call-path", id, suffix) || suffix != "txt")
+        continue;
+      std::ostringstream newName;
+      newName << "call-path" << std::setfill('0') << std::setw(6) << nextId++
+              << ".txt";
+      moveFile(getPath(dir, name), getPath(outputDir, newName.str()));
+    }
+  }
+}
+
+/* The constraint trees of the runs, joined where their tests follow each
+   other in the split run. */
+void PathPrefixRuns::mergeConstraintTrees() {
+  std::string treeFile = getPath(splitDir, "constraint-tree.txt");
+  if (!sys::fs::exists(treeFile))
+    return;
+
+  std::map<std::pair<unsigned, unsigned>, std::string> depths;
+  std::map<std::pair<unsigned, unsigned>, std::vector<std::string>> branches;
+  for (const auto &run : runs) {
+    const std::map<unsigned, unsigned> &mapping = mappings[run.second];
+    for (const TestPairRecord &r :
+         readTestPairs(getPath(run.second, "constraint-tree.txt")))
+      depths[{mapping.at(r.first), mapping.at(r.second)}] = r.value;
+    for (const TestPairRecord &r :
+         readTestPairs(getPath(run.second, "constraint-branches.txt")))
+      branches[{mapping.at(r.first), mapping.at(r.second)}].push_back(r.value);
+  }
+
+  // The tests of neighbouring split tests diverge where those do. Split tests
+  // without tests of their own are bridged by the shallowest divergence
+  // around them, which is where their neighbours diverge when the split run
+  // explored depth-first.
+  std::map<std::pair<unsigned, unsigned>, std::vector<std::string>>
+      splitBranches;
+  for (const TestPairRecord &r :
+       readTestPairs(getPath(splitDir, "constraint-branches.txt")))
+    splitBranches[{r.first, r.second}].push_back(r.value);
+  std::vector<TestPairRecord> splitPairs = readTestPairs(treeFile);
+  std::stable_sort(splitPairs.begin(), splitPairs.end(),
+                   [](const TestPairRecord &a, const TestPairRecord &b) {
+                     return std::make_pair(a.second, a.first) <
+                            std::make_pair(b.second, b.first);
+                   });
+  bool hasLast = false;
+  unsigned last = 0;
+  const TestPairRecord *bridge = nullptr;
+  for (const TestPairRecord &r : splitPairs) {
+    if (r.first == r.second) {
+      if (!runs.count(r.first)) {
+        unsigned id = expansion[r.first].front();
+        depths[{id, id}] = r.value;
+      }
+      continue;
+    }
+    if (!bridge || std::stoul(r.value) < std::stoul(bridge->value))
+      bridge = &r;
+    const std::vector<unsigned> &before = expansion[r.first];
+    const std::vector<unsigned> &after = expansion[r.second];
+    if (!hasLast && !before.empty()) {
+      hasLast = true;
+      last = before.back();
+    }
+    if (after.empty())
+      continue;
+    if (hasLast) {
+      depths[{last, after.front()}] = bridge->value;
+      branches[{last, after.front()}] =
+          splitBranches[{bridge->first, bridge->second}];
+    } else if (before.empty()) {
+      klee_warning("no tests before test %u to compare it with",
+                   after.front());
+    }
+    hasLast = true;
+    last = after.back();
+    bridge = nullptr;
+  }
+
+  auto tree = openOutputFile("constraint-tree.txt");
+  for (const auto &it : depths)
+    *tree << it.first.first << "|" << it.first.second << "|" << it.second;
+  auto constraints = openOutputFile("constraint-branches.txt");
+  for (const auto &it : branches)
+    for (const std::string &value : it.second)
+      *constraints << it.first.first << "|" << it.first.second << "|"
+                   << value;
+}
+
+/* The call paths of the runs, added to a single call tree in the order of
+   their new ids, as a single run would have added them. */
+void PathPrefixRuns::mergeCallTrees() {
+  std::vector<std::pair<unsigned, std::vector<DumpedCall>>> paths;
+  bool found = false;
+  for (const std::string &dir : getRunDirs()) {
+    std::ifstream tree(getPath(dir, "call-tree.txt"));
+    if (!tree)
+      continue;
+    found = true;
+
+    std::map<std::pair<unsigned, unsigned>, DumpedCall> calls;
+    std::ifstream callsFile(getPath(dir, "calls.txt"));
+    std::string line;
+    DumpedCall *current = nullptr;
+    while (std::getline(callsFile, line)) {
+      unsigned id, depth;
+      int end = 0;
+      if (sscanf(line.c_str(), "libVig Call:%u,%u,%n", &id, &depth, &end) ==
+              2 &&
+          end) {
+        current = &calls[{id, depth}];
+        current->function = line.substr(end);
+        current->text.clear();
+        current->returned = true;
+      } else if (current) {
+        current->text += line + "\n";
+      }
+    }
+
+    const std::map<unsigned, unsigned> &mapping = mappings[dir];
+    while (std::getline(tree, line)) {
+      std::vector<unsigned> ids;
+      std::istringstream fields(line);
+      std::string field;
+      while (std::getline(fields, field, ','))
+        if (!field.empty())
+          ids.push_back(std::stoul(field));
+      if (ids.size() < 2)
+        continue;
+      std::vector<DumpedCall> path;
+      for (unsigned depth = 1; depth < ids.size(); ++depth) {
+        DumpedCall &call = calls[{ids[depth], depth}];
+        if (!call.returned)
+          call.text = std::to_string(ids[depth]) + "@" + dir;
+        path.push_back(call);
+      }
+      paths.emplace_back(mapping.at(ids.back()), std::move(path));
+    }
+  }
+  if (!found)
+    return;
+
+  std::stable_sort(paths.begin(), paths.end(),
+                   [](const std::pair<unsigned, std::vector<DumpedCall>> &a,
+                      const std::pair<unsigned, std::vector<DumpedCall>> &b) {
+                     return a.first < b.first;
+                   });
+  DumpedCallTree root;
+  for (const auto &path : paths) {
+    std::vector<const DumpedCall *> calls;
+    for (const DumpedCall &call : path.second)
+      calls.push_back(&call);
+    root.addCallPath(calls.begin(), calls.end(), path.first);
+  }
+
+  auto treeFile = openOutputFile("call-tree.txt");
+  auto callsFile = openOutputFile("calls.txt");
+  if (!paths.empty())
+    root.dumpCallTree(std::vector<BasicCallPathTip<DumpedCall>>(),
+                      treeFile.get(), callsFile.get());
+}
+
+void PathPrefixRuns::mergeReusedSymbols() {
+  std::vector<std::string> lines;
+  std::set<std::string> seen;
+  bool found = false;
+  for (const std::string &dir : getRunDirs()) {
+    std::ifstream f(getPath(dir, "reused-symbols.txt"));
+    if (!f)
+      continue;
+    found = true;
+    std::string line;
+    while (std::getline(f, line))
+      if (seen.insert(line).second)
+        lines.push_back(line);
+  }
+  if (!found)
+    return;
+  auto f = openOutputFile("reused-symbols.txt");
+  for (const std::string &line : lines)
+    *f << line << "\n";
+}
+
+std::map<std::string, uint64_t> PathPrefixRuns::getStats() const {
+  std::map<std::string, uint64_t> totals;
+  const std::string done = "KLEE: done: ";
+  for (const std::string &dir : getRunDirs()) {
+    std::ifstream f(getPath(dir, "info"));
+    std::string line;
+    while (std::getline(f, line)) {
+      size_t equals = line.rfind(" = ");
+      if (line.compare(0, done.size(), done) || equals == std::string::npos ||
+          equals + 3 == line.size() ||
+          !std::all_of(line.begin() + equals + 3, line.end(), ::isdigit))
+        continue;
+      totals[line.substr(done.size(), equals - done.size())] +=
+          std::stoull(line.substr(equals + 3));
+    }
+  }
+  return totals;
+}
+
+/* Merges the runs of klee-distribute into the output directory as if a
+   single run had written them, and prints their statistics. */
+static int mergePathPrefixRuns(int argc, char **argv) {
+  if (OutputDir.empty())
+    klee_error("-merge-path-prefix-runs requires -output-dir");
+
+  PathPrefixRuns runs(OutputDir);
+  runs.merge();
+
+  std::map<std::string, uint64_t> totals = runs.getStats();
+  // The prefixes were replaced by the tests found under them.
+  totals.erase("path prefixes");
+  totals["generated tests"] = 0;
+  for (const std::string &name : getFilenames(OutputDir))
+    if (llvm::StringRef(name).endswith(".ktest"))
+      ++totals["generated tests"];
+
+  std::stringstream stats;
+  stats << "\n";
+  for (const char *name :
+       {"total instructions", "completed paths", "generated tests"})
+    if (totals.count(name))
+      stats << "KLEE: done: " << name << " = " << totals[name] << "\n";
+
+  bool useColors = llvm::errs().is_displayed();
+  if (useColors)
+    llvm::errs().changeColor(llvm::raw_ostream::GREEN,
+                             /*bold=*/true,
+                             /*bg=*/false);
+  llvm::errs() << stats.str();
+  if (useColors)
+    llvm::errs().resetColor();
+
+  std::string error;
+  SmallString<128> infoPath(OutputDir);
+  sys::path::append(infoPath, "info");
+  auto info = klee_open_output_file(infoPath.str().str(), error);
+  if (!info)
+    klee_error("cannot open %s: %s", infoPath.c_str(), error.c_str());
+  for (int i = 0; i < argc; i++)
+    *info << argv[i] << (i + 1 < argc ? " " : "\n");
+  *info << stats.str();
+  return 0;
+}
+
 //===----------------------------------------------------------------------===//
 // main Driver function
 //
@@ -2566,6 +3010,9 @@ int main(int argc, char **argv, char **envp) {
   sys::PrintStackTraceOnErrorSignal();
 #endif
 
+  if (MergePathPrefixRuns)
+    return mergePathPrefixRuns(argc, argv);
+
   if (Watchdog) {
     if (MaxTime.empty()) {
       klee_error("--watchdog used without --max-time");
@@ -2794,6 +3241,12 @@ int main(int argc, char **argv, char **envp) {
   Interpreter::InterpreterOptions IOpts;
   IOpts.MakeConcreteSymbolic = MakeConcreteSymbolic;
   IOpts.CondoneUndeclaredHavocs = CondoneUndeclaredHavocs;
+  IOpts.ParallelWorkers = ParallelWorkers;
+  IOpts.PathPrefixDepth = EmitPathPrefixes;
+  IOpts.ReplayPathIsPrefix = ReplayPathPrefix;
+  IOpts.RecordInstructionTrace = DumpCallTraceInstructions;
+  if (ReplayPathPrefix && ReplayPathFile == "")
+    klee_error("-replay-path-prefix requires -replay-path");
   KleeHandler *handler = new KleeHandler(pArgc, pArgv);
   Interpreter *interpreter = theInterpreter =
       Interpreter::create(ctx, IOpts, handler);
@@ -2922,16 +3375,7 @@ int main(int argc, char **argv, char **envp) {
     interpreter->runFunctionAsMain(mainFn, pArgc, pArgv, pEnvp);
     handler->getInfoStream() << "KLEE: saving call prefixes \n";
 
-    if (DumpCallTracePrefixes)
-      handler->dumpCallPathPrefixes();
-
-    if (DumpCallTraceTree)
-      handler->dumpCallPathTree();
-
-    if (DumpConstraintTree)
-      handler->dumpConstraintTree();
-
-    handler->dumpReusedSymbols();
+    handler->dumpExplorationTrees();
 
     while (!seeds.empty()) {
       kTest_free(seeds.back());
@@ -2939,6 +3383,9 @@ int main(int argc, char **argv, char **envp) {
     }
   }
 
+  for (SolverService *service : interpreter->getSolverServices())
+    service->printClientStats(handler->getInfoStream(), "KLEE: done: ");
+
   auto endTime = std::time(nullptr);
   { // output end and elapsed time
     std::uint32_t h;
@@ -2998,6 +3445,9 @@ int main(int argc, char **argv, char **envp) {
         << "\n";
   stats << "KLEE: done: generated tests = " << handler->getNumTestCases()
         << "\n";
+  if (EmitPathPrefixes)
+    stats << "KLEE: done: path prefixes = " << handler->getNumPathPrefixes()
+          << "\n";
 
   bool useColors = llvm::errs().is_displayed();
   if (useColors)
@@ -9,6 +9,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/CallPathFile.h"
 #include "klee/Expr/ExprBuilder.h"
 #include "klee/perf-contracts.h"
 #include "llvm/Support/CommandLine.h"
@@ -17,10 +19,22 @@
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverService.h"
+#include "klee/Support/CallPathArchive.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
 #include <dlfcn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
+#include <sstream>
 #include <vector>
 #include <deque>
 
@@ -37,9 +51,37 @@ llvm::cl::opt<std::string> UserVariables(
     "user-vars",
     llvm::cl::desc("Sets the value of user variables (var1=val1,var2=val2)."));
 
-llvm::cl::opt<std::string> InputCallPathFile(llvm::cl::desc("<call path>"),
-                                             llvm::cl::Positional,
-                                             llvm::cl::Required);
+llvm::cl::list<std::string> InputCallPathFiles(llvm::cl::desc("<call path>..."),
+                                               llvm::cl::Positional,
+                                               llvm::cl::ZeroOrMore);
+
+llvm::cl::opt<std::string> CallPathDir(
+    "call-path-dir",
+    llvm::cl::desc("Stitch every .call_path file and call path archive in "
+                   "this directory."));
+
+llvm::cl::opt<std::string> CallPathList(
+    "call-path-list",
+    llvm::cl::desc("Stitch every call path listed (one per line) in this "
+                   "file."));
+
+llvm::cl::opt<std::string> OutputFile(
+    "output",
+    llvm::cl::desc("Write the consolidated results of a batch run to this "
+                   "file (default=stdout)."),
+    llvm::cl::init("-"));
+
+llvm::cl::opt<unsigned> NumWorkers(
+    "workers",
+    llvm::cl::desc("Number of worker processes stitching call paths in a "
+                   "batch run (default=1)."),
+    llvm::cl::init(1));
+
+llvm::cl::opt<bool> SolverClientStats(
+    "solver-client-stats",
+    llvm::cl::desc("Print the queries and cache hits of each solver client "
+                   "to stderr (default=false)."),
+    llvm::cl::init(false));
 } // namespace
 
 typedef struct {
@@ -69,6 +111,15 @@ bool operator<(initial_var_t a, initial_var_t b) {
 }
 
 typedef struct {
+  /* What the call path was parsed with, freed with it. Its arrays live in
+     the ArrayCache of the run, as the solver caches may still refer to
+     them. */
+  std::unique_ptr<klee::CallPathFile> binary;
+  std::unique_ptr<llvm::MemoryBuffer> kquery;
+  std::unique_ptr<klee::ExprBuilder> builder;
+  std::unique_ptr<klee::expr::Parser> parser;
+  std::vector<std::unique_ptr<klee::expr::Decl>> decls;
+
   klee::ConstraintSet constraints;
   std::vector<call_t> calls;
   std::map<std::string, const klee::Array *> arrays;
@@ -86,15 +137,42 @@ PCVAbstraction PCVAbs = LOOP_CTRS;
 call_path_t *load_call_path(std::string file_name,
                             std::vector<std::string> expressions_str,
                             std::deque<klee::ref<klee::Expr>> &expressions,
-                            void *contract) {
+                            void *contract, klee::ArrayCache &arrays) {
   LOAD_SYMBOL(contract, contract_get_symbol_size);
   LOAD_SYMBOL(contract, contract_get_symbols);
 
-  std::ifstream call_path_file(file_name);
-  assert(call_path_file.is_open() && "Unable to open call path file.");
+  std::string call_path_str, error;
+  if (!klee::readCallPathFile(file_name, call_path_str, error)) {
+    std::cerr << "Error: Unable to read call path " << file_name << ": "
+              << error << std::endl;
+    exit(-1);
+  }
 
   call_path_t *call_path = new call_path_t;
 
+  /* A binary call path already holds the parsed kQuery; only the text
+     sections are left for the passes below. */
+  klee::CallPathFile *binary = nullptr;
+  if (klee::CallPathFile::isBinary(call_path_str)) {
+    call_path->binary.reset(new klee::CallPathFile(&arrays));
+    binary = call_path->binary.get();
+    if (!binary->readBinary(call_path_str, error)) {
+      std::cerr << "Error: Invalid call path " << file_name << ": " << error
+                << std::endl;
+      exit(-1);
+    }
+    for (const klee::Array *array : binary->arrays) {
+      call_path->arrays[array->name] = array;
+    }
+    call_path->constraints = klee::ConstraintSet(binary->constraints);
+
+    call_path_str.clear();
+    llvm::raw_string_ostream sections(call_path_str);
+    binary->writeText(sections, false);
+    sections.flush();
+  }
+  std::istringstream call_path_file(call_path_str);
+
   enum {
     PASS_ARRAYS,
     PASS_PARSE,
@@ -119,6 +197,11 @@ call_path_t *load_call_path(std::string file_name,
     std::vector<klee::ref<klee::Expr>> exprs;
     std::set<std::string>
         declared_arrays; /* Set of all arrays declared in the kQuery */
+    if (binary) {
+      for (auto ait : call_path->arrays) {
+        declared_arrays.insert(ait.first);
+      }
+    }
 
     int parenthesis_level = 0;
 
@@ -142,6 +225,12 @@ call_path_t *load_call_path(std::string file_name,
           state = STATE_CALLS;
 
           if (pass == PASS_PARSE) {
+            if (binary) {
+              /* Only the extra symbols and expressions are left to parse,
+                 against the arrays of the binary call path. */
+              kQuery = "(query [] false)";
+            }
+
             for (auto ait : contract_get_symbols()) {
               /* Symbols is the set of symbols in the
                  contract, each of the form ->
@@ -186,11 +275,19 @@ call_path_t *load_call_path(std::string file_name,
               }
             }
 
-            std::unique_ptr<llvm::MemoryBuffer> MB = llvm::MemoryBuffer::getMemBuffer(kQuery);
-            klee::ExprBuilder *Builder = klee::createDefaultExprBuilder();
-            klee::expr::Parser *P =
-                klee::expr::Parser::Create("", MB.get(), Builder, false);
+            call_path->kquery = llvm::MemoryBuffer::getMemBufferCopy(kQuery);
+            call_path->builder.reset(klee::createDefaultExprBuilder());
+            call_path->parser.reset(klee::expr::Parser::Create(
+                "", call_path->kquery.get(), call_path->builder.get(), false,
+                &arrays));
+            klee::expr::Parser *P = call_path->parser.get();
+            if (binary) {
+              for (const klee::Array *array : binary->arrays) {
+                P->DeclareArray(array);
+              }
+            }
             while (klee::expr::Decl *D = P->ParseTopLevelDecl()) {
+              call_path->decls.emplace_back(D);
               assert(!P->GetNumErrors() &&
                      "Error parsing kquery in call path file.");
               if (klee::expr::ArrayDecl *AD =
@@ -198,9 +295,15 @@ call_path_t *load_call_path(std::string file_name,
                 call_path->arrays[AD->Root->name] = AD->Root;
               } else if (klee::expr::QueryCommand *QC =
                              llvm::dyn_cast<klee::expr::QueryCommand>(D)) {
-                call_path->constraints =
-                    klee::ConstraintSet(QC->Constraints);
-                exprs = QC->Values;
+                if (binary) {
+                  exprs = binary->values;
+                  exprs.insert(exprs.end(), QC->Values.begin(),
+                               QC->Values.end());
+                } else {
+                  call_path->constraints =
+                      klee::ConstraintSet(QC->Constraints);
+                  exprs = QC->Values;
+                }
                 break;
               }
             }
@@ -426,7 +529,8 @@ std::map<std::string, long> process_candidate(
     call_path_t *call_path, void *contract,
     std::map<initial_var_t, klee::ref<klee::Expr>> vars,
     std::map<std::string, std::map<std::string, std::set<int>>> &cstate,
-    std::map<std::string, perf_formula> &total_performance_formula) {
+    std::map<std::string, perf_formula> &total_performance_formula,
+    klee::Solver *solver) {
   LOAD_SYMBOL(contract, contract_get_metrics);
   LOAD_SYMBOL(contract, contract_get_user_variables);
   LOAD_SYMBOL(contract, contract_get_optimization_variables);
@@ -473,12 +577,6 @@ std::map<std::string, long> process_candidate(
   }
 #endif
 
-  klee::Solver *solver = klee::createCoreSolver(klee::Z3_SOLVER);
-  assert(solver);
-  solver = createCexCachingSolver(solver);
-  solver = createCachingSolver(solver);
-  solver = createIndependentSolver(solver);
-
   klee::ConstraintSet constraints = call_path->constraints;
   klee::ConstraintManager constraints_manager(constraints);
 
@@ -738,119 +836,70 @@ std::map<std::string, long> process_candidate(
   return total_performance;
 }
 
-int main(int argc, char **argv, char **envp) {
-  llvm::cl::ParseCommandLineOptions(argc, argv);
-
-  dlerror();
-  const char *err = NULL;
-  void *contract = dlopen(ContractLib.c_str(), RTLD_NOW);
-  if ((err = dlerror())) {
-    std::cerr << "Error: Unable to load contract plugin " << ContractLib << ": "
-              << err << std::endl;
-    exit(-1);
-  }
-  assert(contract);
-
-  // Get contract symbols
-  LOAD_SYMBOL(contract, contract_init);
-  LOAD_SYMBOL(contract, contract_get_metrics);
-  LOAD_SYMBOL(contract, contract_get_user_variables);
-  LOAD_SYMBOL(contract, contract_get_optimization_variables);
-  LOAD_SYMBOL(contract, contract_get_contracts);
-  LOAD_SYMBOL(contract, contract_has_contract);
-  LOAD_SYMBOL(contract, contract_num_sub_contracts);
-  LOAD_SYMBOL(contract, contract_get_subcontract_constraints);
-  LOAD_SYMBOL(contract, contract_get_sub_contract_performance);
-  LOAD_SYMBOL(contract, contract_display_perf_formula);
-
-  contract_init();
-
-  std::map<std::string, std::string> user_variables_str =
-      contract_get_user_variables();
+/* Everything derived from the contract that does not depend on the call
+   path; computed once per run. */
+typedef struct {
+  void *contract;
+  std::map<std::string, std::string> user_variables_str;
   std::set<std::string> overriden_user_variables;
-
-  /* Incorporating user-provided PCVs to bind all user variables */
-
-  std::string user_variables_param = UserVariables;
-  while (!user_variables_param.empty()) {
-    std::string user_variable_string =
-        user_variables_param.substr(0, user_variables_param.find(","));
-    user_variables_param =
-        user_variable_string.size() == user_variables_param.size()
-            ? ""
-            : user_variables_param.substr(user_variable_string.size() + 1);
-
-    std::string user_var =
-        user_variable_string.substr(0, user_variable_string.find("="));
-    std::string user_val =
-        user_variable_string.substr(user_variable_string.find("=") + 1);
-
-    if (!user_variables_str.count(user_var)) {
-      std::cerr << "Error: User variable " << user_var
-                << " not defined in contract." << std::endl
-                << "Error: Valid user variables:" << std::endl;
-      for (auto it : user_variables_str) {
-        std::cerr << "Error:   " << it.first << std::endl;
-      }
-      exit(-1);
-    }
-
-    user_variables_str[user_var] = user_val;
-    overriden_user_variables.insert(user_var);
-  }
-
-  /* Getting OVs */
-
-  std::map<std::string, std::set<std::string>> optimization_variables_str =
-      contract_get_optimization_variables();
-
-  /* Getting all subcontracts */
-
+  std::map<std::string, std::set<std::string>> optimization_variables_str;
   std::map<std::pair<std::string, int>, std::string>
       subcontract_constraints_str;
-  for (auto function_name : contract_get_contracts()) {
-    for (int sub_contract_idx = 0;
-         sub_contract_idx < contract_num_sub_contracts(function_name);
-         sub_contract_idx++) {
-      subcontract_constraints_str[std::make_pair(function_name,
-                                                 sub_contract_idx)] =
-          contract_get_subcontract_constraints(function_name, sub_contract_idx);
-    }
+  std::vector<std::string> expressions_str;
+} stitch_context_t;
+
+/* The solvers of a run: the bindings of the optimization variables and the
+   candidate subcontracts are checked through a shared chain, whose caches
+   are kept across call paths. */
+struct solvers_t {
+  /* The arrays of all call paths, declared first to outlive the caches.
+     Symbolic arrays are shared by the call paths declaring them alike. */
+  klee::ArrayCache arrays;
+  std::unique_ptr<klee::SolverService> service;
+  std::unique_ptr<klee::Solver> variables;
+  std::unique_ptr<klee::Solver> candidates;
+
+  solvers_t()
+      : service(klee::SolverService::create(
+            klee::createCoreSolver(klee::Z3_SOLVER))),
+        variables(service->createClient("optimization-variables")),
+        candidates(service->createClient("subcontracts")) {}
+
+  ~solvers_t() {
+    if (SolverClientStats)
+      service->printClientStats(llvm::errs());
   }
+};
 
-  /* Getting all expressions for UVs, OVs, subcontracts */
-  std::vector<std::string> expressions_str; 
-  for (auto vit : user_variables_str) {
-    expressions_str.push_back(vit.second);
-  }
-  for (auto vit : optimization_variables_str) {
-    for (auto cit : vit.second) {
-      expressions_str.push_back(cit);
-    }
-  }
-  for (auto cit : subcontract_constraints_str) {
-    expressions_str.push_back(cit.second);
-  }
+/* Stitches the performance of a single call path and prints the result to
+   out. The solvers (and their caches) may be shared across call paths. */
+void stitch_call_path(const std::string &call_path_file,
+                      const stitch_context_t &ctx, solvers_t &solvers,
+                      std::ostream &out) {
+  void *contract = ctx.contract;
+  LOAD_SYMBOL(contract, contract_get_metrics);
+  LOAD_SYMBOL(contract, contract_display_perf_formula);
 
   std::deque<klee::ref<klee::Expr>> expressions;
-  call_path_t *call_path =
-      load_call_path(InputCallPathFile, expressions_str, expressions, contract);
+  std::unique_ptr<call_path_t> call_path(load_call_path(
+      call_path_file, ctx.expressions_str, expressions, contract,
+      solvers.arrays));
 
   std::map<initial_var_t, klee::ref<klee::Expr>> user_variables;
-  for (auto vit : user_variables_str) {
+  for (auto vit : ctx.user_variables_str) {
     assert(!expressions.empty());
     user_variables[(initial_var_t){vit.first, "", 0}] = expressions.front();
     expressions.pop_front();
   }
   std::map<std::string, std::set<klee::ref<klee::Expr>>> optimization_variables;
-  for (auto vit : optimization_variables_str) {
+  for (auto vit : ctx.optimization_variables_str) {
     for (auto cit : vit.second) {
       assert(!expressions.empty());
       optimization_variables[vit.first].insert(expressions.front());
       expressions.pop_front();
     }
   }
-  for (auto cit : subcontract_constraints_str) {
+  for (auto cit : ctx.subcontract_constraints_str) {
     assert(!expressions.empty());
     subcontract_constraints[cit.first] = expressions.front();
     expressions.pop_front();
@@ -873,12 +922,6 @@ int main(int argc, char **argv, char **envp) {
 
   /* Pull in all the constraints from the call path */
 
-  klee::Solver *solver = klee::createCoreSolver(klee::Z3_SOLVER);
-  assert(solver);
-  solver = createCexCachingSolver(solver);
-  solver = createCachingSolver(solver);
-  solver = createIndependentSolver(solver);
-
   klee::ConstraintSet constraints = call_path->constraints;
   klee::ConstraintManager constraints_manager(constraints);
 
@@ -905,30 +948,30 @@ int main(int argc, char **argv, char **envp) {
 
     constraints_manager.addConstraint(eq_expr);
   }
-  
+
   /* Now try to bind each initial OV individually */
 
   std::set<klee::ref<klee::Expr>>::iterator ov_candidate_iterator;
-  for (auto &it : call_path->initial_extra_vars) { 
-    if (!overriden_user_variables.count(it.first.name) &&
+  for (auto &it : call_path->initial_extra_vars) {
+    if (!ctx.overriden_user_variables.count(it.first.name) &&
         optimization_variables.count(it.first.name)) {
 #ifdef DEBUG
-      std::cerr << "Trying to bind OV " << it.first.name << " from DS: " << 
+      std::cerr << "Trying to bind OV " << it.first.name << " from DS: " <<
           it.first.ds_id << " with occurence: " << it.first.occurence << std::endl;
       std::cerr << "Inital expression is: ";
       it.second->print(llvm::errs());
       std::cerr << std::endl;
-#endif 
+#endif
       for(auto cit : optimization_variables[it.first.name]){
 #ifdef DEBUG
       std::cerr << "Comparing with: ";
       cit->print(llvm::errs());
       std::cerr << std::endl;
-#endif 
+#endif
         klee::ref<klee::Expr> eq_expr = exprBuilder->Eq(it.second,cit);
         klee::Query sat_query(constraints, eq_expr);
         bool result = false;
-        bool success = solver->mayBeTrue(sat_query, result);
+        bool success = solvers.variables->mayBeTrue(sat_query, result);
         assert(success);
         if(result){
 #ifdef DEBUG
@@ -939,7 +982,7 @@ int main(int argc, char **argv, char **envp) {
         }
       }
       if(!vars.count(it.first)){
-        std::cerr<< "No satisfying assignment for OV: " << it.first.name << " from DS: " << 
+        std::cerr<< "No satisfying assignment for OV: " << it.first.name << " from DS: " <<
           it.first.ds_id << " with occurence: " << it.first.occurence << std::endl;
         assert(0);
       }
@@ -956,7 +999,8 @@ int main(int argc, char **argv, char **envp) {
     performance[metric] = -1;
   }
 
-  performance = process_candidate(call_path, contract, vars, cstate, formula);
+  performance = process_candidate(call_path.get(), contract, vars, cstate,
+                                  formula, solvers.candidates.get());
 
   if (performance.empty()) {
     /* This is possible when the user-overidden PCVs are not compatible with the path constraints */
@@ -964,28 +1008,378 @@ int main(int argc, char **argv, char **envp) {
   }
 
   for (auto metric : performance) {
-    std::cout << metric.first << "," << metric.second << std::endl;
+    out << metric.first << "," << metric.second << std::endl;
   }
 
   if (!formula.empty()) {
     for (auto metric : formula) {
-      std::cout << metric.first << ", Perf Formula:"
-                << contract_display_perf_formula(metric.second, PCVAbs);
+      out << metric.first << ", Perf Formula:"
+          << contract_display_perf_formula(metric.second, PCVAbs);
     }
   }
 
   if (!cstate.empty()) {
     for (auto cstate_it : cstate) {
       for (auto it : cstate_it.second) {
-        std::cout << "Concrete State:" << cstate_it.first << ":" << it.first
-                  << ":";
+        out << "Concrete State:" << cstate_it.first << ":" << it.first
+            << ":";
         for (auto it1 : it.second) {
-          std::cout << " " << it1;
+          out << " " << it1;
         }
-        std::cout << std::endl;
+        out << std::endl;
+      }
+    }
+  }
+}
+
+/* Appends path to files, or all of its records as "<archive>:<record>" if it
+   is a call path archive. */
+void add_call_path_file(std::vector<std::string> &files,
+                        const std::string &path) {
+  if (!klee::CallPathArchiveReader::isArchive(path)) {
+    files.push_back(path);
+    return;
+  }
+  std::string error;
+  std::unique_ptr<klee::CallPathArchiveReader> archive =
+      klee::CallPathArchiveReader::open(path, error);
+  if (!archive) {
+    std::cerr << "Error: Unable to open call path archive " << path << ": "
+              << error << std::endl;
+    exit(-1);
+  }
+  for (const auto &record : archive->getRecords()) {
+    files.push_back(path + ":" + record.name);
+  }
+}
+
+/* Collects the call paths given on the command line, in a directory and in
+   a list file. Call path archives stand for all the call paths they hold. */
+std::vector<std::string> get_call_path_files() {
+  std::vector<std::string> files;
+  for (const auto &path : InputCallPathFiles) {
+    add_call_path_file(files, path);
+  }
+
+  if (!CallPathList.empty()) {
+    std::ifstream list(CallPathList);
+    if (!list.is_open()) {
+      std::cerr << "Error: Unable to open call path list " << CallPathList
+                << std::endl;
+      exit(-1);
+    }
+    std::string line;
+    while (std::getline(list, line)) {
+      if (!line.empty()) {
+        add_call_path_file(files, line);
+      }
+    }
+  }
+
+  if (!CallPathDir.empty()) {
+    std::vector<std::string> dir_files;
+    std::error_code ec;
+    llvm::sys::fs::directory_iterator i(CallPathDir, ec), e;
+    for (; i != e && !ec; i.increment(ec)) {
+      if (llvm::sys::path::extension(i->path()) == ".call_path" ||
+          klee::CallPathArchiveReader::isArchive(i->path())) {
+        dir_files.push_back(i->path());
+      }
+    }
+    if (ec) {
+      std::cerr << "Error: Unable to read call path directory " << CallPathDir
+                << ": " << ec.message() << std::endl;
+      exit(-1);
+    }
+    std::sort(dir_files.begin(), dir_files.end());
+    for (const auto &path : dir_files) {
+      add_call_path_file(files, path);
+    }
+  }
+
+  return files;
+}
+
+/* The queue the workers of a batch run take call paths from, shared
+   between the processes: next is the index of the next call path to stitch
+   and claimed[w] the one worker w is stitching, if any. */
+struct batch_queue_t {
+  static const size_t none = (size_t)-1;
+  std::atomic<size_t> next;
+  std::atomic<size_t> claimed[];
+};
+
+/* Worker w of a batch run: stitches the call paths it takes from the queue
+   until none are left, with a single solver chain. Each result is appended
+   to results_file as "<idx> <size>\n<output>". */
+void run_batch_worker(const std::vector<std::string> &files,
+                      batch_queue_t *queue, unsigned w,
+                      const stitch_context_t &ctx,
+                      const std::string &results_file) {
+  solvers_t solvers;
+  std::ofstream results(results_file, std::ios::app);
+  assert(results.is_open() && "Unable to open worker results file.");
+
+  for (;;) {
+    size_t idx = queue->next.fetch_add(1);
+    if (idx >= files.size()) {
+      break;
+    }
+    queue->claimed[w] = idx;
+    std::ostringstream out;
+    stitch_call_path(files[idx], ctx, solvers, out);
+    std::string result = out.str();
+    results << idx << " " << result.size() << "\n" << result;
+    results.flush();
+  }
+}
+
+/* Reads the results a worker managed to record before it exited. */
+size_t read_worker_results(const std::string &results_file,
+                           std::map<size_t, std::string> &results) {
+  std::ifstream in(results_file);
+  size_t count = 0;
+  size_t idx, size;
+  while (in >> idx >> size) {
+    in.get();
+    std::string result(size, '\0');
+    if (!in.read(&result[0], size)) {
+      break;
+    }
+    results[idx] = result;
+    count++;
+  }
+  return count;
+}
+
+/* Stitches many call paths with NumWorkers worker processes, which take
+   the next call path from a shared queue whenever they are done with one
+   and keep their solver caches across the paths they handle, and writes one
+   consolidated result, in input order, where each path's section is
+   identical to the output of a single-path run. */
+int run_batch(const std::vector<std::string> &files,
+              const stitch_context_t &ctx) {
+  unsigned num_workers = std::max(1u, std::min<unsigned>(NumWorkers,
+                                                         files.size()));
+
+  llvm::SmallString<128> results_dir;
+  if (std::error_code ec = llvm::sys::fs::createUniqueDirectory(
+          "stitch-perf-contract", results_dir)) {
+    std::cerr << "Error: Unable to create temporary directory: "
+              << ec.message() << std::endl;
+    return -1;
+  }
+
+  size_t queue_size =
+      sizeof(batch_queue_t) + num_workers * sizeof(std::atomic<size_t>);
+  void *queue_memory = mmap(nullptr, queue_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (queue_memory == MAP_FAILED) {
+    perror("mmap");
+    return -1;
+  }
+  batch_queue_t *queue = new (queue_memory) batch_queue_t;
+  queue->next = 0;
+  std::vector<std::string> results_files;
+  for (unsigned w = 0; w < num_workers; w++) {
+    new (&queue->claimed[w]) std::atomic<size_t>(batch_queue_t::none);
+    results_files.push_back(
+        (results_dir + "/worker" + std::to_string(w)).str());
+  }
+
+  std::map<size_t, std::string> results;
+  std::set<size_t> failed;
+  std::map<pid_t, unsigned> running;
+
+  auto spawn = [&](unsigned w) {
+    queue->claimed[w] = batch_queue_t::none;
+    std::cout.flush();
+    std::cerr.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      exit(-1);
+    }
+    if (pid == 0) {
+      run_batch_worker(files, queue, w, ctx, results_files[w]);
+      _exit(0);
+    }
+    running[pid] = w;
+  };
+
+  for (unsigned w = 0; w < num_workers; w++) {
+    spawn(w);
+  }
+
+  while (!running.empty()) {
+    pid_t pid = waitpid(-1, nullptr, 0);
+    if (pid < 0) {
+      perror("waitpid");
+      return -1;
+    }
+    auto rit = running.find(pid);
+    if (rit == running.end()) {
+      continue;
+    }
+    unsigned w = rit->second;
+    running.erase(rit);
+
+    read_worker_results(results_files[w], results);
+    size_t idx = queue->claimed[w];
+    if (idx != batch_queue_t::none && !results.count(idx) &&
+        !failed.count(idx)) {
+      /* The worker died on a call path: record it and carry on with a
+         fresh worker while call paths are left. */
+      std::cerr << "Error: Failed to stitch " << files[idx] << std::endl;
+      failed.insert(idx);
+      if (queue->next < files.size()) {
+        spawn(w);
       }
     }
   }
 
+  /* A worker may also have died between taking a call path and claiming
+     it. */
+  for (size_t i = 0; i < files.size(); i++) {
+    if (!results.count(i) && !failed.count(i)) {
+      std::cerr << "Error: Failed to stitch " << files[i] << std::endl;
+      failed.insert(i);
+    }
+  }
+
+  munmap(queue_memory, queue_size);
+  for (auto &results_file : results_files) {
+    llvm::sys::fs::remove(results_file);
+  }
+  llvm::sys::fs::remove(results_dir);
+
+  std::ofstream output_file;
+  if (OutputFile != "-") {
+    output_file.open(OutputFile);
+    if (!output_file.is_open()) {
+      std::cerr << "Error: Unable to open output file " << OutputFile
+                << std::endl;
+      return -1;
+    }
+  }
+  std::ostream &out = OutputFile == "-" ? std::cout : output_file;
+
+  for (size_t i = 0; i < files.size(); i++) {
+    out << ";;-- Call path: " << files[i] << " --" << std::endl;
+    if (failed.count(i)) {
+      out << "Error: Failed to stitch call path." << std::endl;
+    } else {
+      out << results[i];
+    }
+  }
+
+  return failed.empty() ? 0 : -1;
+}
+
+int main(int argc, char **argv, char **envp) {
+  llvm::cl::ParseCommandLineOptions(argc, argv);
+
+  std::vector<std::string> call_path_files = get_call_path_files();
+  if (call_path_files.empty()) {
+    std::cerr << "Error: No call path to stitch." << std::endl;
+    exit(-1);
+  }
+  bool batch = call_path_files.size() > 1 || !CallPathDir.empty() ||
+               !CallPathList.empty();
+
+  dlerror();
+  const char *err = NULL;
+  void *contract = dlopen(ContractLib.c_str(), RTLD_NOW);
+  if ((err = dlerror())) {
+    std::cerr << "Error: Unable to load contract plugin " << ContractLib << ": "
+              << err << std::endl;
+    exit(-1);
+  }
+  assert(contract);
+
+  // Get contract symbols
+  LOAD_SYMBOL(contract, contract_init);
+  LOAD_SYMBOL(contract, contract_get_metrics);
+  LOAD_SYMBOL(contract, contract_get_user_variables);
+  LOAD_SYMBOL(contract, contract_get_optimization_variables);
+  LOAD_SYMBOL(contract, contract_get_contracts);
+  LOAD_SYMBOL(contract, contract_has_contract);
+  LOAD_SYMBOL(contract, contract_num_sub_contracts);
+  LOAD_SYMBOL(contract, contract_get_subcontract_constraints);
+  LOAD_SYMBOL(contract, contract_get_sub_contract_performance);
+  LOAD_SYMBOL(contract, contract_display_perf_formula);
+
+  contract_init();
+
+  stitch_context_t ctx;
+  ctx.contract = contract;
+  ctx.user_variables_str = contract_get_user_variables();
+
+  /* Incorporating user-provided PCVs to bind all user variables */
+
+  std::string user_variables_param = UserVariables;
+  while (!user_variables_param.empty()) {
+    std::string user_variable_string =
+        user_variables_param.substr(0, user_variables_param.find(","));
+    user_variables_param =
+        user_variable_string.size() == user_variables_param.size()
+            ? ""
+            : user_variables_param.substr(user_variable_string.size() + 1);
+
+    std::string user_var =
+        user_variable_string.substr(0, user_variable_string.find("="));
+    std::string user_val =
+        user_variable_string.substr(user_variable_string.find("=") + 1);
+
+    if (!ctx.user_variables_str.count(user_var)) {
+      std::cerr << "Error: User variable " << user_var
+                << " not defined in contract." << std::endl
+                << "Error: Valid user variables:" << std::endl;
+      for (auto it : ctx.user_variables_str) {
+        std::cerr << "Error:   " << it.first << std::endl;
+      }
+      exit(-1);
+    }
+
+    ctx.user_variables_str[user_var] = user_val;
+    ctx.overriden_user_variables.insert(user_var);
+  }
+
+  /* Getting OVs */
+
+  ctx.optimization_variables_str = contract_get_optimization_variables();
+
+  /* Getting all subcontracts */
+
+  for (auto function_name : contract_get_contracts()) {
+    for (int sub_contract_idx = 0;
+         sub_contract_idx < contract_num_sub_contracts(function_name);
+         sub_contract_idx++) {
+      ctx.subcontract_constraints_str[std::make_pair(function_name,
+                                                     sub_contract_idx)] =
+          contract_get_subcontract_constraints(function_name, sub_contract_idx);
+    }
+  }
+
+  /* Getting all expressions for UVs, OVs, subcontracts */
+  for (auto vit : ctx.user_variables_str) {
+    ctx.expressions_str.push_back(vit.second);
+  }
+  for (auto vit : ctx.optimization_variables_str) {
+    for (auto cit : vit.second) {
+      ctx.expressions_str.push_back(cit);
+    }
+  }
+  for (auto cit : ctx.subcontract_constraints_str) {
+    ctx.expressions_str.push_back(cit.second);
+  }
+
+  if (batch) {
+    return run_batch(call_path_files, ctx);
+  }
+
+  solvers_t solvers;
+  stitch_call_path(call_path_files.front(), ctx, solvers, std::cout);
+
   return 0;
 }
@@ -0,0 +1,227 @@
+// Converts a binary trace of pin-trace.so -binary (trace.bin and
+// trace.table) to the text trace it writes without -binary (trace.out).
+//
+// Usage: pin-trace-decode <trace.table> <trace.bin> [<output>]
+//
+// The records of every thread are printed in the order of the chunks they
+// were written in, rather than interleaved as they executed.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pin-trace-format.h"
+
+typedef struct {
+  std::string function;
+  std::string assembly;
+} static_instruction_t;
+
+typedef struct {
+  // Static indices of the first instructions of the functions called
+  std::vector<uint32_t> calls;
+  // Register values, in the order of the table
+  std::vector<uint64_t> reg_values;
+  std::vector<std::pair<bool, uint64_t>> addresses;
+} thread_state_t;
+
+std::vector<std::pair<int, std::string>> regs;
+std::map<uint32_t, size_t> reg_positions;
+std::vector<static_instruction_t> instructions;
+
+std::string unescape(const std::string &str) {
+  std::string unescaped;
+  for (size_t i = 0; i < str.size(); i++) {
+    if (str[i] == '\\' && i + 1 < str.size()) {
+      char c = str[++i];
+      unescaped += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+    } else {
+      unescaped += str[i];
+    }
+  }
+  return unescaped;
+}
+
+bool load_table(const char *path) {
+  std::ifstream in(path);
+  std::string line;
+  if (!std::getline(in, line) || line != pin_trace::TABLE_MAGIC) {
+    std::cerr << "ERROR: " << path << " is not a trace table" << std::endl;
+    return false;
+  }
+  while (std::getline(in, line)) {
+    std::vector<std::string> fields;
+    size_t begin = 0, end;
+    do {
+      end = line.find('\t', begin);
+      fields.push_back(unescape(line.substr(begin, end - begin)));
+      begin = end + 1;
+    } while (end != std::string::npos);
+
+    char *index_end = NULL;
+    unsigned long index =
+        fields.size() > 1 ? strtoul(fields[1].c_str(), &index_end, 10) : 0;
+    if (!index_end || *index_end) {
+      std::cerr << "ERROR: Invalid trace table entry: " << line << std::endl;
+      return false;
+    }
+    if (fields[0] == "R" && fields.size() == 3) {
+      reg_positions[index] = regs.size();
+      regs.push_back(std::make_pair((int)index, fields[2]));
+    } else if (fields[0] == "I" && fields.size() == 4) {
+      if (index >= instructions.size())
+        instructions.resize(index + 1);
+      instructions[index].function = fields[2];
+      instructions[index].assembly = fields[3];
+    } else {
+      std::cerr << "ERROR: Invalid trace table entry: " << line << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Prints the records of a chunk as pin-trace.cpp's log_instruction does.
+bool decode_chunk(const std::vector<pin_trace::record_t> &records,
+                  thread_state_t &state, std::ostream &trace) {
+  for (auto &record : records) {
+    switch (record.kind) {
+    case pin_trace::RECORD_READ:
+    case pin_trace::RECORD_WRITE:
+      state.addresses.push_back(std::make_pair(
+          record.kind == pin_trace::RECORD_WRITE, record.value));
+      break;
+    case pin_trace::RECORD_REGISTER: {
+      auto position = reg_positions.find(record.index);
+      if (position == reg_positions.end()) {
+        std::cerr << "ERROR: Unknown register " << record.index << std::endl;
+        return false;
+      }
+      state.reg_values.resize(regs.size());
+      state.reg_values[position->second] = record.value;
+      break;
+    }
+    case pin_trace::RECORD_CALL:
+      if (record.index >= instructions.size()) {
+        std::cerr << "ERROR: Unknown instruction " << record.index << std::endl;
+        return false;
+      }
+      state.calls.push_back(record.index);
+      break;
+    case pin_trace::RECORD_RETURN:
+      if (state.calls.empty()) {
+        std::cerr << "ERROR: Return with no call" << std::endl;
+        return false;
+      }
+      state.calls.pop_back();
+      break;
+    case pin_trace::RECORD_CLEAR_STACK:
+      state.calls.clear();
+      break;
+    case pin_trace::RECORD_INSTRUCTION: {
+      if (record.index >= instructions.size()) {
+        std::cerr << "ERROR: Unknown instruction " << record.index << std::endl;
+        return false;
+      }
+      // The stream stays in hexadecimal from the first instruction on, as
+      // when writing trace.out directly
+      state.reg_values.resize(regs.size());
+      for (size_t r = 0; r < regs.size(); ++r) {
+        trace << regs[r].second << " (" << regs[r].first << ")"
+              << " = " << state.reg_values[r] << "\n";
+      }
+
+      trace << std::hex << std::uppercase << record.value << " |";
+      for (auto c : state.calls) {
+        trace << " " << instructions[c].function;
+      }
+
+      const static_instruction_t &instruction = instructions[record.index];
+      trace << " | " << instruction.function << " | " << instruction.assembly
+            << " |";
+
+      for (auto a : state.addresses) {
+        trace << " " << (a.first ? "w" : "r") << a.second;
+      }
+      state.addresses.clear();
+
+      trace << "\n";
+      break;
+    }
+    default:
+      std::cerr << "ERROR: Unknown record kind " << record.kind << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3 || argc > 4) {
+    std::cerr << "Usage: " << argv[0] << " <trace.table> <trace.bin> [<output>]"
+              << std::endl;
+    return 1;
+  }
+  if (!load_table(argv[1]))
+    return 1;
+
+  FILE *in = fopen(argv[2], "rb");
+  if (!in) {
+    std::cerr << "ERROR: Failed to open " << argv[2] << std::endl;
+    return 1;
+  }
+  std::ofstream file;
+  if (argc == 4) {
+    file.open(argv[3], std::ofstream::out);
+    if (!file) {
+      std::cerr << "ERROR: Failed to open " << argv[3] << std::endl;
+      return 1;
+    }
+  }
+  std::ostream &trace = argc == 4 ? file : std::cout;
+
+  pin_trace::file_header_t header;
+  if (fread(&header, sizeof(header), 1, in) != 1 ||
+      memcmp(header.magic, pin_trace::FILE_MAGIC, sizeof(header.magic)) ||
+      header.version != pin_trace::FILE_VERSION) {
+    std::cerr << "ERROR: " << argv[2] << " is not a binary trace" << std::endl;
+    return 1;
+  }
+
+  trace << "IP | Call Stack | Function | Instruction | Memory Accesses\n";
+  std::map<uint32_t, thread_state_t> threads;
+  std::vector<pin_trace::record_t> records;
+  pin_trace::chunk_header_t chunk;
+  bool closed = false;
+  while (fread(&chunk, sizeof(chunk), 1, in) == 1) {
+    if (chunk.thread == pin_trace::END_OF_TRACE) {
+      closed = true;
+      break;
+    }
+    records.resize(chunk.records);
+    if (fread(records.data(), sizeof(pin_trace::record_t), chunk.records,
+              in) != chunk.records) {
+      std::cerr << "ERROR: Truncated chunk in " << argv[2] << std::endl;
+      return 1;
+    }
+    if (!decode_chunk(records, threads[chunk.thread], trace))
+      return 1;
+  }
+  fclose(in);
+  if (!closed) {
+    std::cerr << "WARNING: " << argv[2] << " ends before the end of the trace"
+              << std::endl;
+    return 0;
+  }
+  trace << "#eof\n";
+  trace.flush();
+  return trace ? 0 : 1;
+}
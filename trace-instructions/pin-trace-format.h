@@ -0,0 +1,71 @@
+// The binary trace written by pin-trace.so with -binary, shared by
+// pin-trace.cpp and pin-trace-decode.cpp.
+//
+// trace.bin starts with a file_header_t and is followed by chunks, each a
+// chunk_header_t and the fixed-size records of one application thread. The
+// thread ids of the chunks are never reused, even when Pin reuses the
+// THREADID of a thread that exited:
+//
+//   RECORD_READ/RECORD_WRITE  value: address, before the instruction
+//   RECORD_REGISTER           index: register, value: its new value
+//   RECORD_CALL               index: static index of the first instruction
+//                             of the function called
+//   RECORD_RETURN
+//   RECORD_CLEAR_STACK        the CALL records of the whole call stack follow
+//   RECORD_INSTRUCTION        index: static index, value: instruction pointer
+//
+// Registers are only recorded when their value changed since the previous
+// instruction of the thread. A chunk of thread END_OF_TRACE ends the trace.
+//
+// The static instructions are described in trace.table, as they are
+// instrumented (the registers once logging started):
+//
+//   PIN-TRACE-TABLE 1
+//   R \t <register> \t <name>
+//   I \t <index> \t <function> \t <assembly>
+//
+// with tabs, newlines and backslashes escaped as \t, \n and \\.
+
+#ifndef PIN_TRACE_FORMAT_H
+#define PIN_TRACE_FORMAT_H
+
+#include <stdint.h>
+
+namespace pin_trace {
+
+const char FILE_MAGIC[8] = {'P', 'I', 'N', 'T', 'R', 'A', 'C', 'E'};
+const uint32_t FILE_VERSION = 1;
+const char TABLE_MAGIC[] = "PIN-TRACE-TABLE 1";
+
+enum record_kind_t {
+  RECORD_INSTRUCTION,
+  RECORD_READ,
+  RECORD_WRITE,
+  RECORD_REGISTER,
+  RECORD_CALL,
+  RECORD_RETURN,
+  RECORD_CLEAR_STACK,
+};
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+} file_header_t;
+
+typedef struct {
+  uint32_t thread;
+  uint32_t records;
+} chunk_header_t;
+
+typedef struct {
+  uint64_t value;
+  uint32_t kind;
+  uint32_t index;
+} record_t;
+
+const uint32_t END_OF_TRACE = 0xffffffff;
+
+} // namespace pin_trace
+
+#endif // PIN_TRACE_FORMAT_H
@@ -36,6 +36,8 @@ END_LEGAL */
 #include <string>
 #include <vector>
 
+#include "pin-trace-format.h"
+
 std::ofstream trace;
 
 /* ===================================================================== */
@@ -46,6 +48,10 @@ KNOB<std::string> KnobStartFn(KNOB_MODE_WRITEONCE, "pintool", "start-fn",
                          "specify function at which to start tracing");
 KNOB<std::string> KnobEndFn(KNOB_MODE_WRITEONCE, "pintool", "end-fn", "exit@plt",
                        "specify function at which to end tracing");
+KNOB<BOOL> KnobBinary(KNOB_MODE_WRITEONCE, "pintool", "binary", "0",
+                      "write fixed-size records to trace.bin and the static "
+                      "instructions to trace.table instead of trace.out, to "
+                      "be converted with pin-trace-decode");
 
 typedef struct {
   unsigned long ip;
@@ -62,6 +68,7 @@ std::map<LEVEL_BASE::REG, std::string> regs;
 bool call = false;
 
 bool is_logging = false;
+bool binary = false;
 
 std::string start_fn = "";
 std::string end_fn = "";
@@ -76,6 +83,175 @@ uint64_t (*stub_hardware_read)(uint64_t addr, unsigned offset,
 char *(*get_mapped_memory_ptr)(int) = NULL;
 UINT8 (*get_num_devs)() = NULL;
 
+/* ===================================================================== */
+// Binary trace
+/* ===================================================================== */
+
+// Every application thread fills buffers of its own. Full buffers are
+// written out by an internal thread, so that the application threads do not
+// wait on the file unless it falls behind: at most MAX_SPARE_BUFFERS buffers
+// are allocated on top of those of the threads, after which a thread with a
+// full buffer waits for the flush thread to free one.
+#define BUFFER_RECORDS (1 << 16)
+#define MAX_SPARE_BUFFERS 16
+
+typedef struct {
+  // Unique per application thread, unlike the THREADID Pin reuses
+  UINT32 tid;
+  UINT32 used;
+  pin_trace::record_t *records;
+} buffer_t;
+
+typedef struct {
+  buffer_t buffer;
+  bool call;
+  // Static indices of the first instructions of the functions called
+  std::vector<UINT32> calls;
+  // Whether the call stack was written since logging started
+  bool stack_logged;
+  // Register values last written, in the order of regs
+  std::vector<ADDRINT> reg_values;
+  bool reg_values_logged;
+} thread_data_t;
+
+FILE *binary_trace = NULL;
+// trace.table is written as the instructions are instrumented, so that it
+// matches the chunks of trace.bin written so far if the tool is killed.
+std::ofstream table;
+PIN_LOCK table_lock;
+bool table_regs_written = false;
+std::map<ADDRINT, UINT32> static_instruction_indices;
+
+TLS_KEY thread_data_key;
+PIN_LOCK buffers_lock;
+std::vector<thread_data_t *> threads;
+UINT32 next_thread_id = 0;
+std::vector<buffer_t> full_buffers;
+std::vector<pin_trace::record_t *> free_records;
+UINT32 spare_buffers = 0;
+PIN_SEMAPHORE flush_pending;
+PIN_SEMAPHORE buffer_freed;
+bool flush_exit = false;
+PIN_THREAD_UID flush_thread_uid;
+
+std::string escape(const std::string &str) {
+  std::string escaped;
+  for (auto c : str) {
+    if (c == '\\')
+      escaped += "\\\\";
+    else if (c == '\t')
+      escaped += "\\t";
+    else if (c == '\n')
+      escaped += "\\n";
+    else
+      escaped += c;
+  }
+  return escaped;
+}
+
+void write_binary_trace(const void *data, size_t size) {
+  if (fwrite(data, size, 1, binary_trace) != 1) {
+    PIN_ERROR("Failed to write trace.bin\n");
+    PIN_ExitProcess(1);
+  }
+}
+
+void write_buffer(const buffer_t &buffer) {
+  pin_trace::chunk_header_t header = {buffer.tid, buffer.used};
+  write_binary_trace(&header, sizeof(header));
+  write_binary_trace(buffer.records, buffer.used * sizeof(pin_trace::record_t));
+}
+
+// Queues the buffer of a thread to be written, and gives it an empty one,
+// waiting for the flush thread if too many buffers are in flight.
+void submit_buffer(thread_data_t *td) {
+  PIN_GetLock(&buffers_lock, td->buffer.tid + 1);
+  full_buffers.push_back(td->buffer);
+  PIN_SemaphoreSet(&flush_pending);
+  // Once the flush thread is stopped, Fini writes whatever is queued.
+  while (free_records.empty() && spare_buffers == MAX_SPARE_BUFFERS &&
+         !flush_exit) {
+    // Cleared under the lock, so that a buffer freed from now on wakes us.
+    PIN_SemaphoreClear(&buffer_freed);
+    PIN_ReleaseLock(&buffers_lock);
+    PIN_SemaphoreWait(&buffer_freed);
+    PIN_GetLock(&buffers_lock, td->buffer.tid + 1);
+  }
+  if (free_records.empty()) {
+    td->buffer.records = new pin_trace::record_t[BUFFER_RECORDS];
+    spare_buffers++;
+  } else {
+    td->buffer.records = free_records.back();
+    free_records.pop_back();
+  }
+  PIN_ReleaseLock(&buffers_lock);
+  td->buffer.used = 0;
+}
+
+inline thread_data_t *get_thread_data(THREADID tid) {
+  return static_cast<thread_data_t *>(PIN_GetThreadData(thread_data_key, tid));
+}
+
+inline void log_record(thread_data_t *td, UINT32 kind, UINT32 index,
+                       UINT64 value) {
+  if (td->buffer.used == BUFFER_RECORDS)
+    submit_buffer(td);
+  pin_trace::record_t &record = td->buffer.records[td->buffer.used++];
+  record.value = value;
+  record.kind = kind;
+  record.index = index;
+}
+
+VOID flush_buffers(VOID *arg) {
+  std::vector<buffer_t> buffers;
+  bool done;
+  do {
+    PIN_SemaphoreWait(&flush_pending);
+    PIN_GetLock(&buffers_lock, 0);
+    buffers.swap(full_buffers);
+    PIN_SemaphoreClear(&flush_pending);
+    done = flush_exit;
+    PIN_ReleaseLock(&buffers_lock);
+
+    for (auto &buffer : buffers)
+      write_buffer(buffer);
+    fflush(binary_trace);
+
+    PIN_GetLock(&buffers_lock, 0);
+    for (auto &buffer : buffers)
+      free_records.push_back(buffer.records);
+    PIN_ReleaseLock(&buffers_lock);
+    if (!buffers.empty())
+      PIN_SemaphoreSet(&buffer_freed);
+    buffers.clear();
+  } while (!done);
+}
+
+VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v) {
+  thread_data_t *td = new thread_data_t();
+  td->buffer.used = 0;
+  td->buffer.records = new pin_trace::record_t[BUFFER_RECORDS];
+  td->call = false;
+  td->stack_logged = false;
+  td->reg_values_logged = false;
+  PIN_SetThreadData(thread_data_key, td, tid);
+
+  PIN_GetLock(&buffers_lock, tid + 1);
+  td->buffer.tid = next_thread_id++;
+  threads.push_back(td);
+  PIN_ReleaseLock(&buffers_lock);
+}
+
+// Stops the flush thread while internal threads may still run.
+VOID PrepareForFini(VOID *v) {
+  PIN_GetLock(&buffers_lock, 0);
+  flush_exit = true;
+  PIN_ReleaseLock(&buffers_lock);
+  PIN_SemaphoreSet(&flush_pending);
+  PIN_SemaphoreSet(&buffer_freed);
+  PIN_WaitForThreadTermination(flush_thread_uid, PIN_INFINITE_TIMEOUT, NULL);
+}
+
 VOID log_read_op(VOID *ip, UINT8 *addr, UINT32 size, THREADID tid,
                  CONTEXT *ctxt) {
 #if DEBUG
@@ -108,8 +284,13 @@ fflush(stdout);
       }
     }
   }
-  if (is_logging)
-    addresses.push_back(std::make_pair(0, (unsigned long)addr));
+  if (is_logging) {
+    if (binary)
+      log_record(get_thread_data(tid), pin_trace::RECORD_READ, 0,
+                 (ADDRINT)addr);
+    else
+      addresses.push_back(std::make_pair(0, (unsigned long)addr));
+  }
 }
 
 VOID intercept_write_op(VOID *ip, UINT8 *addr, UINT32 size, THREADID tid,
@@ -208,20 +389,99 @@ VOID log_return() {
   calls.pop_back();
 }
 
+VOID bin_log_write_op(THREADID tid, VOID *addr) {
+  if (is_logging)
+    log_record(get_thread_data(tid), pin_trace::RECORD_WRITE, 0,
+               (ADDRINT)addr);
+}
+
+// Same as log_instruction, with the call stack and the registers that
+// changed recorded for pin-trace-decode to print.
+VOID bin_log_instruction(THREADID tid, const CONTEXT *ctx, ADDRINT ip,
+                         UINT32 index) {
+  thread_data_t *td = get_thread_data(tid);
+  bool called = td->call;
+  if (called) {
+    td->calls.push_back(index);
+    td->call = false;
+  }
+  if (!is_logging) {
+    td->stack_logged = false;
+    return;
+  }
+
+  if (!td->stack_logged) {
+    log_record(td, pin_trace::RECORD_CLEAR_STACK, 0, 0);
+    for (auto c : td->calls)
+      log_record(td, pin_trace::RECORD_CALL, c, 0);
+    td->stack_logged = true;
+  } else if (called) {
+    log_record(td, pin_trace::RECORD_CALL, index, 0);
+  }
+
+  if (!td->reg_values_logged)
+    td->reg_values.resize(regs.size());
+  UINT32 r = 0;
+  for (std::map<LEVEL_BASE::REG, std::string>::iterator i = regs.begin();
+       i != regs.end(); ++i, ++r) {
+    ADDRINT value = PIN_GetContextReg(ctx, i->first);
+    if (!td->reg_values_logged || td->reg_values[r] != value) {
+      log_record(td, pin_trace::RECORD_REGISTER, i->first, value);
+      td->reg_values[r] = value;
+    }
+  }
+  td->reg_values_logged = true;
+
+  log_record(td, pin_trace::RECORD_INSTRUCTION, index, ip);
+}
+
+VOID bin_log_call(THREADID tid) { get_thread_data(tid)->call = true; }
+
+VOID bin_log_return(THREADID tid) {
+  thread_data_t *td = get_thread_data(tid);
+  assert((!td->calls.empty()) && "Return with no Call.");
+  td->calls.pop_back();
+  if (is_logging && td->stack_logged)
+    log_record(td, pin_trace::RECORD_RETURN, 0, 0);
+}
+
+// The index of an instruction in trace.table. Instructions instrumented
+// again (e.g. in another trace) keep their index.
+UINT32 static_instruction_index(INS ins) {
+  ADDRINT ip = INS_Address(ins);
+  std::map<ADDRINT, UINT32>::iterator i = static_instruction_indices.find(ip);
+  if (i != static_instruction_indices.end())
+    return i->second;
+  UINT32 index = static_instruction_indices.size();
+  static_instruction_indices[ip] = index;
+  PIN_GetLock(&table_lock, 0);
+  table << "I\t" << index << "\t" << escape(RTN_FindNameByAddress(ip)) << "\t"
+        << escape(INS_Disassemble(ins)) << std::endl;
+  PIN_ReleaseLock(&table_lock);
+  return index;
+}
+
 // Pin calls this function every time a new instruction is encountered
 VOID Instruction(INS ins, VOID *v) {
-  // Insert a call to printins before every instruction
-  instruction_data_t *id = new instruction_data_t();
-  id->ip = INS_Address(ins);
-  id->function = RTN_FindNameByAddress(id->ip);
-  id->assembly = INS_Disassemble(ins);
-
-  /* We don't print this anymore */
-  id->category = CATEGORY_StringShort(INS_Category(ins));
-
-  /* Getting written registers */
-  for (unsigned int i = 1; i <= INS_MaxNumWRegs(ins); ++i) {
-    id->written_regs[LEVEL_BASE::REG_FullRegName(INS_RegW(ins, i))] = 1;
+  instruction_data_t *id = NULL;
+  UINT32 index = 0;
+  if (binary) {
+    // The strings only go to trace.table, once per instruction
+    index = static_instruction_index(ins);
+  } else {
+    // Insert a call to printins before every instruction
+    id = new instruction_data_t();
+    id->ip = INS_Address(ins);
+    id->function = RTN_FindNameByAddress(id->ip);
+    id->assembly = INS_Disassemble(ins);
+
+    /* We don't print this anymore */
+    id->category = CATEGORY_StringShort(INS_Category(ins));
+
+    /* Getting written registers */
+    for (unsigned int i = 1; i <= INS_MaxNumWRegs(ins); ++i) {
+      id->written_regs[LEVEL_BASE::REG_FullRegName(INS_RegW(ins, i))] = 1;
+    }
   }
 
   // Instruments memory accesses using a predicated call, i.e.
@@ -243,9 +503,15 @@ VOID Instruction(INS ins, VOID *v) {
     // both read and written (for instance incl (%eax) on IA-32)
     // In that case we instrument it once for read and once for write.
     if (INS_MemoryOperandIsWritten(ins, memOp)) {
-      INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)log_write_op,
-                               IARG_INST_PTR, IARG_MEMORYOP_EA, memOp,
-                               IARG_END);
+      if (binary) {
+        INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)bin_log_write_op,
+                                 IARG_THREAD_ID, IARG_MEMORYOP_EA, memOp,
+                                 IARG_END);
+      } else {
+        INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)log_write_op,
+                                 IARG_INST_PTR, IARG_MEMORYOP_EA, memOp,
+                                 IARG_END);
+      }
       if (!INS_IsProcedureCall(ins)) {
         INS_InsertPredicatedCall(ins, IPOINT_AFTER, (AFUNPTR)intercept_write_op,
                                  IARG_INST_PTR, IARG_MEMORYOP_EA, memOp,
@@ -258,6 +524,21 @@ VOID Instruction(INS ins, VOID *v) {
 #define ACTUALLY_TRACING 1
 #if ACTUALLY_TRACING
 
+  if (binary) {
+    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)bin_log_instruction,
+                   IARG_THREAD_ID, IARG_CONST_CONTEXT, IARG_INST_PTR,
+                   IARG_UINT32, index, IARG_END);
+
+    if (INS_IsRet(ins)) {
+      INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)bin_log_return,
+                     IARG_THREAD_ID, IARG_END);
+    } else if (INS_IsProcedureCall(ins)) {
+      INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)bin_log_call,
+                     IARG_THREAD_ID, IARG_END);
+    }
+    return;
+  }
+
   INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)log_instruction, IARG_CONTEXT,
                  IARG_PTR, id, IARG_END);
 
@@ -291,6 +572,18 @@ VOID trace_before(CHAR *name, ADDRINT size) {
   regs[LEVEL_BASE::REG_FullRegName(LEVEL_BASE::REG_R13)] = "r13";
   regs[LEVEL_BASE::REG_FullRegName(LEVEL_BASE::REG_R14)] = "r14";
   regs[LEVEL_BASE::REG_FullRegName(LEVEL_BASE::REG_R15)] = "r15";
+
+  if (binary) {
+    PIN_GetLock(&table_lock, 0);
+    if (!table_regs_written) {
+      for (std::map<LEVEL_BASE::REG, std::string>::iterator i = regs.begin();
+           i != regs.end(); ++i)
+        table << "R\t" << i->first << "\t" << escape(i->second) << "\n";
+      table.flush();
+      table_regs_written = true;
+    }
+    PIN_ReleaseLock(&table_lock);
+  }
 }
 
 VOID trace_after(ADDRINT ret) {
@@ -320,8 +613,25 @@ VOID Image(IMG img, VOID *v) {
 }
 // This function is called when the application exits
 VOID Fini(INT32 code, VOID *v) {
-  trace << "#eof" << std::endl;
-  trace.close();
+  if (!binary) {
+    trace << "#eof" << std::endl;
+    trace.close();
+    return;
+  }
+
+  // The flush thread is done: write what is left from here
+  PIN_GetLock(&buffers_lock, 0);
+  for (auto &buffer : full_buffers)
+    write_buffer(buffer);
+  full_buffers.clear();
+  for (auto td : threads)
+    if (td->buffer.used)
+      write_buffer(td->buffer);
+  PIN_ReleaseLock(&buffers_lock);
+  pin_trace::chunk_header_t end = {pin_trace::END_OF_TRACE, 0};
+  write_binary_trace(&end, sizeof(end));
+  fclose(binary_trace);
+  table.close();
 }
 
 /* ===================================================================== */
@@ -404,10 +714,6 @@ EXCEPT_HANDLING_RESULT GlobalHandler2(THREADID threadIndex,
 /* ===================================================================== */
 
 int main(int argc, char *argv[]) {
-  trace.open("trace.out", std::ofstream::out);
-  trace << "IP | Call Stack | Function | Instruction | Memory Accesses"
-        << std::endl;
-
   // Load debug symbols.
   PIN_InitSymbols();
 
@@ -418,6 +724,44 @@ int main(int argc, char *argv[]) {
   // Knobs
   start_fn = KnobStartFn.Value();
   end_fn = KnobEndFn.Value();
+  binary = KnobBinary.Value();
+
+  if (binary) {
+    binary_trace = fopen("trace.bin", "wb");
+    if (!binary_trace) {
+      PIN_ERROR("Failed to open trace.bin\n");
+      return 1;
+    }
+    pin_trace::file_header_t header;
+    memcpy(header.magic, pin_trace::FILE_MAGIC, sizeof(header.magic));
+    header.version = pin_trace::FILE_VERSION;
+    header.reserved = 0;
+    write_binary_trace(&header, sizeof(header));
+
+    table.open("trace.table", std::ofstream::out);
+    if (!table) {
+      PIN_ERROR("Failed to open trace.table\n");
+      return 1;
+    }
+    table << pin_trace::TABLE_MAGIC << std::endl;
+    PIN_InitLock(&table_lock);
+
+    thread_data_key = PIN_CreateThreadDataKey(NULL);
+    PIN_InitLock(&buffers_lock);
+    PIN_SemaphoreInit(&flush_pending);
+    PIN_SemaphoreInit(&buffer_freed);
+    PIN_AddThreadStartFunction(ThreadStart, 0);
+    PIN_AddPrepareForFiniFunction(PrepareForFini, 0);
+    if (PIN_SpawnInternalThread(flush_buffers, NULL, 0, &flush_thread_uid) ==
+        INVALID_THREADID) {
+      PIN_ERROR("Failed to start the trace flush thread\n");
+      return 1;
+    }
+  } else {
+    trace.open("trace.out", std::ofstream::out);
+    trace << "IP | Call Stack | Function | Instruction | Memory Accesses"
+          << std::endl;
+  }
 
   // Exception handler
   PIN_AddInternalExceptionHandler(GlobalHandler2, NULL);
@@ -0,0 +1,310 @@
+// trace-ir-instrs/TraceDecode.cpp
+//
+// Rebuilds the text trace (as written to trace.out) from a binary trace
+// (trace.bin) and the side table the pass wrote with -trace-ir-binary.
+//
+// Usage: trace-ir-decode [-counts] <trace.table> <trace.bin> [<output>]
+//
+// With -counts, prints how many instructions of every opcode were executed
+// instead. For a block trace (-trace-ir-blocks), these are rebuilt from the
+// opcode histograms of the blocks entered.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TraceFormat.h"
+
+namespace {
+
+struct TableEntry {
+    char kind = 0;
+    std::string function, opcode, operands, callee;
+    std::vector<std::string> args;
+    // Index of the opcode in Table::opcodes
+    uint32_t opcodeIndex = 0;
+    // Words of the values logged after the id
+    uint32_t valueWords = 0;
+    // Opcode indices and counts of a block
+    std::vector<std::pair<uint32_t, uint32_t>> histogram;
+};
+
+struct Table {
+    std::vector<TableEntry> entries;
+    std::vector<std::string> opcodes;
+    std::map<std::string, uint32_t> opcodeIndices;
+    // Whether instructions are counted from block histograms
+    bool hasBlocks = false;
+
+    uint32_t getOpcode(const std::string &opcode) {
+        auto it = opcodeIndices.emplace(opcode, opcodes.size()).first;
+        if (it->second == opcodes.size())
+            opcodes.push_back(opcode);
+        return it->second;
+    }
+};
+
+// Executed instructions by opcode index
+struct Counts {
+    std::vector<uint64_t> instructions;
+    uint64_t blocks = 0;
+};
+
+std::string unescape(const std::string &str) {
+    std::string unescaped;
+    for (size_t i = 0; i < str.size(); i++) {
+        if (str[i] == '\\' && i + 1 < str.size()) {
+            char c = str[++i];
+            unescaped += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+        } else {
+            unescaped += str[i];
+        }
+    }
+    return unescaped;
+}
+
+// Parses the histogram of a block, "opcode:count,...".
+bool parseHistogram(Table &table, TableEntry &entry) {
+    const std::string &str = entry.operands;
+    for (size_t begin = 0; begin < str.size();) {
+        size_t end = str.find(',', begin);
+        if (end == std::string::npos)
+            end = str.size();
+        size_t colon = str.find(':', begin);
+        if (colon >= end)
+            return false;
+        char *countEnd;
+        unsigned long count = strtoul(str.c_str() + colon + 1, &countEnd, 10);
+        if (countEnd != str.c_str() + end)
+            return false;
+        entry.histogram.emplace_back(table.getOpcode(str.substr(begin, colon - begin)), count);
+        begin = end + 1;
+    }
+    return true;
+}
+
+bool loadTable(const char *path, Table &table) {
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line) || line != trace_ir::TableMagic) {
+        fprintf(stderr, "ERROR: %s is not a trace table\n", path);
+        return false;
+    }
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields;
+        size_t begin = 0, end;
+        do {
+            end = line.find('\t', begin);
+            fields.push_back(unescape(line.substr(begin, end - begin)));
+            begin = end + 1;
+        } while (end != std::string::npos);
+
+        char *idEnd;
+        unsigned long id = strtoul(fields[0].c_str(), &idEnd, 10);
+        bool isCall = fields.size() > 1 && fields[1] == "C";
+        if (*idEnd || fields.size() < (isCall ? 6u : 5u) ||
+            fields[1].size() != 1 || !strchr("ILSCB", fields[1][0])) {
+            fprintf(stderr, "ERROR: Invalid trace table entry: %s\n", line.c_str());
+            return false;
+        }
+        if (id >= table.entries.size())
+            table.entries.resize(id + 1);
+        TableEntry &entry = table.entries[id];
+        entry.kind = fields[1][0];
+        entry.function = fields[2];
+        entry.opcode = fields[3];
+        entry.operands = fields[4];
+        if (entry.kind == 'B') {
+            // The opcode field of a block is its name
+            table.hasBlocks = true;
+            if (!parseHistogram(table, entry)) {
+                fprintf(stderr, "ERROR: Invalid block histogram: %s\n", line.c_str());
+                return false;
+            }
+            continue;
+        }
+        entry.opcodeIndex = table.getOpcode(entry.opcode);
+        if (entry.kind == 'L' || entry.kind == 'S')
+            entry.valueWords = 2;
+        if (isCall) {
+            entry.callee = fields[5];
+            entry.args.assign(fields.begin() + 6, fields.end());
+            for (const std::string &arg : entry.args)
+                if (arg != "unk" && arg.compare(0, 2, "s:") != 0)
+                    entry.valueWords += 2;
+        }
+    }
+    return true;
+}
+
+uint64_t getU64(const uint32_t *words) {
+    return words[0] | (uint64_t) words[1] << 32;
+}
+
+// Adds the records of a chunk to `counts`. Returns false if it is
+// malformed.
+bool countChunk(const Table &table, const std::vector<uint32_t> &words,
+                Counts &counts) {
+    counts.instructions.resize(table.opcodes.size());
+    for (size_t i = 0; i < words.size();) {
+        uint32_t id = words[i++];
+        if (id >= table.entries.size() || !table.entries[id].kind) {
+            fprintf(stderr, "ERROR: Unknown instruction id %u\n", id);
+            return false;
+        }
+        const TableEntry &entry = table.entries[id];
+        i += entry.valueWords;
+        if (i > words.size())
+            return false;
+        if (entry.kind == 'B') {
+            counts.blocks++;
+            for (auto &opcode : entry.histogram)
+                counts.instructions[opcode.first] += opcode.second;
+        } else if (!table.hasBlocks) {
+            counts.instructions[entry.opcodeIndex]++;
+        }
+    }
+    return true;
+}
+
+// Prints the records of a chunk. Returns false if it is malformed.
+bool decodeChunk(const Table &table, const std::vector<uint32_t> &words,
+                 FILE *out) {
+    for (size_t i = 0; i < words.size();) {
+        uint32_t id = words[i++];
+        if (id >= table.entries.size() || !table.entries[id].kind) {
+            fprintf(stderr, "ERROR: Unknown instruction id %u\n", id);
+            return false;
+        }
+        const TableEntry &entry = table.entries[id];
+        if (entry.kind == 'B') {
+            fprintf(out, "BLOCK %s %s\n", entry.function.c_str(), entry.opcode.c_str());
+            continue;
+        }
+        if (entry.kind == 'L' || entry.kind == 'S') {
+            if (i + 2 > words.size())
+                return false;
+            fprintf(out, "%s %p\n", entry.kind == 'L' ? "LOAD" : "STORE",
+                    (void *) (uintptr_t) getU64(&words[i]));
+            i += 2;
+        } else if (entry.kind == 'C') {
+            fprintf(out, "CALL %s (", entry.callee.c_str());
+            for (size_t a = 0; a < entry.args.size(); a++) {
+                const std::string &arg = entry.args[a];
+                if (a > 0)
+                    fputs(", ", out);
+                if (arg.compare(0, 2, "s:") == 0) {
+                    fputs(arg.c_str() + 2, out);
+                    continue;
+                }
+                if (arg == "unk") {
+                    fputs("<unk>", out);
+                    continue;
+                }
+                if (i + 2 > words.size())
+                    return false;
+                uint64_t value = getU64(&words[i]);
+                i += 2;
+                if (arg == "ld") {
+                    fprintf(out, "%ld", (long) value);
+                } else if (arg == "f") {
+                    double d;
+                    memcpy(&d, &value, sizeof(d));
+                    fprintf(out, "%f", d);
+                } else {
+                    fprintf(out, "%p", (void *) (uintptr_t) value);
+                }
+            }
+            fputs(")\n", out);
+        }
+        fprintf(out, "%s | %s | %s\n", entry.function.c_str(),
+                entry.opcode.c_str(), entry.operands.c_str());
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *program = argv[0];
+    bool countMode = argc > 1 && strcmp(argv[1], "-counts") == 0;
+    if (countMode) {
+        argv++;
+        argc--;
+    }
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "Usage: %s [-counts] <trace.table> <trace.bin> [<output>]\n", program);
+        return 1;
+    }
+    Table table;
+    if (!loadTable(argv[1], table))
+        return 1;
+
+    FILE *in = fopen(argv[2], "rb");
+    if (!in) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", argv[2]);
+        return 1;
+    }
+    FILE *out = argc == 4 ? fopen(argv[3], "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", argv[3]);
+        return 1;
+    }
+    static char outBuffer[1 << 20];
+    setvbuf(out, outBuffer, _IOFBF, sizeof(outBuffer));
+
+    trace_ir::FileHeader header;
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, trace_ir::FileMagic, sizeof(header.magic)) ||
+        header.version != trace_ir::FileVersion) {
+        fprintf(stderr, "ERROR: %s is not a binary trace\n", argv[2]);
+        return 1;
+    }
+
+    if (!countMode)
+        fprintf(out, "Function | Instruction | Operands\n");
+    trace_ir::ChunkHeader chunk;
+    std::vector<uint32_t> words;
+    Counts counts;
+    bool closed = false;
+    while (fread(&chunk, sizeof(chunk), 1, in) == 1) {
+        if (chunk.thread == trace_ir::EndOfTrace) {
+            if (!countMode)
+                fprintf(out, "EOF\n");
+            closed = true;
+            break;
+        }
+        words.resize(chunk.words);
+        if (fread(words.data(), sizeof(uint32_t), chunk.words, in) != chunk.words ||
+            !(countMode ? countChunk(table, words, counts) : decodeChunk(table, words, out))) {
+            fprintf(stderr, "ERROR: Truncated or corrupt chunk in %s\n", argv[2]);
+            return 1;
+        }
+    }
+    if (!closed)
+        fprintf(stderr, "WARNING: %s was not closed by trace_close_log\n", argv[2]);
+
+    if (countMode) {
+        counts.instructions.resize(table.opcodes.size());
+        uint64_t total = 0;
+        for (uint64_t count : counts.instructions)
+            total += count;
+        if (table.hasBlocks)
+            fprintf(out, "Blocks: %lu\n", (unsigned long) counts.blocks);
+        fprintf(out, "Instructions: %lu\n", (unsigned long) total);
+        fprintf(out, "Opcode | Count\n");
+        // Opcodes in alphabetical order
+        for (auto &opcode : table.opcodeIndices)
+            if (counts.instructions[opcode.second])
+                fprintf(out, "%s | %lu\n", opcode.first.c_str(),
+                        (unsigned long) counts.instructions[opcode.second]);
+    }
+    return fclose(out) ? 1 : 0;
+}
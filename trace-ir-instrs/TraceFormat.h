@@ -0,0 +1,62 @@
+// trace-ir-instrs/TraceFormat.h
+//
+// The binary trace written by the runtime for a module instrumented with
+// -trace-ir-binary, shared by TraceRuntime.cpp and TraceDecode.cpp.
+//
+// The file starts with a FileHeader and is followed by chunks. Each chunk
+// is a ChunkHeader and `words` 32-bit words of records written by one thread:
+//
+//   instruction: id
+//   block:       id
+//   load/store:  id, address
+//   call:        id, one 64-bit value per argument with a value
+//
+// 64-bit values are two words, low word first. The kind of a record and the
+// arguments of a call come from the side table the pass writes next to the
+// instrumented module (see -trace-ir-table):
+//
+//   TRACE-IR-TABLE 1
+//   <id> \t <kind> \t <function> \t <opcode> \t <operand types>
+//        [\t <callee> \t <argument>...]
+//
+// where kind is I (instruction), L (load), S (store) or C (call), and every
+// call argument is "ld", "f", "p", "unk" or "s:<string>". Tabs, newlines and
+// backslashes in names are escaped as \t, \n and \\.
+//
+// A block trace (-trace-ir-blocks) logs the entry of a basic block instead
+// of its instructions, except for its memory accesses and calls. A block is
+// described as
+//
+//   <id> \t B \t <function> \t <block name or #index> \t <opcode>:<count>,...
+//
+// where the counts are those of the instructions of the block.
+//
+// A chunk of thread EndOfTrace marks a trace closed by trace_close_log.
+
+#ifndef TRACE_IR_TRACEFORMAT_H
+#define TRACE_IR_TRACEFORMAT_H
+
+#include <stdint.h>
+
+namespace trace_ir {
+
+const char FileMagic[8] = {'K', 'T', 'R', 'A', 'C', 'E', 'I', 'R'};
+const uint32_t FileVersion = 1;
+const char TableMagic[] = "TRACE-IR-TABLE 1";
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct ChunkHeader {
+    uint32_t thread;
+    uint32_t words;
+};
+
+const uint32_t EndOfTrace = 0xffffffff;
+
+} // namespace trace_ir
+
+#endif // TRACE_IR_TRACEFORMAT_H
@@ -6,9 +6,13 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/CommandLine.h"
+#include <fstream>
+#include <map>
 #include <vector>
 #include <set>
 
+#include "TraceFormat.h"
+
 using namespace llvm;
 
 // Configurable start/end function names
@@ -16,6 +20,14 @@ static cl::opt<std::string>
     StartFunction("trace-ir-start", cl::desc("Name of function to start tracing"), cl::init("nf_core_process"));
 static cl::opt<std::string>
     EndFunction("trace-ir-end", cl::desc("Name of function to end tracing"), cl::init("exit@plt"));
+// Binary traces log a static id per instruction instead of its strings
+static cl::opt<bool>
+    BinaryTrace("trace-ir-binary", cl::desc("Log instruction ids and addresses to a buffered binary trace (trace.bin), to be decoded with trace-ir-decode"), cl::init(false));
+static cl::opt<std::string>
+    TableFile("trace-ir-table", cl::desc("Where -trace-ir-binary writes the table describing the instruction ids"), cl::init("trace.table"));
+// Block traces log basic block entries, whose opcode histograms are static
+static cl::opt<bool>
+    BlockTrace("trace-ir-blocks", cl::desc("Only log basic block entries, memory accesses and calls to the binary trace, with the opcode histogram of every block in the table (implies -trace-ir-binary)"), cl::init(false));
 
 namespace {
 
@@ -26,7 +38,11 @@ struct TraceIRInstrs : public ModulePass {
     // Runtime hook declarations
     Type *VoidTy, *Int1Ty, *I8PtrTy, *I32Ty;
     Function *setIsTracing, *checkTracingClosed, *traceClose, *traceInst, *traceCall, *traceMem, *openTraceFile;
+    Function *traceId, *traceIdMem, *traceIdCall, *openTraceBuffer;
     std::set<std::string> runtimeFnNames;
+    // Side table of the binary trace, one line per instruction id
+    std::string table;
+    uint32_t nextId = 0;
 
     void declareRuntimeHooks(Module &M) {
         LLVMContext &Ctx = M.getContext();
@@ -42,6 +58,9 @@ struct TraceIRInstrs : public ModulePass {
         FunctionType *TraceCallTy = FunctionType::get(VoidTy, {I8PtrTy, I8PtrTy, I8PtrTy}, true);
         FunctionType *TraceMemTy = FunctionType::get(VoidTy, {I8PtrTy, I8PtrTy, I8PtrTy}, false);
         FunctionType *OpenTraceFileTy = FunctionType::get(VoidTy, {}, false);
+        FunctionType *TraceIdTy = FunctionType::get(VoidTy, {I32Ty}, false);
+        FunctionType *TraceIdMemTy = FunctionType::get(VoidTy, {I32Ty, I8PtrTy}, false);
+        FunctionType *TraceIdCallTy = FunctionType::get(VoidTy, {I32Ty, I32Ty}, true);
         setIsTracing = cast<Function>(M.getOrInsertFunction("set_is_tracing", SetTracingTy).getCallee());
         checkTracingClosed = cast<Function>(M.getOrInsertFunction("check_tracing_closed", CheckClosedTy).getCallee());
         traceClose = cast<Function>(M.getOrInsertFunction("trace_close_log", TraceCloseTy).getCallee());
@@ -49,6 +68,10 @@ struct TraceIRInstrs : public ModulePass {
         traceCall = cast<Function>(M.getOrInsertFunction("trace_call_log", TraceCallTy).getCallee());
         traceMem = cast<Function>(M.getOrInsertFunction("trace_mem_log", TraceMemTy).getCallee());
         openTraceFile = cast<Function>(M.getOrInsertFunction("open_trace_file", OpenTraceFileTy).getCallee());
+        traceId = cast<Function>(M.getOrInsertFunction("trace_id_log", TraceIdTy).getCallee());
+        traceIdMem = cast<Function>(M.getOrInsertFunction("trace_id_mem_log", TraceIdMemTy).getCallee());
+        traceIdCall = cast<Function>(M.getOrInsertFunction("trace_id_call_log", TraceIdCallTy).getCallee());
+        openTraceBuffer = cast<Function>(M.getOrInsertFunction("open_trace_buffer", OpenTraceFileTy).getCallee());
         // Set of runtime function names to skip
         runtimeFnNames = {
             "set_is_tracing",
@@ -56,7 +79,10 @@ struct TraceIRInstrs : public ModulePass {
             "trace_close_log",
             "trace_inst_log",
             "trace_call_log",
-            "trace_mem_log"
+            "trace_mem_log",
+            "trace_id_log",
+            "trace_id_mem_log",
+            "trace_id_call_log"
         };
     }
 
@@ -86,6 +112,100 @@ struct TraceIRInstrs : public ModulePass {
         return allTypes;
     }
 
+    bool isBinaryTrace() const { return BinaryTrace || BlockTrace; }
+
+    // Helper: escape a table field
+    static std::string escape(StringRef str) {
+        std::string escaped;
+        for (char c : str) {
+            if (c == '\\') escaped += "\\\\";
+            else if (c == '\t') escaped += "\\t";
+            else if (c == '\n') escaped += "\\n";
+            else escaped += c;
+        }
+        return escaped;
+    }
+
+    // Binary trace: log the id of the instruction, with the address of a
+    // memory access or the argument values of a call, and describe the id
+    // in the side table
+    void instrumentInstructionBinary(Function &F, Instruction &I, IRBuilder<> &builder) {
+        Value *id = builder.getInt32(nextId);
+        std::string kind = "I", callInfo;
+        if (auto *call = dyn_cast<CallInst>(&I)) {
+            kind = "C";
+            callInfo = "\t" + escape(call->getCalledFunction() ? call->getCalledFunction()->getName() : "<indirect>");
+            std::vector<Value*> callArgs = {id, nullptr};
+            for (unsigned i = 0; i < call->getNumArgOperands(); ++i) {
+                Value *arg = call->getArgOperand(i);
+                if (arg->getType()->isIntegerTy()) {
+                    callInfo += "\tld";
+                    callArgs.push_back(builder.CreateSExtOrBitCast(arg, builder.getInt64Ty()));
+                } else if (arg->getType()->isFloatingPointTy()) {
+                    callInfo += "\tf";
+                    callArgs.push_back(builder.CreateBitCast(builder.CreateFPCast(arg, builder.getDoubleTy()), builder.getInt64Ty()));
+                } else if (auto *cda = dyn_cast<ConstantDataArray>(arg)) {
+                    if (cda->isString()) {
+                        // Printed with %s, i.e. up to the first NUL
+                        callInfo += "\ts:" + escape(cda->getAsString().split('\0').first);
+                    } else {
+                        callInfo += "\tp";
+                        callArgs.push_back(builder.CreatePtrToInt(builder.CreatePointerCast(arg, I8PtrTy), builder.getInt64Ty()));
+                    }
+                } else if (arg->getType()->isPointerTy()) {
+                    callInfo += "\tp";
+                    callArgs.push_back(builder.CreatePtrToInt(arg, builder.getInt64Ty()));
+                } else {
+                    callInfo += "\tunk";
+                }
+            }
+            callArgs[1] = builder.getInt32(callArgs.size() - 2);
+            builder.CreateCall(traceIdCall, callArgs);
+        } else if (auto *load = dyn_cast<LoadInst>(&I)) {
+            kind = "L";
+            builder.CreateCall(traceIdMem, {id, builder.CreatePointerCast(load->getPointerOperand(), I8PtrTy)});
+        } else if (auto *store = dyn_cast<StoreInst>(&I)) {
+            kind = "S";
+            builder.CreateCall(traceIdMem, {id, builder.CreatePointerCast(store->getPointerOperand(), I8PtrTy)});
+        } else {
+            builder.CreateCall(traceId, {id});
+        }
+        table += std::to_string(nextId) + "\t" + kind + "\t" + escape(F.getName()) + "\t" + I.getOpcodeName() + "\t" + escape(collectOperandTypes(&I)) + callInfo + "\n";
+        nextId++;
+    }
+
+    // Block trace: log the id of the block when entering it, and describe
+    // the block in the side table with the histogram of its opcodes. Only
+    // memory accesses and calls are logged as they happen.
+    bool instrumentBlockEntry(Function &F, BasicBlock &BB, unsigned index) {
+        std::map<std::string, unsigned> histogram;
+        std::vector<Instruction*> logged;
+        for (Instruction &I : BB) {
+            if (auto *call = dyn_cast<CallInst>(&I))
+                if (isRuntimeCall(call)) continue; // Skip calls to runtime functions
+            histogram[I.getOpcodeName()]++;
+            if (isa<CallInst>(&I) || isa<LoadInst>(&I) || isa<StoreInst>(&I))
+                logged.push_back(&I);
+        }
+        // Log the entry after the PHI nodes and after set_is_tracing(true)
+        auto entry = BB.getFirstInsertionPt();
+        while (isa<CallInst>(&*entry) && isRuntimeCall(cast<CallInst>(&*entry)))
+            ++entry;
+        IRBuilder<> builder(&*entry);
+        builder.CreateCall(traceId, {builder.getInt32(nextId)});
+        std::string counts;
+        for (auto &opcode : histogram)
+            counts += (counts.empty() ? "" : ",") + opcode.first + ":" + std::to_string(opcode.second);
+        std::string name = BB.hasName() ? BB.getName().str() : "#" + std::to_string(index);
+        table += std::to_string(nextId) + "\tB\t" + escape(F.getName()) + "\t" + escape(name) + "\t" + counts + "\n";
+        nextId++;
+        for (Instruction *I : logged) {
+            IRBuilder<> builder(I);
+            instrumentInstructionBinary(F, *I, builder);
+        }
+        return true;
+    }
+
     // Instrument a single basic block
     bool instrumentBasicBlock(Function &F, BasicBlock &BB) {
         bool modified = false;
@@ -101,6 +221,11 @@ struct TraceIRInstrs : public ModulePass {
             Instruction *insertAfter = phiNodes.back();
             IRBuilder<> builder(insertAfter->getNextNode());
             for (PHINode *phi : phiNodes) {
+                if (isBinaryTrace()) {
+                    instrumentInstructionBinary(F, *phi, builder);
+                    modified = true;
+                    continue;
+                }
                 Value *fnStr = builder.CreateGlobalStringPtr(F.getName());
                 Value *opStr = builder.CreateGlobalStringPtr(phi->getOpcodeName());
                 // Collect operand types
@@ -114,6 +239,13 @@ struct TraceIRInstrs : public ModulePass {
         for (; it != BB.end(); ++it) {
             Instruction &I = *it;
             IRBuilder<> builder(&I);
+            if (isBinaryTrace()) {
+                if (auto *call = dyn_cast<CallInst>(&I))
+                    if (isRuntimeCall(call)) continue; // Skip calls to runtime functions
+                instrumentInstructionBinary(F, I, builder);
+                modified = true;
+                continue;
+            }
             Value *fnStr = builder.CreateGlobalStringPtr(F.getName());
             Value *opStr = builder.CreateGlobalStringPtr(I.getOpcodeName());
             // Collect operand types
@@ -209,11 +341,12 @@ struct TraceIRInstrs : public ModulePass {
             // Insert open_trace_file at the beginning of main
             Instruction *insertPt = &*F.getEntryBlock().getFirstInsertionPt();
             IRBuilder<> builder(insertPt);
-            builder.CreateCall(openTraceFile);
+            builder.CreateCall(isBinaryTrace() ? openTraceBuffer : openTraceFile);
         }
         // Instrument all basic blocks
+        unsigned index = 0;
         for (BasicBlock &BB : F) {
-            if (instrumentBasicBlock(F, BB))
+            if (BlockTrace ? instrumentBlockEntry(F, BB, index++) : instrumentBasicBlock(F, BB))
                 modified = true;
         }
         return modified;
@@ -227,6 +360,14 @@ struct TraceIRInstrs : public ModulePass {
             if (instrumentFunction(F))
                 modified = true;
         }
+        if (isBinaryTrace()) {
+            std::ofstream tableFile(TableFile);
+            if (!tableFile) {
+                errs() << "ERROR: Failed to open trace table " << TableFile << "\n";
+                exit(1);
+            }
+            tableFile << trace_ir::TableMagic << "\n" << table;
+        }
         return modified;
     }
 };
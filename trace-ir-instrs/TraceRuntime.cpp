@@ -3,12 +3,34 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <string.h>
 #include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "TraceFormat.h"
 
 extern "C" {
 static FILE* trace_file = nullptr;
 static bool is_tracing = false;
 
+// Binary traces (-trace-ir-binary): every thread appends its records to a
+// buffer of its own, which is written out in a single chunk when full. The
+// two first words of a buffer are kept for the chunk header.
+static const uint32_t trace_buffer_words = 1 << 20;
+struct trace_buffer {
+    trace_buffer* next;
+    uint32_t used;
+    uint32_t words[2 + trace_buffer_words];
+};
+static int trace_fd = -1;
+static pthread_mutex_t trace_buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static trace_buffer* trace_buffers = nullptr;
+static uint32_t trace_num_threads = 0;
+static __thread trace_buffer* thread_trace_buffer = nullptr;
+
 // Call this at the beginning of main
 void open_trace_file() {
     if (!trace_file) {
@@ -23,6 +45,95 @@ void open_trace_file() {
     }
 }
 
+static void write_trace(const void* data, size_t size) {
+    const char* p = (const char*) data;
+    while (size) {
+        ssize_t written = write(trace_fd, p, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "ERROR: Failed to write trace file\n");
+            exit(1);
+        }
+        p += written;
+        size -= written;
+    }
+}
+
+static void flush_trace_buffer(trace_buffer* buffer) {
+    // Read the count once, so that the chunk header matches what is written.
+    uint32_t used = buffer->used;
+    if (!used) return;
+    buffer->words[1] = used;
+    write_trace(buffer->words, (2 + used) * sizeof(uint32_t));
+    buffer->used = 0;
+}
+
+static void flush_trace_buffers() {
+    pthread_mutex_lock(&trace_buffers_lock);
+    for (trace_buffer* buffer = trace_buffers; buffer; buffer = buffer->next)
+        flush_trace_buffer(buffer);
+    pthread_mutex_unlock(&trace_buffers_lock);
+}
+
+// Keeps the buffered records of programs that end through exit() (e.g.
+// rte_exit) without calling trace_close_log. The trace is left unclosed.
+// Limitation: exit() does not stop the other threads, which may still
+// append to their buffers while they are written out here; their last
+// records may then be lost or, if a buffer fills up meanwhile, a chunk may
+// be written twice. The buffer of the exiting thread is always complete.
+static void flush_trace_at_exit() {
+    if (trace_fd >= 0)
+        flush_trace_buffers();
+}
+
+// Call this at the beginning of main, instead of open_trace_file
+void open_trace_buffer() {
+    if (trace_fd >= 0) return;
+    trace_fd = open("trace.bin", O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (trace_fd < 0) {
+        fprintf(stderr, "ERROR: Failed to open trace file\n");
+        exit(1);
+    }
+    trace_ir::FileHeader header;
+    memcpy(header.magic, trace_ir::FileMagic, sizeof(header.magic));
+    header.version = trace_ir::FileVersion;
+    header.reserved = 0;
+    write_trace(&header, sizeof(header));
+    static bool flush_at_exit = false;
+    if (!flush_at_exit) {
+        atexit(flush_trace_at_exit);
+        flush_at_exit = true;
+    }
+}
+
+static uint32_t* reserve_trace_words(uint32_t n) {
+    trace_buffer* buffer = thread_trace_buffer;
+    if (!buffer) {
+        buffer = (trace_buffer*) malloc(sizeof(trace_buffer));
+        if (!buffer) {
+            fprintf(stderr, "ERROR: Failed to allocate trace buffer\n");
+            exit(1);
+        }
+        buffer->used = 0;
+        pthread_mutex_lock(&trace_buffers_lock);
+        buffer->words[0] = trace_num_threads++;
+        buffer->next = trace_buffers;
+        trace_buffers = buffer;
+        pthread_mutex_unlock(&trace_buffers_lock);
+        thread_trace_buffer = buffer;
+    }
+    if (buffer->used + n > trace_buffer_words)
+        flush_trace_buffer(buffer);
+    uint32_t* words = buffer->words + 2 + buffer->used;
+    buffer->used += n;
+    return words;
+}
+
+static inline void put_trace_u64(uint32_t* words, uint64_t value) {
+    words[0] = (uint32_t) value;
+    words[1] = (uint32_t) (value >> 32);
+}
+
 void set_is_tracing(bool val) {
     if (is_tracing == val) {
         fprintf(stderr, "ERROR: set_is_tracing called with value already set (%s)!\n", val ? "true" : "false");
@@ -64,6 +175,31 @@ void trace_mem_log(const char* fn, const char* type, const void* addr) {
     is_tracing = true;
 }
 
+void trace_id_log(uint32_t id) {
+    if (!is_tracing || trace_fd < 0) return;
+    *reserve_trace_words(1) = id;
+}
+
+void trace_id_mem_log(uint32_t id, const void* addr) {
+    if (!is_tracing || trace_fd < 0) return;
+    uint32_t* words = reserve_trace_words(3);
+    words[0] = id;
+    put_trace_u64(words + 1, (uint64_t) (uintptr_t) addr);
+}
+
+// The arguments are the 64-bit values of the call arguments, as listed in
+// the side table.
+void trace_id_call_log(uint32_t id, uint32_t nargs, ...) {
+    if (!is_tracing || trace_fd < 0) return;
+    uint32_t* words = reserve_trace_words(1 + 2 * nargs);
+    words[0] = id;
+    va_list args;
+    va_start(args, nargs);
+    for (uint32_t i = 0; i < nargs; i++)
+        put_trace_u64(words + 1 + 2 * i, va_arg(args, uint64_t));
+    va_end(args);
+}
+
 void trace_close_log() {
     if (is_tracing) {
         fprintf(stderr, "ERROR: Tracing was not properly closed before program exit!\n");
@@ -73,5 +209,13 @@ void trace_close_log() {
         fclose(trace_file);
         trace_file = nullptr;
     }
+    if (trace_fd >= 0) {
+        // The other threads are expected to be done tracing by now.
+        flush_trace_buffers();
+        trace_ir::ChunkHeader end = {trace_ir::EndOfTrace, 0};
+        write_trace(&end, sizeof(end));
+        close(trace_fd);
+        trace_fd = -1;
+    }
 }
 } 
\ No newline at end of file
@@ -0,0 +1,88 @@
+//===-- ByteRangeMaskTest.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/ADT/BitArray.h"
+#include "klee/ADT/ByteRangeMask.h"
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+std::vector<ByteRangeMask::Range> ranges(const ByteRangeMask &mask) {
+  return std::vector<ByteRangeMask::Range>(mask.begin(), mask.end());
+}
+
+TEST(ByteRangeMaskTest, MergesOverlappingAndAdjacentRanges) {
+  ByteRangeMask mask;
+  mask.set(10, 20);
+  mask.set(30);
+  mask.set(0, 2);
+  EXPECT_EQ((std::vector<ByteRangeMask::Range>{{0, 2}, {10, 20}, {30, 31}}),
+            ranges(mask));
+
+  // Adjacent ranges coalesce.
+  mask.set(20, 25);
+  mask.set(2);
+  EXPECT_EQ((std::vector<ByteRangeMask::Range>{{0, 3}, {10, 25}, {30, 31}}),
+            ranges(mask));
+
+  // A range covering several others replaces them.
+  mask.set(5, 40);
+  EXPECT_EQ((std::vector<ByteRangeMask::Range>{{0, 3}, {5, 40}}),
+            ranges(mask));
+  EXPECT_EQ(38u, mask.count());
+
+  // Setting bytes already set changes nothing.
+  mask.set(6, 8);
+  mask.set(0);
+  EXPECT_EQ(2u, mask.numRanges());
+}
+
+TEST(ByteRangeMaskTest, Get) {
+  ByteRangeMask mask;
+  EXPECT_FALSE(mask.get(0));
+  mask.set(4, 8);
+  mask.set(12);
+  EXPECT_FALSE(mask.get(3));
+  EXPECT_TRUE(mask.get(4));
+  EXPECT_TRUE(mask.get(7));
+  EXPECT_FALSE(mask.get(8));
+  EXPECT_TRUE(mask.get(12));
+  EXPECT_FALSE(mask.get(13));
+}
+
+TEST(ByteRangeMaskTest, ToBitsMatchesBitwiseMask) {
+  ByteRangeMask mask;
+  BitArray bits(100);
+  unsigned sets[][2] = {{0, 1}, {3, 40}, {63, 64}, {64, 97}};
+  for (auto &s : sets) {
+    mask.set(s[0], s[1]);
+    for (unsigned i = s[0]; i < s[1]; ++i)
+      bits.set(i);
+  }
+  uint32_t words[4] = {1, 2, 3, 4};
+  mask.toBits(words, 4);
+  for (unsigned i = 0; i < 4; ++i)
+    EXPECT_EQ(bits.get_bits()[i], words[i]) << "word " << i;
+}
+
+TEST(ByteRangeMaskTest, BitArraySetsRangesByWord) {
+  BitArray bits(96, false);
+  bits.set(5, 70, true);
+  bits.set(32, 64, false);
+  for (unsigned i = 0; i < 96; ++i)
+    EXPECT_EQ((i >= 5 && i < 32) || (i >= 64 && i < 70), bits.get(i))
+        << "bit " << i;
+}
+
+} // namespace
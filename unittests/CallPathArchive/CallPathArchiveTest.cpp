@@ -0,0 +1,69 @@
+#include "klee/Config/config.h"
+#include "klee/Support/CallPathArchive.h"
+
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+
+using namespace klee;
+
+#ifdef HAVE_ZLIB_H
+namespace {
+void removeArchive(const std::string &path) {
+  std::remove(path.c_str());
+  std::remove((path + ".idx").c_str());
+}
+} // namespace
+
+TEST(CallPathArchiveTest, RoundTrip) {
+  const std::string path = "cpa1.gz";
+  removeArchive(path);
+  std::string error;
+  {
+    CallPathArchiveWriter writer(path, error);
+    ASSERT_TRUE(error.empty()) << error;
+    ASSERT_TRUE(writer.append("test000001.call_path", "first\n", error));
+    ASSERT_TRUE(writer.append("test000002.call_path", "", error));
+    ASSERT_TRUE(writer.append("test000003.call_path",
+                              std::string(100000, 'A'), error));
+  }
+
+  ASSERT_TRUE(CallPathArchiveReader::isArchive(path));
+  auto reader = CallPathArchiveReader::open(path, error);
+  ASSERT_TRUE(reader) << error;
+  ASSERT_EQ(3u, reader->getRecords().size());
+
+  std::string contents;
+  ASSERT_TRUE(reader->read("test000001.call_path", contents, error));
+  EXPECT_EQ("first\n", contents);
+  ASSERT_TRUE(reader->read("test000002.call_path", contents, error));
+  EXPECT_EQ("", contents);
+  ASSERT_TRUE(reader->read(reader->getRecords()[2], contents, error));
+  EXPECT_EQ(std::string(100000, 'A'), contents);
+  EXPECT_FALSE(reader->read("missing", contents, error));
+  removeArchive(path);
+}
+
+/* Reopening an archive appends to it instead of truncating it. */
+TEST(CallPathArchiveTest, Append) {
+  const std::string path = "cpa2.gz";
+  removeArchive(path);
+  std::string error;
+  {
+    CallPathArchiveWriter writer(path, error);
+    ASSERT_TRUE(writer.append("a", "abc", error));
+  }
+  {
+    CallPathArchiveWriter writer(path, error);
+    ASSERT_TRUE(writer.append("b", "defg", error));
+  }
+
+  std::string contents;
+  ASSERT_TRUE(readCallPathFile(path + ":a", contents, error)) << error;
+  EXPECT_EQ("abc", contents);
+  ASSERT_TRUE(readCallPathFile(path + ":b", contents, error)) << error;
+  EXPECT_EQ("defg", contents);
+  removeArchive(path);
+}
+#endif
@@ -0,0 +1,162 @@
+//===-- CallPathFileTest.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/CallPathFile.h"
+#include "klee/Expr/Expr.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+namespace {
+
+std::string toString(const ref<Expr> &e) {
+  std::string s;
+  llvm::raw_string_ostream os(s);
+  os << e;
+  return os.str();
+}
+
+/* Arrays are recreated when reading a call path, so expressions are compared
+   through their printed form. */
+void expectSameCallPath(const CallPathFile &a, const CallPathFile &b) {
+  ASSERT_EQ(a.constraints.size(), b.constraints.size());
+  for (unsigned i = 0; i < a.constraints.size(); ++i)
+    EXPECT_EQ(toString(a.constraints[i]), toString(b.constraints[i]));
+  ASSERT_EQ(a.values.size(), b.values.size());
+  for (unsigned i = 0; i < a.values.size(); ++i)
+    EXPECT_EQ(toString(a.values[i]), toString(b.values[i]));
+  EXPECT_EQ(a.calls, b.calls);
+  EXPECT_EQ(a.tags, b.tags);
+  EXPECT_EQ(a.bpfCalls, b.bpfCalls);
+  EXPECT_EQ(a.pathCost, b.pathCost);
+}
+
+void fillCallPath(ArrayCache &ac, CallPathFile &callPath) {
+  const Array *packet = ac.CreateArray("packet", 64);
+  ref<ConstantExpr> table[] = {ConstantExpr::alloc(1, Expr::Int8),
+                               ConstantExpr::alloc(2, Expr::Int8)};
+  const Array *constant = ac.CreateArray("table", 2, table, table + 2);
+
+  UpdateList updates(packet, nullptr);
+  updates.extend(ConstantExpr::alloc(0, Expr::Int32),
+                 ConstantExpr::alloc(42, Expr::Int8));
+  ref<Expr> byte0 = ReadExpr::create(updates, ConstantExpr::alloc(0, 32));
+  ref<Expr> byte1 = ReadExpr::create(UpdateList(packet, nullptr),
+                                     ConstantExpr::alloc(1, 32));
+  ref<Expr> word = ConcatExpr::create(byte1, byte0);
+  ref<Expr> lookup = ReadExpr::create(UpdateList(constant, nullptr),
+                                      ZExtExpr::create(byte1, Expr::Int32));
+
+  callPath.constraints.push_back(UltExpr::create(word, ConstantExpr::alloc(0x1234, Expr::Int16)));
+  callPath.constraints.push_back(EqExpr::create(lookup, byte0));
+  callPath.values.push_back(word);
+  callPath.values.push_back(
+      SelectExpr::create(callPath.constraints[1], byte1,
+                         ExtractExpr::create(word, 4, Expr::Int8)));
+  callPath.values.push_back(
+      AddExpr::alloc(SExtExpr::create(word, 128),
+                     ConstantExpr::alloc(llvm::APInt(128, {1, 2}))));
+  callPath.calls = "12:f(x:(w32 1)) -> (w32 0)\n"
+                   "extra:PCV:occupancy: &1 = &[(w32 0) -> (w32 1)]\n";
+  callPath.tags.emplace_back("tag", "value");
+  callPath.bpfCalls = "3\n";
+  callPath.pathCost = "instructions = 10\nloads = 2\nstores = 1\ncost = 12\n";
+}
+} // namespace
+
+TEST(CallPathFileTest, BinaryRoundTrip) {
+  ArrayCache ac;
+  CallPathFile original;
+  fillCallPath(ac, original);
+
+  std::string binary;
+  llvm::raw_string_ostream os(binary);
+  original.writeBinary(os);
+  os.flush();
+  ASSERT_TRUE(CallPathFile::isBinary(binary));
+
+  CallPathFile read;
+  std::string error;
+  ASSERT_TRUE(read.read(binary, error)) << error;
+  expectSameCallPath(original, read);
+  EXPECT_EQ(2u, read.arrays.size());
+
+  // The shared subexpressions are read back as a single object.
+  EXPECT_EQ(read.values[0].get(), read.values[2]->getKid(0)->getKid(0).get());
+}
+
+TEST(CallPathFileTest, TextRoundTrip) {
+  ArrayCache ac;
+  CallPathFile original;
+  fillCallPath(ac, original);
+
+  std::string text;
+  llvm::raw_string_ostream os(text);
+  original.writeText(os);
+  os.flush();
+  ASSERT_FALSE(CallPathFile::isBinary(text));
+
+  CallPathFile read;
+  std::string error;
+  ASSERT_TRUE(read.read(text, error)) << error;
+  expectSameCallPath(original, read);
+}
+
+TEST(CallPathFileTest, RejectsTruncatedBinary) {
+  ArrayCache ac;
+  CallPathFile original;
+  fillCallPath(ac, original);
+
+  std::string binary;
+  llvm::raw_string_ostream os(binary);
+  original.writeBinary(os);
+  os.flush();
+
+  CallPathFile read;
+  std::string error;
+  EXPECT_FALSE(read.read(binary.substr(0, binary.size() / 2), error));
+  EXPECT_FALSE(error.empty());
+}
+
+TEST(CallPathFileTest, SharedArrayCache) {
+  ArrayCache ac;
+  CallPathFile original;
+  fillCallPath(ac, original);
+
+  std::string binary, text;
+  llvm::raw_string_ostream binaryOS(binary), textOS(text);
+  original.writeBinary(binaryOS);
+  original.writeText(textOS);
+  binaryOS.flush();
+  textOS.flush();
+
+  ArrayCache shared;
+  const Array *packet;
+  {
+    CallPathFile fromBinary(&shared), fromText(&shared);
+    std::string error;
+    ASSERT_TRUE(fromBinary.read(binary, error)) << error;
+    ASSERT_TRUE(fromText.read(text, error)) << error;
+    ASSERT_EQ(2u, fromBinary.arrays.size());
+    // Symbolic arrays are shared, constant ones are not.
+    packet = fromBinary.arrays[0]->isSymbolicArray() ? fromBinary.arrays[0]
+                                                      : fromBinary.arrays[1];
+    EXPECT_NE(fromText.arrays.end(), std::find(fromText.arrays.begin(),
+                                               fromText.arrays.end(), packet));
+  }
+  // The arrays outlive the call paths.
+  EXPECT_EQ("packet", packet->name);
+  EXPECT_EQ(packet, shared.CreateArray("packet", 64));
+}
@@ -0,0 +1,131 @@
+//===-- PathCostTest.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Core/PathCost.h"
+#include "klee/Module/KInstruction.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// A caller doing `callee(); load; ret` and a callee doing `store; ret`, as
+/// a trace of (call stack, instruction) steps. The functions are built once,
+/// as the call stack trie shared by the process refers to them.
+struct Program {
+  llvm::LLVMContext ctx;
+  std::unique_ptr<llvm::Module> module{new llvm::Module("m", ctx)};
+  std::vector<std::unique_ptr<KInstruction>> kinsts;
+  std::vector<std::pair<CallStackTrie::NodeId, KInstruction *>> trace;
+
+  KInstruction *kinst(llvm::Instruction *inst) {
+    kinsts.emplace_back(new KInstruction());
+    kinsts.back()->inst = inst;
+    return kinsts.back().get();
+  }
+
+  Program() {
+    llvm::Type *voidTy = llvm::Type::getVoidTy(ctx);
+    llvm::Type *intTy = llvm::Type::getInt32Ty(ctx);
+    llvm::FunctionType *fnTy = llvm::FunctionType::get(voidTy, false);
+    llvm::Function *callee = llvm::Function::Create(
+        fnTy, llvm::Function::ExternalLinkage, "pc_callee", module.get());
+    llvm::Function *caller = llvm::Function::Create(
+        fnTy, llvm::Function::ExternalLinkage, "pc_caller", module.get());
+    llvm::GlobalVariable *global = new llvm::GlobalVariable(
+        *module, intTy, false, llvm::GlobalValue::ExternalLinkage,
+        llvm::ConstantInt::get(intTy, 0), "g");
+
+    llvm::IRBuilder<> b(llvm::BasicBlock::Create(ctx, "entry", callee));
+    llvm::Instruction *store =
+        b.CreateStore(llvm::ConstantInt::get(intTy, 1), global);
+    llvm::Instruction *calleeRet = b.CreateRetVoid();
+    b.SetInsertPoint(llvm::BasicBlock::Create(ctx, "entry", caller));
+    llvm::Instruction *call = b.CreateCall(callee);
+    llvm::Instruction *load = b.CreateLoad(intTy, global);
+    llvm::Instruction *callerRet = b.CreateRetVoid();
+
+    CallStackTrie &stacks = CallStackTrie::get();
+    CallStackTrie::NodeId inCaller = stacks.push(CallStackTrie::Root, caller);
+    CallStackTrie::NodeId inCallee = stacks.push(inCaller, callee);
+    trace = {{inCaller, kinst(call)},
+             {inCallee, kinst(store)},
+             {inCallee, kinst(calleeRet)},
+             {inCaller, kinst(load)},
+             {inCaller, kinst(callerRet)}};
+  }
+};
+
+std::vector<bool> run(const PathCostModel &model, PathCost &cost) {
+  static Program program;
+  std::vector<bool> counted;
+  for (const auto &step : program.trace)
+    counted.push_back(model.step(cost, step.first, step.second));
+  return counted;
+}
+
+TEST(PathCostTest, CountsEveryInstructionWithoutDemarcation) {
+  PathCostModel model;
+  std::string error;
+  ASSERT_TRUE(model.parse("cost load 4 # a comment\ncost store 3\n", error))
+      << error;
+
+  PathCost cost;
+  EXPECT_EQ(std::vector<bool>(5, true), run(model, cost));
+  EXPECT_EQ(5u, cost.instructions);
+  EXPECT_EQ(1u, cost.loads);
+  EXPECT_EQ(1u, cost.stores);
+  EXPECT_EQ(3u + 4u + 3u, cost.cost);
+}
+
+TEST(PathCostTest, SkipsDemarcatedFunctions) {
+  PathCostModel model;
+  std::string error;
+  ASSERT_TRUE(model.parse("cost default 2\ndemarcate-regex pc_c.*ee\n", error))
+      << error;
+
+  PathCost cost;
+  EXPECT_EQ(std::vector<bool>({true, false, false, true, true}),
+            run(model, cost));
+  EXPECT_EQ(3u, cost.instructions);
+  EXPECT_EQ(1u, cost.loads);
+  EXPECT_EQ(0u, cost.stores);
+  EXPECT_EQ(6u, cost.cost);
+  EXPECT_EQ("instructions = 3\nloads = 1\nstores = 0\ncost = 6\n",
+            PathCostModel::format(cost));
+}
+
+TEST(PathCostTest, RejectsMalformedConfigs) {
+  std::string error;
+  EXPECT_FALSE(PathCostModel().parse("cost lod 1\n", error));
+  EXPECT_FALSE(PathCostModel().parse("cost load x\n", error));
+  EXPECT_FALSE(PathCostModel().parse("demarcate-regex (\n", error));
+  EXPECT_FALSE(PathCostModel().parse("ignore f\n", error));
+  EXPECT_NE(std::string::npos, error.find("line 1"));
+}
+
+TEST(PathCostModelTest, DefaultModelDemarcatesLibraries) {
+  const PathCostModel &model = PathCostModel::get();
+  EXPECT_TRUE(model.isDemarcated("dmap_get_a"));
+  EXPECT_TRUE(model.isDemarcated("rte_eth_tx_burst"));
+  EXPECT_TRUE(model.isDemarcated("klee"));
+  EXPECT_FALSE(model.isDemarcated("nf_core_process"));
+}
+
+} // namespace
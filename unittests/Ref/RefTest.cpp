@@ -14,6 +14,8 @@
 #include "klee/ADT/Ref.h"
 #include "gtest/gtest.h"
 #include <iostream>
+#include <thread>
+#include <vector>
 
 using klee::ref;
 
@@ -172,3 +174,24 @@ TEST(RefTest, SelfRef) {
   r_root = r_root->next_;
   EXPECT_EQ(2u, r_e_1->_refCount.getCount());
 }
+
+TEST(RefTest, ThreadSafeCounting) {
+  klee::ReferenceCounter::setThreadSafe(true);
+  finished = 0;
+  finished_counter = 0;
+  {
+    ref<Expr> r(new Expr());
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < 4; ++i)
+      threads.emplace_back([&r] {
+        for (unsigned j = 0; j < 100000; ++j)
+          ref<Expr> copy(r);
+      });
+    for (auto &thread : threads)
+      thread.join();
+    EXPECT_EQ(1u, r->_refCount.getCount());
+    finished = 1;
+  }
+  EXPECT_EQ(1, finished_counter);
+  klee::ReferenceCounter::setThreadSafe(false);
+}
@@ -17,10 +17,19 @@
 
 #include "llvm/Support/raw_ostream.h"
 
+#include <bitset>
+#include <memory>
+#include <vector>
+
 using namespace klee;
 
 namespace {
 
+// The label of a process tree edge tagged with `tag`.
+std::string tagLabel(unsigned tag) {
+  return "0b" + std::bitset<PtrBitCount>(tag).to_string();
+}
+
 TEST(SearcherTest, RandomPath) {
   // First state
   ExecutionState es;
@@ -155,13 +164,16 @@ TEST(SearcherTest, TwoRandomPathDot) {
       << "\tnode [style=\"filled\",width=.1,height=.1,fontname=\"Terminus\"]\n"
       << "\tedge [arrowsize=.3]\n"
       << "\tn" << rootPNode << " [shape=diamond];\n"
-      << "\tn" << rootPNode << " -> n" << esParentPNode << " [label=0b011];\n"
-      << "\tn" << rootPNode << " -> n" << rightLeafPNode << " [label=0b000];\n"
+      << "\tn" << rootPNode << " -> n" << esParentPNode
+      << " [label=" << tagLabel(0b011) << "];\n"
+      << "\tn" << rootPNode << " -> n" << rightLeafPNode
+      << " [label=" << tagLabel(0b000) << "];\n"
       << "\tn" << rightLeafPNode << " [shape=diamond,fillcolor=green];\n"
       << "\tn" << esParentPNode << " [shape=diamond];\n"
       << "\tn" << esParentPNode << " -> n" << es1LeafPNode
-      << " [label=0b010];\n"
-      << "\tn" << esParentPNode << " -> n" << esLeafPNode << " [label=0b001];\n"
+      << " [label=" << tagLabel(0b010) << "];\n"
+      << "\tn" << esParentPNode << " -> n" << esLeafPNode
+      << " [label=" << tagLabel(0b001) << "];\n"
       << "\tn" << esLeafPNode << " [shape=diamond,fillcolor=green];\n"
       << "\tn" << es1LeafPNode << " [shape=diamond,fillcolor=green];\n"
       << "}\n";
@@ -186,12 +198,14 @@ TEST(SearcherTest, TwoRandomPathDot) {
       << "\tnode [style=\"filled\",width=.1,height=.1,fontname=\"Terminus\"]\n"
       << "\tedge [arrowsize=.3]\n"
       << "\tn" << rootPNode << " [shape=diamond];\n"
-      << "\tn" << rootPNode << " -> n" << esParentPNode << " [label=0b001];\n"
-      << "\tn" << rootPNode << " -> n" << rightLeafPNode << " [label=0b000];\n"
+      << "\tn" << rootPNode << " -> n" << esParentPNode
+      << " [label=" << tagLabel(0b001) << "];\n"
+      << "\tn" << rootPNode << " -> n" << rightLeafPNode
+      << " [label=" << tagLabel(0b000) << "];\n"
       << "\tn" << rightLeafPNode << " [shape=diamond,fillcolor=green];\n"
       << "\tn" << esParentPNode << " [shape=diamond];\n"
       << "\tn" << esParentPNode << " -> n" << es1LeafPNode
-      << " [label=0b001];\n"
+      << " [label=" << tagLabel(0b001) << "];\n"
       << "\tn" << es1LeafPNode << " [shape=diamond,fillcolor=green];\n"
       << "}\n";
 
@@ -209,9 +223,9 @@ TEST(SearcherDeathTest, TooManyRandomPaths) {
   processTree.remove(es.ptreeNode); // Need to remove to avoid leaks
 
   RNG rng;
-  RandomPathSearcher rp(processTree, rng);
-  RandomPathSearcher rp1(processTree, rng);
-  RandomPathSearcher rp2(processTree, rng);
-  ASSERT_DEATH({ RandomPathSearcher rp3(processTree, rng); }, "");
+  std::vector<std::unique_ptr<RandomPathSearcher>> searchers;
+  for (int i = 0; i < PtrBitCount; ++i)
+    searchers.emplace_back(new RandomPathSearcher(processTree, rng));
+  ASSERT_DEATH({ RandomPathSearcher rp(processTree, rng); }, "");
 }
 }
@@ -0,0 +1,142 @@
+//===-- IndependentSolverTest.cpp -----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+ArrayCache ac;
+
+/// Records the constraints of the queries it receives.
+class RecordingSolver : public SolverImpl {
+public:
+  std::vector<ConstraintSet> &queries;
+
+  explicit RecordingSolver(std::vector<ConstraintSet> &_queries)
+      : queries(_queries) {}
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    queries.push_back(query.constraints);
+    isValid = false;
+    return true;
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    queries.push_back(query.constraints);
+    result = ConstantExpr::create(0, query.expr->getWidth());
+    return true;
+  }
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution) {
+    queries.push_back(query.constraints);
+    for (const Array *array : objects)
+      values.push_back(std::vector<unsigned char>(array->size));
+    hasSolution = true;
+    return true;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
+ref<Expr> read(const Array *array, unsigned index) {
+  return ReadExpr::create(UpdateList(array, nullptr),
+                          ConstantExpr::create(index, Expr::Int32));
+}
+
+ref<Expr> ule(const ref<Expr> &a, const ref<Expr> &b) {
+  return UleExpr::create(a, b);
+}
+
+TEST(IndependentSolverTest, ReusesPartitionsOfPrefixes) {
+  const Array *a = ac.CreateArray("ia", 4);
+  const Array *b = ac.CreateArray("ib", 4);
+  const Array *c = ac.CreateArray("ic", 4);
+
+  std::vector<ConstraintSet> queries;
+  std::unique_ptr<Solver> solver(createIndependentSolver(
+      new Solver(new RecordingSolver(queries))));
+  bool isValid;
+
+  ref<Expr> a0 = ule(read(a, 0), ConstantExpr::create(10, Expr::Int8));
+  ref<Expr> b0 = ule(read(b, 0), ConstantExpr::create(10, Expr::Int8));
+  ref<Expr> a1 = ule(read(a, 1), read(c, 0));
+  ref<Expr> a0c0 = ule(read(a, 0), read(c, 0));
+
+  ConstraintSet parent(std::vector<ref<Expr>>{a0, b0, a1});
+  uint64_t hits = stats::independentPartitionHits;
+  uint64_t misses = stats::independentPartitionMisses;
+
+  // a[0] only depends on the first constraint; a[1] and c[0] are separate.
+  ASSERT_TRUE(solver->impl->computeTruth(
+      Query(parent, ule(read(a, 0), ConstantExpr::create(5, Expr::Int8))),
+      isValid));
+  ASSERT_EQ(1u, queries.back().size());
+  EXPECT_EQ(a0, *queries.back().begin());
+  EXPECT_EQ(misses + 1, stats::independentPartitionMisses);
+
+  // The same constraints again reuse the partition.
+  ASSERT_TRUE(solver->impl->computeTruth(
+      Query(parent, ule(read(c, 0), ConstantExpr::create(5, Expr::Int8))),
+      isValid));
+  ASSERT_EQ(1u, queries.back().size());
+  EXPECT_EQ(a1, *queries.back().begin());
+  EXPECT_EQ(hits + 1, stats::independentPartitionHits);
+
+  // A child state links a[0] and c[0]: only the appended constraint is
+  // indexed, and the factors of both merge in their original order.
+  uint64_t indexed = stats::independentConstraintsIndexed;
+  ConstraintSet child(std::vector<ref<Expr>>{a0, b0, a1, a0c0});
+  ASSERT_TRUE(solver->impl->computeTruth(
+      Query(child, ule(read(a, 0), ConstantExpr::create(5, Expr::Int8))),
+      isValid));
+  EXPECT_EQ(ConstraintSet(std::vector<ref<Expr>>{a0, a1, a0c0}),
+            queries.back());
+  EXPECT_EQ(indexed + 1, stats::independentConstraintsIndexed);
+
+  // A rewritten constraint set shares no prefix but is still partitioned
+  // correctly.
+  ConstraintSet rewritten(std::vector<ref<Expr>>{b0, a0c0});
+  ASSERT_TRUE(solver->impl->computeTruth(
+      Query(rewritten, ule(read(b, 0), ConstantExpr::create(5, Expr::Int8))),
+      isValid));
+  EXPECT_EQ(ConstraintSet(std::vector<ref<Expr>>{b0}), queries.back());
+
+  // Initial values are solved per factor, with the query in its own factor.
+  queries.clear();
+  std::vector<const Array *> objects{a, b, c};
+  std::vector<std::vector<unsigned char>> values;
+  bool hasSolution;
+  ASSERT_TRUE(solver->impl->computeInitialValues(
+      Query(child, ule(ConstantExpr::create(5, Expr::Int8), read(b, 0))),
+      objects, values, hasSolution));
+  ASSERT_TRUE(hasSolution);
+  ASSERT_EQ(3u, values.size());
+  ASSERT_EQ(2u, queries.size());
+  std::vector<size_t> sizes{queries[0].size(), queries[1].size()};
+  std::sort(sizes.begin(), sizes.end());
+  EXPECT_EQ(2u, sizes[0]); // b0 and the negated query
+  EXPECT_EQ(3u, sizes[1]); // a0, a1 and a0c0
+}
+
+} // namespace
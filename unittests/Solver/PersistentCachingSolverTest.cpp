@@ -0,0 +1,217 @@
+//===-- PersistentCachingSolverTest.cpp -----------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+
+#include "llvm/Support/FileSystem.h"
+
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+ArrayCache ac;
+
+/// A core solver for which every assignment is all ones, counting the
+/// queries it receives.
+class CountingSolver : public SolverImpl {
+public:
+  unsigned &queries;
+
+  explicit CountingSolver(unsigned &_queries) : queries(_queries) {}
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    ++queries;
+    isValid = false;
+    return true;
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    ++queries;
+    result = ConstantExpr::create(1, query.expr->getWidth());
+    return true;
+  }
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution) {
+    ++queries;
+    for (const Array *array : objects)
+      values.push_back(std::vector<unsigned char>(array->size, 1));
+    hasSolution = true;
+    return true;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
+ref<Expr> ule(const Array *array, uint64_t value) {
+  ref<Expr> read = ReadExpr::create(UpdateList(array, nullptr),
+                                    ConstantExpr::create(0, Expr::Int32));
+  return UleExpr::create(read, ConstantExpr::create(value, Expr::Int8));
+}
+
+class PersistentCachingSolverTest : public ::testing::Test {
+protected:
+  llvm::SmallString<128> path;
+
+  void SetUp() override {
+    int fd;
+    ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("query-cache", "bin", fd,
+                                                   path));
+    close(fd);
+  }
+
+  void TearDown() override { llvm::sys::fs::remove(path); }
+
+  std::unique_ptr<Solver> open(unsigned &queries) {
+    return std::unique_ptr<Solver>(createPersistentCachingSolver(
+        new Solver(new CountingSolver(queries)), path.str().str()));
+  }
+};
+
+TEST_F(PersistentCachingSolverTest, ReusesResultsOfEarlierRuns) {
+  const Array *x = ac.CreateArray("px", 1);
+  const Array *y = ac.CreateArray("py", 1);
+  std::vector<const Array *> objects{x, y};
+  bool result, hasSolution;
+  ref<ConstantExpr> value;
+  std::vector<std::vector<unsigned char>> values;
+
+  unsigned first = 0;
+  {
+    std::unique_ptr<Solver> solver = open(first);
+    ConstraintSet constraints(std::vector<ref<Expr>>{ule(x, 10), ule(y, 20)});
+    ASSERT_TRUE(solver->mustBeTrue(Query(constraints, ule(x, 5)), result));
+    ASSERT_TRUE(solver->getValue(Query(constraints, ule(y, 5)), value));
+    ASSERT_TRUE(solver->impl->computeInitialValues(
+        Query(constraints, ConstantExpr::alloc(0, Expr::Bool)), objects,
+        values, hasSolution));
+  }
+  EXPECT_EQ(3u, first);
+
+  // A later run answers the same queries from the file, whatever the order
+  // of the constraints.
+  unsigned second = 0;
+  std::unique_ptr<Solver> solver = open(second);
+  ConstraintSet constraints(std::vector<ref<Expr>>{ule(y, 20), ule(x, 10)});
+  uint64_t hits = stats::queryPersistentCacheHits;
+  ASSERT_TRUE(solver->mustBeTrue(Query(constraints, ule(x, 5)), result));
+  EXPECT_FALSE(result);
+  ASSERT_TRUE(solver->getValue(Query(constraints, ule(y, 5)), value));
+  EXPECT_EQ(ConstantExpr::create(1, Expr::Bool), value);
+  values.clear();
+  ASSERT_TRUE(solver->impl->computeInitialValues(
+      Query(constraints, ConstantExpr::alloc(0, Expr::Bool)), objects, values,
+      hasSolution));
+  EXPECT_TRUE(hasSolution);
+  EXPECT_EQ(std::vector<std::vector<unsigned char>>({{1}, {1}}), values);
+
+  // The negation of a cached validity query is cached as well.
+  ASSERT_TRUE(solver->mayBeTrue(
+      Query(constraints, Expr::createIsZero(ule(x, 5))), result));
+  EXPECT_TRUE(result);
+  EXPECT_EQ(0u, second);
+  EXPECT_EQ(hits + 4, stats::queryPersistentCacheHits);
+
+  // A new query reaches the core solver.
+  ASSERT_TRUE(solver->mustBeTrue(Query(constraints, ule(x, 6)), result));
+  EXPECT_EQ(1u, second);
+}
+
+TEST_F(PersistentCachingSolverTest, IdentifiesArraysByPosition) {
+  // Arrays loaded from different files may share a name, and equal arrays
+  // of different runs may not.
+  ArrayCache other;
+  const Array *x = ac.CreateArray("buf", 1);
+  const Array *y = other.CreateArray("buf", 1);
+  const Array *z = ac.CreateArray("renamed", 1);
+  bool result;
+
+  unsigned queries = 0;
+  std::unique_ptr<Solver> solver = open(queries);
+  ConstraintSet same(std::vector<ref<Expr>>{ule(x, 10)});
+  ASSERT_TRUE(solver->mustBeTrue(Query(same, ule(x, 5)), result));
+  EXPECT_EQ(1u, queries);
+
+  // The same query over another array is answered from the file.
+  ConstraintSet renamed(std::vector<ref<Expr>>{ule(z, 10)});
+  ASSERT_TRUE(solver->mustBeTrue(Query(renamed, ule(z, 5)), result));
+  EXPECT_EQ(1u, queries);
+
+  // Two arrays of the same name are still told apart.
+  ConstraintSet different(std::vector<ref<Expr>>{ule(y, 10)});
+  ASSERT_TRUE(solver->mustBeTrue(Query(different, ule(x, 5)), result));
+  EXPECT_EQ(2u, queries);
+}
+
+TEST_F(PersistentCachingSolverTest, SharesResultsBetweenOpenCaches) {
+  const Array *x = ac.CreateArray("sx", 1);
+  ConstraintSet constraints;
+  bool result;
+
+  unsigned first = 0, second = 0;
+  std::unique_ptr<Solver> a = open(first);
+  std::unique_ptr<Solver> b = open(second);
+  ASSERT_TRUE(a->mustBeTrue(Query(constraints, ule(x, 5)), result));
+  ASSERT_TRUE(b->mustBeTrue(Query(constraints, ule(x, 5)), result));
+  ASSERT_TRUE(b->mustBeTrue(Query(constraints, ule(x, 6)), result));
+  ASSERT_TRUE(a->mustBeTrue(Query(constraints, ule(x, 6)), result));
+  EXPECT_EQ(1u, first);
+  EXPECT_EQ(1u, second);
+}
+
+TEST_F(PersistentCachingSolverTest, IgnoresTornRecords) {
+  const Array *x = ac.CreateArray("tx", 1);
+  ConstraintSet constraints;
+  bool result;
+
+  unsigned queries = 0;
+  open(queries)->mustBeTrue(Query(constraints, ule(x, 5)), result);
+  {
+    // A record cut short by a crash.
+    std::ofstream file(path.c_str(), std::ios::app | std::ios::binary);
+    file << std::string(40, 'x');
+  }
+
+  // The valid records are still used, and new ones replace the torn one.
+  std::unique_ptr<Solver> solver = open(queries);
+  ASSERT_TRUE(solver->mustBeTrue(Query(constraints, ule(x, 5)), result));
+  EXPECT_EQ(1u, queries);
+  ASSERT_TRUE(solver->mustBeTrue(Query(constraints, ule(x, 6)), result));
+  EXPECT_EQ(2u, queries);
+  ASSERT_TRUE(open(queries)->mustBeTrue(Query(constraints, ule(x, 6)), result));
+  EXPECT_EQ(2u, queries);
+}
+
+TEST_F(PersistentCachingSolverTest, RejectsForeignFiles) {
+  {
+    std::ofstream file(path.c_str(), std::ios::binary);
+    file << "not a query cache";
+  }
+  unsigned queries = 0;
+  Solver *core = new Solver(new CountingSolver(queries));
+  std::unique_ptr<Solver> solver(
+      createPersistentCachingSolver(core, path.str().str()));
+  EXPECT_EQ(core, solver.get());
+}
+
+} // namespace
@@ -0,0 +1,102 @@
+//===-- SolverServiceTest.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverService.h"
+#include "klee/Solver/SolverStats.h"
+
+#include <memory>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+ArrayCache ac;
+
+/// A core solver for which every assignment is all zeroes.
+class ZeroSolver : public SolverImpl {
+public:
+  time::Span &timeout;
+
+  explicit ZeroSolver(time::Span &_timeout) : timeout(_timeout) {}
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    ++stats::queries;
+    isValid = false;
+    return true;
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    ++stats::queries;
+    result = ConstantExpr::create(0, query.expr->getWidth());
+    return true;
+  }
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution) {
+    ++stats::queries;
+    for (const Array *array : objects)
+      values.push_back(std::vector<unsigned char>(array->size));
+    hasSolution = true;
+    return true;
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+  void setCoreSolverTimeout(time::Span t) { timeout = t; }
+};
+
+ref<Expr> ule(const Array *array, uint64_t value) {
+  ref<Expr> read = ReadExpr::create(UpdateList(array, nullptr),
+                                    ConstantExpr::create(0, Expr::Int32));
+  return UleExpr::create(read, ConstantExpr::create(value, Expr::Int8));
+}
+
+TEST(SolverServiceTest, SharesCachesBetweenClients) {
+  const Array *x = ac.CreateArray("sx", 1);
+  time::Span timeout;
+  std::unique_ptr<SolverService> service =
+      SolverService::create(new Solver(new ZeroSolver(timeout)));
+  std::unique_ptr<Solver> executor(service->createClient("executor"));
+  std::unique_ptr<Solver> analysis(service->createClient("analysis"));
+
+  ConstraintSet constraints;
+  bool result;
+  executor->setCoreSolverTimeout(time::seconds(5));
+  ASSERT_TRUE(executor->mustBeTrue(Query(constraints, ule(x, 10)), result));
+  EXPECT_FALSE(result);
+  EXPECT_EQ(time::seconds(5), timeout);
+
+  // The same query from another client is answered by the caches.
+  ASSERT_TRUE(analysis->mustBeTrue(Query(constraints, ule(x, 10)), result));
+  EXPECT_FALSE(result);
+
+  // A new query of the analysis reaches the core solver with its own
+  // timeout.
+  ASSERT_TRUE(analysis->mustBeTrue(Query(constraints, ule(x, 20)), result));
+  EXPECT_EQ(time::Span(), timeout);
+
+  std::vector<SolverService::ClientStats> stats = service->getClientStats();
+  ASSERT_EQ(2u, stats.size());
+  EXPECT_EQ("executor", stats[0].name);
+  EXPECT_EQ(1u, stats[0].queries);
+  EXPECT_EQ(0u, stats[0].cacheHits);
+  EXPECT_EQ("analysis", stats[1].name);
+  EXPECT_EQ(2u, stats[1].queries);
+  EXPECT_EQ(1u, stats[1].cacheHits);
+}
+
+} // namespace
@@ -0,0 +1,129 @@
+//===-- SymbolConnectivityTest.cpp ----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Core/SymbolConnectivity.h"
+#include "klee/ADT/RNG.h"
+#include "klee/Expr/ArrayCache.h"
+
+#include <string>
+
+using namespace klee;
+
+namespace {
+
+/// The fixpoint SymbolConnectivity replaces, which visits every constraint
+/// in every round.
+std::vector<ref<Expr>> naiveRelevantConstraints(const ConstraintSet &cs,
+                                                SymbolSet symbols) {
+  std::vector<ref<Expr>> ret;
+  llvm::SmallPtrSet<Expr *, 32> inserted;
+  bool newSymbols;
+  do {
+    newSymbols = false;
+    for (const ref<Expr> &c : cs) {
+      if (inserted.count(c.get()))
+        continue;
+      SymbolSet constrained = GetExprSymbols::visit(c);
+      bool intersects = false;
+      for (const Array *a : constrained)
+        intersects = intersects || symbols.count(a);
+      if (!intersects)
+        continue;
+      for (const Array *a : constrained)
+        newSymbols = symbols.insert(a).second || newSymbols;
+      ret.push_back(c);
+      inserted.insert(c.get());
+    }
+  } while (newSymbols);
+  return ret;
+}
+
+ref<Expr> read(const Array *array) {
+  return ReadExpr::create(UpdateList(array, nullptr),
+                          ConstantExpr::alloc(0, Expr::Int32));
+}
+
+class SymbolConnectivityTest : public ::testing::Test {
+protected:
+  ArrayCache cache;
+  std::vector<const Array *> arrays;
+  RNG rng;
+
+  void SetUp() override {
+    for (unsigned i = 0; i < 12; ++i)
+      arrays.push_back(cache.CreateArray("a" + std::to_string(i), 1));
+  }
+
+  /// A constraint over up to three random arrays.
+  ref<Expr> randomConstraint() {
+    unsigned numArrays = rng.getInt32() % 4;
+    ref<Expr> sum = ConstantExpr::alloc(rng.getInt32() % 7, Expr::Int8);
+    for (unsigned i = 0; i < numArrays; ++i)
+      sum = AddExpr::create(sum, read(arrays[rng.getInt32() % arrays.size()]));
+    return UltExpr::create(sum, ConstantExpr::alloc(200, Expr::Int8));
+  }
+
+  void expectSameAsNaive(const SymbolConnectivity &index,
+                         const ConstraintSet &cs) {
+    ASSERT_TRUE(index.isUpToDate(cs));
+    for (unsigned i = 0; i < 20; ++i) {
+      SymbolSet symbols;
+      for (unsigned j = rng.getInt32() % 3; j > 0; --j)
+        symbols.insert(arrays[rng.getInt32() % arrays.size()]);
+      EXPECT_EQ(naiveRelevantConstraints(cs, symbols),
+                index.relevantConstraints(symbols));
+    }
+  }
+};
+
+TEST_F(SymbolConnectivityTest, AppendedConstraints) {
+  std::vector<ref<Expr>> constraints;
+  SymbolConnectivity index;
+  for (unsigned i = 0; i < 30; ++i) {
+    constraints.push_back(randomConstraint());
+    ConstraintSet cs(constraints);
+    index.update(cs);
+    expectSameAsNaive(index, cs);
+  }
+}
+
+TEST_F(SymbolConnectivityTest, RewrittenConstraints) {
+  std::vector<ref<Expr>> constraints;
+  for (unsigned i = 0; i < 30; ++i)
+    constraints.push_back(randomConstraint());
+  SymbolConnectivity index;
+  index.update(ConstraintSet(constraints));
+
+  // Replacing constraints may disconnect components.
+  for (unsigned i = 0; i < 10; ++i) {
+    constraints[rng.getInt32() % constraints.size()] = randomConstraint();
+    ConstraintSet cs(constraints);
+    index.update(cs);
+    expectSameAsNaive(index, cs);
+  }
+}
+
+TEST_F(SymbolConnectivityTest, CopiesAreIndependent) {
+  std::vector<ref<Expr>> constraints;
+  for (unsigned i = 0; i < 10; ++i)
+    constraints.push_back(randomConstraint());
+  SymbolConnectivity index;
+  index.update(ConstraintSet(constraints));
+
+  SymbolConnectivity copy(index);
+  std::vector<ref<Expr>> extended(constraints);
+  extended.push_back(randomConstraint());
+  copy.update(ConstraintSet(extended));
+
+  expectSameAsNaive(index, ConstraintSet(constraints));
+  expectSameAsNaive(copy, ConstraintSet(extended));
+}
+} // namespace